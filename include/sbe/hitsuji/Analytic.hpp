@@ -0,0 +1,43 @@
+/* Generated SBE (Simple Binary Encoding) message codec */
+#ifndef _ANALYTIC_HPP_
+#define _ANALYTIC_HPP_
+
+/* math.h needed for NAN */
+#include <math.h>
+#include "sbe/sbe.hpp"
+
+using namespace sbe;
+
+namespace hitsuji {
+
+class Analytic
+{
+public:
+
+    enum Value 
+    {
+        none = (sbe_uint8_t)0,
+        bar = (sbe_uint8_t)1,
+        rollupBar = (sbe_uint8_t)2,
+        close = (sbe_uint8_t)3,
+        test = (sbe_uint8_t)4,
+        NULL_VALUE = (sbe_uint8_t)255
+    };
+
+    static Analytic::Value get(const sbe_uint8_t value)
+    {
+        switch (value)
+        {
+            case 0: return none;
+            case 1: return bar;
+            case 2: return rollupBar;
+            case 3: return close;
+            case 4: return test;
+            case 255: return NULL_VALUE;
+        }
+
+        throw "unknown value for enum Analytic";
+    }
+};
+}
+#endif
@@ -8,7 +8,7 @@
 
 #include "hitsuji/VarDataEncoding.hpp"
 #include "hitsuji/GroupSizeEncoding.hpp"
-#include "hitsuji/Flags.hpp"
+#include "hitsuji/Analytic.hpp"
 
 using namespace sbe;
 
@@ -29,7 +29,7 @@ public:
 
     static sbe_uint16_t sbeBlockLength(void)
     {
-        return (sbe_uint16_t)12;
+        return (sbe_uint16_t)14;
     }
 
     static sbe_uint16_t sbeTemplateId(void)
@@ -218,7 +218,23 @@ public:
         return *this;
     }
 
-    static const char *rsslBufferMetaAttribute(const MetaAttribute::Attribute metaAttribute)
+    static int shardId(void)
+    {
+        return 4;
+    }
+
+    static int shardSinceVersion(void)
+    {
+         return 0;
+    }
+
+    bool shardInActingVersion(void)
+    {
+        return (actingVersion_ >= 0) ? true : false;
+    }
+
+
+    static const char *shardMetaAttribute(const MetaAttribute::Attribute metaAttribute)
     {
         switch (metaAttribute)
         {
@@ -230,67 +246,69 @@ public:
         return "";
     }
 
-    static const char *rsslBufferCharacterEncoding()
+    static sbe_uint8_t shardNullValue()
     {
-        return "UTF-8";
+        return (sbe_uint8_t)255;
     }
 
-    static int rsslBufferSinceVersion(void)
+    static sbe_uint8_t shardMinValue()
     {
-         return 0;
+        return (sbe_uint8_t)0;
     }
 
-    bool rsslBufferInActingVersion(void)
+    static sbe_uint8_t shardMaxValue()
     {
-        return (actingVersion_ >= 0) ? true : false;
+        return (sbe_uint8_t)254;
     }
 
-    static int rsslBufferId(void)
+    sbe_uint8_t shard(void) const
     {
-        return 3;
+        return (*((sbe_uint8_t *)(buffer_ + offset_ + 12)));
     }
 
+    Reply &shard(const sbe_uint8_t value)
+    {
+        *((sbe_uint8_t *)(buffer_ + offset_ + 12)) = (value);
+        return *this;
+    }
 
-    static int rsslBufferHeaderSize()
+    static int analyticId(void)
     {
-        return 1;
+        return 7;
+    }
+
+    static int analyticSinceVersion(void)
+    {
+         return 0;
     }
 
-    sbe_int64_t rsslBufferLength(void) const
+    bool analyticInActingVersion(void)
     {
-        return (*((sbe_uint8_t *)(buffer_ + position())));
+        return (actingVersion_ >= 0) ? true : false;
     }
 
-    const char *rsslBuffer(void)
+
+    static const char *analyticMetaAttribute(const MetaAttribute::Attribute metaAttribute)
     {
-         const char *fieldPtr = (buffer_ + position() + 1);
-         position(position() + 1 + *((sbe_uint8_t *)(buffer_ + position())));
-         return fieldPtr;
+        switch (metaAttribute)
+        {
+            case MetaAttribute::EPOCH: return "unix";
+            case MetaAttribute::TIME_UNIT: return "nanosecond";
+            case MetaAttribute::SEMANTIC_TYPE: return "";
+        }
+
+        return "";
     }
 
-    int getRsslBuffer(char *dst, const int length)
+    Analytic::Value analytic(void) const
     {
-        sbe_uint64_t sizeOfLengthField = 1;
-        sbe_uint64_t lengthPosition = position();
-        position(lengthPosition + sizeOfLengthField);
-        sbe_int64_t dataLength = (*((sbe_uint8_t *)(buffer_ + lengthPosition)));
-        int bytesToCopy = (length < dataLength) ? length : dataLength;
-        sbe_uint64_t pos = position();
-        position(position() + (sbe_uint64_t)dataLength);
-        ::memcpy(dst, buffer_ + pos, bytesToCopy);
-        return bytesToCopy;
+        return Analytic::get((*((sbe_uint8_t *)(buffer_ + offset_ + 13))));
     }
 
-    int putRsslBuffer(const char *src, const int length)
+    Reply &analytic(const Analytic::Value value)
     {
-        sbe_uint64_t sizeOfLengthField = 1;
-        sbe_uint64_t lengthPosition = position();
-        *((sbe_uint8_t *)(buffer_ + lengthPosition)) = ((sbe_uint8_t)length);
-        position(lengthPosition + sizeOfLengthField);
-        sbe_uint64_t pos = position();
-        position(position() + (sbe_uint64_t)length);
-        ::memcpy(buffer_ + pos, src, length);
-        return length;
+        *((sbe_uint8_t *)(buffer_ + offset_ + 13)) = (value);
+        return *this;
     }
 };
 }
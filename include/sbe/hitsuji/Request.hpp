@@ -29,7 +29,7 @@ public:
 
     static sbe_uint16_t sbeBlockLength(void)
     {
-        return (sbe_uint16_t)17;
+        return (sbe_uint16_t)34;
     }
 
     static sbe_uint16_t sbeTemplateId(void)
@@ -365,6 +365,168 @@ public:
         return flags_;
     }
 
+    static int shardId(void)
+    {
+        return 9;
+    }
+
+    static int shardSinceVersion(void)
+    {
+         return 0;
+    }
+
+    bool shardInActingVersion(void)
+    {
+        return (actingVersion_ >= 0) ? true : false;
+    }
+
+
+    static const char *shardMetaAttribute(const MetaAttribute::Attribute metaAttribute)
+    {
+        switch (metaAttribute)
+        {
+            case MetaAttribute::EPOCH: return "unix";
+            case MetaAttribute::TIME_UNIT: return "nanosecond";
+            case MetaAttribute::SEMANTIC_TYPE: return "";
+        }
+
+        return "";
+    }
+
+    static sbe_uint8_t shardNullValue()
+    {
+        return (sbe_uint8_t)255;
+    }
+
+    static sbe_uint8_t shardMinValue()
+    {
+        return (sbe_uint8_t)0;
+    }
+
+    static sbe_uint8_t shardMaxValue()
+    {
+        return (sbe_uint8_t)254;
+    }
+
+    sbe_uint8_t shard(void) const
+    {
+        return (*((sbe_uint8_t *)(buffer_ + offset_ + 17)));
+    }
+
+    Request &shard(const sbe_uint8_t value)
+    {
+        *((sbe_uint8_t *)(buffer_ + offset_ + 17)) = (value);
+        return *this;
+    }
+
+    static int readTimeId(void)
+    {
+        return 10;
+    }
+
+    static int readTimeSinceVersion(void)
+    {
+         return 0;
+    }
+
+    bool readTimeInActingVersion(void)
+    {
+        return (actingVersion_ >= 0) ? true : false;
+    }
+
+
+    static const char *readTimeMetaAttribute(const MetaAttribute::Attribute metaAttribute)
+    {
+        switch (metaAttribute)
+        {
+            case MetaAttribute::EPOCH: return "unix";
+            case MetaAttribute::TIME_UNIT: return "nanosecond";
+            case MetaAttribute::SEMANTIC_TYPE: return "";
+        }
+
+        return "";
+    }
+
+    static sbe_uint64_t readTimeNullValue()
+    {
+        return 0xffffffffffffffffL;
+    }
+
+    static sbe_uint64_t readTimeMinValue()
+    {
+        return 0x0L;
+    }
+
+    static sbe_uint64_t readTimeMaxValue()
+    {
+        return 0xfffffffffffffffeL;
+    }
+
+    sbe_uint64_t readTime(void) const
+    {
+        return SBE_LITTLE_ENDIAN_ENCODE_64(*((sbe_uint64_t *)(buffer_ + offset_ + 18)));
+    }
+
+    Request &readTime(const sbe_uint64_t value)
+    {
+        *((sbe_uint64_t *)(buffer_ + offset_ + 18)) = SBE_LITTLE_ENDIAN_ENCODE_64(value);
+        return *this;
+    }
+
+    static int queueTimeId(void)
+    {
+        return 11;
+    }
+
+    static int queueTimeSinceVersion(void)
+    {
+         return 0;
+    }
+
+    bool queueTimeInActingVersion(void)
+    {
+        return (actingVersion_ >= 0) ? true : false;
+    }
+
+
+    static const char *queueTimeMetaAttribute(const MetaAttribute::Attribute metaAttribute)
+    {
+        switch (metaAttribute)
+        {
+            case MetaAttribute::EPOCH: return "unix";
+            case MetaAttribute::TIME_UNIT: return "nanosecond";
+            case MetaAttribute::SEMANTIC_TYPE: return "";
+        }
+
+        return "";
+    }
+
+    static sbe_uint64_t queueTimeNullValue()
+    {
+        return 0xffffffffffffffffL;
+    }
+
+    static sbe_uint64_t queueTimeMinValue()
+    {
+        return 0x0L;
+    }
+
+    static sbe_uint64_t queueTimeMaxValue()
+    {
+        return 0xfffffffffffffffeL;
+    }
+
+    sbe_uint64_t queueTime(void) const
+    {
+        return SBE_LITTLE_ENDIAN_ENCODE_64(*((sbe_uint64_t *)(buffer_ + offset_ + 26)));
+    }
+
+    Request &queueTime(const sbe_uint64_t value)
+    {
+        *((sbe_uint64_t *)(buffer_ + offset_ + 26)) = SBE_LITTLE_ENDIAN_ENCODE_64(value);
+        return *this;
+    }
+
     class View
     {
     private:
@@ -556,27 +718,27 @@ public:
 
     static int itemNameHeaderSize()
     {
-        return 1;
+        return 4;
     }
 
     sbe_int64_t itemNameLength(void) const
     {
-        return (*((sbe_uint8_t *)(buffer_ + position())));
+        return SBE_LITTLE_ENDIAN_ENCODE_32(*((sbe_uint32_t *)(buffer_ + position())));
     }
 
     const char *itemName(void)
     {
-         const char *fieldPtr = (buffer_ + position() + 1);
-         position(position() + 1 + *((sbe_uint8_t *)(buffer_ + position())));
+         const char *fieldPtr = (buffer_ + position() + 4);
+         position(position() + 4 + SBE_LITTLE_ENDIAN_ENCODE_32(*((sbe_uint32_t *)(buffer_ + position()))));
          return fieldPtr;
     }
 
     int getItemName(char *dst, const int length)
     {
-        sbe_uint64_t sizeOfLengthField = 1;
+        sbe_uint64_t sizeOfLengthField = 4;
         sbe_uint64_t lengthPosition = position();
         position(lengthPosition + sizeOfLengthField);
-        sbe_int64_t dataLength = (*((sbe_uint8_t *)(buffer_ + lengthPosition)));
+        sbe_int64_t dataLength = SBE_LITTLE_ENDIAN_ENCODE_32(*((sbe_uint32_t *)(buffer_ + lengthPosition)));
         int bytesToCopy = (length < dataLength) ? length : dataLength;
         sbe_uint64_t pos = position();
         position(position() + (sbe_uint64_t)dataLength);
@@ -586,9 +748,9 @@ public:
 
     int putItemName(const char *src, const int length)
     {
-        sbe_uint64_t sizeOfLengthField = 1;
+        sbe_uint64_t sizeOfLengthField = 4;
         sbe_uint64_t lengthPosition = position();
-        *((sbe_uint8_t *)(buffer_ + lengthPosition)) = ((sbe_uint8_t)length);
+        *((sbe_uint32_t *)(buffer_ + lengthPosition)) = SBE_LITTLE_ENDIAN_ENCODE_32((sbe_uint32_t)length);
         position(lengthPosition + sizeOfLengthField);
         sbe_uint64_t pos = position();
         position(position() + (sbe_uint64_t)length);
@@ -36,29 +36,29 @@ public:
     }
 
 
-    static sbe_uint8_t lengthNullValue()
+    static sbe_uint32_t lengthNullValue()
     {
-        return (sbe_uint8_t)255;
+        return 4294967295;
     }
 
-    static sbe_uint8_t lengthMinValue()
+    static sbe_uint32_t lengthMinValue()
     {
-        return (sbe_uint8_t)0;
+        return 0;
     }
 
-    static sbe_uint8_t lengthMaxValue()
+    static sbe_uint32_t lengthMaxValue()
     {
-        return (sbe_uint8_t)254;
+        return 4294967294;
     }
 
-    sbe_uint8_t length(void) const
+    sbe_uint32_t length(void) const
     {
-        return (*((sbe_uint8_t *)(buffer_ + offset_ + 0)));
+        return SBE_LITTLE_ENDIAN_ENCODE_32(*((sbe_uint32_t *)(buffer_ + offset_ + 0)));
     }
 
-    VarDataEncoding &length(const sbe_uint8_t value)
+    VarDataEncoding &length(const sbe_uint32_t value)
     {
-        *((sbe_uint8_t *)(buffer_ + offset_ + 0)) = (value);
+        *((sbe_uint32_t *)(buffer_ + offset_ + 0)) = SBE_LITTLE_ENDIAN_ENCODE_32(value);
         return *this;
     }
 
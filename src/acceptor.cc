@@ -0,0 +1,457 @@
+/* RSSL server socket and connection handshakes.
+ */
+
+#include "acceptor.hh"
+
+#include <sstream>
+
+#include <windows.h>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+#include "chromium/logging.hh"
+#include "chromium/metrics/histogram.hh"
+#include "upaostream.hh"
+#include "provider.hh"
+#include "upa.hh"
+
+/* Longest readiness wait, bounds handshake expiry. */
+static const int kMaxPollTimeoutMs = 1000;
+
+/* Handshakes outstanding longer are closed, releasing session capacity. */
+static const uint64_t kHandshakeTimeoutMs = 60 * 1000;
+
+/* Acceptor clock. */
+static inline
+uint64_t
+monotonic_milliseconds()
+{
+	using namespace boost::chrono;
+	return duration_cast<milliseconds> (steady_clock::now().time_since_epoch()).count();
+}
+
+hitsuji::acceptor_t::acceptor_t (
+	const hitsuji::config_t& config,
+	std::shared_ptr<hitsuji::upa_t> upa
+	) :
+	creation_time_ (boost::posix_time::second_clock::universal_time()),
+	config_ (config),
+	upa_ (upa),
+	rssl_sock_ (nullptr),
+	keep_running_ (true),
+	ready_count_ (0),
+	now_ (0),
+	handshake_ms_ (nullptr),
+	stats_slot_ (0),
+	next_stats_time_ (0)
+{
+}
+
+hitsuji::acceptor_t::~acceptor_t()
+{
+	DLOG(INFO) << "~acceptor_t";
+	Close();
+/* Cleanup RSSL stack. */
+	upa_.reset();
+/* Summary output */
+	using namespace boost::posix_time;
+	auto uptime = second_clock::universal_time() - creation_time_;
+	VLOG(3) << "Acceptor summary: {"
+		 " \"Uptime\": \"" << to_simple_string (uptime) << "\""
+		", \"ConnectionsReceived\": " << cumulative_stats_[ACCEPTOR_PC_CONNECTION_RECEIVED] <<
+		", \"ConnectionsRejected\": " << cumulative_stats_[ACCEPTOR_PC_CONNECTION_REJECTED] <<
+		", \"ConnectionsAccepted\": " << cumulative_stats_[ACCEPTOR_PC_CONNECTION_ACCEPTED] <<
+		", \"ConnectionsHandedOver\": " << cumulative_stats_[ACCEPTOR_PC_CONNECTION_HANDED_OVER] <<
+		", \"HandshakeExceptions\": " << cumulative_stats_[ACCEPTOR_PC_HANDSHAKE_EXCEPTION] <<
+		", \"HandshakeTimeouts\": " << cumulative_stats_[ACCEPTOR_PC_HANDSHAKE_TIMEOUT] <<
+		" }";
+	if (VLOG_IS_ON(3) && nullptr != handshake_ms_) {
+		std::string handshakes;
+		handshake_ms_->WriteAscii (true, "\n", &handshakes);
+		VLOG(3) << handshakes;
+	}
+}
+
+/* 7.2. Establish Network Communication.
+ * Open RSSL port and listen for incoming connection attempts.
+ */
+bool
+hitsuji::acceptor_t::Initialize()
+{
+#ifndef NDEBUG
+	RsslBindOptions addr = RSSL_INIT_BIND_OPTS;
+#else
+	RsslBindOptions addr;
+	rsslClearBindOpts (&addr);
+#endif
+	RsslError rssl_err;
+
+/* Readiness notification, persistent across passes. */
+	if (!poller_.Initialize())
+		return false;
+	handshake_ms_ = chromium::Histogram::FactoryGet ("Acceptor.HandshakeMs", 1, 60000, 50, chromium::Histogram::kNoFlags);
+	expired_.reserve (config_.session_capacity);
+	now_ = monotonic_milliseconds();
+
+/* 9.4.1. Bind server socket. */
+	VLOG(3) << "Binding RSSL server socket.";
+	addr.serviceName             = const_cast<char*> (config_.rssl_port.c_str());	// port or service name
+	addr.protocolType	     = RSSL_RWF_PROTOCOL_TYPE;
+	addr.majorVersion	     = RSSL_RWF_MAJOR_VERSION;
+	addr.minorVersion	     = RSSL_RWF_MINOR_VERSION;
+/* Replies beyond a packed buffer are fragmented to at most this size. */
+	addr.maxFragmentSize	     = static_cast<RsslUInt32> (config_.maximum_data_size > UINT16_MAX ? UINT16_MAX : config_.maximum_data_size);
+/* Compression is offered, each client negotiates at connect. */
+	if (0 == config_.compression.compare ("zlib")) {
+		addr.compressionType = RSSL_COMP_ZLIB;
+		addr.compressionLevel = static_cast<RsslUInt32> (config_.compression_level > 9 ? 9 : config_.compression_level);
+	} else if (0 == config_.compression.compare ("lz4")) {
+		addr.compressionType = RSSL_COMP_LZ4;
+	} else {
+		LOG_IF(WARNING, !config_.compression.empty() && 0 != config_.compression.compare ("none"))
+			<< "Unknown compression type \"" << config_.compression << "\", compression disabled.";
+		addr.compressionType = RSSL_COMP_NONE;
+	}
+
+	RsslServer* s = rsslBind (&addr, &rssl_err);
+/* Hard failure on bind as likely a configuration issue. */
+	if (nullptr == s) {
+		LOG(ERROR) << "rsslBind: { "
+			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
+			", \"sysError\": " << rssl_err.sysError << ""
+			", \"text\": \"" << rssl_err.text << "\""
+			", \"serviceName\": \"" << addr.serviceName << "\""
+			", \"protocolType\": \"" << internal::protocol_type_string (addr.protocolType) << "\""
+			", \"majorVersion\": " << static_cast<unsigned> (addr.majorVersion) << ""
+			", \"minorVersion\": " << static_cast<unsigned> (addr.minorVersion) << ""
+			" }";
+		return false;
+	} else {
+		LOG(INFO) << "RSSL server socket created: { "
+			  "\"portNumber\": " << s->portNumber << ""
+			", \"protocolType\": \"" << internal::protocol_type_string (addr.protocolType) << "\""
+			", \"majorVersion\": " << static_cast<unsigned> (addr.majorVersion) << ""
+			", \"minorVersion\": " << static_cast<unsigned> (addr.minorVersion) << ""
+			", \"compressionType\": \"" << internal::compression_type_string (static_cast<RsslCompTypes> (addr.compressionType)) << "\""
+			", \"compressionLevel\": " << addr.compressionLevel << ""
+			", \"maxFragmentSize\": " << addr.maxFragmentSize << ""
+			", \"socketId\": " << s->socketId << ""
+			", \"state\": \"" << internal::channel_state_string (s->state) << "\""
+			" }";
+		rssl_sock_ = s;
+	}
+	return true;
+}
+
+void
+hitsuji::acceptor_t::Run()
+{
+	DCHECK(keep_running_) << "Quit must have been called outside of Run!";
+
+	poller_.Add (rssl_sock_->socketId, poller_t::kRead, nullptr);
+	ready_count_ = 0;
+
+/* Stats table column for the acceptor thread. */
+	if (0 == stats_slot_) {
+		stats_slot_ = RegisterStatsThread ("Acceptor");
+		acceptor_rows_.Bind (stats_slot_, kAcceptorStatsNames);
+	}
+
+	for (;;) {
+		bool did_work = DoWork();
+
+		if (!keep_running_)
+			break;
+
+		if (did_work)
+			continue;
+
+		ready_count_ = poller_.Wait (kMaxPollTimeoutMs);
+	}
+
+	keep_running_ = true;
+}
+
+void
+hitsuji::acceptor_t::Quit()
+{
+	keep_running_ = false;
+	poller_.Wake();
+}
+
+bool
+hitsuji::acceptor_t::DoWork()
+{
+	bool did_work = false;
+
+	now_ = monotonic_milliseconds();
+
+	if (ready_count_ > 0) {
+		const auto& events = poller_.events();
+		for (size_t i = 0; i < events.size(); ++i) {
+			const poller_t::event_t event = events[i];
+/* removed during this pass */
+			if (0 == event.events)
+				continue;
+/* New client connection */
+			if (rssl_sock_->socketId == event.fd) {
+				OnConnection();
+				did_work = true;
+				continue;
+			}
+			RsslChannel* c = static_cast<RsslChannel*> (event.context);
+			DCHECK (nullptr != c);
+			if (event.events & poller_t::kError) {
+				Close (c);
+			} else {
+				OnInitializingState (c);
+			}
+			did_work = true;
+		}
+		ready_count_ = 0;
+	}
+
+	ExpireHandshakes();
+
+/* Counters copied to the shared-memory stats table */
+	if (0 != stats_slot_ && now_ >= next_stats_time_) {
+		acceptor_rows_.Publish (cumulative_stats_);
+		next_stats_time_ = now_ + config_.stats_interval_ms;
+	}
+	return did_work;
+}
+
+void
+hitsuji::acceptor_t::ExpireHandshakes()
+{
+	for (auto it = handshakes_.begin(); it != handshakes_.end(); ++it) {
+		if (now_ - it->second >= kHandshakeTimeoutMs)
+			expired_.push_back (it->first);
+	}
+	for (auto it = expired_.begin(); it != expired_.end(); ++it) {
+		cumulative_stats_[ACCEPTOR_PC_HANDSHAKE_TIMEOUT]++;
+		LOG(WARNING) << "RSSL handshake timeout, closing connection.";
+		Close (*it);
+	}
+	expired_.clear();
+}
+
+/* 7.2. Establish Network Communication.
+ * When an OMM consumer application attempts to connection begin the initialization process.
+ */
+void
+hitsuji::acceptor_t::OnConnection()
+{
+	cumulative_stats_[ACCEPTOR_PC_CONNECTION_RECEIVED]++;
+/* Capacity is shared by all shards and connections still initializing. */
+	size_t connection_count = handshakes_.size();
+	for (auto it = shards_.begin(); it != shards_.end(); ++it)
+		connection_count += (*it)->connection_count();
+	if (!keep_running_ || connection_count >= config_.session_capacity)
+		RejectConnection();
+	else
+		AcceptConnection();
+}
+
+void
+hitsuji::acceptor_t::RejectConnection()
+{
+#ifndef NDEBUG
+	RsslAcceptOptions addr = RSSL_INIT_ACCEPT_OPTS;
+#else
+	RsslAcceptOptions addr;
+	rsslClearAcceptOpts (&addr);
+#endif
+	RsslError rssl_err;
+
+	VLOG(2) << "Rejecting new connection request.";
+
+	addr.nakMount = RSSL_TRUE;
+	RsslChannel* c = rsslAccept (rssl_sock_, &addr, &rssl_err);
+	if (nullptr == c) {
+		LOG(ERROR) << "rsslAccept: { "
+			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
+			", \"sysError\": " << rssl_err.sysError << ""
+			", \"text\": \"" << rssl_err.text << "\""
+			", \"nakMount\": " << (addr.nakMount ? "true" : "false") << ""
+			" }";
+	}
+	cumulative_stats_[ACCEPTOR_PC_CONNECTION_REJECTED]++;
+}
+
+void
+hitsuji::acceptor_t::AcceptConnection()
+{
+#ifndef NDEBUG
+	RsslAcceptOptions addr = RSSL_INIT_ACCEPT_OPTS;
+#else
+	RsslAcceptOptions addr;
+	rsslClearAcceptOpts (&addr);
+#endif
+	RsslError rssl_err;
+
+	VLOG(2) << "Accepting new connection request.";
+
+	addr.nakMount = RSSL_FALSE;
+	RsslChannel* c = rsslAccept (rssl_sock_, &addr, &rssl_err);
+	if (nullptr == c) {
+		LOG(ERROR) << "rsslAccept: { "
+			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
+			", \"sysError\": " << rssl_err.sysError << ""
+			", \"text\": \"" << rssl_err.text << "\""
+			", \"nakMount\": " << (addr.nakMount ? "true" : "false") << ""
+			" }";
+		return;
+	}
+
+/* Initialize here until active. */
+	handshakes_.emplace (c, now_);
+	poller_.Add (c->socketId, poller_t::kRead, c);
+	cumulative_stats_[ACCEPTOR_PC_CONNECTION_ACCEPTED]++;
+
+	std::stringstream client_hostname, client_ip;
+	if (nullptr == c->clientHostname) 
+		client_hostname << "null";
+	else	
+		client_hostname << '"' << c->clientHostname << '"';
+	if (nullptr == c->clientIP)	
+		client_ip << "null";
+	else	
+		client_ip << '"' << c->clientIP << '"';
+
+	LOG(INFO) << "RSSL client socket created: { "
+		  "\"clientHostname\": " << client_hostname.str() << ""
+		", \"clientIP\": " << client_ip.str() << ""
+		", \"connectionType\": \"" << internal::connection_type_string (c->connectionType) << "\""
+		", \"majorVersion\": " << static_cast<unsigned> (c->majorVersion) << ""
+		", \"minorVersion\": " << static_cast<unsigned> (c->minorVersion) << ""
+		", \"pingTimeout\": " << c->pingTimeout << ""
+		", \"protocolType\": \"" << internal::protocol_type_string (c->protocolType) << "\""
+		", \"socketId\": " << c->socketId << ""
+		", \"state\": \"" << internal::channel_state_string (c->state) << "\""
+		" }";
+}
+
+void
+hitsuji::acceptor_t::OnInitializingState (
+	RsslChannel* c
+	)
+{
+	RsslInProgInfo state;
+	RsslError rssl_err;
+	RsslRet rc;
+
+	DCHECK (nullptr != c);
+
+/* In place of absent API: rsslClearError (&rssl_err); */
+	rssl_err.rsslErrorId = 0;
+	rssl_err.sysError = 0;
+	rssl_err.text[0] = '\0';
+
+	rc = rsslInitChannel (c, &state, &rssl_err);
+	switch (rc) {
+	case RSSL_RET_CHAN_INIT_IN_PROGRESS:
+		if ((state.flags & RSSL_IP_FD_CHANGE) == RSSL_IP_FD_CHANGE) {
+			cumulative_stats_[ACCEPTOR_PC_RSSL_PROTOCOL_DOWNGRADE]++;
+			LOG(INFO) << "RSSL protocol downgrade, reconnected.";
+			poller_.Replace (state.oldSocket, c->socketId);
+		} else {
+			LOG(INFO) << "RSSL connection in progress.";
+		}
+		break;
+	case RSSL_RET_SUCCESS:
+		HandOver (c);
+		break;
+	default:
+		cumulative_stats_[ACCEPTOR_PC_HANDSHAKE_EXCEPTION]++;
+		LOG(ERROR) << "rsslInitChannel: { "
+			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
+			", \"sysError\": " << rssl_err.sysError << ""
+			", \"text\": \"" << rssl_err.text << "\""
+			" }";
+		Close (c);
+		break;
+	}
+}
+
+/* Least loaded event loop owns the active connection for its lifetime. */
+void
+hitsuji::acceptor_t::HandOver (
+	RsslChannel* c
+	)
+{
+	DCHECK (nullptr != c);
+	auto it = handshakes_.find (c);
+	DCHECK (handshakes_.end() != it);
+	handshake_ms_->Add (static_cast<int> (now_ - it->second));
+	handshakes_.erase (it);
+	poller_.Remove (c->socketId);
+
+	DCHECK (!shards_.empty());
+	provider_t* owner = shards_.front();
+	for (auto jt = shards_.begin(); jt != shards_.end(); ++jt) {
+		if ((*jt)->connection_count() < owner->connection_count())
+			owner = *jt;
+	}
+	owner->Adopt (c);
+	cumulative_stats_[ACCEPTOR_PC_CONNECTION_HANDED_OVER]++;
+	VLOG(2) << "Handed over active connection: { "
+		  "\"socketId\": " << c->socketId << ""
+		", \"shard\": " << owner->shard() << ""
+		" }";
+}
+
+void
+hitsuji::acceptor_t::Close (
+	RsslChannel* c
+	)
+{
+	RsslError rssl_err;
+
+	DCHECK (nullptr != c);
+
+	handshakes_.erase (c);
+	poller_.Remove (c->socketId);
+	LOG(INFO) << "Closing RSSL connection.";
+	if (RSSL_RET_SUCCESS != rsslCloseChannel (c, &rssl_err)) {
+		LOG(WARNING) << "rsslCloseChannel: { "
+			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
+			", \"sysError\": " << rssl_err.sysError << ""
+			", \"text\": \"" << rssl_err.text << "\""
+			" }";
+	}
+}
+
+void
+hitsuji::acceptor_t::Close()
+{
+/* Connections still initializing. */
+	VLOG_IF(3, handshakes_.size() > 0) << "Closing " << handshakes_.size() << " initializing connections.";
+	while (!handshakes_.empty())
+		Close (handshakes_.begin()->first);
+
+/* Closing listening socket. */
+	if (nullptr != rssl_sock_) {
+		RsslServerInfo server_info;
+		RsslError rssl_err;
+		VLOG(3) << "Closing RSSL server socket.";
+		VLOG_IF(3, RSSL_RET_SUCCESS == rsslGetServerInfo (rssl_sock_, &server_info, &rssl_err))
+			<< "RSSL server summary: {"
+			 " \"currentBufferUsage\": " << server_info.currentBufferUsage << ""
+			", \"peakBufferUsage\": " << server_info.peakBufferUsage << ""
+			" }";
+		poller_.Remove (rssl_sock_->socketId);
+		if (RSSL_RET_SUCCESS != rsslCloseServer (rssl_sock_, &rssl_err)) {
+			LOG(ERROR) << "rsslCloseServer: { "
+				  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
+				", \"sysError\": " << rssl_err.sysError << ""
+				", \"text\": \"" << rssl_err.text << "\""
+				" }";
+		}
+		rssl_sock_ = nullptr;
+	}
+	VLOG(3) << "Acceptor closed.";
+}
+
+/* eof */
\ No newline at end of file
@@ -0,0 +1,123 @@
+/* RSSL server socket and connection handshakes on a dedicated thread.  Channels are handed
+ * to the least loaded event loop once active, so a reconnect storm does not delay replies
+ * to established clients.
+ */
+
+#ifndef ACCEPTOR_HH_
+#define ACCEPTOR_HH_
+
+#include <winsock2.h>
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/* Boost Atomics */
+#include <boost/atomic.hpp>
+
+/* Boost Posix Time */
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+/* UPA 7.2 */
+#include <upa/upa.h>
+
+#include "chromium/debug/leak_tracker.hh"
+#include "config.hh"
+#include "counters.hh"
+#include "poller.hh"
+#include "stats.hh"
+
+namespace chromium
+{
+	class Histogram;
+}
+
+namespace hitsuji
+{
+/* Performance Counters */
+	enum {
+		ACCEPTOR_PC_CONNECTION_RECEIVED,
+		ACCEPTOR_PC_CONNECTION_REJECTED,
+		ACCEPTOR_PC_CONNECTION_ACCEPTED,
+		ACCEPTOR_PC_CONNECTION_HANDED_OVER,
+		ACCEPTOR_PC_RSSL_PROTOCOL_DOWNGRADE,
+		ACCEPTOR_PC_HANDSHAKE_EXCEPTION,
+		ACCEPTOR_PC_HANDSHAKE_TIMEOUT,
+/* marker */
+		ACCEPTOR_PC_MAX
+	};
+
+	class upa_t;
+	class provider_t;
+
+	class acceptor_t
+	{
+	public:
+		explicit acceptor_t (const config_t& config, std::shared_ptr<upa_t> upa);
+		~acceptor_t();
+
+/* Bind the RSSL server socket. */
+		bool Initialize();
+/* Run the handshake loop. This blocks until Quit is called. */
+		void Run();
+/* Quit an earlier call to Run(), callable from any thread. */
+		void Quit();
+		void Close();
+
+/* Event loops receiving active connections.  Owned by the application and outliving
+ * every call to Run.
+ */
+		void SetShards (const std::vector<provider_t*>& shards) {
+			shards_ = shards;
+		}
+
+	private:
+		bool DoWork();
+		void ExpireHandshakes();
+
+		void OnConnection();
+		void RejectConnection();
+		void AcceptConnection();
+		void OnInitializingState (RsslChannel* handle);
+		void HandOver (RsslChannel* handle);
+		void Close (RsslChannel* handle);
+
+		const config_t& config_;
+
+/* UPA context. */
+		std::shared_ptr<upa_t> upa_;
+/* Server socket for new connections */
+		RsslServer* rssl_sock_;
+/* This flag is set to false when Run should return. */
+		boost::atomic_bool keep_running_;
+
+/* Readiness of the server socket and initializing channels, context is the RsslChannel. */
+		poller_t poller_;
+		int ready_count_;
+		uint64_t now_;
+
+/* Sibling event loops for load balancing. */
+		std::vector<provider_t*> shards_;
+/* Channels between rsslAccept and the active state, value is the accept time. */
+		std::unordered_map<RsslChannel*, uint64_t> handshakes_;
+		std::vector<RsslChannel*> expired_;
+/* rsslAccept to active state, milliseconds. */
+		chromium::Histogram* handshake_ms_;
+
+/** Performance Counters **/
+		boost::posix_time::ptime creation_time_;
+		counters_t<ACCEPTOR_PC_MAX> cumulative_stats_;
+/* Column of the shared-memory stats table, bound on the acceptor thread. */
+		int stats_slot_;
+		stats_rows_t<ACCEPTOR_PC_MAX> acceptor_rows_;
+		uint64_t next_stats_time_;
+
+		chromium::debug::LeakTracker<acceptor_t> leak_tracker_;
+	};
+
+} /* namespace hitsuji */
+
+#endif /* ACCEPTOR_HH_ */
+
+/* eof */
\ No newline at end of file
@@ -11,9 +11,12 @@
 #include "chromium/logging.hh"
 #include "chromium/string_piece.hh"
 #include "upaostream.hh"
+#include "packed_buffer.hh"
 #include "provider.hh"
 
-/* Maximum encoded size of an RSSL provider to client message. */
+/* Maximum encoded size of a login, directory or status message, and of a packed buffer.
+ * Analytic replies beyond a packed buffer are written in a buffer of their own size.
+ */
 #define MAX_MSG_SIZE 4096
 
 static const std::string kErrorNone = "";
@@ -27,6 +30,7 @@ hitsuji::client_t::client_t (
 	std::shared_ptr<hitsuji::provider_t> provider,
 	Delegate* delegate, 
 	RsslChannel* handle,
+	uint64_t session_handle,
 	const char* address
 	) :
 	creation_time_ (boost::posix_time::second_clock::universal_time()),
@@ -35,11 +39,22 @@ hitsuji::client_t::client_t (
 	delegate_ (delegate),
 	address_ (address),
 	handle_ (handle),
+	session_handle_ (session_handle),
 	pending_count_ (0),
+	pack_buf_ (nullptr),
+	pack_length_ (0),
+	pack_available_ (0),
+	pack_count_ (0),
+	queued_bytes_ (0),
+	is_write_blocked_ (false),
+	max_queue_time_ (0),
 	is_logged_in_ (false),
-	login_token_ (0)
+	login_token_ (0),
+	directory_token_ (0),
+	next_ping_ (0),
+	next_pong_ (0),
+	ping_interval_ (0)
 {
-	ZeroMemory (cumulative_stats_, sizeof (cumulative_stats_));
 	ZeroMemory (snap_stats_, sizeof (snap_stats_));
 
 /* Set logger ID */
@@ -51,6 +66,12 @@ hitsuji::client_t::client_t (
 hitsuji::client_t::~client_t()
 {
 	DLOG(INFO) << "~client_t";
+/* Unsent replies are discarded with the session. */
+	ReleasePack();
+/* Timers are owned by the provider event loop. */
+	provider_->timers_.Cancel (&ping_timer_);
+	provider_->timers_.Cancel (&pong_timer_);
+	provider_->timers_.Cancel (&write_timer_);
 /* Remove reference on containing provider. */
 	provider_.reset();
 
@@ -60,7 +81,11 @@ hitsuji::client_t::~client_t()
 		 " \"Uptime\": \"" << to_simple_string (uptime) << "\""
 		", \"MsgsReceived\": " << cumulative_stats_[CLIENT_PC_RSSL_MSGS_RECEIVED] <<
 		", \"MsgsSent\": " << cumulative_stats_[CLIENT_PC_RSSL_MSGS_SENT] <<
+		", \"MsgsPacked\": " << cumulative_stats_[CLIENT_PC_RSSL_PACKED_MSGS] <<
 		", \"MsgsRejected\": " << cumulative_stats_[CLIENT_PC_RSSL_MSGS_REJECTED] <<
+		", \"RepliesQueued\": " << cumulative_stats_[CLIENT_PC_REPLY_QUEUED] <<
+		", \"RepliesDiscarded\": " << cumulative_stats_[CLIENT_PC_REPLY_DISCARDED] <<
+		", \"MaxQueueTimeMs\": " << max_queue_time_ <<
 		" }";
 }
 
@@ -115,13 +140,28 @@ hitsuji::client_t::Initialize()
 		", \"protocolType\": " << handle_->protocolType << ""
 		", \"socketId\": " << handle_->socketId << ""
 		", \"state\": \"" << internal::channel_state_string (handle_->state) << "\""
+		", \"compressionType\": \"" << internal::compression_type_string (static_cast<RsslCompTypes> (info.compressionType)) << "\""
 		" }";
+/* Small messages gain little from compression, leave them uncompressed. */
+	if (RSSL_COMP_NONE != info.compressionType) {
+		int threshold = static_cast<int> (provider_->config_.compression_threshold);
+		rc = rsslIoctl (handle_, RSSL_COMPRESSION_THRESHOLD, &threshold, &rssl_err);
+		if (RSSL_RET_SUCCESS != rc) {
+			LOG(WARNING) << prefix_ << "rsslIoctl: { "
+				  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
+				", \"sysError\": " << rssl_err.sysError << ""
+				", \"text\": \"" << rssl_err.text << "\""
+				", \"code\": \"RSSL_COMPRESSION_THRESHOLD\""
+				", \"value\": " << threshold << ""
+				" }";
+		}
+	}
 /* Derive expected RSSL ping interval from negotiated timeout. */
 	ping_interval_ = handle_->pingTimeout / 3;
 /* Schedule first RSSL ping. */
-	next_ping_ = last_activity_ + boost::posix_time::seconds (ping_interval_);
+	next_ping_ = provider_->now() + 1000 * ping_interval_;
 /* Treat connect as first RSSL pong. */
-	next_pong_ = last_activity_ + boost::posix_time::seconds (handle_->pingTimeout);
+	next_pong_ = provider_->now() + 1000 * handle_->pingTimeout;
 	return true;
 }
 
@@ -130,6 +170,8 @@ hitsuji::client_t::Initialize()
 bool
 hitsuji::client_t::Close()
 {
+/* Replies precede the login close. */
+	SubmitPack();
 /* client_t exists when client session is active but not necessarily logged in. */
 	if (is_logged_in_) {
 /* reject new item requests. */
@@ -506,6 +548,41 @@ hitsuji::client_t::AcceptLogin (
 	const RsslRequestMsg* login_msg,
 	int32_t login_token
 	)
+{
+	DCHECK (nullptr != login_msg);
+	VLOG(2) << prefix_ << "Sending MMT_LOGIN accepted.";
+
+/* Encoded once per RWF version and login name, e.g. reconnecting ADS. */
+	std::string key;
+	encoded_cache_t::login_key (
+		chromium::StringPiece (login_msg->msgBase.msgKey.name.data, login_msg->msgBase.msgKey.name.length),
+		login_msg->msgBase.msgKey.nameType,
+		rwf_version(),
+		&key);
+	const std::vector<char>* encoded = provider_->encoded_cache().GetLogin (key);
+	if (nullptr == encoded) {
+		char data[MAX_MSG_SIZE];
+		RsslBuffer buf = { MAX_MSG_SIZE, data };
+		if (!EncodeLoginRefresh (login_msg, login_token, &buf)) {
+			cumulative_stats_[CLIENT_PC_MMT_LOGIN_EXCEPTION]++;
+			return false;
+		}
+		encoded = &provider_->encoded_cache().SetLogin (key, buf.data, buf.length);
+	}
+	if (!SubmitEncoded (login_token, *encoded)) {
+		cumulative_stats_[CLIENT_PC_MMT_LOGIN_EXCEPTION]++;
+		return false;
+	}
+	cumulative_stats_[CLIENT_PC_MMT_LOGIN_ACCEPTED]++;
+	return true;
+}
+
+bool
+hitsuji::client_t::EncodeLoginRefresh (
+	const RsslRequestMsg* login_msg,
+	int32_t login_token,
+	RsslBuffer* buf
+	)
 {
 #ifndef NDEBUG
 	RsslRefreshMsg response = RSSL_INIT_REFRESH_MSG;
@@ -522,12 +599,9 @@ hitsuji::client_t::AcceptLogin (
 	rsslClearElementList (&element_list);
 	rsslClearElementEntry (&element_entry);
 #endif
-	RsslBuffer* buf;
-	RsslError rssl_err;
 	RsslRet rc;
 
 	DCHECK (nullptr != login_msg);
-	VLOG(2) << prefix_ << "Sending MMT_LOGIN accepted.";
 
 /* Set the message model type. */
 	response.msgBase.domainType = RSSL_DMT_LOGIN;
@@ -557,17 +631,6 @@ hitsuji::client_t::AcceptLogin (
 /* Error code. */
 	response.state.code = RSSL_SC_NONE;
 
-	buf = rsslGetBuffer (handle_, MAX_MSG_SIZE, RSSL_FALSE /* not packed */, &rssl_err);
-	if (nullptr == buf) {
-		LOG(ERROR) << prefix_ << "rsslGetBuffer: { "
-			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
-			", \"sysError\": " << rssl_err.sysError << ""
-			", \"text\": \"" << rssl_err.text << "\""
-			", \"size\": " << MAX_MSG_SIZE << ""
-			", \"packedBuffer\": false"
-			" }";
-		return false;
-	}	
 	rc = rsslSetEncodeIteratorBuffer (&it, buf);
 	if (RSSL_RET_SUCCESS != rc) {
 		LOG(ERROR) << prefix_ << "rsslSetEncodeIteratorBuffer: { "
@@ -575,7 +638,7 @@ hitsuji::client_t::AcceptLogin (
 			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
 			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
 			" }";
-		goto cleanup;
+		return false;
 	}
 	rc = rsslSetEncodeIteratorRWFVersion (&it, rwf_major_version(), rwf_minor_version());
 	if (RSSL_RET_SUCCESS != rc) {
@@ -586,7 +649,7 @@ hitsuji::client_t::AcceptLogin (
 			", \"majorVersion\": " << static_cast<unsigned> (rwf_major_version()) << ""
 			", \"minorVersion\": " << static_cast<unsigned> (rwf_minor_version()) << ""
 			" }";
-		goto cleanup;
+		return false;
 	}
 	rc = rsslEncodeMsgInit (&it, reinterpret_cast<RsslMsg*> (&response), MAX_MSG_SIZE);
 	if (RSSL_RET_ENCODE_MSG_KEY_OPAQUE != rc) {
@@ -596,7 +659,7 @@ hitsuji::client_t::AcceptLogin (
 			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
 			", \"dataMaxSize\": " << MAX_MSG_SIZE << ""
 			" }";
-		goto cleanup;
+		return false;
 	}
 
 /* Encode attribute object after message instead of before as per RFA. */
@@ -609,7 +672,7 @@ hitsuji::client_t::AcceptLogin (
 			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
 			", \"flags\": \"RSSL_ELF_HAS_STANDARD_DATA\""
 			" }";
-		goto cleanup;
+		return false;
 	}
 
 /* Images and & updates cannot be stale. */
@@ -642,7 +705,7 @@ hitsuji::client_t::AcceptLogin (
 			", \"dataType\": \"" << rsslDataTypeToString (element_entry.dataType) << "\""
 			", \"providePermissionExpressions\": " << provide_permission_expressions << ""
 			" }";
-		goto cleanup;
+		return false;
 	}
 /* No permission profile. */
 	static const uint64_t provide_permission_profile = 0;
@@ -658,7 +721,7 @@ hitsuji::client_t::AcceptLogin (
 			", \"dataType\": \"" << rsslDataTypeToString (element_entry.dataType) << "\""
 			", \"providePermissionProfile\": " << provide_permission_profile << ""
 			" }";
-		goto cleanup;
+		return false;
 	}
 /* Downstream application drives stream recovery. */
 	static const uint64_t single_open = 0;
@@ -674,12 +737,27 @@ hitsuji::client_t::AcceptLogin (
 			", \"dataType\": \"" << rsslDataTypeToString (element_entry.dataType) << "\""
 			", \"singleOpen\": " << single_open << ""
 			" }";
-		goto cleanup;
+		return false;
 	}
 /* Batch requests not supported. */
 /* OMM posts not supported. */
 /* Optimized pause and resume not supported. */
-/* Views not supported. */
+/* Field identifier list views. */
+	static const uint64_t support_view_requests = 1;
+	element_entry.dataType	= RSSL_DT_UINT;
+	element_entry.name	= RSSL_ENAME_SUPPORT_VIEW;
+	rc = rsslEncodeElementEntry (&it, &element_entry, &support_view_requests);
+	if (RSSL_RET_SUCCESS != rc) {
+		LOG(ERROR) << prefix_ << "rsslEncodeElementEntry: { "
+			  "\"returnCode\": " << static_cast<signed> (rc) << ""
+			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
+			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
+			", \"name\": \"RSSL_ENAME_SUPPORT_VIEW\""
+			", \"dataType\": \"" << rsslDataTypeToString (element_entry.dataType) << "\""
+			", \"supportViewRequests\": " << support_view_requests << ""
+			" }";
+		return false;
+	}
 /* Warm standby not supported. */
 /* Binding complete. */
 	rc = rsslEncodeElementListComplete (&it, RSSL_TRUE /* commit */);
@@ -689,7 +767,7 @@ hitsuji::client_t::AcceptLogin (
 			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
 			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
 			" }";
-		goto cleanup;
+		return false;
 	}
 	rc = rsslEncodeMsgKeyAttribComplete (&it, RSSL_TRUE /* commit */);
 	if (RSSL_RET_SUCCESS != rc) {
@@ -698,7 +776,7 @@ hitsuji::client_t::AcceptLogin (
 			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
 			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
 			" }";
-		goto cleanup;
+		return false;
 	}
 	if (RSSL_RET_SUCCESS != rsslEncodeMsgComplete (&it, RSSL_TRUE /* commit */)) {
 		LOG(ERROR) << prefix_ << "rsslEncodeMsgComplete: { "
@@ -706,7 +784,7 @@ hitsuji::client_t::AcceptLogin (
 			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
 			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
 			" }";
-		goto cleanup;
+		return false;
 	}
 	buf->length = rsslGetEncodedBufferLength (&it);
 	LOG_IF(WARNING, 0 == buf->length) << prefix_ << "rsslGetEncodedBufferLength returned 0.";
@@ -715,27 +793,12 @@ hitsuji::client_t::AcceptLogin (
 //	if (!rsslValidateMsg (reinterpret_cast<RsslMsg*> (&response))) {
 //		cumulative_stats_[CLIENT_PC_MMT_LOGIN_RESPONSE_MALFORMED]++;
 //		LOG(ERROR) << prefix_ << "rsslValidateMsg failed.";
-//		goto cleanup;
+//		return false;
 //	} else {
 //		cumulative_stats_[CLIENT_PC_MMT_LOGIN_RESPONSE_VALIDATED]++;
 //		LOG(INFO) << prefix_ << "rsslValidateMsg succeeded.";
 //	}
-
-	if (!Submit (buf)) {
-		goto cleanup;
-	}
-	cumulative_stats_[CLIENT_PC_MMT_LOGIN_ACCEPTED]++;
 	return true;
-cleanup:
-	cumulative_stats_[CLIENT_PC_MMT_LOGIN_EXCEPTION]++;
-	if (RSSL_RET_SUCCESS != rsslReleaseBuffer (buf, &rssl_err)) {
-		LOG(WARNING) << prefix_ << "rsslReleaseBuffer: { "
-			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
-			", \"sysError\": " << rssl_err.sysError << ""
-			", \"text\": \"" << rssl_err.text << "\""
-			" }";
-	}
-	return false;
 }
 
 /* 7.4. Provide Source Directory Information.
@@ -834,7 +897,8 @@ hitsuji::client_t::OnItemRequest (
  */
 	const uint16_t service_id    = request_msg->msgBase.msgKey.serviceId;
 	const uint8_t  model_type    = request_msg->msgBase.domainType;
-	const std::string item_name (request_msg->msgBase.msgKey.name.data, request_msg->msgBase.msgKey.name.length);
+/* References the read buffer, valid until the next rsslRead on this channel. */
+	const chromium::StringPiece item_name (request_msg->msgBase.msgKey.name.data, request_msg->msgBase.msgKey.name.length);
 	const bool use_attribinfo_in_updates = !!(request_msg->flags & RSSL_RQMF_MSG_KEY_IN_UPDATES);
 	const bool has_view = !!(request_msg->flags & RSSL_RQMF_HAS_VIEW);
 
@@ -883,32 +947,42 @@ hitsuji::client_t::OnItemRequest (
 	} else {
 		cumulative_stats_[CLIENT_PC_ITEM_SNAPSHOT_REQUEST_RECEIVED]++;
 	}
-	const auto jt = tokens_.find (request_token);
-	if (jt != tokens_.end()) {
+	if (!tokens_.insert (request_token)) {
 		cumulative_stats_[CLIENT_PC_ITEM_REISSUE_REQUEST_RECEIVED]++;
 /* Explicitly ignore reissue as it does not alter response data. */
 		return true;
-	} else {
-		tokens_.emplace (request_token);
 	}
 /* Extract view field ids */
 	if (has_view) {
 		if (RSSL_DT_ELEMENT_LIST == request_msg->msgBase.containerType) {
-			std::vector<int_fast16_t> view_by_fid;
-			if (ParseView (it, reinterpret_cast<const RsslMsg*> (request_msg), &view_by_fid))
-				return delegate_->OnRequest (
-						    reinterpret_cast<uintptr_t> (handle_),
+/* Event loop scratch vector, capacity is retained between requests. */
+			std::vector<int_fast16_t>& view_by_fid = provider_->view_by_fid_;
+			if (ParseView (it, reinterpret_cast<const RsslMsg*> (request_msg), &view_by_fid)) {
+				cumulative_stats_[CLIENT_PC_ITEM_VIEW_REQUEST_RECEIVED]++;
+				if (!delegate_->OnRequest (
+						    session_handle_,
 						    rwf_version(),
 						    request_token,
 						    service_id,
 						    item_name,
 						    use_attribinfo_in_updates,
 						    view_by_fid
-						    );
+						    ))
+				{
+					return false;
+				}
+				provider_->OnRequestDispatched (session_handle_, request_token);
+				return true;
+			}
+/* Unusable view, fall back to the full image. */
+		} else {
+			LOG(WARNING) << prefix_ << "RSSL_RQMF_HAS_VIEW set but container type is not RSSL_DT_ELEMENT_LIST.";
 		}
-		LOG(WARNING) << prefix_ << "RSSL_RQMF_HAS_VIEW set but container type is not RSSL_DT_ELEMENT_LIST.";
 	}
-	return delegate_->OnRequest (reinterpret_cast<uintptr_t> (handle_), rwf_version(), request_token, service_id, item_name, use_attribinfo_in_updates);
+	if (!delegate_->OnRequest (session_handle_, rwf_version(), request_token, service_id, item_name, use_attribinfo_in_updates))
+		return false;
+	provider_->OnRequestDispatched (session_handle_, request_token);
+	return true;
 }
 
 bool
@@ -932,7 +1006,13 @@ hitsuji::client_t::ParseView (
 		return false;
 	}
 
-	RsslUInt viewType;
+	RsslArray rssl_array;
+	RsslBuffer array_entry;
+	RsslInt fid;
+	RsslUInt view_type = RDM_VIEW_TYPE_FIELD_ID_LIST;	/* default when ViewType is absent */
+	bool has_view_data = false;
+
+	view_by_fid->clear();
 	do {
 		rc = rsslDecodeElementEntry (it, &element);
 		switch (rc) {
@@ -940,8 +1020,8 @@ hitsuji::client_t::ParseView (
 			break;
 		case RSSL_RET_SUCCESS:
 			if (rsslBufferIsEqual (&element.name, &RSSL_ENAME_VIEW_TYPE)) {
-				if (RSSL_DT_UINT == element.dataType) {					
-					rc = rsslDecodeUInt (it, &viewType);
+				if (RSSL_DT_UINT == element.dataType) {
+					rc = rsslDecodeUInt (it, &view_type);
 					if (RSSL_RET_SUCCESS != rc) {
 						LOG(WARNING) << prefix_ << "rsslDecodeUInt: { "
 							  "\"returnCode\": " << static_cast<signed> (rc) << ""
@@ -952,8 +1032,61 @@ hitsuji::client_t::ParseView (
 					}
 				} else {
 					LOG(WARNING) << prefix_ << "RSSL_ENAME_VIEW_TYPE found in element list but entry data type is not RSSL_DT_UINT.";
+					return false;
+				}
+			} else if (rsslBufferIsEqual (&element.name, &RSSL_ENAME_VIEW_DATA)) {
+				if (RSSL_DT_ARRAY != element.dataType) {
+					LOG(WARNING) << prefix_ << "RSSL_ENAME_VIEW_DATA found in element list but entry data type is not RSSL_DT_ARRAY.";
+					return false;
+				}
+				rc = rsslDecodeArray (it, &rssl_array);
+				if (RSSL_RET_SUCCESS != rc) {
+					LOG(WARNING) << prefix_ << "rsslDecodeArray: { "
+						  "\"returnCode\": " << static_cast<signed> (rc) << ""
+						", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
+						", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
+						" }";
+					return false;
+				}
+/* Field identifier lists only, element name lists are rejected below. */
+				if (RSSL_DT_INT != rssl_array.primitiveType) {
+					LOG(WARNING) << prefix_ << "RSSL_ENAME_VIEW_DATA array primitive type is not RSSL_DT_INT: { "
+						  "\"primitiveType\": \"" << rsslDataTypeToString (rssl_array.primitiveType) << "\""
+						" }";
+					return false;
 				}
+				while (RSSL_RET_END_OF_CONTAINER != (rc = rsslDecodeArrayEntry (it, &array_entry))) {
+					if (RSSL_RET_SUCCESS != rc) {
+						LOG(WARNING) << prefix_ << "rsslDecodeArrayEntry: { "
+							  "\"returnCode\": " << static_cast<signed> (rc) << ""
+							", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
+							", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
+							" }";
+						return false;
+					}
+					rc = rsslDecodeInt (it, &fid);
+					if (RSSL_RET_BLANK_DATA == rc)
+						continue;
+					if (RSSL_RET_SUCCESS != rc) {
+						LOG(WARNING) << prefix_ << "rsslDecodeInt: { "
+							  "\"returnCode\": " << static_cast<signed> (rc) << ""
+							", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
+							", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
+							" }";
+						return false;
+					}
+					if (fid < INT16_MIN || fid > INT16_MAX) {
+						LOG(WARNING) << prefix_ << "Ignoring out of range field identifier in view: { "
+							  "\"fid\": " << fid << ""
+							" }";
+						continue;
+					}
+					view_by_fid->push_back (static_cast<int_fast16_t> (fid));
+				}
+				has_view_data = true;
 			}
+/* Reset for outer loop test. */
+			rc = RSSL_RET_SUCCESS;
 			break;
 		default:
 			LOG(WARNING) << prefix_ << "rsslDecodeElementEntry: { "
@@ -964,58 +1097,465 @@ hitsuji::client_t::ParseView (
 			return false;
 		}
 	} while (RSSL_RET_SUCCESS == rc);
-	return false;
+
+	if (RDM_VIEW_TYPE_FIELD_ID_LIST != view_type) {
+		LOG(WARNING) << prefix_ << "Unsupported view type: { "
+			  "\"viewType\": " << view_type << ""
+			" }";
+		return false;
+	}
+	if (!has_view_data) {
+		LOG(WARNING) << prefix_ << "RSSL_RQMF_HAS_VIEW set but RSSL_ENAME_VIEW_DATA not found.";
+		return false;
+	}
+/* Sorted and unique for intersection by the analytics. */
+	std::sort (view_by_fid->begin(), view_by_fid->end());
+	view_by_fid->erase (std::unique (view_by_fid->begin(), view_by_fid->end()), view_by_fid->end());
+	return true;
 }
 
 bool
 hitsuji::client_t::OnSourceDirectoryUpdate()
 {
+/* No directory stream open yet, the refresh will carry current state. */
+	if (0 == directory_token_)
+		return true;
 	return SendDirectoryUpdate (directory_token_, provider_->service_name());
 }
 
+/* Replies are copied into one packed buffer per client, the provider submits each pending
+ * packed buffer once per pass of the event loop.  Whilst the channel is backed up replies
+ * are held in the outbound queue instead.
+ *
+ * Returns false on error, true on success.
+ */
 bool
 hitsuji::client_t::SendReply (
 	int32_t request_token,
 	const void* data,
-	size_t length
+	size_t length
 	)
 {
-	RsslBuffer* buf;
-	RsslError rssl_err;
-	DCHECK(length <= MAX_MSG_SIZE);
 /* Drop response if token already canceled */
 	if (0 == tokens_.erase (request_token))
 		return true;
+/* Preserve ordering behind queued replies. */
+	if (is_write_blocked_ || !queue_.empty())
+		return Enqueue (request_token, data, length);
+	if (!PackReply (data, length)) {
+		if (is_write_blocked_)
+			return Enqueue (request_token, data, length);
+		return false;
+	}
+	cumulative_stats_[CLIENT_PC_ITEM_SENT]++;
+	return true;
+}
+
+/* Copy one encoded reply into the packed buffer, on an empty buffer pool the channel is
+ * marked blocked and the reply is not consumed.
+ *
+ * Returns false on error, true on success.
+ */
+bool
+hitsuji::client_t::PackReply (
+	const void* data,
+	size_t length
+	)
+{
+	RsslError rssl_err;
+/* Replies beyond a packed buffer are written alone. */
+	if (!fits_packed_buffer (length, MAX_MSG_SIZE))
+		return WriteReply (data, length);
+	if (nullptr != pack_buf_) {
+/* Pack previous reply if the next fits, otherwise submit and start a new buffer. */
+		if (can_pack (pack_length_, length, pack_available_)) {
+			pack_buf_->length = static_cast<uint32_t> (pack_length_);
+			RsslBuffer* buf = rsslPackBuffer (handle_, pack_buf_, &rssl_err);
+			if (nullptr == buf) {
+				LOG(ERROR) << prefix_ << "rsslPackBuffer: { "
+					  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
+					", \"sysError\": " << rssl_err.sysError << ""
+					", \"text\": \"" << rssl_err.text << "\""
+					" }";
+				ReleasePack();
+				return false;
+			}
+			pack_buf_ = buf;
+			pack_available_ = buf->length;
+		} else if (!SubmitPack()) {
+			return false;
+		}
+	}
+	if (nullptr == pack_buf_) {
 /* Copy into RSSL channel buffer pool */
-	buf = rsslGetBuffer (handle_, MAX_MSG_SIZE, RSSL_FALSE /* not packed */, &rssl_err);
+		pack_buf_ = rsslGetBuffer (handle_, MAX_MSG_SIZE, RSSL_TRUE /* packed */, &rssl_err);
+		if (nullptr == pack_buf_) {
+			if (RSSL_RET_BUFFER_NO_BUFFERS == rssl_err.rsslErrorId) {
+				VLOG(2) << prefix_ << "RSSL buffer pool exhausted, queueing replies.";
+				SetWriteBlocked();
+				return false;
+			}
+			LOG(ERROR) << prefix_ << "rsslGetBuffer: { "
+				  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
+				", \"sysError\": " << rssl_err.sysError << ""
+				", \"text\": \"" << rssl_err.text << "\""
+				", \"size\": " << MAX_MSG_SIZE << ""
+				", \"packedBuffer\": true"
+				" }";
+			return false;
+		}
+		pack_available_ = pack_buf_->length;
+		pack_count_ = 0;
+		provider_->OnPackPending (session_handle_);
+	}
+/* The pool may hand out a smaller buffer than requested. */
+	if (length > pack_available_) {
+		ReleasePack();
+		return WriteReply (data, length);
+	}
+	CopyMemory (pack_buf_->data, data, length);
+	pack_length_ = length;
+	pack_count_++;
+	return true;
+}
+
+/* Copy one encoded reply into a dedicated RSSL buffer, the transport fragments buffers
+ * beyond the negotiated maximum fragment size.  As with packing, on an empty buffer pool the
+ * channel is marked blocked and the reply is not consumed.
+ *
+ * Returns false on error, true on success.
+ */
+bool
+hitsuji::client_t::WriteReply (
+	const void* data,
+	size_t length
+	)
+{
+	RsslError rssl_err;
+	RsslBuffer* buf = rsslGetBuffer (handle_, static_cast<uint32_t> (length), RSSL_FALSE /* not packed */, &rssl_err);
 	if (nullptr == buf) {
+		if (RSSL_RET_BUFFER_NO_BUFFERS == rssl_err.rsslErrorId) {
+			VLOG(2) << prefix_ << "RSSL buffer pool exhausted, queueing replies.";
+			SetWriteBlocked();
+			return false;
+		}
 		LOG(ERROR) << prefix_ << "rsslGetBuffer: { "
 			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
 			", \"sysError\": " << rssl_err.sysError << ""
 			", \"text\": \"" << rssl_err.text << "\""
-			", \"size\": " << MAX_MSG_SIZE << ""
+			", \"size\": " << length << ""
 			", \"packedBuffer\": false"
 			" }";
 		return false;
 	}
+	if (buf->length < length) {
+		LOG(ERROR) << prefix_ << "rsslGetBuffer returned " << buf->length << " bytes for a " << length << " byte reply.";
+		rsslReleaseBuffer (buf, &rssl_err);
+		return false;
+	}
 	CopyMemory (buf->data, data, length);
 	buf->length = static_cast<uint32_t> (length);
+/* Submits any pending packed buffer first. */
 	if (!Submit (buf)) {
-		goto cleanup;
+		if (RSSL_RET_SUCCESS != rsslReleaseBuffer (buf, &rssl_err)) {
+			LOG(WARNING) << prefix_ << "rsslReleaseBuffer: { "
+				  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
+				", \"sysError\": " << rssl_err.sysError << ""
+				", \"text\": \"" << rssl_err.text << "\""
+				" }";
+		}
+		return false;
 	}
-	cumulative_stats_[CLIENT_PC_ITEM_SENT]++;
 	return true;
-cleanup:
-	if (RSSL_RET_SUCCESS != rsslReleaseBuffer (buf, &rssl_err)) {
+}
+
+/* Write the pending packed buffer, if any.
+ *
+ * Returns false on error, true on success.
+ */
+bool
+hitsuji::client_t::SubmitPack()
+{
+	if (nullptr == pack_buf_)
+		return true;
+	RsslBuffer* buf = pack_buf_;
+	const unsigned count = pack_count_;
+	buf->length = static_cast<uint32_t> (pack_length_);
+	pack_buf_ = nullptr;
+	pack_length_ = pack_available_ = 0;
+	pack_count_ = 0;
+	const int status = provider_->Submit (handle_, buf);
+	if (!status) {
+		RsslError rssl_err;
+		if (RSSL_RET_SUCCESS != rsslReleaseBuffer (buf, &rssl_err)) {
+			LOG(WARNING) << prefix_ << "rsslReleaseBuffer: { "
+				  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
+				", \"sysError\": " << rssl_err.sysError << ""
+				", \"text\": \"" << rssl_err.text << "\""
+				" }";
+		}
+		return false;
+	}
+	cumulative_stats_[CLIENT_PC_RSSL_MSGS_SENT] += count;
+	cumulative_stats_[CLIENT_PC_RSSL_PACKED_MSGS] += count;
+	provider_->cumulative_stats_[PROVIDER_PC_RSSL_PACKED_MSGS] += count;
+	return true;
+}
+
+void
+hitsuji::client_t::ReleasePack()
+{
+	if (nullptr == pack_buf_)
+		return;
+	RsslError rssl_err;
+	if (RSSL_RET_SUCCESS != rsslReleaseBuffer (pack_buf_, &rssl_err)) {
 		LOG(WARNING) << prefix_ << "rsslReleaseBuffer: { "
 			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
 			", \"sysError\": " << rssl_err.sysError << ""
 			", \"text\": \"" << rssl_err.text << "\""
 			" }";
 	}
+	pack_buf_ = nullptr;
+	pack_length_ = pack_available_ = 0;
+	pack_count_ = 0;
+}
+
+bool
+hitsuji::client_t::ParseSlowConsumerPolicy (
+	const std::string& str,
+	SlowConsumerPolicy* policy
+	)
+{
+	DCHECK (nullptr != policy);
+	if (0 == str.compare ("buffer"))
+		*policy = kBuffer;
+	else if (0 == str.compare ("conflate"))
+		*policy = kConflate;
+	else if (0 == str.compare ("close"))
+		*policy = kCloseStreams;
+	else if (0 == str.compare ("disconnect"))
+		*policy = kDisconnect;
+	else
+		return false;
+	return true;
+}
+
+/* Further replies are queued until the provider reports the channel flushed or retries the
+ * buffer pool.
+ */
+void
+hitsuji::client_t::SetWriteBlocked()
+{
+	if (is_write_blocked_)
+		return;
+	is_write_blocked_ = true;
+	provider_->WaitWritable (handle_);
+}
+
+/* Copy a reply into the outbound queue applying the slow consumer policy at the byte budget.
+ * Every stream losing a reply to the policy is closed with a recoverable status so that the
+ * consumer can re-request, queued statuses are never evicted.
+ *
+ * Returns false on error, true on success.
+ */
+bool
+hitsuji::client_t::Enqueue (
+	int32_t request_token,
+	const void* data,
+	size_t length
+	)
+{
+	const SlowConsumerPolicy policy = provider_->slow_consumer_policy();
+	const size_t budget = provider_->config_.client_queue_bytes;
+	if (kConflate == policy) {
+/* Reissue on a stream with a reply already queued, keep the newest image in place. */
+		for (auto it = queue_.begin(); it != queue_.end(); ++it) {
+			if (it->token != request_token || it->is_status)
+				continue;
+			queued_bytes_ -= it->data.size();
+			it->data.assign (static_cast<const char*> (data), static_cast<const char*> (data) + length);
+			queued_bytes_ += length;
+			cumulative_stats_[CLIENT_PC_REPLY_CONFLATED]++;
+			return true;
+		}
+	}
+	if (0 != budget && queued_bytes_ + length > budget) {
+		cumulative_stats_[CLIENT_PC_QUEUE_OVERFLOW]++;
+		switch (policy) {
+		case kConflate: {
+/* Evict the oldest streams with queued replies until the reply fits. */
+			std::vector<int32_t> closing;
+			while (queued_bytes_ + length > budget) {
+				auto it = std::find_if (queue_.begin(), queue_.end(), [](const queued_reply_t& reply) { return !reply.is_status; });
+				if (queue_.end() == it)
+					break;
+				closing.push_back (it->token);
+				DiscardReplies (it->token);
+			}
+			bool is_dropped = (queued_bytes_ + length > budget);
+			for (auto jt = closing.begin(); jt != closing.end(); ++jt)
+				is_dropped |= (*jt == request_token);
+			if (is_dropped && closing.end() == std::find (closing.begin(), closing.end(), request_token))
+				closing.push_back (request_token);
+			for (auto jt = closing.begin(); jt != closing.end(); ++jt) {
+				if (!CloseStream (*jt))
+					return false;
+			}
+			if (is_dropped) {
+				cumulative_stats_[CLIENT_PC_REPLY_DISCARDED]++;
+				return true;
+			}
+			break;
+		}
+		case kCloseStreams:
+			return CloseQueuedStreams (request_token);
+		case kDisconnect:
+			LOG(WARNING) << prefix_ << "Slow consumer exceeded outbound budget, aborting connection: { "
+				  "\"queueDepth\": " << queue_.size() << ""
+				", \"queuedBytes\": " << queued_bytes_ << ""
+				", \"budget\": " << budget << ""
+				" }";
+			cumulative_stats_[CLIENT_PC_REPLY_DISCARDED] += static_cast<uint32_t> (queue_.size() + 1);
+			queue_.clear();
+			queued_bytes_ = 0;
+			provider_->Abort (handle_);
+			return true;
+		case kBuffer:
+		default:
+/* Drop the reply that does not fit and close its stream. */
+			cumulative_stats_[CLIENT_PC_REPLY_DISCARDED]++;
+			return CloseStream (request_token);
+		}
+	}
+	queued_reply_t reply;
+	reply.token = request_token;
+	reply.is_status = false;
+	reply.enqueued = provider_->now();
+	queue_.push_back (reply);
+	queue_.back().data.assign (static_cast<const char*> (data), static_cast<const char*> (data) + length);
+	queued_bytes_ += length;
+	cumulative_stats_[CLIENT_PC_REPLY_QUEUED]++;
+	return true;
+}
+
+/* Replace every queued reply and the overflowing reply with a recoverable close status.
+ *
+ * Returns false on error, true on success.
+ */
+bool
+hitsuji::client_t::CloseQueuedStreams (
+	int32_t request_token
+	)
+{
+	std::vector<int32_t> closing;
+	for (auto it = queue_.begin(); it != queue_.end(); ++it) {
+/* One close per stream. */
+		if (!it->is_status && closing.end() == std::find (closing.begin(), closing.end(), it->token))
+			closing.push_back (it->token);
+	}
+	if (closing.end() == std::find (closing.begin(), closing.end(), request_token))
+		closing.push_back (request_token);
+	cumulative_stats_[CLIENT_PC_REPLY_DISCARDED]++;
+	LOG(WARNING) << prefix_ << "Slow consumer exceeded outbound budget, closing " << closing.size() << " streams.";
+	for (auto jt = closing.begin(); jt != closing.end(); ++jt) {
+		if (!CloseStream (*jt))
+			return false;
+	}
+	return true;
+}
+
+/* Discard the queued replies of one stream and queue a recoverable close status in their
+ * place.  Statuses are small and one per stream so are not held to the budget.
+ *
+ * Returns false on error, true on success.
+ */
+bool
+hitsuji::client_t::CloseStream (
+	int32_t request_token
+	)
+{
+	static const chromium::StringPiece kSlowConsumerText ("Slow consumer.");
+	tokens_.erase (request_token);
+	DiscardReplies (request_token);
+	char buf[MAX_MSG_SIZE];
+	size_t length = sizeof (buf);
+	if (!provider_t::WriteRawClose (rwf_version(), request_token, provider_->service_id(), RSSL_DMT_MARKET_PRICE, chromium::StringPiece(), false /* no key */, RSSL_STREAM_CLOSED_RECOVER, RSSL_SC_NONE, kSlowConsumerText, buf, &length))
+		return false;
+	queued_reply_t reply;
+	reply.token = request_token;
+	reply.is_status = true;
+	reply.enqueued = provider_->now();
+	queue_.push_back (reply);
+	queue_.back().data.assign (buf, buf + length);
+	queued_bytes_ += length;
+	cumulative_stats_[CLIENT_PC_QUEUE_STREAM_CLOSED]++;
+	return true;
+}
+
+/* Remove the queued replies of one stream, leaving any queued status. */
+void
+hitsuji::client_t::DiscardReplies (
+	int32_t request_token
+	)
+{
+	for (auto it = queue_.begin(); it != queue_.end();) {
+		if (it->token != request_token || it->is_status) {
+			++it;
+			continue;
+		}
+		queued_bytes_ -= it->data.size();
+		it = queue_.erase (it);
+		cumulative_stats_[CLIENT_PC_REPLY_DISCARDED]++;
+	}
+}
+
+/* Consumer closed a stream whilst its reply is queued.
+ *
+ * Returns true if a queued reply was removed.
+ */
+bool
+hitsuji::client_t::DiscardQueued (
+	int32_t request_token
+	)
+{
+	for (auto it = queue_.begin(); it != queue_.end(); ++it) {
+		if (it->token != request_token)
+			continue;
+		queued_bytes_ -= it->data.size();
+		queue_.erase (it);
+		return true;
+	}
 	return false;
 }
 
+/* Pack queued replies in order until the channel backs up again or the queue is empty, the
+ * packed buffer is submitted with the others at the end of the pass.
+ */
+void
+hitsuji::client_t::OnWritable()
+{
+	is_write_blocked_ = false;
+	while (!queue_.empty() && !is_write_blocked_) {
+		const queued_reply_t& reply = queue_.front();
+		if (PackReply (&reply.data.front(), reply.data.size())) {
+			if (reply.is_status)
+				cumulative_stats_[CLIENT_PC_ITEM_CLOSED]++;
+			else
+				cumulative_stats_[CLIENT_PC_ITEM_SENT]++;
+		} else if (is_write_blocked_) {
+			break;
+		} else {
+			cumulative_stats_[CLIENT_PC_REPLY_DISCARDED]++;
+		}
+		const uint64_t queue_time = provider_->now() - reply.enqueued;
+		cumulative_stats_[CLIENT_PC_QUEUE_TIME_MS] += static_cast<uint32_t> (queue_time);
+		if (queue_time > max_queue_time_)
+			max_queue_time_ = static_cast<uint32_t> (queue_time);
+		queued_bytes_ -= reply.data.size();
+		queue_.pop_front();
+	}
+}
+
 bool
 hitsuji::client_t::OnCloseMsg (
 	RsslDecodeIterator* it,
@@ -1095,12 +1635,15 @@ hitsuji::client_t::OnItemClose (
 	}
 
 /* Remove token */
-	const auto it = tokens_.find (request_token);
-	if (it == tokens_.end()) {
+	if (0 == tokens_.erase (request_token)) {
+		if (DiscardQueued (request_token)) {
+			cumulative_stats_[CLIENT_PC_ITEM_CLOSED]++;
+			DLOG(INFO) << prefix_ << "Closed request with queued reply.";
+			return true;
+		}
 		cumulative_stats_[CLIENT_PC_CLOSE_MSGS_DISCARDED]++;
 		LOG(INFO) << prefix_ << "Discarding close request on closed item.";
 	} else {		
-		tokens_.erase (it);
 		cumulative_stats_[CLIENT_PC_ITEM_CLOSED]++;
 		DLOG(INFO) << prefix_ << "Closed open request.";
 	}
@@ -1119,6 +1662,41 @@ hitsuji::client_t::SendDirectoryRefresh (
 	const char* service_name,	/* can by nullptr */
 	uint32_t filter_mask
 	)
+{
+	VLOG(2) << prefix_ << "Sending directory refresh.";
+
+/* Encoded once per RWF version and filter mask until the service state changes. */
+	const uint64_t key = encoded_cache_t::directory_key (rwf_version(), RSSL_MC_REFRESH, filter_mask);
+	const bool is_cacheable = (nullptr == service_name || 0 == strcmp (service_name, provider_->service_name()));
+	const std::vector<char>* encoded = is_cacheable ? provider_->encoded_cache().GetDirectory (key) : nullptr;
+	std::vector<char> uncached;
+	if (nullptr == encoded) {
+		char data[MAX_MSG_SIZE];
+		RsslBuffer buf = { MAX_MSG_SIZE, data };
+		if (!EncodeDirectoryRefresh (request_token, service_name, filter_mask, &buf))
+			return false;
+		if (is_cacheable) {
+			encoded = &provider_->encoded_cache().SetDirectory (key, buf.data, buf.length);
+		} else {
+			uncached.assign (buf.data, buf.data + buf.length);
+			encoded = &uncached;
+		}
+	}
+	if (!SubmitEncoded (request_token, *encoded)) {
+		LOG(ERROR) << prefix_ << "Submit failed.";
+		return false;
+	}
+	cumulative_stats_[CLIENT_PC_MMT_DIRECTORY_SENT]++;
+	return true;
+}
+
+bool
+hitsuji::client_t::EncodeDirectoryRefresh (
+	int32_t request_token,
+	const char* service_name,	/* can by nullptr */
+	uint32_t filter_mask,
+	RsslBuffer* buf
+	)
 {
 /* 7.5.9.1 Create a response message (4.2.2) */
 	RsslRefreshMsg response = RSSL_INIT_REFRESH_MSG;
@@ -1128,12 +1706,8 @@ hitsuji::client_t::SendDirectoryRefresh (
 	RsslEncodeIterator it;
 	rsslClearEncodeIterator (&it);
 #endif
-	RsslBuffer* buf;
-	RsslError rssl_err;
 	RsslRet rc;
 
-	VLOG(2) << prefix_ << "Sending directory refresh.";
-
 /* 7.5.9.2 Set the message model type of the response. */
 	response.msgBase.domainType = RSSL_DMT_SOURCE;
 /* 7.5.9.3 Set response type. */
@@ -1172,18 +1746,6 @@ hitsuji::client_t::SendDirectoryRefresh (
 /* Error code. */
 	response.state.code = RSSL_SC_NONE;
 
-/* pop buffer from RSSL memory pool */
-	buf = rsslGetBuffer (handle_, MAX_MSG_SIZE, RSSL_FALSE /* not packed */, &rssl_err);
-	if (nullptr == buf) {
-		LOG(ERROR) << prefix_ << "rsslGetBuffer: { "
-			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
-			", \"sysError\": " << rssl_err.sysError << ""
-			", \"text\": \"" << rssl_err.text << "\""
-			", \"size\": " << MAX_MSG_SIZE << ""
-			", \"packedBuffer\": false"
-			" }";
-		return false;
-	}
 /* tie buffer to RSSL write iterator */
 	rc = rsslSetEncodeIteratorBuffer (&it, buf);
 	if (RSSL_RET_SUCCESS != rc) {
@@ -1192,7 +1754,7 @@ hitsuji::client_t::SendDirectoryRefresh (
 			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
 			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
 			" }";
-		goto cleanup;
+		return false;
 	}
 /* encode with clients preferred protocol version */
 	rc = rsslSetEncodeIteratorRWFVersion (&it, rwf_major_version(), rwf_minor_version());
@@ -1204,7 +1766,7 @@ hitsuji::client_t::SendDirectoryRefresh (
 			", \"majorVersion\": " << static_cast<unsigned> (rwf_major_version()) << ""
 			", \"minorVersion\": " << static_cast<unsigned> (rwf_minor_version()) << ""
 			" }";
-		goto cleanup;
+		return false;
 	}
 /* start multi-step encoder */
 	rc = rsslEncodeMsgInit (&it, reinterpret_cast<RsslMsg*> (&response), MAX_MSG_SIZE);
@@ -1215,12 +1777,12 @@ hitsuji::client_t::SendDirectoryRefresh (
 			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
 			", \"dataMaxSize\": " << MAX_MSG_SIZE << ""
 			" }";
-		goto cleanup;
+		return false;
 	}
 /* populate directory map */
 	if (!provider_->GetDirectoryMap (&it, service_name, filter_mask, RSSL_MPEA_ADD_ENTRY)) {
 		LOG(ERROR) << prefix_ << "GetDirectoryMap failed.";
-		goto cleanup;
+		return false;
 	}
 /* finalize multi-step encoder */
 	rc = rsslEncodeMsgComplete (&it, RSSL_TRUE /* commit */);
@@ -1230,7 +1792,7 @@ hitsuji::client_t::SendDirectoryRefresh (
 			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
 			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
 			" }";
-		goto cleanup;
+		return false;
 	}
 	buf->length = rsslGetEncodedBufferLength (&it);
 	LOG_IF(WARNING, 0 == buf->length) << prefix_ << "rsslGetEncodedBufferLength returned 0.";
@@ -1239,33 +1801,51 @@ hitsuji::client_t::SendDirectoryRefresh (
 	if (!rsslValidateMsg (reinterpret_cast<RsslMsg*> (&response))) {
 		cumulative_stats_[CLIENT_PC_MMT_DIRECTORY_MALFORMED]++;
 		LOG(ERROR) << prefix_ << "rsslValidateMsg failed.";
-		goto cleanup;
+		return false;
 	} else {
 		cumulative_stats_[CLIENT_PC_MMT_DIRECTORY_VALIDATED]++;
 		LOG(INFO) << prefix_ << "rsslValidateMsg succeeded.";
 	}
+	return true;
+}
 
-	if (!Submit (buf)) {
+bool
+hitsuji::client_t::SendDirectoryUpdate (
+	int32_t directory_token,
+	const char* service_name	/* can by nullptr */
+	)
+{
+	VLOG(2) << prefix_ << "Sending directory update.";
+
+	const uint64_t key = encoded_cache_t::directory_key (rwf_version(), RSSL_MC_UPDATE, RDM_DIRECTORY_SERVICE_STATE_FILTER | RDM_DIRECTORY_SERVICE_LOAD_FILTER);
+	const bool is_cacheable = (nullptr == service_name || 0 == strcmp (service_name, provider_->service_name()));
+	const std::vector<char>* encoded = is_cacheable ? provider_->encoded_cache().GetDirectory (key) : nullptr;
+	std::vector<char> uncached;
+	if (nullptr == encoded) {
+		char data[MAX_MSG_SIZE];
+		RsslBuffer buf = { MAX_MSG_SIZE, data };
+		if (!EncodeDirectoryUpdate (directory_token, service_name, &buf))
+			return false;
+		if (is_cacheable) {
+			encoded = &provider_->encoded_cache().SetDirectory (key, buf.data, buf.length);
+		} else {
+			uncached.assign (buf.data, buf.data + buf.length);
+			encoded = &uncached;
+		}
+	}
+	if (!SubmitEncoded (directory_token, *encoded)) {
 		LOG(ERROR) << prefix_ << "Submit failed.";
-		goto cleanup;
+		return false;
 	}
 	cumulative_stats_[CLIENT_PC_MMT_DIRECTORY_SENT]++;
 	return true;
-cleanup:
-	if (RSSL_RET_SUCCESS != rsslReleaseBuffer (buf, &rssl_err)) {
-		LOG(WARNING) << prefix_ << "rsslReleaseBuffer: { "
-			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
-			", \"sysError\": " << rssl_err.sysError << ""
-			", \"text\": \"" << rssl_err.text << "\""
-			" }";
-	}
-	return false;
 }
 
 bool
-hitsuji::client_t::SendDirectoryUpdate (
+hitsuji::client_t::EncodeDirectoryUpdate (
 	int32_t directory_token,
-	const char* service_name	/* can by nullptr */
+	const char* service_name,	/* can by nullptr */
+	RsslBuffer* buf
 	)
 {
 	RsslUpdateMsg response = RSSL_INIT_UPDATE_MSG;
@@ -1275,32 +1855,17 @@ hitsuji::client_t::SendDirectoryUpdate (
 	RsslEncodeIterator it;
 	rsslClearEncodeIterator (&it);
 #endif
-	RsslBuffer* buf;
-	RsslError rssl_err;
 	RsslRet rc;
 
-	VLOG(2) << prefix_ << "Sending directory update.";
-
 	response.msgBase.domainType = RSSL_DMT_SOURCE;
 	response.msgBase.msgClass = RSSL_MC_UPDATE;
 	response.flags = RSSL_UPMF_DO_NOT_CONFLATE;
 	response.msgBase.containerType = RSSL_DT_MAP;
-	response.msgBase.msgKey.filter = RDM_DIRECTORY_SERVICE_STATE_FILTER;
+	response.msgBase.msgKey.filter = RDM_DIRECTORY_SERVICE_STATE_FILTER | RDM_DIRECTORY_SERVICE_LOAD_FILTER;
 	response.msgBase.msgKey.flags = RSSL_MKF_HAS_FILTER;
 	response.flags |= RSSL_RFMF_HAS_MSG_KEY;
 	response.msgBase.streamId = directory_token;
 
-	buf = rsslGetBuffer (handle_, MAX_MSG_SIZE, RSSL_FALSE /* not packed */, &rssl_err);
-	if (nullptr == buf) {
-		LOG(ERROR) << prefix_ << "rsslGetBuffer: { "
-			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
-			", \"sysError\": " << rssl_err.sysError << ""
-			", \"text\": \"" << rssl_err.text << "\""
-			", \"size\": " << MAX_MSG_SIZE << ""
-			", \"packedBuffer\": false"
-			" }";
-		return false;
-	}
 	rc = rsslSetEncodeIteratorBuffer (&it, buf);
 	if (RSSL_RET_SUCCESS != rc) {
 		LOG(ERROR) << prefix_ << "rsslSetEncodeIteratorBuffer: { "
@@ -1308,7 +1873,7 @@ hitsuji::client_t::SendDirectoryUpdate (
 			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
 			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
 			" }";
-		goto cleanup;
+		return false;
 	}
 	rc = rsslSetEncodeIteratorRWFVersion (&it, rwf_major_version(), rwf_minor_version());
 	if (RSSL_RET_SUCCESS != rc) {
@@ -1319,7 +1884,7 @@ hitsuji::client_t::SendDirectoryUpdate (
 			", \"majorVersion\": " << static_cast<unsigned> (rwf_major_version()) << ""
 			", \"minorVersion\": " << static_cast<unsigned> (rwf_minor_version()) << ""
 			" }";
-		goto cleanup;
+		return false;
 	}
 	rc = rsslEncodeMsgInit (&it, reinterpret_cast<RsslMsg*> (&response), MAX_MSG_SIZE);
 	if (RSSL_RET_ENCODE_CONTAINER != rc) {
@@ -1329,11 +1894,11 @@ hitsuji::client_t::SendDirectoryUpdate (
 			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
 			", \"dataMaxSize\": " << MAX_MSG_SIZE << ""
 			" }";
-		goto cleanup;
+		return false;
 	}
-	if (!provider_->GetDirectoryMap (&it, service_name, RDM_DIRECTORY_SERVICE_STATE_FILTER, RSSL_MPEA_UPDATE_ENTRY)) {
+	if (!provider_->GetDirectoryMap (&it, service_name, RDM_DIRECTORY_SERVICE_STATE_FILTER | RDM_DIRECTORY_SERVICE_LOAD_FILTER, RSSL_MPEA_UPDATE_ENTRY)) {
 		LOG(ERROR) << prefix_ << "GetDirectoryMap failed.";
-		goto cleanup;
+		return false;
 	}
 	rc = rsslEncodeMsgComplete (&it, RSSL_TRUE /* commit */);
 	if (RSSL_RET_SUCCESS != rc) {
@@ -1342,34 +1907,19 @@ hitsuji::client_t::SendDirectoryUpdate (
 			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
 			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
 			" }";
-		goto cleanup;
+		return false;
 	}
 	buf->length = rsslGetEncodedBufferLength (&it);
 	LOG_IF(WARNING, 0 == buf->length) << prefix_ << "rsslGetEncodedBufferLength returned 0.";
 	if (!rsslValidateMsg (reinterpret_cast<RsslMsg*> (&response))) {
 		cumulative_stats_[CLIENT_PC_MMT_DIRECTORY_MALFORMED]++;
 		LOG(ERROR) << prefix_ << "rsslValidateMsg failed.";
-		goto cleanup;
+		return false;
 	} else {
 		cumulative_stats_[CLIENT_PC_MMT_DIRECTORY_VALIDATED]++;
 		LOG(INFO) << prefix_ << "rsslValidateMsg succeeded.";
 	}
-
-	if (!Submit (buf)) {
-		LOG(ERROR) << prefix_ << "Submit failed.";
-		goto cleanup;
-	}
-	cumulative_stats_[CLIENT_PC_MMT_DIRECTORY_SENT]++;
 	return true;
-cleanup:
-	if (RSSL_RET_SUCCESS != rsslReleaseBuffer (buf, &rssl_err)) {
-		LOG(WARNING) << prefix_ << "rsslReleaseBuffer: { "
-			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
-			", \"sysError\": " << rssl_err.sysError << ""
-			", \"text\": \"" << rssl_err.text << "\""
-			" }";
-	}
-	return false;
 }
 
 bool
@@ -1428,6 +1978,85 @@ cleanup:
 	return false;
 }
 
+/* Copy a pre-encoded response into an RSSL buffer and patch in the stream ID of this
+ * client's request.
+ *
+ * Returns false on error, true on success.
+ */
+bool
+hitsuji::client_t::SubmitEncoded (
+	int32_t request_token,
+	const std::vector<char>& encoded
+	)
+{
+#ifndef NDEBUG
+	RsslEncodeIterator it = RSSL_INIT_ENCODE_ITERATOR;
+#else
+	RsslEncodeIterator it;
+	rsslClearEncodeIterator (&it);
+#endif
+	RsslBuffer* buf;
+	RsslError rssl_err;
+	RsslRet rc;
+
+	DCHECK (!encoded.empty());
+	buf = rsslGetBuffer (handle_, static_cast<uint32_t> (encoded.size()), RSSL_FALSE /* not packed */, &rssl_err);
+	if (nullptr == buf) {
+		LOG(ERROR) << prefix_ << "rsslGetBuffer: { "
+			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
+			", \"sysError\": " << rssl_err.sysError << ""
+			", \"text\": \"" << rssl_err.text << "\""
+			", \"size\": " << encoded.size() << ""
+			", \"packedBuffer\": false"
+			" }";
+		return false;
+	}
+	CopyMemory (buf->data, &encoded.front(), encoded.size());
+	buf->length = static_cast<uint32_t> (encoded.size());
+	rc = rsslSetEncodeIteratorBuffer (&it, buf);
+	if (RSSL_RET_SUCCESS != rc) {
+		LOG(ERROR) << prefix_ << "rsslSetEncodeIteratorBuffer: { "
+			  "\"returnCode\": " << static_cast<signed> (rc) << ""
+			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
+			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
+			" }";
+		goto cleanup;
+	}
+	rc = rsslSetEncodeIteratorRWFVersion (&it, rwf_major_version(), rwf_minor_version());
+	if (RSSL_RET_SUCCESS != rc) {
+		LOG(ERROR) << prefix_ << "rsslSetEncodeIteratorRWFVersion: { "
+			  "\"returnCode\": " << static_cast<signed> (rc) << ""
+			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
+			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
+			", \"majorVersion\": " << static_cast<unsigned> (rwf_major_version()) << ""
+			", \"minorVersion\": " << static_cast<unsigned> (rwf_minor_version()) << ""
+			" }";
+		goto cleanup;
+	}
+	rc = rsslReplaceStreamId (&it, request_token);
+	if (RSSL_RET_SUCCESS != rc) {
+		LOG(ERROR) << prefix_ << "rsslReplaceStreamId: { "
+			  "\"returnCode\": " << static_cast<signed> (rc) << ""
+			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
+			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
+			", \"streamId\": " << request_token << ""
+			" }";
+		goto cleanup;
+	}
+	if (!Submit (buf))
+		goto cleanup;
+	return true;
+cleanup:
+	if (RSSL_RET_SUCCESS != rsslReleaseBuffer (buf, &rssl_err)) {
+		LOG(WARNING) << prefix_ << "rsslReleaseBuffer: { "
+			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
+			", \"sysError\": " << rssl_err.sysError << ""
+			", \"text\": \"" << rssl_err.text << "\""
+			" }";
+	}
+	return false;
+}
+
 /* Forward submit requests to containing provider.
  */
 int
@@ -1436,6 +2065,8 @@ hitsuji::client_t::Submit (
 	)
 {
 	DCHECK(nullptr != buf);
+/* Preserve ordering with pending replies. */
+	SubmitPack();
 	const int status = provider_->Submit (handle_, buf);
 	if (status) cumulative_stats_[CLIENT_PC_RSSL_MSGS_SENT]++;
 	return status;
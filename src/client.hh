@@ -5,9 +5,9 @@
 #define CLIENT_HH_
 
 #include <cstdint>
+#include <deque>
 #include <memory>
 #include <unordered_map>
-#include <unordered_set>
 
 /* Boost Posix Time */
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -19,13 +19,17 @@
 #include "chromium/string_piece.hh"
 #include "upa.hh"
 #include "config.hh"
+#include "counters.hh"
 #include "deleter.hh"
+#include "flat_hash.hh"
+#include "timer_wheel.hh"
 
 namespace hitsuji
 {
 /* Performance Counters */
 	enum {
 		CLIENT_PC_RSSL_MSGS_SENT,
+		CLIENT_PC_RSSL_PACKED_MSGS,
 		CLIENT_PC_RSSL_MSGS_RECEIVED,
 		CLIENT_PC_RSSL_MSGS_REJECTED,
 		CLIENT_PC_REQUEST_MSGS_RECEIVED,
@@ -54,6 +58,7 @@ namespace hitsuji
 		CLIENT_PC_ITEM_STREAMING_REQUEST_RECEIVED,
 		CLIENT_PC_ITEM_REISSUE_REQUEST_RECEIVED,
 		CLIENT_PC_ITEM_SNAPSHOT_REQUEST_RECEIVED,
+		CLIENT_PC_ITEM_VIEW_REQUEST_RECEIVED,
 		CLIENT_PC_ITEM_REQUEST_REJECTED,
 		CLIENT_PC_ITEM_VALIDATED,
 		CLIENT_PC_ITEM_MALFORMED,
@@ -66,6 +71,12 @@ namespace hitsuji
 		CLIENT_PC_ITEM_CLOSE_VALIDATED,
 		CLIENT_PC_OMM_INACTIVE_CLIENT_SESSION_RECEIVED,
 		CLIENT_PC_OMM_INACTIVE_CLIENT_SESSION_EXCEPTION,
+		CLIENT_PC_REPLY_QUEUED,
+		CLIENT_PC_REPLY_CONFLATED,
+		CLIENT_PC_REPLY_DISCARDED,
+		CLIENT_PC_QUEUE_OVERFLOW,
+		CLIENT_PC_QUEUE_STREAM_CLOSED,
+		CLIENT_PC_QUEUE_TIME_MS,
 		CLIENT_PC_MAX
 	};
 
@@ -80,16 +91,25 @@ namespace hitsuji
 		public:
 		    Delegate() {}
 
-		    virtual bool OnRequest (uintptr_t handle, uint16_t rwf_version, int32_t token, uint16_t service_id, const std::string& item_name, bool use_attribinfo_in_updates) = 0;
-		    virtual bool OnRequest (uintptr_t handle, uint16_t rwf_version, int32_t token, uint16_t service_id, const std::string& item_name, bool use_attribinfo_in_updates, const std::vector<int_fast16_t>& view_by_fid) = 0;
+		    virtual bool OnRequest (uint64_t handle, uint16_t rwf_version, int32_t token, uint16_t service_id, const chromium::StringPiece& item_name, bool use_attribinfo_in_updates) = 0;
+		    virtual bool OnRequest (uint64_t handle, uint16_t rwf_version, int32_t token, uint16_t service_id, const chromium::StringPiece& item_name, bool use_attribinfo_in_updates, const std::vector<int_fast16_t>& view_by_fid) = 0;
 /* TBD */
-//		    virtual bool OnCancel (uintptr_t handle, uint16_t rwf_version, int32_t token, uint16_t service_id, const std::string& item_name, bool use_attribinfo_in_updates) = 0;
+//		    virtual bool OnCancel (uint64_t handle, uint16_t rwf_version, int32_t token, uint16_t service_id, const std::string& item_name, bool use_attribinfo_in_updates) = 0;
 
 		protected:
 		    virtual ~Delegate() {}
 		};
 
-		explicit client_t (std::shared_ptr<provider_t> provider, Delegate* delegate, RsslChannel* handle, const char* address);
+/* Action taken when the outbound queue of a backed up client exceeds its byte budget. */
+		enum SlowConsumerPolicy {
+			kBuffer,		/* discard replies that do not fit and close their streams */
+			kConflate,		/* replace queued reply on the same stream, evict and close oldest */
+			kCloseStreams,		/* discard queued replies and close their streams */
+			kDisconnect		/* abort the connection */
+		};
+		static bool ParseSlowConsumerPolicy (const std::string& str, SlowConsumerPolicy* policy);
+
+		explicit client_t (std::shared_ptr<provider_t> provider, Delegate* delegate, RsslChannel* handle, uint64_t session_handle, const char* address);
 		~client_t();
 
 		bool Initialize();
@@ -97,11 +117,17 @@ namespace hitsuji
 
 		bool OnSourceDirectoryUpdate();
 		bool SendReply (int32_t token, const void* data, size_t length);
+/* RSSL channel flushed, resume writing queued replies. */
+		void OnWritable();
 
 /* RSSL client socket */
 		RsslChannel*const handle() const {
 			return handle_;
 		}
+/* Provider slot table handle, stable for the life of this session. */
+		uint64_t session_handle() const {
+			return session_handle_;
+		}
 		uint8_t rwf_major_version() const {
 			return handle_->majorVersion;
 		}
@@ -111,9 +137,19 @@ namespace hitsuji
 		uint16_t rwf_version() const {
 			return (rwf_major_version() * 256) + rwf_minor_version();
 		}
-		const std::unordered_set<int32_t>& tokens() const {
+		const internal::flat_set_t<int32_t>& tokens() const {
 			return tokens_;
 		}
+		size_t queue_depth() const {
+			return queue_.size();
+		}
+		size_t queued_bytes() const {
+			return queued_bytes_;
+		}
+/* Owned by the provider event loop thread. */
+		const counters_t<CLIENT_PC_MAX>& cumulative_stats() const {
+			return cumulative_stats_;
+		}
 
 	private:
 		bool OnMsg (RsslDecodeIterator* it, const RsslMsg* msg);
@@ -130,22 +166,37 @@ namespace hitsuji
 
 		bool RejectLogin (const RsslRequestMsg* msg, int32_t login_token);
 		bool AcceptLogin (const RsslRequestMsg* msg, int32_t login_token);
+		bool EncodeLoginRefresh (const RsslRequestMsg* msg, int32_t login_token, RsslBuffer* buf);
 
 		bool SendDirectoryRefresh (int32_t token, const char* service_name, uint32_t filter_mask);
+		bool EncodeDirectoryRefresh (int32_t token, const char* service_name, uint32_t filter_mask, RsslBuffer* buf);
 		bool SendDirectoryUpdate (int32_t token, const char* service_name);
+		bool EncodeDirectoryUpdate (int32_t token, const char* service_name, RsslBuffer* buf);
 		bool SendClose (int32_t token, uint16_t service_id, uint8_t model_type, const chromium::StringPiece& item_name, bool use_attribinfo_in_updates, uint8_t stream_state, uint8_t status_code, const chromium::StringPiece& status_text);
 		int Submit (RsslBuffer* buf);
+		bool SubmitEncoded (int32_t token, const std::vector<char>& encoded);
+		bool PackReply (const void* data, size_t length);
+		bool WriteReply (const void* data, size_t length);
+		bool SubmitPack();
+		void ReleasePack();
+		bool Enqueue (int32_t token, const void* data, size_t length);
+		bool CloseQueuedStreams (int32_t token);
+		bool CloseStream (int32_t token);
+		void DiscardReplies (int32_t token);
+		bool DiscardQueued (int32_t token);
+		void SetWriteBlocked();
 
-		const boost::posix_time::ptime& NextPing() const {
+/* Deadlines only move forward here, expired timers re-arm to the latest deadline. */
+		uint64_t NextPing() const {
 			return next_ping_;
 		}
-		const boost::posix_time::ptime& NextPong() const {
+		uint64_t NextPong() const {
 			return next_pong_;
 		}
-		void SetNextPing (const boost::posix_time::ptime& time_) {
+		void SetNextPing (uint64_t time_) {
 			next_ping_ = time_;
 		}
-		void SetNextPong (const boost::posix_time::ptime& time_) {
+		void SetNextPong (uint64_t time_) {
 			next_pong_ = time_;
 		}
 		void IncrementPendingCount() {
@@ -170,25 +221,51 @@ namespace hitsuji
 
 /* UPA socket. */
 		RsslChannel* handle_;
+/* Generation-checked slot handle passed to workers in place of the socket. */
+		const uint64_t session_handle_;
 /* Pending messages to flush. */
 		unsigned pending_count_;
+/* Packed buffer of replies written once per event loop pass. */
+		RsslBuffer* pack_buf_;
+/* Length of the last reply copied into the packed buffer but not yet packed. */
+		size_t pack_length_;
+/* Remaining capacity of the packed buffer. */
+		size_t pack_available_;
+		unsigned pack_count_;
 
+/* Outbound queue whilst the channel is backed up, bounded by client_queue_bytes.  Keeps a
+ * slow consumer from draining the shared RSSL buffer pool of the event loop.
+ */
+		struct queued_reply_t {
+			int32_t token;
+			bool is_status;
+			uint64_t enqueued;
+			std::vector<char> data;
+		};
+		std::deque<queued_reply_t> queue_;
+		size_t queued_bytes_;
+		bool is_write_blocked_;
+		uint32_t max_queue_time_;
+
 /* Watchlist of all items. */
-		std::unordered_set<int32_t> tokens_;
+		internal::flat_set_t<int32_t> tokens_;
 /* Item requests may appear before login success has been granted. */
 		bool is_logged_in_;
 		int32_t directory_token_;
 		int32_t login_token_;
-/* RSSL keepalive state. */
-		boost::posix_time::ptime next_ping_;
-		boost::posix_time::ptime next_pong_;
+/* RSSL keepalive state, milliseconds on the provider event loop clock. */
+		uint64_t next_ping_;
+		uint64_t next_pong_;
 		unsigned ping_interval_;
+		timer_wheel_t::entry_t ping_timer_, pong_timer_;
+/* Buffer pool retry whilst blocked with nothing to flush. */
+		timer_wheel_t::entry_t write_timer_;
 
 		friend provider_t;
 
 /** Performance Counters **/
 		boost::posix_time::ptime creation_time_, last_activity_;
-		uint32_t cumulative_stats_[CLIENT_PC_MAX];
+		counters_t<CLIENT_PC_MAX> cumulative_stats_;
 		uint32_t snap_stats_[CLIENT_PC_MAX];
 
 #ifdef HITSUJIMIB_H
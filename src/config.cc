@@ -12,7 +12,35 @@ hitsuji::config_t::config_t() :
 	vendor_name ("Thomson Reuters"),
 	maximum_data_size (64 * 1024),
 	session_capacity (8),
-	worker_count (6)
+	worker_count (6),
+	shard_count (1),
+	read_budget_msgs (32),
+	read_budget_bytes (64 * 1024),
+	compression ("none"),
+	compression_level (6),
+	compression_threshold (1024),
+	client_queue_bytes (4 * 1024 * 1024),
+	slow_consumer_policy ("buffer"),
+	open_limit (10000),
+	open_window (1000),	/* ZMQ_SNDHWM */
+	load_target_ms (2000),
+	load_bands (8),
+	load_interval_ms (1000),
+	latency_interval_ms (60000),
+	stats_table ("Hitsuji"),
+	stats_interval_ms (1000),
+	trace_ring_size (16 * 1024),
+	trace_file ("/Hitsuji.trace"),
+	overload_wait_ms (10000),
+	overload_memory_mb (0),
+	overload_sustain_ms (30000),
+	overload_recovery_pct (75),
+	reply_slab_size (64 * 1024),
+	reply_slab_count (128),
+	request_slab_count (256),
+	dacs_lock_ttl (300),
+	symbol_refresh_interval (300),
+	negative_cache_size (4096)
 {
 /* C++11 initializer lists not supported in MSVC2010 */
 }
@@ -36,6 +36,94 @@ namespace hitsuji
 
 //  Count of request worker threads.
 		size_t worker_count;
+
+//  Count of RSSL event loop threads, new connections go to the least loaded, maximum 255.
+		size_t shard_count;
+
+//  Messages read from one connection per event loop pass before moving to the next.
+		unsigned read_budget_msgs;
+
+//  Bytes read from one connection per event loop pass before moving to the next.
+		size_t read_budget_bytes;
+
+//  Compression offered to clients: none, zlib, or lz4.
+		std::string compression;
+
+//  zlib compression level, 0 to 9.
+		unsigned compression_level;
+
+//  Messages smaller than this many bytes are sent uncompressed.
+		unsigned compression_threshold;
+
+//  Outbound byte budget per client whilst the connection is backed up, 0 for unlimited.
+		size_t client_queue_bytes;
+
+//  Action when a client exceeds its outbound budget: buffer, conflate, close, or disconnect.
+		std::string slow_consumer_policy;
+
+//  Outstanding requests at which the advertised OpenLimit reaches zero and LoadFactor saturates.
+		size_t open_limit;
+
+//  Requests queued for a worker at which the advertised OpenWindow reaches zero.
+		size_t open_window;
+
+//  95th percentile service time in milliseconds at which LoadFactor saturates.
+		unsigned load_target_ms;
+
+//  Count of LoadFactor bands, crossing a band or a change of OpenLimit or OpenWindow sends a source directory update.
+		unsigned load_bands;
+
+//  Interval in milliseconds to recalculate service load.
+		unsigned load_interval_ms;
+
+//  Interval in milliseconds to log per stage latency percentiles and DACS lock cache statistics, 0 to disable.
+		unsigned latency_interval_ms;
+
+//  Name of the shared-memory stats table for external monitoring, empty to disable.
+		std::string stats_table;
+
+//  Interval in milliseconds to copy event loop counters to the stats table.
+		unsigned stats_interval_ms;
+
+//  Trace records kept per event loop and worker thread, 32 bytes each, 0 to disable.
+		size_t trace_ring_size;
+
+//  File written by a trace dump on demand or on fault, decoded by HitsujiTrace.
+		std::string trace_file;
+
+//  95th percentile worker service time in milliseconds, including queue wait, at which the
+//  service is overloaded, 0 to disable.
+		unsigned overload_wait_ms;
+
+//  Process private bytes in MiB at which the service is overloaded, 0 to disable.
+		size_t overload_memory_mb;
+
+//  Milliseconds an overload or recovery must be sustained before AcceptingRequests changes.
+		unsigned overload_sustain_ms;
+
+//  Percentage of each overload limit under which the service recovers.
+		unsigned overload_recovery_pct;
+
+//  Capacity in bytes of each reply encode buffer, the largest response a worker can write.
+		size_t reply_slab_size;
+
+//  Reply encode buffers allocated at start, the pool grows on demand.
+		size_t reply_slab_count;
+
+//  Request encode buffers allocated at start, the pool grows on demand.
+		size_t request_slab_count;
+
+//  Lifetime of cached DACS locks in seconds, 0 to disable caching.
+		unsigned dacs_lock_ttl;
+
+//  File of symbols to preload, one per line, e.g. C:/Vhayu/Config/symbolmap.txt.
+		std::string symbol_map;
+
+//  Interval in seconds to rebuild the symbol table, 0 to disable.
+		unsigned symbol_refresh_interval;
+
+//  Count of unknown symbols remembered between refreshes.
+		size_t negative_cache_size;
 	};
 
 	inline
@@ -48,6 +136,35 @@ namespace hitsuji
 			", \"maximum_data_size\": " << config.maximum_data_size <<
 			", \"session_capacity\": " << config.session_capacity << 
 			", \"worker_count\": " << config.worker_count << 
+			", \"shard_count\": " << config.shard_count <<
+			", \"read_budget_msgs\": " << config.read_budget_msgs <<
+			", \"read_budget_bytes\": " << config.read_budget_bytes <<
+			", \"compression\": \"" << config.compression << "\""
+			", \"compression_level\": " << config.compression_level <<
+			", \"compression_threshold\": " << config.compression_threshold <<
+			", \"client_queue_bytes\": " << config.client_queue_bytes <<
+			", \"slow_consumer_policy\": \"" << config.slow_consumer_policy << "\""
+			", \"open_limit\": " << config.open_limit <<
+			", \"open_window\": " << config.open_window <<
+			", \"load_target_ms\": " << config.load_target_ms <<
+			", \"load_bands\": " << config.load_bands <<
+			", \"load_interval_ms\": " << config.load_interval_ms <<
+			", \"latency_interval_ms\": " << config.latency_interval_ms <<
+			", \"stats_table\": \"" << config.stats_table << "\""
+			", \"stats_interval_ms\": " << config.stats_interval_ms <<
+			", \"trace_ring_size\": " << config.trace_ring_size <<
+			", \"trace_file\": \"" << config.trace_file << "\""
+			", \"overload_wait_ms\": " << config.overload_wait_ms <<
+			", \"overload_memory_mb\": " << config.overload_memory_mb <<
+			", \"overload_sustain_ms\": " << config.overload_sustain_ms <<
+			", \"overload_recovery_pct\": " << config.overload_recovery_pct <<
+			", \"reply_slab_size\": " << config.reply_slab_size <<
+			", \"reply_slab_count\": " << config.reply_slab_count <<
+			", \"request_slab_count\": " << config.request_slab_count <<
+			", \"dacs_lock_ttl\": " << config.dacs_lock_ttl <<
+			", \"symbol_map\": \"" << config.symbol_map << "\""
+			", \"symbol_refresh_interval\": " << config.symbol_refresh_interval <<
+			", \"negative_cache_size\": " << config.negative_cache_size <<
 			" }";
 		return o;
 	}
@@ -0,0 +1,79 @@
+/* Performance counters with a single writer.
+ *
+ * Each counter set is updated only by the thread that owns it, such as an event loop, a
+ * worker or the acceptor, and the SNMP agent reads it on demand from its own thread.
+ *
+ * Counters are 64-bit relaxed atomics, so a reader never sees a torn value.  Because there
+ * is only one writer, an increment is a plain load and store with no locked instruction.
+ *
+ * Each set is aligned to a cache line, so counters updated by different threads never
+ * share a line.  A reader wanting a total across threads sums the sets itself.
+ */
+
+#ifndef COUNTERS_HH_
+#define COUNTERS_HH_
+
+#include <cstddef>
+#include <cstdint>
+
+/* Boost Atomics */
+#include <boost/atomic.hpp>
+
+#if defined(_MSC_VER)
+#	define HITSUJI_CACHELINE_ALIGN __declspec(align(64))
+#else
+#	define HITSUJI_CACHELINE_ALIGN __attribute__((aligned(64)))
+#endif
+
+namespace hitsuji
+{
+	class counter_t
+	{
+	public:
+		counter_t() : value_ (0) {}
+
+/* Owner thread only. */
+		void operator++ (int) {
+			value_.store (value_.load (boost::memory_order_relaxed) + 1, boost::memory_order_relaxed);
+		}
+		counter_t& operator+= (uint64_t value) {
+			value_.store (value_.load (boost::memory_order_relaxed) + value, boost::memory_order_relaxed);
+			return *this;
+		}
+/* Any thread. */
+		operator uint64_t() const {
+			return value_.load (boost::memory_order_relaxed);
+		}
+
+	private:
+		boost::atomic<uint64_t> value_;
+	};
+
+	template <size_t N>
+	class HITSUJI_CACHELINE_ALIGN counters_t
+	{
+	public:
+		counter_t& operator[] (size_t i) {
+			return counters_[i];
+		}
+		uint64_t operator[] (size_t i) const {
+			return counters_[i];
+		}
+		static size_t size() {
+			return N;
+		}
+/* Add this set to per counter totals, as read by an aggregating reader. */
+		void AddTo (uint64_t (&totals)[N]) const {
+			for (size_t i = 0; i < N; ++i)
+				totals[i] += counters_[i];
+		}
+
+	private:
+		counter_t counters_[N];
+	};
+
+} /* namespace hitsuji */
+
+#endif /* COUNTERS_HH_ */
+
+/* eof */
\ No newline at end of file
@@ -0,0 +1,104 @@
+/* Pre-encoded directory and login responses of one event loop.
+ *
+ * Every client of an event loop is sent the same login refresh and source directory bytes
+ * apart from the stream ID, which is patched per client.  Free of the RSSL headers so that
+ * keying and invalidation can be tested alone.
+ */
+
+#ifndef ENCODED_CACHE_HH_
+#define ENCODED_CACHE_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Boost Atomics */
+#include <boost/atomic.hpp>
+
+#include "chromium/string_piece.hh"
+
+namespace hitsuji
+{
+	class encoded_cache_t
+	{
+	public:
+/* Login images are bounded by login_capacity distinct keys, normally one or two ADS login
+ * names.
+ */
+		explicit encoded_cache_t (size_t login_capacity)
+			: generation_ (0)
+			, login_capacity_ (login_capacity)
+		{
+		}
+
+/* Directory images depend on RWF version, message class and filter mask. */
+		static uint64_t directory_key (uint16_t rwf_version, uint8_t msg_class, uint32_t filter_mask) {
+			return (static_cast<uint64_t> (rwf_version) << 40) | (static_cast<uint64_t> (msg_class) << 32) | filter_mask;
+		}
+/* Login images depend on RWF version, login name and name type, independent of service
+ * state.
+ */
+		static void login_key (const chromium::StringPiece& name, uint8_t name_type, uint16_t rwf_version, std::string* key) {
+			key->assign (name.data(), name.size());
+			key->push_back ('\0');
+			key->push_back (static_cast<char> (name_type));
+			key->push_back (static_cast<char> (rwf_version / 256));
+			key->push_back (static_cast<char> (rwf_version % 256));
+		}
+
+/* Advanced on any service state change, directory images encoded before are stale.  May be
+ * called from any thread.
+ */
+		void Invalidate() {
+			generation_.fetch_add (1, boost::memory_order_relaxed);
+		}
+
+/* Returns nullptr when absent or stale. */
+		const std::vector<char>* GetDirectory (uint64_t key) const {
+			auto it = directories_.find (key);
+			if (directories_.end() == it || it->second.generation != generation_.load())
+				return nullptr;
+			return &it->second.data;
+		}
+		const std::vector<char>& SetDirectory (uint64_t key, const void* data, size_t length) {
+			encoded_t& encoded = directories_[key];
+			encoded.generation = generation_.load();
+			encoded.data.assign (static_cast<const char*> (data), static_cast<const char*> (data) + length);
+			return encoded.data;
+		}
+
+		const std::vector<char>* GetLogin (const std::string& key) const {
+			auto it = logins_.find (key);
+			if (logins_.end() == it)
+				return nullptr;
+			return &it->second;
+		}
+		const std::vector<char>& SetLogin (const std::string& key, const void* data, size_t length) {
+			if (logins_.size() >= login_capacity_ && logins_.end() == logins_.find (key))
+				logins_.clear();
+			std::vector<char>& encoded = logins_[key];
+			encoded.assign (static_cast<const char*> (data), static_cast<const char*> (data) + length);
+			return encoded;
+		}
+
+		size_t directory_count() const { return directories_.size(); }
+		size_t login_count() const { return logins_.size(); }
+
+	private:
+		boost::atomic_uint32_t generation_;
+		struct encoded_t {
+			uint32_t generation;
+			std::vector<char> data;
+		};
+		std::unordered_map<uint64_t, encoded_t> directories_;
+		std::unordered_map<std::string, std::vector<char>> logins_;
+		const size_t login_capacity_;
+	};
+
+} /* namespace hitsuji */
+
+#endif /* ENCODED_CACHE_HH_ */
+
+/* eof */
@@ -0,0 +1,106 @@
+/* Direct RWF serialisation of a standard field list of reals.
+ *
+ * Field identifiers, order and types are fixed per analytic so the container is written
+ * straight into a buffer, bypassing the encode iterator state machine.  Output matches
+ * rsslEncodeFieldListInit, rsslEncodeFieldEntry and rsslEncodeFieldListComplete.
+ *
+ * An optional sorted view restricts output to the intersecting field identifiers.
+ */
+
+#ifndef FIELD_LIST_HH_
+#define FIELD_LIST_HH_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/* UPA 7.4 headers */
+#include <upa/upa.h>
+
+namespace internal {
+
+class real_field_list_t
+{
+public:
+	real_field_list_t (void* data, size_t length, const std::vector<RsslFieldId>* view = nullptr)
+		: data_ (static_cast<uint8_t*> (data))
+		, length_ (length)
+		, offset_ (0)
+		, count_ (0)
+		, view_ (nullptr != view && !view->empty() ? view : nullptr)
+	{
+/* flags, standard data only */
+		if (length_ >= 3) {
+			data_[0] = RSSL_FLF_HAS_STANDARD_DATA;
+/* field count patched on completion */
+			offset_ = 3;
+		} else {
+			offset_ = length_ + 1;
+		}
+	}
+
+/* Returns true if the field identifier is requested. */
+	bool IsInView (RsslFieldId fid) const {
+		return nullptr == view_ || std::binary_search (view_->begin(), view_->end(), fid);
+	}
+
+/* Returns false if the buffer is exhausted, fields outside the view are skipped. */
+	bool Append (RsslFieldId fid, const RsslReal& real) {
+		if (!IsInView (fid))
+			return true;
+/* fid (2) + length (1) + hint (1) + maximum mantissa (8) */
+		if (offset_ + 12 > length_) {
+			offset_ = length_ + 1;
+			return false;
+		}
+		data_[offset_++] = static_cast<uint8_t> (static_cast<uint16_t> (fid) >> 8);
+		data_[offset_++] = static_cast<uint8_t> (fid);
+		if (real.isBlank) {
+			data_[offset_++] = 0;
+		} else {
+			const unsigned width = signed_width (real.value);
+			data_[offset_++] = static_cast<uint8_t> (1 + width);
+			data_[offset_++] = real.hint;
+			for (unsigned i = width; i > 0; --i)
+				data_[offset_++] = static_cast<uint8_t> (static_cast<uint64_t> (real.value) >> ((i - 1) * 8));
+		}
+		++count_;
+		return true;
+	}
+
+/* Returns false on overflow, otherwise sets encoded to the completed container. */
+	bool Complete (RsslBuffer* encoded) {
+		if (offset_ > length_)
+			return false;
+		data_[1] = static_cast<uint8_t> (count_ >> 8);
+		data_[2] = static_cast<uint8_t> (count_);
+		encoded->data = reinterpret_cast<char*> (data_);
+		encoded->length = static_cast<uint32_t> (offset_);
+		return true;
+	}
+
+private:
+/* Minimum two's complement width, at least one byte. */
+	static unsigned signed_width (int64_t value) {
+		unsigned width = 1;
+		while (width < 8) {
+			const int64_t limit = INT64_C(1) << (width * 8 - 1);
+			if (value >= -limit && value < limit)
+				break;
+			++width;
+		}
+		return width;
+	}
+
+	uint8_t* data_;
+	size_t length_;
+	size_t offset_;
+	uint16_t count_;
+	const std::vector<RsslFieldId>* view_;
+};
+
+} /* namespace internal */
+
+#endif /* FIELD_LIST_HH_ */
+
+/* eof */
\ No newline at end of file
@@ -0,0 +1,208 @@
+/* Open addressing hash containers for integral keys.
+ *
+ * Linear probing over one contiguous array with backward shift deletion, there are no
+ * tombstones and no per entry nodes.  Storage grows past the high water mark only and is
+ * never released by erase() or clear(), so steady state insertion and erasure do not touch
+ * the heap.
+ */
+
+#ifndef FLAT_HASH_HH_
+#define FLAT_HASH_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace internal {
+
+template <typename Key, typename Value>
+class flat_map_t
+{
+public:
+	explicit flat_map_t (size_t capacity = 16)
+		: size_ (0)
+		, mask_ (0)
+		, shift_ (64)
+	{
+		reserve (capacity);
+	}
+
+	size_t size() const {
+		return size_;
+	}
+	bool empty() const {
+		return 0 == size_;
+	}
+
+/* Returns nullptr if absent. */
+	Value* find (Key key) {
+		for (size_t i = bucket (key);; i = (i + 1) & mask_) {
+			slot_t& slot = slots_[i];
+			if (!slot.is_used)
+				return nullptr;
+			if (slot.key == key)
+				return &slot.value;
+		}
+	}
+	const Value* find (Key key) const {
+		return const_cast<flat_map_t*> (this)->find (key);
+	}
+	size_t count (Key key) const {
+		return nullptr != find (key) ? 1 : 0;
+	}
+
+/* Returns false if the key is already present, the existing value is kept. */
+	bool insert (Key key, const Value& value) {
+		if (2 * (size_ + 1) > slots_.size())
+			rehash (2 * slots_.size());
+		for (size_t i = bucket (key);; i = (i + 1) & mask_) {
+			slot_t& slot = slots_[i];
+			if (!slot.is_used) {
+				slot.key = key;
+				slot.value = value;
+				slot.is_used = true;
+				++size_;
+				return true;
+			}
+			if (slot.key == key)
+				return false;
+		}
+	}
+	Value& operator[] (Key key) {
+		Value* value = find (key);
+		if (nullptr == value) {
+			insert (key, Value());
+			value = find (key);
+		}
+		return *value;
+	}
+
+/* Returns count of entries removed. */
+	size_t erase (Key key) {
+		size_t hole = bucket (key);
+		for (;; hole = (hole + 1) & mask_) {
+			if (!slots_[hole].is_used)
+				return 0;
+			if (slots_[hole].key == key)
+				break;
+		}
+/* Shift back each following entry whose probe sequence passes through the hole. */
+		for (size_t i = (hole + 1) & mask_; slots_[i].is_used; i = (i + 1) & mask_) {
+			const size_t home = bucket (slots_[i].key);
+			if (((i - home) & mask_) >= ((i - hole) & mask_)) {
+				slots_[hole] = slots_[i];
+				hole = i;
+			}
+		}
+		slots_[hole].is_used = false;
+		--size_;
+		return 1;
+	}
+
+/* Erase every entry matching pred (key, value), returns count of entries removed.  A slot is
+ * revisited after an erase as the backward shift may have moved a later entry into it.
+ */
+	template <typename Predicate>
+	size_t erase_if (Predicate pred) {
+		size_t removed = 0;
+		for (size_t i = 0; i < slots_.size();) {
+			if (slots_[i].is_used && pred (slots_[i].key, slots_[i].value)) {
+				erase (slots_[i].key);
+				++removed;
+				continue;
+			}
+			++i;
+		}
+		return removed;
+	}
+
+	void clear() {
+		for (auto it = slots_.begin(); it != slots_.end(); ++it)
+			it->is_used = false;
+		size_ = 0;
+	}
+
+/* Pre-size for count entries at the maximum load factor of one half. */
+	void reserve (size_t count) {
+		size_t capacity = 16;
+		while (capacity < 2 * count)
+			capacity *= 2;
+		if (capacity > slots_.size())
+			rehash (capacity);
+	}
+
+private:
+	struct slot_t {
+		Key key;
+		Value value;
+		bool is_used;
+	};
+
+/* Fibonacci hashing, sequential stream identifiers spread over the table. */
+	size_t bucket (Key key) const {
+		return static_cast<size_t> ((static_cast<uint64_t> (key) * UINT64_C(0x9E3779B97F4A7C15)) >> shift_);
+	}
+
+	void rehash (size_t capacity) {
+		std::vector<slot_t> slots (capacity);
+		for (auto it = slots.begin(); it != slots.end(); ++it)
+			it->is_used = false;
+		slots_.swap (slots);
+		mask_ = capacity - 1;
+		shift_ = 64;
+		for (size_t i = capacity; i > 1; i >>= 1)
+			--shift_;
+		size_ = 0;
+		for (auto it = slots.begin(); it != slots.end(); ++it) {
+			if (it->is_used)
+				insert (it->key, it->value);
+		}
+	}
+
+	std::vector<slot_t> slots_;
+	size_t size_;
+	size_t mask_;
+	unsigned shift_;
+};
+
+template <typename Key>
+class flat_set_t
+{
+public:
+	explicit flat_set_t (size_t capacity = 16)
+		: map_ (capacity)
+	{
+	}
+
+	size_t size() const {
+		return map_.size();
+	}
+	bool empty() const {
+		return map_.empty();
+	}
+	size_t count (Key key) const {
+		return map_.count (key);
+	}
+/* Returns false if the key is already present. */
+	bool insert (Key key) {
+		return map_.insert (key, true);
+	}
+	size_t erase (Key key) {
+		return map_.erase (key);
+	}
+	void clear() {
+		map_.clear();
+	}
+	void reserve (size_t count) {
+		map_.reserve (count);
+	}
+
+private:
+	flat_map_t<Key, bool> map_;
+};
+
+} /* namespace internal */
+
+#endif /* FLAT_HASH_HH_ */
+
+/* eof */
\ No newline at end of file
@@ -7,27 +7,31 @@
 #define __STDC_FORMAT_MACROS
 #include <cstdint>
 #include <inttypes.h>
+#include <sstream>
 
 #include <windows.h>
 
 #include "chromium/logging.hh"
+#include "chromium/metrics/stats_table.hh"
+#include "acceptor.hh"
+#include "permdata.hh"
 #include "provider.hh"
+#include "shard.hh"
+#include "slab_pool.hh"
+#include "stats.hh"
+#include "symbol_table.hh"
+#include "trace.hh"
 #include "upa.hh"
 #include "version.hh"
 #include "worker.hh"
 
-/* Outstanding defects:
- * warning C4244: '=' : conversion from 'const sbe_uint64_t' to 'int', possible loss of data
- * warning C4244: 'return' : conversion from 'sbe_uint64_t' to 'int', possible loss of data
- * warning C4146: unary minus operator applied to unsigned type, result still unsigned
- * warning C4244: 'initializing' : conversion from 'sbe_int64_t' to 'int', possible loss of data
- */
-#pragma warning(push)
-#pragma warning(disable: 4244 146)
-#include "hitsuji/MessageHeader.hpp"
-#include "hitsuji/Request.hpp"
-#include "hitsuji/Reply.hpp"
-#pragma warning(pop)
+/* SBE shard identifier is 8-bit. */
+static const size_t kMaxShardCount = UINT8_MAX;
+
+#ifndef CONFIG_AS_APPLICATION
+/* Tcl API: drop every cached DACS lock, e.g. after a PermData correction. */
+static const char* kClearDacsLocksCommand = "hitsuji_clear_dacs_locks";
+#endif
 
 /* Global weak pointer to shutdown as application */
 static std::weak_ptr<hitsuji::hitsuji_t> g_application;
@@ -43,9 +47,7 @@ hitsuji::hitsuji_t::hitsuji_t()
 	, shutting_down_ (false)
 /* Unique instance number, never decremented. */
 	, instance_ (instance_count_.fetch_add (1, boost::memory_order_relaxed))
-	, sbe_hdr_ (new hitsuji::MessageHeader())
-	, sbe_request_ (new hitsuji::Request())
-	, sbe_reply_ (new hitsuji::Reply())
+	, is_fault_handler_installed_ (false)
 {
 }
 
@@ -73,6 +75,9 @@ hitsuji::hitsuji_t::init (
 	if (!Start()) {
 		throw vpf::UserPluginException ("Hitsuji plugin start failed.");
 	}
+/* Register Tcl API. */
+	registerCommand (getId(), kClearDacsLocksCommand);
+	LOG(INFO) << "Registered Tcl API \"" << kClearDacsLocksCommand << "\"";
 }
 
 /* Free all resources whilst logging device is attached. */
@@ -83,6 +88,8 @@ hitsuji::hitsuji_t::destroy ()
 		  "\"pluginType\": \"" << plugin_type_ << "\""
 		", \"pluginId\": \"" << plugin_id_ << "\""
 		" }";
+/* Unregister Tcl API. */
+	deregisterCommand (getId(), kClearDacsLocksCommand);
 	Stop();
 /* Thunk to VA user-plugin base class. */
 	vpf::AbstractUserPlugin::destroy();
@@ -95,7 +102,16 @@ hitsuji::hitsuji_t::execute (
 	vpf::TCLCommandData& cmdData
 	)
 {
-	return TCL_ERROR;
+	const std::string command (cmdInfo.getCommandName());
+	if (kClearDacsLocksCommand == command) {
+		if (!(bool)permdata_)
+			return TCL_ERROR;
+		permdata_->Clear();
+		LOG(INFO) << "Cleared DACS lock cache.";
+		return TCL_OK;
+	}
+/* Any other command dumps the trace rings. */
+	return DumpTraces() ? TCL_OK : TCL_ERROR;
 }
 #else /* CONFIG_AS_APPLICATION */
 /* On a shutdown event set a global flag and force the event queue
@@ -116,6 +132,9 @@ CtrlHandler (
 		message = "Caught close event";
 		break;
 	case CTRL_BREAK_EVENT:
+/* Dump trace rings without stopping, shut down as before when tracing is disabled. */
+		if (!g_application.expired() && g_application.lock()->DumpTraces())
+			return TRUE;
 		message = "Caught ctrl-break event";
 		break;
 	case CTRL_LOGOFF_EVENT:
@@ -163,8 +182,8 @@ void
 hitsuji::hitsuji_t::Quit()
 {
 	shutting_down_ = true;
-	if ((bool)provider_) {
-		provider_->Quit();
+	if (!shards_.empty()) {
+		shards_.front()->provider()->Quit();
 	}
 }
 #endif /* CONFIG_AS_APPLICATION */
@@ -172,8 +191,6 @@ hitsuji::hitsuji_t::Quit()
 bool
 hitsuji::hitsuji_t::Initialize()
 {
-	SOCKET reply_sock = INVALID_SOCKET;
-
 	LOG(INFO) << "Hitsuji: { "
 		  "\"version\": \"" << version_major << '.' << version_minor << '.' << version_build << "\""
 		", \"build\": { "
@@ -186,7 +203,6 @@ hitsuji::hitsuji_t::Initialize()
 		" }";
 	try {
 		static const std::function<int(void*)> zmq_term_deleter = zmq_ctx_term;
-		static const std::function<int(void*)> zmq_close_deleter = zmq_close;
 		int rc;
 /* ZeroMQ context */
 		zmq_context_.reset (zmq_ctx_new(), zmq_term_deleter);
@@ -201,39 +217,51 @@ hitsuji::hitsuji_t::Initialize()
 		LOG(INFO) << "ZeroMQ: { "
 			  "\"version\": \"" << zmq_version_major << '.' << zmq_version_minor << '.' << zmq_version_patch << "\""
 			" }";
-/* PUSH to distribute tasks */
-		worker_request_sock_.reset (zmq_socket (zmq_context_.get(), ZMQ_PUSH), zmq_close_deleter);
-		if (!(bool)worker_request_sock_)
-			goto cleanup;
-		rc = zmq_bind (worker_request_sock_.get(), "inproc://worker/request");
-		if (-1 == rc)
-			goto cleanup;
-/* PULL for worker reply messages */
-		worker_reply_sock_.reset (zmq_socket (zmq_context_.get(), ZMQ_PULL), zmq_close_deleter);
-		if (!(bool)worker_reply_sock_)
-			goto cleanup;
-		rc = zmq_bind (worker_reply_sock_.get(), "inproc://worker/reply");
-		if (-1 == rc)
-			goto cleanup;
-/* Extract notification socket to pass to provider message pump */
-		size_t sock_len = sizeof (reply_sock);
-		rc = zmq_getsockopt (worker_reply_sock_.get(), ZMQ_FD, &reply_sock, &sock_len);
-		if (-1 == rc)
-			goto cleanup;
 	} catch (const std::exception& e) {
 		LOG(ERROR) << "ZMQ::Exception: { "
 			"\"What\": \"" << e.what() << "\" }";
 		goto cleanup;
 	}
+/* Stats table before any thread registers a column, a second instance in the process
+ * shares the first instance's table and keeps it mapped until both have reset.
+ */
+	stats_table_ = AcquireStatsTable (config_.stats_table);
+/* Trace rings are written to the trace file on demand and on an unhandled exception. */
+	if (config_.trace_ring_size > 0 && !is_fault_handler_installed_) {
+		InstallTraceFaultHandler (config_.trace_file);
+		is_fault_handler_installed_ = true;
+	}
 	try {
 /* UPA context */
 		upa_.reset (new upa_t (config_));
 		if (!(bool)upa_ || !upa_->Initialize())
 			goto cleanup;
-/* UPA provider */
-		provider_.reset (new provider_t (config_, upa_, static_cast<provider_t::Delegate*> (this), reply_sock, static_cast<client_t::Delegate*> (this)));
-		if (!(bool)provider_ || !provider_->Initialize())
+/* RSSL event loops, each binding its worker queues before workers connect. */
+		const size_t shard_count = (0 == config_.shard_count) ? 1
+					 : (config_.shard_count > kMaxShardCount) ? kMaxShardCount
+					 : config_.shard_count;
+		LOG_IF(WARNING, shard_count != config_.shard_count) << "Shard count limited to " << shard_count << ".";
+/* Providers divide the worker pool by the effective count. */
+		config_.shard_count = shard_count;
+/* Request encode buffers, passed to workers by address. */
+		request_pool_.reset (new slab_pool_t (shard_t::kMaxRequestSize, config_.request_slab_count));
+		if (!(bool)request_pool_)
+			goto cleanup;
+		std::vector<provider_t*> providers;
+		for (size_t i = 0; i < shard_count; ++i) {
+			auto shard = std::make_shared<shard_t> (static_cast<unsigned> (i), config_, upa_, zmq_context_, request_pool_);
+			if (!(bool)shard)
+				goto cleanup;
+			shards_.push_back (shard);
+			if (!shard->Initialize())
+				goto cleanup;
+			providers.push_back (shard->provider().get());
+		}
+/* Acceptor completes handshakes and balances active connections over every shard. */
+		acceptor_.reset (new acceptor_t (config_, upa_));
+		if (!(bool)acceptor_ || !acceptor_->Initialize())
 			goto cleanup;
+		acceptor_->SetShards (providers);
 	} catch (const std::exception& e) {
 		LOG(ERROR) << "Upa::Initialisation exception: { "
 			"\"What\": \"" << e.what() << "\""
@@ -241,9 +269,29 @@ hitsuji::hitsuji_t::Initialize()
 		goto cleanup;
 	}
 	try {
+/* Permission data */
+		permdata_.reset (new vhayu::permdata_t (boost::chrono::seconds (config_.dacs_lock_ttl), boost::chrono::milliseconds (config_.latency_interval_ms)));
+		if (!(bool)permdata_)
+			goto cleanup;
+/* Symbol table, cached DACS locks of dropped symbols are invalidated. */
+		std::shared_ptr<vhayu::permdata_t> permdata (permdata_);
+		symbol_table_.reset (new vhayu::symbol_table_t (config_.symbol_map, boost::chrono::seconds (config_.symbol_refresh_interval), config_.negative_cache_size,
+			[permdata](const TBSymbolHandle& handle) {
+				permdata->Invalidate (handle);
+			}));
+		if (!(bool)symbol_table_ || !symbol_table_->Initialize())
+			goto cleanup;
+/* Reply encode buffers, the tail of each slab carries the worker timestamps. */
+		if (config_.reply_slab_size <= kReplyTrailerSize) {
+			LOG(ERROR) << "Reply slab size must exceed " << static_cast<unsigned> (kReplyTrailerSize) << " bytes.";
+			goto cleanup;
+		}
+		slab_pool_.reset (new slab_pool_t (config_.reply_slab_size, config_.reply_slab_count));
+		if (!(bool)slab_pool_)
+			goto cleanup;
 /* Worker threads */
 		for (size_t i = 0; i < config_.worker_count; ++i) {
-			auto worker = std::make_shared<worker_t> (zmq_context_);
+			auto worker = std::make_shared<worker_t> (zmq_context_, permdata_, symbol_table_, slab_pool_, request_pool_, shards_.size(), config_.trace_ring_size);
 			if (!(bool)worker)
 				goto cleanup;
 			auto thread = std::make_shared<boost::thread> ([worker, i](){
@@ -268,180 +316,13 @@ cleanup:
 	return false;
 }
 
-bool
-hitsuji::hitsuji_t::OnRequest (
-	uintptr_t handle,
-	uint16_t rwf_version, 
-	int32_t token,
-	uint16_t service_id,
-	const std::string& item_name,
-	bool use_attribinfo_in_updates
-	)
-{
-	DVLOG(3) << "Request: { "
-		  "\"handle\": " << handle << ""
-		", \"rwf_version\": " << rwf_version << ""
-		", \"token\": " << token << ""
-		", \"service_id\": " << service_id << ""
-		", \"item_name\": \"" << item_name << "\""
-		", \"use_attribinfo_in_updates\": " << (use_attribinfo_in_updates ? "true" : "false") << ""
-		" }";
-/* distribute to worker */
-	static const int version = 0;
-	int rc = zmq_msg_init_size (&zmq_msg_, MessageHeader::size() + Request::sbeBlockLength() + Request::itemNameHeaderSize() + item_name.size());
-	if (rc) {
-		LOG(ERROR) << "zmq_msg_init_size failed: " << zmq_strerror (zmq_errno());
-		return false;
-	}
-	sbe_hdr_->wrap (reinterpret_cast<char*> (zmq_msg_data (&zmq_msg_)), 0, version, static_cast<int> (zmq_msg_size (&zmq_msg_)))
-		.blockLength (Request::sbeBlockLength())
-		.templateId (Request::sbeTemplateId())
-		.schemaId (Request::sbeSchemaId())
-		.version (Request::sbeSchemaVersion());
-	sbe_request_->wrapForEncode (reinterpret_cast<char*> (zmq_msg_data (&zmq_msg_)), sbe_hdr_->size(), static_cast<int> (zmq_msg_size (&zmq_msg_)))
-		.handle (handle)
-		.rwfVersion (rwf_version)
-		.token (token)
-		.serviceId (service_id);
-	sbe_request_->flags().clear()
-		.abort (false)
-		.useAttribInfoInUpdates (use_attribinfo_in_updates);
-	sbe_request_->putItemName (item_name.c_str(), static_cast<int> (item_name.size()));
-	LOG(INFO) << "Distributing task \"" << item_name << "\" to worker pool.";
-	rc = zmq_msg_send (&zmq_msg_, worker_request_sock_.get(), 0);
-	if (-1 == rc) {
-		LOG(ERROR) << "zmq_send failed: " << zmq_strerror (zmq_errno());
-		rc = zmq_msg_close (&zmq_msg_);
-		LOG_IF(ERROR, rc) << "zmq_msg_close failed: " << zmq_strerror (zmq_errno());
-		return false;
-	}
-	return true;
-}
-
-bool
-hitsuji::hitsuji_t::OnRequest (
-	uintptr_t handle,
-	uint16_t rwf_version, 
-	int32_t token,
-	uint16_t service_id,
-	const std::string& item_name,
-	bool use_attribinfo_in_updates,
-	const std::vector<int_fast16_t>& view_by_fid
-	)
-{
-	DVLOG(3) << "Request: { "
-		  "\"handle\": " << handle << ""
-		", \"rwf_version\": " << rwf_version << ""
-		", \"token\": " << token << ""
-		", \"service_id\": " << service_id << ""
-		", \"item_name\": \"" << item_name << "\""
-		", \"use_attribinfo_in_updates\": " << (use_attribinfo_in_updates ? "true" : "false") << ""
-		", \"view_by_fid\": []"
-		" }";
-/* distribute to worker */
-	static const int version = 0;
-	int rc = zmq_msg_init_size (&zmq_msg_, MessageHeader::size() + Request::sbeBlockLength() + Request::itemNameHeaderSize() + item_name.size());
-	if (rc) {
-		LOG(ERROR) << "zmq_msg_init_size failed: " << zmq_strerror (zmq_errno());
-		return false;
-	}
-	sbe_hdr_->wrap (reinterpret_cast<char*> (zmq_msg_data (&zmq_msg_)), 0, version, static_cast<int> (zmq_msg_size (&zmq_msg_)))
-		.blockLength (Request::sbeBlockLength())
-		.templateId (Request::sbeTemplateId())
-		.schemaId (Request::sbeSchemaId())
-		.version (Request::sbeSchemaVersion());
-	sbe_request_->wrapForEncode (reinterpret_cast<char*> (zmq_msg_data (&zmq_msg_)), sbe_hdr_->size(), static_cast<int> (zmq_msg_size (&zmq_msg_)))
-		.handle (handle)
-		.rwfVersion (rwf_version)
-		.token (token)
-		.serviceId (service_id);
-	sbe_request_->flags().clear()
-		.abort (false)
-		.useAttribInfoInUpdates (use_attribinfo_in_updates);
-	Request::View &view = sbe_request_->viewCount (static_cast<int> (view_by_fid.size()));
-	for (auto it = view_by_fid.begin(); it != view_by_fid.end(); ++it) {
-		view.next().fid (*it);
-	}
-	sbe_request_->putItemName (item_name.c_str(), static_cast<int> (item_name.size()));
-	LOG(INFO) << "Distributing task \"" << item_name << "\" to worker pool.";
-	rc = zmq_msg_send (&zmq_msg_, worker_request_sock_.get(), 0);
-	if (-1 == rc) {
-		LOG(ERROR) << "zmq_send failed: " << zmq_strerror (zmq_errno());
-		rc = zmq_msg_close (&zmq_msg_);
-		LOG_IF(ERROR, rc) << "zmq_msg_close failed: " << zmq_strerror (zmq_errno());
-		return false;
-	}
-	return true;
-}
-
-bool
-hitsuji::hitsuji_t::OnReply (
-	const void* buffer,
-	size_t length
-	)
-{
-	static const int version = 0;
-	sbe_hdr_->wrap (reinterpret_cast<char*> (const_cast<void*> (buffer)), 0, version, static_cast<int> (length));
-	sbe_reply_->wrapForDecode (reinterpret_cast<char*> (const_cast<void*> (buffer)), sbe_hdr_->size(), sbe_hdr_->blockLength(), sbe_hdr_->version(), static_cast<int> (length));
-	const uintptr_t handle = sbe_reply_->handle();
-	const int32_t token = sbe_reply_->token();
-	DVLOG(3) << "Reply: { "
-		  "\"handle\": " << handle << ""
-		", \"token\": " << token << ""
-		" }";
-	return provider_->SendReply (reinterpret_cast<RsslChannel*> (handle), token, sbe_reply_->rsslBuffer(), sbe_reply_->rsslBufferLength());
-}
-
-bool
-hitsuji::hitsuji_t::OnRead()
-{
-	int rc, zmq_events = 0;
-	size_t zmq_events_len = sizeof (zmq_events);
-	rc = zmq_getsockopt (worker_reply_sock_.get(), ZMQ_EVENTS, &zmq_events, &zmq_events_len);
-	if (-1 == rc) {
-		LOG(ERROR) << "zmq_getsockopt (ZMQ_EVENTS) failed: " << zmq_strerror (zmq_errno());
-		return false;
-	}
-	if (zmq_events & ZMQ_POLLIN) {
-		rc = zmq_msg_init (&zmq_msg_);
-		if (-1 == rc) {
-			LOG(ERROR) << "zmq_msg_init failed: " << zmq_strerror (zmq_errno());
-			return false;
-		}
-		rc = zmq_msg_recv (&zmq_msg_, worker_reply_sock_.get(), 0);
-		if (-1 == rc) {
-			LOG(ERROR) << "zmq_recv failed: " << zmq_strerror (zmq_errno());
-			zmq_msg_close (&zmq_msg_);
-			return false;
-		}
-		if (!OnReply (zmq_msg_data (&zmq_msg_), zmq_msg_size (&zmq_msg_))) {
-			return false;
-		}
-		rc = zmq_msg_close (&zmq_msg_);
-		if (-1 == rc) {
-			LOG(ERROR) << "zmq_msg_close failed: " << zmq_strerror (zmq_errno());
-			return false;
-		}
-/* re-read events due to edge triggering */
-		rc = zmq_getsockopt (worker_reply_sock_.get(), ZMQ_EVENTS, &zmq_events, &zmq_events_len);
-		if (-1 == rc) {
-			LOG(ERROR) << "zmq_getsockopt (ZMQ_EVENTS) failed: " << zmq_strerror (zmq_errno());
-			return false;
-		}
-		if (zmq_events & ZMQ_POLLIN) {
-			return true;
-		}
-	}
-	return false;
-}
-
 bool
 hitsuji::hitsuji_t::AbortWorkers()
 {
 	unsigned active_workers = 0;
 	for (auto it = workers_.begin(); it != workers_.end(); ++it) {
 		if ((bool)it->second && it->second->joinable()) {
-			if (AbortOneWorker()) {
+			if (!shards_.empty() && shards_.front()->AbortOneWorker()) {
 				++active_workers;
 			} else {
 				LOG(ERROR) << "Failed to abort worker \"" << it->second->get_id() << "\".";
@@ -460,33 +341,6 @@ hitsuji::hitsuji_t::AbortWorkers()
 	return true;
 }
 
-bool
-hitsuji::hitsuji_t::AbortOneWorker()
-{
-	static const int version = 0;
-	int rc = zmq_msg_init_size (&zmq_msg_, MessageHeader::size() + Request::sbeBlockLength());
-	if (rc) {
-		LOG(ERROR) << "zmq_msg_init_size failed: " << zmq_strerror (zmq_errno());
-		return false;		}
-	sbe_hdr_->wrap (reinterpret_cast<char*> (zmq_msg_data (&zmq_msg_)), 0, version, static_cast<int> (zmq_msg_size (&zmq_msg_)))
-		.blockLength (Request::sbeBlockLength())
-		.templateId (Request::sbeTemplateId())
-		.schemaId (Request::sbeSchemaId())
-		.version (Request::sbeSchemaVersion());
-	sbe_request_->wrapForEncode (reinterpret_cast<char*> (zmq_msg_data (&zmq_msg_)), sbe_hdr_->size(), static_cast<int> (zmq_msg_size (&zmq_msg_)));
-	sbe_request_->flags().clear()
-		.abort (true);
-	rc = zmq_msg_send (&zmq_msg_, worker_request_sock_.get(), 0);
-	if (-1 == rc) {
-		LOG(ERROR) << "zmq_send failed: " << zmq_strerror (zmq_errno());
-		rc = zmq_msg_close (&zmq_msg_);
-		LOG_IF(ERROR, rc) << "zmq_msg_close failed: " << zmq_strerror (zmq_errno());
-		return false;
-	} else {
-		return true;
-	}
-}
-
 bool
 hitsuji::hitsuji_t::Start()
 {
@@ -513,8 +367,8 @@ hitsuji::hitsuji_t::Stop()
 		  "\"instance\": " << instance_ <<
 		" }";
 	shutting_down_ = true;
-	if ((bool)provider_) {
-		provider_->Quit();
+	if (!shards_.empty()) {
+		shards_.front()->provider()->Quit();
 /* Wait for mainloop to quit */
 		boost::unique_lock<boost::mutex> lock (mainloop_lock_);
 		while (!mainloop_shutdown_)
@@ -541,26 +395,61 @@ hitsuji::hitsuji_t::Reset()
 		}
 	}
 	chromium::debug::LeakTracker<worker_t>::CheckForLeaks();
+/* Summarise DACS lock cache effectiveness */
+	if ((bool)permdata_) {
+		permdata_->Report();
+		permdata_.reset();
+	}
+	if ((bool)symbol_table_) {
+		symbol_table_->Reset();
+		symbol_table_.reset();
+	}
 /* Release ZMQ sockets before context */
-	CHECK (worker_request_sock_.use_count() <= 1);
-	worker_request_sock_.reset();
-	CHECK (worker_reply_sock_.use_count() <= 1);
-	worker_reply_sock_.reset();
+	for (auto it = shards_.begin(); it != shards_.end(); ++it)
+		(*it)->Reset();
 	CHECK (zmq_context_.use_count() <= 1);
 	zmq_context_.reset();
+/* Undelivered replies are released with the context, undelivered requests are not. */
+	slab_pool_.reset();
+	request_pool_.reset();
+	chromium::debug::LeakTracker<slab_pool_t>::CheckForLeaks();
+/* Stop new connections before closing the event loops they are handed to. */
+	if ((bool)acceptor_) {
+		acceptor_->Close();
+		CHECK_LE (acceptor_.use_count(), 1);
+		acceptor_.reset();
+	}
+	chromium::debug::LeakTracker<acceptor_t>::CheckForLeaks();
 /* Close client sockets with reference counts on provider. */
-	if ((bool)provider_)
-		provider_->Close();
-/* Release everything with an UPA dependency. */
-	CHECK_LE (provider_.use_count(), 1);
-	provider_.reset();
+	for (auto it = shards_.begin(); it != shards_.end(); ++it)
+		(*it)->Close();
+	shards_.clear();
 /* Final tests before releasing UPA context */
 	chromium::debug::LeakTracker<client_t>::CheckForLeaks();
-	chromium::debug::LeakTracker<provider_t>::CheckForLeaks();
+	chromium::debug::LeakTracker<provider_t>::CheckForLeaks();
+	chromium::debug::LeakTracker<shard_t>::CheckForLeaks();
 /* No more UPA sockets so close up context */
 	CHECK_LE (upa_.use_count(), 1);
 	upa_.reset();
 	chromium::debug::LeakTracker<upa_t>::CheckForLeaks();
+/* Every exporting thread has been joined, the last instance clears the current table. */
+	stats_table_.reset();
+/* Rings were released by their workers and event loops, restore the previous filter. */
+	if (is_fault_handler_installed_) {
+		UninstallTraceFaultHandler();
+		is_fault_handler_installed_ = false;
+	}
+}
+
+/* Write every registered trace ring to the trace file, false when tracing is disabled or
+ * the file cannot be written.
+ */
+bool
+hitsuji::hitsuji_t::DumpTraces()
+{
+	if (0 == config_.trace_ring_size)
+		return false;
+	return DumpTraceRings (config_.trace_file);
 }
 
 void
@@ -571,12 +460,46 @@ hitsuji::hitsuji_t::MainLoop()
 		boost::unique_lock<boost::shared_mutex> (global_list_lock_);
 		global_list_.push_back (this);
 	}
+/* Acceptor and secondary shards run on their own threads. */
+	std::shared_ptr<acceptor_t> acceptor (acceptor_);
+	std::shared_ptr<boost::thread> acceptor_thread (std::make_shared<boost::thread> ([acceptor]() {
+		try {
+			acceptor->Run();
+		} catch (const std::exception& e) {
+			LOG(ERROR) << "Runtime exception: { "
+				"\"What\": \"" << e.what() << "\""
+				", \"acceptor\": true"
+				" }";
+		}
+	}));
+	std::vector<std::shared_ptr<boost::thread>> threads;
+	for (size_t i = 1; i < shards_.size(); ++i) {
+		auto provider = shards_[i]->provider();
+		threads.emplace_back (std::make_shared<boost::thread> ([provider]() {
+			try {
+				provider->Run();
+			} catch (const std::exception& e) {
+				LOG(ERROR) << "Runtime exception: { "
+					"\"What\": \"" << e.what() << "\""
+					", \"shard\": " << provider->shard() << ""
+					" }";
+			}
+		}));
+	}
 	try {
-		provider_->Run(); 
+		shards_.front()->provider()->Run(); 
 	} catch (const std::exception& e) {
 		LOG(ERROR) << "Runtime exception: { "
 			"\"What\": \"" << e.what() << "\" }";
 	}
+/* Shard zero stopped, stop and join the acceptor and every other shard. */
+	acceptor->Quit();
+	acceptor_thread->join();
+	acceptor.reset();
+	for (size_t i = 1; i < shards_.size(); ++i)
+		shards_[i]->provider()->Quit();
+	for (auto it = threads.begin(); it != threads.end(); ++it)
+		(*it)->join();
 	{
 /* Remove from list before clearing. */
 		boost::unique_lock<boost::shared_mutex> (global_list_lock_);
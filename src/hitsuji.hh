@@ -9,6 +9,7 @@
 #include <forward_list>
 #include <list>
 #include <memory>
+#include <vector>
 
 /* Boost Atomics */
 #include <boost/atomic.hpp>
@@ -24,26 +25,32 @@
 
 #include "googleurl/url_parse.h"
 #include "chromium/string_piece.hh"
-#include "client.hh"
-#include "provider.hh"
 #include "config.hh"
 
-/* Maximum encoded size of an RSSL provider to client message. */
-#define MAX_MSG_SIZE 4096
-
 namespace vta
 {
 	class bar_t;
 	class test_t;
 }
 
+namespace vhayu
+{
+	class permdata_t;
+	class symbol_table_t;
+}
+
+namespace chromium
+{
+	class StatsTable;
+}
+
 namespace hitsuji
 {
 	class upa_t;
+	class acceptor_t;
+	class slab_pool_t;
+	class shard_t;
 	class worker_t;
-	class MessageHeader;
-	class Request;
-	class Reply;
 
 	class hitsuji_t
 /* Permit global weak pointer to application instance for shutdown notification. */
@@ -54,8 +61,6 @@ namespace hitsuji
 /* Tcl API interface. */
 		, public vpf::Command
 #endif
-		, public client_t::Delegate	/* Rssl requests */
-		, public provider_t::Delegate	/* Worker replies */
 	{
 	public:
 		explicit hitsuji_t();
@@ -76,12 +81,10 @@ namespace hitsuji
 /* Quit an earlier call to Run(). */
 		void Quit();
 #endif
-		virtual bool OnRequest (uintptr_t handle, uint16_t rwf_version, int32_t token, uint16_t service_id, const std::string& item_name, bool use_attribinfo_in_updates) override;
-		virtual bool OnRequest (uintptr_t handle, uint16_t rwf_version, int32_t token, uint16_t service_id, const std::string& item_name, bool use_attribinfo_in_updates, const std::vector<int_fast16_t>& view_by_fid) override;
-		virtual bool OnRead() override;
-
 		bool Initialize();
 		void Reset();
+/* Dump per-thread trace rings to config_t::trace_file. */
+		bool DumpTraces();
 
 /* Global list of all instances.  SearchEngine.exe owns pointer. */
 		static std::list<hitsuji_t*> global_list_;
@@ -97,11 +100,8 @@ namespace hitsuji
 		void Stop();
 
 		bool AbortWorkers();
-		bool AbortOneWorker();
-
-		bool OnReply (const void* buffer, size_t length);
 
-/* Mainloop procesing thread. */
+/* Mainloop procesing thread, runs shard zero. */
 		std::unique_ptr<boost::thread> event_thread_;
 /* Worker threads*/		
 		std::forward_list<std::pair<std::shared_ptr<worker_t>, std::shared_ptr<boost::thread>>> workers_;
@@ -121,18 +121,29 @@ namespace hitsuji
 		config_t config_;
 /* UPA context. */
 		std::shared_ptr<upa_t> upa_;
-/* UPA provider */
-		std::shared_ptr<provider_t> provider_;
+/* RSSL server socket and connection handshakes, on its own thread. */
+		std::shared_ptr<acceptor_t> acceptor_;
+/* RSSL event loops, each owning the connections handed over by the acceptor. */
+		std::vector<std::shared_ptr<shard_t>> shards_;
+/* DACS lock cache shared by workers. */
+		std::shared_ptr<vhayu::permdata_t> permdata_;
+/* SearchEngine symbol handles shared by workers. */
+		std::shared_ptr<vhayu::symbol_table_t> symbol_table_;
+/* Reply encode buffers shared by workers and event loops. */
+		std::shared_ptr<slab_pool_t> slab_pool_;
+/* Request encode buffers shared by event loops and workers. */
+		std::shared_ptr<slab_pool_t> request_pool_;
 /* ZMQ context. */
 		std::shared_ptr<void> zmq_context_;
-		std::shared_ptr<void> worker_request_sock_;
-		std::shared_ptr<void> worker_reply_sock_;
-/* ZMQ message */
-		zmq_msg_t zmq_msg_;
-/* Sbe message buffer */
-		std::shared_ptr<MessageHeader> sbe_hdr_;
-		std::shared_ptr<Request> sbe_request_;
-		std::shared_ptr<Reply> sbe_reply_;
+/* Shared-memory counters for external monitoring, one per process. */
+		std::shared_ptr<chromium::StatsTable> stats_table_;
+/* Trace fault handler installed by this instance, uninstalled on reset. */
+		bool is_fault_handler_installed_;
+
+#ifdef HITSUJIMIB_H
+		friend Netsnmp_Next_Data_Point hitsujiWorkerTable_get_next_data_point;
+		friend Netsnmp_Node_Handler hitsujiWorkerTable_handler;
+#endif /* HITSUJIMIB_H */
 	};
 
 } /* namespace hitsuji */
@@ -0,0 +1,97 @@
+/* Item name decomposition, symbol[?query][#fragment], without copying or allocation.
+ *
+ * Results match the earlier round trip through googleurl of "null://localhost/" + item name,
+ * ParseStandardURL and ExtractFileName.
+ */
+
+#ifndef ITEM_NAME_HH_
+#define ITEM_NAME_HH_
+
+#include "chromium/string_piece.hh"
+
+namespace internal {
+
+/* Components reference the source item name. */
+struct parsed_item_name_t
+{
+	chromium::StringPiece symbol;
+	chromium::StringPiece query;
+	chromium::StringPiece fragment;
+};
+
+/* Returns false if the item name has no symbol.
+ */
+static inline
+bool
+parse_item_name (
+	const chromium::StringPiece& item_name,
+	parsed_item_name_t* parsed
+	)
+{
+/* Fragment: everything after the first '#' */
+	chromium::StringPiece path (item_name);
+	const size_t hash = path.find ('#');
+	if (chromium::StringPiece::npos != hash) {
+		parsed->fragment = path.substr (hash + 1);
+		path = path.substr (0, hash);
+	} else {
+		parsed->fragment.clear();
+	}
+/* Query: everything after the first '?' preceding the fragment */
+	const size_t question = path.find ('?');
+	if (chromium::StringPiece::npos != question) {
+		parsed->query = path.substr (question + 1);
+		path = path.substr (0, question);
+	} else {
+		parsed->query.clear();
+	}
+/* Symbol: last path segment, standard URLs treat backslash as a separator */
+	const size_t slash = path.find_last_of ("/\\");
+	if (chromium::StringPiece::npos != slash)
+		path = path.substr (slash + 1);
+/* Drop path parameters */
+	const size_t semicolon = path.find (';');
+	if (chromium::StringPiece::npos != semicolon)
+		path = path.substr (0, semicolon);
+	parsed->symbol = path;
+	return !parsed->symbol.empty();
+}
+
+/* For each key-value pair, i.e. a=x&b=y&c=z -> (a,x) (b,y) (c,z), advancing query.
+ *
+ * Returns false when the query is exhausted.
+ */
+static inline
+bool
+extract_query_key_value (
+	chromium::StringPiece* query,
+	chromium::StringPiece* key,
+	chromium::StringPiece* value
+	)
+{
+	if (query->empty())
+		return false;
+	chromium::StringPiece pair (*query);
+	const size_t ampersand = pair.find ('&');
+	if (chromium::StringPiece::npos != ampersand) {
+		pair = pair.substr (0, ampersand);
+		query->remove_prefix (ampersand + 1);
+	} else {
+		query->clear();
+	}
+	const size_t equals = pair.find ('=');
+	if (chromium::StringPiece::npos != equals) {
+		*key = pair.substr (0, equals);
+		*value = pair.substr (equals + 1);
+	} else {
+		*key = pair;
+		value->clear();
+	}
+	return true;
+}
+
+} /* namespace internal */
+
+#endif /* ITEM_NAME_HH_ */
+
+/* eof */
\ No newline at end of file
@@ -0,0 +1,160 @@
+/* Per stage request latency.
+ */
+
+#include "latency.hh"
+
+#include <climits>
+#include <cstring>
+#include <sstream>
+
+#include "chromium/logging.hh"
+
+/* Histogram range, one second and beyond is the overflow bucket. */
+static const int kMaxLatencyNs = 1000 * 1000 * 1000;
+static const size_t kLatencyBuckets = 100;
+
+static const char* kAnalyticNames[hitsuji::kAnalyticCount] = {
+	"None",
+	"Bar",
+	"RollupBar",
+	"Close",
+	"Test"
+};
+
+static const char* kStageNames[hitsuji::kLatencyStageCount] = {
+	"Total",
+	"Dispatch",
+	"Queue",
+	"Parse",
+	"Lookup",
+	"Calculate",
+	"Encode",
+	"Return",
+	"Write"
+};
+
+/* Upper bound of the bucket holding the given fraction of samples, in parts per thousand. */
+static
+uint32_t
+percentile (
+	const chromium::Histogram& histogram,
+	const chromium::Histogram::SampleSet& samples,
+	int64_t total,
+	unsigned permille
+	)
+{
+	const int64_t target = (total * permille + 999) / 1000;
+	int64_t seen = 0;
+	const size_t last = histogram.bucket_count() - 1;
+	for (size_t i = 0; i < last; ++i) {
+		seen += samples.counts (i);
+		if (seen >= target)
+			return static_cast<uint32_t> (histogram.ranges (i + 1) - 1);
+	}
+	return static_cast<uint32_t> (histogram.declared_max());
+}
+
+hitsuji::latency_t::latency_t()
+{
+	memset (histograms_, 0, sizeof (histograms_));
+	memset (percentiles_, 0, sizeof (percentiles_));
+}
+
+void
+hitsuji::latency_t::Initialize (
+	const std::string& prefix
+	)
+{
+	for (unsigned i = 0; i < kAnalyticCount; ++i) {
+		for (unsigned j = 0; j < kLatencyStageCount; ++j) {
+			std::ostringstream name;
+			name << prefix << '.' << kAnalyticNames[i] << '.' << kStageNames[j] << "Ns";
+			histograms_[i][j] = chromium::Histogram::FactoryGet (name.str(), 1, kMaxLatencyNs, kLatencyBuckets, chromium::Histogram::kNoFlags);
+			last_[i][j].Resize (*histograms_[i][j]);
+		}
+	}
+}
+
+void
+hitsuji::latency_t::Add (
+	const latency_stamps_t& latency
+	)
+{
+	DCHECK_LT (latency.analytic, static_cast<unsigned> (kAnalyticCount));
+	chromium::Histogram** histograms = histograms_[latency.analytic];
+	const uint64_t* stamps = latency.stamps;
+	for (unsigned i = 1; i < kLatencyStampCount; ++i) {
+		const uint64_t elapsed = (stamps[i] > stamps[i - 1]) ? stamps[i] - stamps[i - 1] : 0;
+		histograms[i]->Add ((elapsed < INT_MAX) ? static_cast<int> (elapsed) : INT_MAX);
+	}
+	const uint64_t total = (stamps[kWriteStamp] > stamps[kReadStamp]) ? stamps[kWriteStamp] - stamps[kReadStamp] : 0;
+	histograms[kTotalStage]->Add ((total < INT_MAX) ? static_cast<int> (total) : INT_MAX);
+}
+
+void
+hitsuji::latency_t::Snapshot (
+	unsigned shard
+	)
+{
+	chromium::Histogram::SampleSet current;
+	for (unsigned i = 0; i < kAnalyticCount; ++i) {
+		if (nullptr == histograms_[i][kTotalStage])
+			return;
+		for (unsigned j = 0; j < kLatencyStageCount; ++j) {
+			const chromium::Histogram& histogram = *histograms_[i][j];
+			histogram.SnapshotSample (&current);
+/* Interval samples, the cumulative snapshot is retained for the next interval. */
+			chromium::Histogram::SampleSet interval (current);
+			interval.Subtract (last_[i][j]);
+			last_[i][j] = current;
+			const int64_t total = interval.TotalCount();
+			percentiles_t& p = percentiles_[i][j];
+			p.count = static_cast<uint32_t> (total);
+			if (0 == total) {
+				p.p50 = p.p90 = p.p99 = p.p999 = 0;
+				continue;
+			}
+			p.p50 = percentile (histogram, interval, total, 500);
+			p.p90 = percentile (histogram, interval, total, 900);
+			p.p99 = percentile (histogram, interval, total, 990);
+			p.p999 = percentile (histogram, interval, total, 999);
+		}
+		if (0 == percentiles_[i][kTotalStage].count)
+			continue;
+		std::ostringstream stages;
+		for (unsigned j = 0; j < kLatencyStageCount; ++j) {
+			const percentiles_t& p = percentiles_[i][j];
+			stages << ((0 == j) ? "" : ", ") << '"' << kStageNames[j] << "\": { "
+				  "\"p50\": " << p.p50 << ""
+				", \"p90\": " << p.p90 << ""
+				", \"p99\": " << p.p99 << ""
+				", \"p999\": " << p.p999 << ""
+				" }";
+		}
+		LOG(INFO) << "Latency: { "
+			  "\"shard\": " << shard << ""
+			", \"analytic\": \"" << kAnalyticNames[i] << "\""
+			", \"replies\": " << percentiles_[i][kTotalStage].count << ""
+			", \"unit\": \"ns\""
+			", " << stages.str() << ""
+			" }";
+	}
+}
+
+const char*
+hitsuji::latency_t::analytic_name (
+	unsigned analytic
+	)
+{
+	return (analytic < kAnalyticCount) ? kAnalyticNames[analytic] : "";
+}
+
+const char*
+hitsuji::latency_t::stage_name (
+	unsigned stage
+	)
+{
+	return (stage < kLatencyStageCount) ? kStageNames[stage] : "";
+}
+
+/* eof */
\ No newline at end of file
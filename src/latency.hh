@@ -0,0 +1,116 @@
+/* Per stage request latency.
+ *
+ * Each request carries monotonic nanosecond timestamps from the event loop read, through
+ * the worker, back to the client write.  The event loop owning the client records the
+ * difference between consecutive timestamps in one histogram per analytic and stage, and
+ * periodically reduces each interval to percentiles for logging and SNMP.
+ *
+ * Not thread-safe, owned by one event loop.
+ */
+
+#ifndef LATENCY_HH_
+#define LATENCY_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+#include "chromium/metrics/histogram.hh"
+
+namespace hitsuji
+{
+/* Timestamps in request order, each stage ends at its timestamp. */
+	enum latency_stamp_e {
+		kReadStamp,		/* request read from the client socket */
+		kQueueStamp,		/* encoded and queued to the worker pool */
+		kDequeueStamp,		/* taken from the queue by a worker */
+		kParseStamp,		/* item name parsed */
+		kLookupStamp,		/* symbol and permission data resolved */
+		kCalculateStamp,	/* analytic calculated */
+		kEncodeStamp,		/* response encoded */
+		kReceiveStamp,		/* reply received by the event loop */
+		kWriteStamp,		/* reply written or queued to the client */
+		kLatencyStampCount
+	};
+
+/* Stage zero is read to write, the remainder end at the timestamp of the same index. */
+	enum {
+		kTotalStage = 0,
+		kLatencyStageCount = kLatencyStampCount
+	};
+
+/* Indexed by the SBE Analytic enumeration, none for requests closed before calculation. */
+	enum {
+		kAnalyticCount = 5
+	};
+
+/* Timestamps of one reply, unreached stages repeat the preceding timestamp. */
+	struct latency_stamps_t
+	{
+		unsigned analytic;
+		uint64_t stamps[kLatencyStampCount];
+	};
+
+/* Worker timestamps, kReadStamp to kEncodeStamp, appended to the encoded response in the
+ * reply slab so that the Reply header frame remains within the ZeroMQ inline message size.
+ * Unaligned, copy in and out.
+ */
+	enum {
+		kReplyTrailerSize = kReceiveStamp * sizeof (uint64_t)
+	};
+
+/* Nanoseconds of the monotonic clock, comparable between threads. */
+	static inline
+	uint64_t
+	monotonic_nanoseconds()
+	{
+		using namespace boost::chrono;
+		return duration_cast<nanoseconds> (steady_clock::now().time_since_epoch()).count();
+	}
+
+	class latency_t
+	{
+	public:
+/* Summary of one histogram over the last interval, nanoseconds. */
+		struct percentiles_t {
+			uint32_t count;
+			uint32_t p50;
+			uint32_t p90;
+			uint32_t p99;
+			uint32_t p999;
+		};
+
+		latency_t();
+
+/* Histograms are named with the event loop prefix, e.g. "Provider0.Bar.CalculateNs". */
+		void Initialize (const std::string& prefix);
+
+		void Add (const latency_stamps_t& latency);
+
+/* Reduce samples since the previous call to percentiles and log one JSON line per analytic
+ * with replies in the interval.
+ */
+		void Snapshot (unsigned shard);
+
+		const percentiles_t& percentiles (unsigned analytic, unsigned stage) const {
+			return percentiles_[analytic][stage];
+		}
+
+		static const char* analytic_name (unsigned analytic);
+		static const char* stage_name (unsigned stage);
+
+	private:
+		chromium::Histogram* histograms_[kAnalyticCount][kLatencyStageCount];
+/* Cumulative samples at the previous snapshot. */
+		chromium::Histogram::SampleSet last_[kAnalyticCount][kLatencyStageCount];
+		percentiles_t percentiles_[kAnalyticCount][kLatencyStageCount];
+	};
+
+} /* namespace hitsuji */
+
+#endif /* LATENCY_HH_ */
+
+/* eof */
\ No newline at end of file
@@ -0,0 +1,42 @@
+/* RIPC packed buffer arithmetic.
+ *
+ * Replies for one client are copied into one RSSL packed buffer.  rsslPackBuffer closes the
+ * pending reply behind a length prefix and returns the space remaining, the last reply is
+ * prefixed as the buffer is written.  Free of the RSSL headers so that it can be tested alone.
+ */
+
+#ifndef PACKED_BUFFER_HH_
+#define PACKED_BUFFER_HH_
+
+#include <cstddef>
+
+namespace hitsuji
+{
+	enum {
+/* RIPC packed message length prefix. */
+		kPackedHeaderSize = 2
+	};
+
+/* True if a reply of length bytes can follow the pending reply with available bytes left,
+ * reserving the prefix of both.
+ */
+	static inline
+	bool
+	can_pack (size_t pending_length, size_t length, size_t available)
+	{
+		return pending_length + length + (2 * kPackedHeaderSize) <= available;
+	}
+
+/* True if a reply can start an empty packed buffer of capacity bytes and still be followed. */
+	static inline
+	bool
+	fits_packed_buffer (size_t length, size_t capacity)
+	{
+		return can_pack (0, length, capacity);
+	}
+
+} /* namespace hitsuji */
+
+#endif /* PACKED_BUFFER_HH_ */
+
+/* eof */
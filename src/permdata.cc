@@ -17,8 +17,69 @@ static const int kFRPermission			= kFRFixedFields + 0;
 /* Field names */
 static const char* kPermissionField		= "Permission";
 
+vhayu::permdata_t::permdata_t (
+	const boost::chrono::seconds& ttl,
+	const boost::chrono::milliseconds& report_interval
+	)
+	: ttl_ (ttl)
+	, hits_ (0)
+	, misses_ (0)
+	, miss_latency_ (0)
+	, evictions_ (0)
+	, report_interval_ (report_interval)
+	, next_report_ ((boost::chrono::steady_clock::now() + report_interval).time_since_epoch().count())
+	, next_sweep_ ((boost::chrono::steady_clock::now() + ttl).time_since_epoch().count())
+{
+}
 
-/* Fetch permission data with FlexRecord Cursor API.
+/* Returns true and copies the lock when a fresh entry exists.
+ */
+template <typename Map, typename Key>
+bool
+vhayu::permdata_t::Lookup (
+	Map& map,
+	const Key& key,
+	const boost::chrono::steady_clock::time_point& now,
+	std::string* lock
+	)
+{
+	if (0 == ttl_.count())
+		return false;
+	{
+		boost::shared_lock<boost::shared_mutex> lock_guard (map_lock_);
+		auto it = map.find (key);
+		if (map.end() == it || now >= it->second.expiry)
+			return false;
+		lock->assign (it->second.lock);
+	}
+	hits_++;
+	MaybeReport (now);
+	MaybeSweep (now);
+	return true;
+}
+
+template <typename Map, typename Key>
+void
+vhayu::permdata_t::Store (
+	Map& map,
+	const Key& key,
+	const boost::chrono::steady_clock::time_point& now,
+	const std::string& lock
+	)
+{
+	if (0 == ttl_.count())
+		return;
+	{
+		boost::unique_lock<boost::shared_mutex> lock_guard (map_lock_);
+		auto& entry = map[key];
+		entry.lock.assign (lock);
+		entry.expiry = now + ttl_;
+	}
+	MaybeSweep (now);
+}
+
+/* Fetch permission data with FlexRecord Cursor API, served from the shared cache when a
+ * fresh entry exists.
  *
  * FlexRecReader::Open is an expensive call, ~250ms and allocates virtual memory pages.
  * FlexRecReader::Close is an expensive call, ~150ms.
@@ -33,9 +94,15 @@ vhayu::permdata_t::GetDacsLock (
 	)
 {
 #ifndef CONFIG_AS_APPLICATION
+	using namespace boost::chrono;
+	auto t0 = steady_clock::now();
+/* Copy of the name as key, negligible against opening a cursor. */
+	const std::string key (symbol_name.as_string());
+	if (Lookup (name_map_, key, t0, lock))
+		return true;
 /* Symbol names */
 	std::set<std::string> symbol_set;
-	symbol_set.insert (symbol_name.as_string());
+	symbol_set.insert (key);
 /* FlexRecord fields */
 	char permdata[32];
 	size_t length = sizeof (permdata);
@@ -66,8 +133,18 @@ vhayu::permdata_t::GetDacsLock (
 		LOG(ERROR) << "No recorded permission data for item \"" << symbol_name << "\".";
 		goto cleanup;
 	}
-	asciiLockToBinary (permdata, lock);
+	if (!asciiLockToBinary (permdata, lock)) {
+		LOG(WARNING) << "Malformed permission data for item \"" << symbol_name << "\".";
+		goto cleanup;
+	}
     	fr.Close();
+	{
+		auto t1 = steady_clock::now();
+		misses_++;
+		miss_latency_ += duration_cast<microseconds> (t1 - t0).count();
+		MaybeReport (t1);
+		Store (name_map_, key, t1, *lock);
+	}
 	return true;
 cleanup:
 	fr.Close();
@@ -77,7 +154,8 @@ cleanup:
 #endif /* CONFIG_AS_APPLICATION */
 }
 
-/* Fetch permission data with FlexRecord Primitives API.
+/* Fetch permission data with FlexRecord Primitives API, served from the shared cache when a
+ * fresh entry exists.
  *
  * Returns false on error, true on success.
  */
@@ -90,6 +168,10 @@ vhayu::permdata_t::GetDacsLock (
 	)
 {
 #ifndef CONFIG_AS_APPLICATION
+	using namespace boost::chrono;
+	auto t0 = steady_clock::now();
+	if (Lookup (map_, handle, t0, lock))
+		return true;
 /* Time period */
 	static const __time32_t from = 86400 * 2;  /* magic numbers */
 /*   Unable to deblob.  Data get error: -1000024
@@ -98,6 +180,7 @@ vhayu::permdata_t::GetDacsLock (
 	static const __time32_t till = INT32_MAX - 4;
 
 	DVLOG(4) << "from: " << from << " till: " << till;
+	std::string ascii_lock;
 	try {
 		U64 numRecs = FlexRecPrimitives::GetFlexRecords (
 							handle, 
@@ -107,14 +190,133 @@ vhayu::permdata_t::GetDacsLock (
 							view_element->view,
 							work_area->data,
 							OnFlexRecord,
-							lock /* closure */
+							&ascii_lock /* closure */
 								);
 	} catch (const std::exception& e) {
 		LOG(ERROR) << "FlexRecPrimitives::GetFlexRecords raised exception " << e.what();
 		return false;
 	}
+	auto t1 = steady_clock::now();
+	misses_++;
+	miss_latency_ += duration_cast<microseconds> (t1 - t0).count();
+	MaybeReport (t1);
+/* Recorded as hex text, RSSL permission data is binary.  Malformed records are not cached
+ * so that a corrected record is picked up on the next request.
+ */
+	if (!asciiLockToBinary (ascii_lock, lock)) {
+		LOG(WARNING) << "Malformed permission data: { "
+			  "\"length\": " << ascii_lock.size() << ""
+			" }";
+		return false;
+	}
+	Store (map_, handle, t1, *lock);
 #endif /* CONFIG_AS_APPLICATION */
 	return true;
+}
+
+void
+vhayu::permdata_t::Report() const
+{
+	LOG(INFO) << "PermData: { "
+		  "\"hits\": " << hits() << ""
+		", \"misses\": " << misses() << ""
+		", \"hitRatio\": " << hit_ratio() << ""
+		", \"evictions\": " << evictions() << ""
+		", \"savedLatencyMs\": " << boost::chrono::duration_cast<boost::chrono::milliseconds> (saved_latency()).count() << ""
+		" }";
+}
+
+/* Called by every worker, the first past the deadline advances it and reports. */
+void
+vhayu::permdata_t::MaybeReport (
+	const boost::chrono::steady_clock::time_point& now
+	)
+{
+	if (0 == report_interval_.count())
+		return;
+	int64_t next_report = next_report_.load (boost::memory_order_relaxed);
+	if (now.time_since_epoch().count() < next_report)
+		return;
+	const int64_t following = (now + report_interval_).time_since_epoch().count();
+	if (next_report_.compare_exchange_strong (next_report, following, boost::memory_order_relaxed))
+		Report();
+}
+
+/* Erase entries expired by now, returns count erased. */
+template <typename Map>
+static
+size_t
+EraseExpired (
+	Map* map,
+	const boost::chrono::steady_clock::time_point& now
+	)
+{
+	size_t count = 0;
+	for (auto it = map->begin(); it != map->end();) {
+		if (now >= it->second.expiry) {
+			it = map->erase (it);
+			++count;
+		} else {
+			++it;
+		}
+	}
+	return count;
+}
+
+/* Called by every worker, the first past the deadline advances it and sweeps.  Without a
+ * sweep expired entries would only be replaced on the next miss for the same symbol and the
+ * cache would grow with every symbol ever requested.
+ */
+void
+vhayu::permdata_t::MaybeSweep (
+	const boost::chrono::steady_clock::time_point& now
+	)
+{
+	if (0 == ttl_.count())
+		return;
+	int64_t next_sweep = next_sweep_.load (boost::memory_order_relaxed);
+	if (now.time_since_epoch().count() < next_sweep)
+		return;
+	const int64_t following = (now + ttl_).time_since_epoch().count();
+	if (!next_sweep_.compare_exchange_strong (next_sweep, following, boost::memory_order_relaxed))
+		return;
+	size_t evicted, remaining;
+	{
+		boost::unique_lock<boost::shared_mutex> lock_guard (map_lock_);
+		evicted = EraseExpired (&map_, now) + EraseExpired (&name_map_, now);
+		remaining = map_.size() + name_map_.size();
+	}
+	evictions_ += evicted;
+	DVLOG(3) << "PermData sweep: { "
+		  "\"evicted\": " << evicted << ""
+		", \"remaining\": " << remaining << ""
+		" }";
+}
+
+void
+vhayu::permdata_t::Invalidate (
+	const TBSymbolHandle& handle
+	)
+{
+	boost::unique_lock<boost::shared_mutex> lock_guard (map_lock_);
+	map_.erase (handle);
+}
+
+void
+vhayu::permdata_t::Invalidate (
+	const chromium::StringPiece& symbol_name
+	)
+{
+	boost::unique_lock<boost::shared_mutex> lock_guard (map_lock_);
+	name_map_.erase (symbol_name.as_string());
+}
+
+void
+vhayu::permdata_t::Clear()
+{
+	boost::unique_lock<boost::shared_mutex> lock_guard (map_lock_);
+	map_.clear();
+	name_map_.clear();
 }
 
 /* Returns <1> to continue processing, <2> to halt processing due to an error.
@@ -158,21 +360,25 @@ HexChar (char c, uint8_t* value)
 	return false;
 }
 
-void
+bool
 vhayu::permdata_t::asciiLockToBinary (
 	const chromium::StringPiece& ascii_lock,
 	std::string* dacs_lock
 	)
 {
+	if (0 != (ascii_lock.size() % 2))
+		return false;
 	dacs_lock->resize (ascii_lock.size() / 2);
 
 	for (size_t i = 0; i < dacs_lock->size(); i++) {
-		uint8_t v = 0;
-		CHECK(HexChar(ascii_lock[i*2], &v));
-		(*dacs_lock)[i] = v << 4;
-		CHECK(HexChar(ascii_lock[i*2 + 1], &v));
-		(*dacs_lock)[i] |= v;
+		uint8_t hi = 0, lo = 0;
+		if (!HexChar(ascii_lock[i*2], &hi) || !HexChar(ascii_lock[i*2 + 1], &lo)) {
+			dacs_lock->clear();
+			return false;
+		}
+		(*dacs_lock)[i] = (hi << 4) | lo;
 	}
+	return true;
 }
 
 
@@ -8,6 +8,12 @@
 #include <unordered_map>
 #include <string>
 
+/* Boost Atomics */
+#include <boost/atomic.hpp>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
 /* Boost threading. */
 #include <boost/thread.hpp>
 
@@ -22,20 +28,77 @@ namespace vhayu
 	class permdata_t
 	{
 	public:
-		permdata_t() {}
+/* Cached DACS locks expire after ttl, a zero ttl disables caching.  Expired locks are swept
+ * once per ttl so the cache only holds symbols requested within the last two periods.  Cache
+ * statistics are logged every report_interval, zero to log only at shutdown.
+ */
+		permdata_t (const boost::chrono::seconds& ttl, const boost::chrono::milliseconds& report_interval);
 
 		bool GetDacsLock (const chromium::StringPiece& item_name, std::string *lock);
 		bool GetDacsLock (const TBSymbolHandle& handle, FlexRecWorkAreaElement* work_area, FlexRecViewElement* view_element, std::string *lock);
 
+/* Drop cached lock for one symbol, e.g. after a permission change. */
+		void Invalidate (const TBSymbolHandle& handle);
+		void Invalidate (const chromium::StringPiece& symbol_name);
+/* Drop all cached locks. */
+		void Clear();
+
+/* Cache statistics. */
+		uint64_t hits() const { return hits_.load(); }
+		uint64_t misses() const { return misses_.load(); }
+		uint64_t evictions() const { return evictions_.load(); }
+		double hit_ratio() const {
+			const uint64_t lookups = hits() + misses();
+			return 0 == lookups ? 0.0 : static_cast<double> (hits()) / lookups;
+		}
+/* Estimated PermData FlexRecord scan time avoided by cache hits. */
+		boost::chrono::microseconds saved_latency() const {
+			const uint64_t misses = this->misses();
+			return boost::chrono::microseconds (0 == misses ? 0 : (hits() * miss_latency_.load()) / misses);
+		}
+/* Log cache statistics. */
+		void Report() const;
+
 /* FlexRecPrimitives callback */
 		static int OnFlexRecord(FRTreeCallbackInfo* info);
 
-		static void asciiLockToBinary (const chromium::StringPiece& ascii_lock, std::string* dacs_lock);
+/* Returns false when the recorded lock is not an even length of hex digits. */
+		static bool asciiLockToBinary (const chromium::StringPiece& ascii_lock, std::string* dacs_lock);
 
 	protected:
-// TBD: performance testing.
-//		std::unordered_map<std::string, std::string> map_;
-//		boost::shared_mutex map_lock_;
+		void MaybeReport (const boost::chrono::steady_clock::time_point& now);
+		void MaybeSweep (const boost::chrono::steady_clock::time_point& now);
+
+		struct dacs_lock_t
+		{
+			std::string lock;
+			boost::chrono::steady_clock::time_point expiry;
+		};
+
+		template <typename Map, typename Key>
+		bool Lookup (Map& map, const Key& key, const boost::chrono::steady_clock::time_point& now, std::string* lock);
+		template <typename Map, typename Key>
+		void Store (Map& map, const Key& key, const boost::chrono::steady_clock::time_point& now, const std::string& lock);
+
+/* Binary DACS locks shared by all workers, read-mostly, by handle for the Primitives API and
+ * by name for the cursor API.
+ */
+		std::unordered_map<TBSymbolHandle, dacs_lock_t> map_;
+		std::unordered_map<std::string, dacs_lock_t> name_map_;
+		boost::shared_mutex map_lock_;
+		const boost::chrono::seconds ttl_;
+
+/* Statistics: miss latency is cumulative microseconds spent scanning PermData. */
+		boost::atomic<uint64_t> hits_;
+		boost::atomic<uint64_t> misses_;
+		boost::atomic<uint64_t> miss_latency_;
+		boost::atomic<uint64_t> evictions_;
+
+/* Next periodic report, steady clock nanoseconds, claimed by one worker. */
+		const boost::chrono::milliseconds report_interval_;
+		boost::atomic<int64_t> next_report_;
+/* Next sweep of expired locks, steady clock nanoseconds, claimed by one worker. */
+		boost::atomic<int64_t> next_sweep_;
 	};
 
 } /* namespace vhayu */
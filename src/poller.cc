@@ -0,0 +1,362 @@
+/* Socket readiness notification.
+ */
+
+#include "poller.hh"
+
+#if !defined(_WIN32)
+#	include <sys/eventfd.h>
+#	include <unistd.h>
+#	include <cerrno>
+#	include <cstring>
+#endif
+
+#include "chromium/logging.hh"
+
+/* Ready events returned per wait. */
+static const size_t kMaxEvents = 256;
+
+hitsuji::poller_t::poller_t()
+	: wake_fd_ (INVALID_SOCKET)
+#if !defined(_WIN32)
+	, epoll_fd_ (-1)
+#endif
+{
+}
+
+hitsuji::poller_t::~poller_t()
+{
+	Close();
+}
+
+bool
+hitsuji::poller_t::Initialize()
+{
+	events_.reserve (kMaxEvents);
+#if !defined(_WIN32)
+	epoll_fd_ = epoll_create1 (EPOLL_CLOEXEC);
+	if (-1 == epoll_fd_) {
+		LOG(ERROR) << "epoll_create1: { "
+			  "\"errno\": " << errno << ""
+			", \"text\": \"" << strerror (errno) << "\""
+			" }";
+		return false;
+	}
+	epoll_events_.resize (kMaxEvents);
+#endif
+	return CreateWaker() && Add (wake_fd_, kRead, nullptr);
+}
+
+#if defined(_WIN32)
+/* No eventfd or pipe usable with WSAPoll: a non-blocking datagram socket connected to itself
+ * on the loopback interface.
+ */
+bool
+hitsuji::poller_t::CreateWaker()
+{
+	SOCKET s = socket (AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (INVALID_SOCKET == s) {
+		LOG(ERROR) << "socket: { "
+			  "\"wsaLastError\": " << WSAGetLastError() << ""
+			" }";
+		return false;
+	}
+	struct sockaddr_in addr;
+	int addr_len = sizeof (addr);
+	ZeroMemory (&addr, sizeof (addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	u_long non_blocking = 1;
+	if (SOCKET_ERROR == bind (s, reinterpret_cast<struct sockaddr*> (&addr), sizeof (addr)) ||
+	    SOCKET_ERROR == getsockname (s, reinterpret_cast<struct sockaddr*> (&addr), &addr_len) ||
+	    SOCKET_ERROR == connect (s, reinterpret_cast<struct sockaddr*> (&addr), addr_len) ||
+	    SOCKET_ERROR == ioctlsocket (s, FIONBIO, &non_blocking))
+	{
+		LOG(ERROR) << "Loopback waker socket: { "
+			  "\"wsaLastError\": " << WSAGetLastError() << ""
+			" }";
+		closesocket (s);
+		return false;
+	}
+	wake_fd_ = s;
+	return true;
+}
+
+void
+hitsuji::poller_t::Wake()
+{
+/* A full socket buffer already implies a pending wake. */
+	static const char c = 0;
+	send (wake_fd_, &c, sizeof (c), 0);
+}
+
+void
+hitsuji::poller_t::DrainWaker()
+{
+	char buf[64];
+	while (recv (wake_fd_, buf, sizeof (buf), 0) > 0);
+}
+#else
+bool
+hitsuji::poller_t::CreateWaker()
+{
+	wake_fd_ = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (-1 == wake_fd_) {
+		LOG(ERROR) << "eventfd: { "
+			  "\"errno\": " << errno << ""
+			", \"text\": \"" << strerror (errno) << "\""
+			" }";
+		return false;
+	}
+	return true;
+}
+
+void
+hitsuji::poller_t::Wake()
+{
+	const uint64_t one = 1;
+/* EAGAIN only on counter overflow, a wake is then already pending. */
+	const ssize_t rc = write (wake_fd_, &one, sizeof (one));
+	(void)rc;
+}
+
+void
+hitsuji::poller_t::DrainWaker()
+{
+	uint64_t count;
+	const ssize_t rc = read (wake_fd_, &count, sizeof (count));
+	(void)rc;
+}
+#endif
+
+void
+hitsuji::poller_t::Close()
+{
+	registrations_.clear();
+	events_.clear();
+#if defined(_WIN32)
+	pollfds_.clear();
+	if (INVALID_SOCKET != wake_fd_) {
+		closesocket (wake_fd_);
+		wake_fd_ = INVALID_SOCKET;
+	}
+#else
+	if (-1 != wake_fd_) {
+		close (wake_fd_);
+		wake_fd_ = -1;
+	}
+	if (-1 != epoll_fd_) {
+		close (epoll_fd_);
+		epoll_fd_ = -1;
+	}
+#endif
+}
+
+#if defined(_WIN32)
+static SHORT
+to_poll_events (unsigned interest)
+{
+	SHORT events = 0;
+	if (interest & hitsuji::poller_t::kRead)  events |= POLLRDNORM;
+	if (interest & hitsuji::poller_t::kWrite) events |= POLLWRNORM;
+	return events;
+}
+#else
+static uint32_t
+to_epoll_events (unsigned interest)
+{
+	uint32_t events = 0;
+	if (interest & hitsuji::poller_t::kRead)  events |= EPOLLIN;
+	if (interest & hitsuji::poller_t::kWrite) events |= EPOLLOUT;
+	return events;
+}
+#endif
+
+bool
+hitsuji::poller_t::Add (
+	SOCKET fd,
+	unsigned interest,
+	void* context
+	)
+{
+	DCHECK(INVALID_SOCKET != fd);
+	auto it = registrations_.find (fd);
+	if (registrations_.end() != it) {
+		it->second.context = context;
+		return Modify (fd, interest);
+	}
+	registration_t registration;
+	registration.interest = interest;
+	registration.context = context;
+#if defined(_WIN32)
+	WSAPOLLFD pollfd;
+	pollfd.fd = fd;
+	pollfd.events = to_poll_events (interest);
+	pollfd.revents = 0;
+	registration.index = pollfds_.size();
+	pollfds_.push_back (pollfd);
+#else
+	struct epoll_event ev;
+	ev.events = to_epoll_events (interest);
+	ev.data.fd = fd;
+	if (-1 == epoll_ctl (epoll_fd_, EPOLL_CTL_ADD, fd, &ev)) {
+		LOG(ERROR) << "epoll_ctl: { "
+			  "\"op\": \"EPOLL_CTL_ADD\""
+			", \"fd\": " << fd << ""
+			", \"errno\": " << errno << ""
+			", \"text\": \"" << strerror (errno) << "\""
+			" }";
+		return false;
+	}
+#endif
+	registrations_.emplace (fd, registration);
+	return true;
+}
+
+bool
+hitsuji::poller_t::Modify (
+	SOCKET fd,
+	unsigned interest
+	)
+{
+	auto it = registrations_.find (fd);
+	if (registrations_.end() == it)
+		return false;
+	if (it->second.interest == interest)
+		return true;
+	it->second.interest = interest;
+#if defined(_WIN32)
+	pollfds_[it->second.index].events = to_poll_events (interest);
+#else
+	struct epoll_event ev;
+	ev.events = to_epoll_events (interest);
+	ev.data.fd = fd;
+	if (-1 == epoll_ctl (epoll_fd_, EPOLL_CTL_MOD, fd, &ev)) {
+		LOG(ERROR) << "epoll_ctl: { "
+			  "\"op\": \"EPOLL_CTL_MOD\""
+			", \"fd\": " << fd << ""
+			", \"errno\": " << errno << ""
+			", \"text\": \"" << strerror (errno) << "\""
+			" }";
+		return false;
+	}
+#endif
+	return true;
+}
+
+bool
+hitsuji::poller_t::Replace (
+	SOCKET old_fd,
+	SOCKET new_fd
+	)
+{
+	if (old_fd == new_fd)
+		return true;
+	auto it = registrations_.find (old_fd);
+	if (registrations_.end() == it)
+		return false;
+	const registration_t registration = it->second;
+	Remove (old_fd);
+	return Add (new_fd, registration.interest, registration.context);
+}
+
+void
+hitsuji::poller_t::Remove (
+	SOCKET fd
+	)
+{
+	auto it = registrations_.find (fd);
+	if (registrations_.end() == it)
+		return;
+#if defined(_WIN32)
+	const size_t index = it->second.index;
+	if (index != pollfds_.size() - 1) {
+		pollfds_[index] = pollfds_.back();
+		registrations_[pollfds_[index].fd].index = index;
+	}
+	pollfds_.pop_back();
+#else
+/* Closed descriptors are removed implicitly, ignore failure. */
+	epoll_ctl (epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+#endif
+	registrations_.erase (it);
+/* Drop stale notifications from the current wait. */
+	for (auto jt = events_.begin(); jt != events_.end(); ++jt) {
+		if (jt->fd == fd)
+			jt->events = 0;
+	}
+}
+
+int
+hitsuji::poller_t::Wait (
+	int timeout_ms
+	)
+{
+	events_.clear();
+#if defined(_WIN32)
+	if (pollfds_.empty()) {
+		Sleep (timeout_ms);
+		return 0;
+	}
+	const int rc = WSAPoll (pollfds_.data(), static_cast<ULONG> (pollfds_.size()), timeout_ms);
+	if (SOCKET_ERROR == rc) {
+		LOG(ERROR) << "WSAPoll: { "
+			  "\"wsaLastError\": " << WSAGetLastError() << ""
+			" }";
+		return -1;
+	}
+	int remaining = rc;
+	for (auto it = pollfds_.begin(); remaining > 0 && it != pollfds_.end(); ++it) {
+		if (0 == it->revents)
+			continue;
+		--remaining;
+		if (wake_fd_ == it->fd) {
+			it->revents = 0;
+			DrainWaker();
+			continue;
+		}
+		event_t event;
+		event.fd = it->fd;
+		event.context = registrations_[it->fd].context;
+		event.events = 0;
+		if (it->revents & (POLLRDNORM | POLLHUP)) event.events |= kRead;
+		if (it->revents & POLLWRNORM)             event.events |= kWrite;
+		if (it->revents & (POLLERR | POLLNVAL))   event.events |= kError;
+		it->revents = 0;
+		events_.push_back (event);
+	}
+	return static_cast<int> (events_.size());
+#else
+	const int rc = epoll_wait (epoll_fd_, epoll_events_.data(), static_cast<int> (epoll_events_.size()), timeout_ms);
+	if (-1 == rc) {
+		if (EINTR == errno)
+			return 0;
+		LOG(ERROR) << "epoll_wait: { "
+			  "\"errno\": " << errno << ""
+			", \"text\": \"" << strerror (errno) << "\""
+			" }";
+		return -1;
+	}
+	for (int i = 0; i < rc; ++i) {
+		const struct epoll_event& ev = epoll_events_[i];
+		if (wake_fd_ == ev.data.fd) {
+			DrainWaker();
+			continue;
+		}
+		auto it = registrations_.find (ev.data.fd);
+		if (registrations_.end() == it)
+			continue;
+		event_t event;
+		event.fd = ev.data.fd;
+		event.context = it->second.context;
+		event.events = 0;
+		if (ev.events & (EPOLLIN | EPOLLHUP)) event.events |= kRead;
+		if (ev.events & EPOLLOUT)             event.events |= kWrite;
+		if (ev.events & EPOLLERR)             event.events |= kError;
+		events_.push_back (event);
+	}
+	return static_cast<int> (events_.size());
+#endif
+}
+
+/* eof */
\ No newline at end of file
@@ -0,0 +1,112 @@
+/* Socket readiness notification.
+ *
+ * Registrations persist across waits, each carries the caller context so a ready event maps
+ * directly to its connection without scanning every socket.  Backends are epoll on Linux and
+ * WSAPoll on Windows.  Another thread may interrupt a wait through Wake, an eventfd on Linux
+ * and a loopback datagram socket on Windows.
+ *
+ * Only the Windows backend ships.  WSAPoll still scans every registration in the kernel and
+ * here on each wait, so a wait stays O(sessions): it drops the fd_set rebuild and the
+ * FD_SETSIZE cap but is not O(ready) as epoll is.  An IOCP or AFD backend would be needed for
+ * that.  tests/poller_unittest.cc reports the cost of one wait against select().
+ */
+
+#ifndef POLLER_HH_
+#define POLLER_HH_
+
+#if defined(_WIN32)
+#	include <winsock2.h>
+#else
+#	include <sys/epoll.h>
+typedef int SOCKET;
+#	ifndef INVALID_SOCKET
+#		define INVALID_SOCKET (-1)
+#	endif
+#endif
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace hitsuji
+{
+	class poller_t
+	{
+	public:
+		enum {
+			kRead	= 0x1,
+			kWrite	= 0x2,
+/* Output only: hang-up or socket error. */
+			kError	= 0x4
+		};
+
+		struct event_t {
+			SOCKET fd;
+			void* context;
+			unsigned events;
+		};
+
+		poller_t();
+		~poller_t();
+
+		bool Initialize();
+		void Close();
+
+/* Register socket with interest set, re-registering replaces interest and context. */
+		bool Add (SOCKET fd, unsigned interest, void* context);
+/* Replace interest set of a registered socket. */
+		bool Modify (SOCKET fd, unsigned interest);
+/* Move a registration to a new socket, e.g. RSSL_RET_READ_FD_CHANGE. */
+		bool Replace (SOCKET old_fd, SOCKET new_fd);
+		void Remove (SOCKET fd);
+
+/* Returns interest set, zero if not registered. */
+		unsigned interest (SOCKET fd) const {
+			auto it = registrations_.find (fd);
+			return registrations_.end() == it ? 0 : it->second.interest;
+		}
+		size_t size() const {
+			return registrations_.size();
+		}
+
+/* Wait for readiness up to timeout milliseconds, returns number of ready events, zero
+ * on timeout, or -1 on error.
+ */
+		int Wait (int timeout_ms);
+		const std::vector<event_t>& events() const {
+			return events_;
+		}
+/* Interrupt the current or next Wait, the only method safe to call from another thread. */
+		void Wake();
+
+	private:
+		bool CreateWaker();
+		void DrainWaker();
+
+		struct registration_t {
+			unsigned interest;
+			void* context;
+#if defined(_WIN32)
+/* Index into pollfds_. */
+			size_t index;
+#endif
+		};
+
+		std::unordered_map<SOCKET, registration_t> registrations_;
+/* Readable whilst a wake is pending, never reported as an event. */
+		SOCKET wake_fd_;
+		std::vector<event_t> events_;
+#if defined(_WIN32)
+/* Dense array for WSAPoll, removal swaps with the last entry. */
+		std::vector<WSAPOLLFD> pollfds_;
+#else
+		int epoll_fd_;
+		std::vector<struct epoll_event> epoll_events_;
+#endif
+	};
+
+} /* namespace hitsuji */
+
+#endif /* POLLER_HH_ */
+
+/* eof */
\ No newline at end of file
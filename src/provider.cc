@@ -7,18 +7,60 @@
 #include <utility>
 
 #include <windows.h>
+#include <psapi.h>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
 
 #include "chromium/logging.hh"
+#include "chromium/metrics/histogram.hh"
 #include "upaostream.hh"
 #include "client.hh"
 
 /* Reuters Wire Format nomenclature for RDM dictionary names. */
 static const std::string kRdmFieldDictionaryName ("RWFFld");
 static const std::string kEnumTypeDictionaryName ("RWFEnum");
+
+/* Longest readiness wait, otherwise the next timer expiry.  Guards against a missed edge
+ * triggered ZeroMQ notification.
+ */
+static const int kMaxPollTimeoutMs = 1000;
+/* Interval to retry an exhausted RSSL buffer pool with no output pending. */
+static const unsigned kWriteRetryMs = 10;
+
+/* Worker service times retained for the 95th percentile per load calculation. */
+static const size_t kServiceTimeSamples = 256;
+
+/* Requests without a worker reply after this period are dropped from the load calculation. */
+static const uint64_t kInFlightExpiryMs = 60 * 1000;
+
+/* RDM LoadFactor range, lower is less loaded. */
+static const uint64_t kMaxLoadFactor = UINT16_MAX;
+
+/* Process private bytes, 0 on failure. */
+static
+size_t
+process_private_bytes()
+{
+	PROCESS_MEMORY_COUNTERS_EX pmc;
+	if (!GetProcessMemoryInfo (GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*> (&pmc), sizeof (pmc)))
+		return 0;
+	return pmc.PrivateUsage;
+}
+
+/* Event loop clock. */
+static inline
+uint64_t
+monotonic_milliseconds()
+{
+	using namespace boost::chrono;
+	return duration_cast<milliseconds> (steady_clock::now().time_since_epoch()).count();
+}
 
 hitsuji::provider_t::provider_t (
 	const hitsuji::config_t& config,
 	std::shared_ptr<hitsuji::upa_t> upa,
+	unsigned shard,
 	hitsuji::provider_t::Delegate* reply_delegate,
 	SOCKET reply_sock,
 	hitsuji::client_t::Delegate* request_delegate 
@@ -26,92 +68,137 @@ hitsuji::provider_t::provider_t (
 	creation_time_ (boost::posix_time::second_clock::universal_time()),
 	last_activity_ (creation_time_),
 	config_ (config),
+	shard_ (shard),
 	upa_ (upa),
 	reply_delegate_ (reply_delegate),
 	reply_sock_ (reply_sock),
 	request_delegate_ (request_delegate),
-	rssl_sock_ (nullptr),
+	ready_count_ (0),
+	pass_reads_ (0),
+	read_time_ (0),
+	pass_dispatches_ (0),
+	reads_per_pass_ (nullptr),
+	dispatches_per_pass_ (nullptr),
+	now_ (0),
+	client_count_ (0),
+	slow_consumer_policy_ (client_t::kBuffer),
+	is_reply_pending_ (false),
+	is_adopt_pending_ (false),
+	connection_count_ (0),
 	keep_running_ (true),
 	min_rwf_version_ (0),
 	service_id_ (1),	// first and only service
 	is_accepting_connections_ (true),
-	is_accepting_requests_ (true)
+	is_accepting_requests_ (true),
+	overload_since_ (0),
+	recovery_since_ (0),
+	encoded_cache_ (config.session_capacity),
+	reply_latency_ms_ (nullptr),
+	service_time_count_ (0),
+	service_time_p95_ (0),
+	next_load_time_ (0),
+	next_latency_time_ (0),
+	stats_slot_ (0),
+	next_stats_time_ (0),
+	trace_ (nullptr)
 {
-	ZeroMemory (cumulative_stats_, sizeof (cumulative_stats_));
 	ZeroMemory (snap_stats_, sizeof (snap_stats_));
+	ZeroMemory (released_client_stats_, sizeof (released_client_stats_));
+	service_times_.assign (kServiceTimeSamples, 0);
+	sorted_service_times_.reserve (kServiceTimeSamples);
+/* Request path scratch space, sized once so dispatch does not allocate. */
+	in_flight_.reserve (config_.open_limit);
+	view_by_fid_.reserve (UINT8_MAX);
+/* Idle until the first calculation. */
+	load_.open_limit = config_.open_limit;
+	load_.open_window = config_.open_window;
+	load_.load_factor = 0;
+	load_.band = 0;
 }
 
 hitsuji::provider_t::~provider_t()
 {
 	DLOG(INFO) << "~provider_t";
 	Close();
+/* Close pumps replies through the ring, release it afterwards. */
+	UnregisterTraceRing (trace_);
 /* Cleanup RSSL stack. */
 	upa_.reset();
 /* Summary output */
 	using namespace boost::posix_time;
 	auto uptime = second_clock::universal_time() - creation_time_;
 	VLOG(3) << "Provider summary: {"
-		 " \"Uptime\": \"" << to_simple_string (uptime) << "\""
-		", \"ConnectionsReceived\": " << cumulative_stats_[PROVIDER_PC_CONNECTION_RECEIVED] <<
+		 " \"Shard\": " << shard_ <<
+		", \"Uptime\": \"" << to_simple_string (uptime) << "\""
+		", \"ConnectionsAdopted\": " << cumulative_stats_[PROVIDER_PC_CONNECTION_ADOPTED] <<
 		", \"ClientSessions\": " << cumulative_stats_[PROVIDER_PC_CLIENT_SESSION_ACCEPTED] <<
 		", \"MsgsReceived\": " << cumulative_stats_[PROVIDER_PC_RSSL_MSGS_RECEIVED] <<
 		", \"MsgsMalformed\": " << cumulative_stats_[PROVIDER_PC_RSSL_MSGS_MALFORMED] <<
 		", \"MsgsSent\": " << cumulative_stats_[PROVIDER_PC_RSSL_MSGS_SENT] <<
 		", \"MsgsEnqueued\": " << cumulative_stats_[PROVIDER_PC_RSSL_MSGS_ENQUEUED] <<
+		", \"MsgsPacked\": " << cumulative_stats_[PROVIDER_PC_RSSL_PACKED_MSGS] <<
+		", \"WriteCalls\": " << cumulative_stats_[PROVIDER_PC_RSSL_WRITE_CALLS] <<
+		", \"Flushes\": " << cumulative_stats_[PROVIDER_PC_RSSL_FLUSH] <<
+		", \"BytesSent\": " << cumulative_stats_[PROVIDER_PC_BYTES_SENT] <<
+		", \"UncompressedBytesSent\": " << cumulative_stats_[PROVIDER_PC_UNCOMPRESSED_BYTES_SENT] <<
+		", \"StaleReplies\": " << cumulative_stats_[PROVIDER_PC_STALE_REPLY_DISCARDED] <<
+		", \"ExpiredRequests\": " << cumulative_stats_[PROVIDER_PC_REQUEST_EXPIRED] <<
+		", \"LoadUpdates\": " << cumulative_stats_[PROVIDER_PC_SERVICE_LOAD_UPDATED] <<
+		", \"Overloads\": " << cumulative_stats_[PROVIDER_PC_SERVICE_OVERLOADED] <<
 		" }";
+	if (VLOG_IS_ON(3) && nullptr != reads_per_pass_) {
+		std::string reads, dispatches, latency;
+		reads_per_pass_->WriteAscii (true, "\n", &reads);
+		dispatches_per_pass_->WriteAscii (true, "\n", &dispatches);
+		reply_latency_ms_->WriteAscii (true, "\n", &latency);
+		VLOG(3) << reads;
+		VLOG(3) << dispatches;
+		VLOG(3) << latency;
+	}
 }
 
-/* 7.2. Establish Network Communication.
- * Open RSSL port and listen for incoming connection attempts.
- */
 bool
 hitsuji::provider_t::Initialize()
 {
-#ifndef NDEBUG
-	RsslBindOptions addr = RSSL_INIT_BIND_OPTS;
-#else
-	RsslBindOptions addr;
-	rsslClearBindOpts (&addr);
-#endif
-	RsslError rssl_err;
-
 	last_activity_ = boost::posix_time::second_clock::universal_time();
 
 /* RSSL Version Info. */
 	if (!upa_->VerifyVersion())
 		return false;
 
-/* 9.4.1. Bind server socket. */
-	VLOG(3) << "Binding RSSL server socket.";
-	addr.serviceName             = const_cast<char*> (config_.rssl_port.c_str());	// port or service name
-	addr.protocolType	     = RSSL_RWF_PROTOCOL_TYPE;
-	addr.majorVersion	     = RSSL_RWF_MAJOR_VERSION;
-	addr.minorVersion	     = RSSL_RWF_MINOR_VERSION;
-
-	RsslServer* s = rsslBind (&addr, &rssl_err);
-/* Hard failure on bind as likely a configuration issue. */
-	if (nullptr == s) {
-		LOG(ERROR) << "rsslBind: { "
-			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
-			", \"sysError\": " << rssl_err.sysError << ""
-			", \"text\": \"" << rssl_err.text << "\""
-			", \"serviceName\": \"" << addr.serviceName << "\""
-			", \"protocolType\": \"" << internal::protocol_type_string (addr.protocolType) << "\""
-			", \"majorVersion\": " << static_cast<unsigned> (addr.majorVersion) << ""
-			", \"minorVersion\": " << static_cast<unsigned> (addr.minorVersion) << ""
-			" }";
+/* Readiness notification, persistent across event loop passes. */
+	if (!poller_.Initialize())
 		return false;
-	} else {
-		LOG(INFO) << "RSSL server socket created: { "
-			  "\"portNumber\": " << s->portNumber << ""
-			", \"protocolType\": \"" << internal::protocol_type_string (addr.protocolType) << "\""
-			", \"majorVersion\": " << static_cast<unsigned> (addr.majorVersion) << ""
-			", \"minorVersion\": " << static_cast<unsigned> (addr.minorVersion) << ""
-			", \"socketId\": " << s->socketId << ""
-			", \"state\": \"" << internal::channel_state_string (s->state) << "\""
-			" }";
-		rssl_sock_ = s;
-	}
+	pending_reads_.reserve (config_.session_capacity);
+	reads_.reserve (config_.session_capacity);
+/* Read activity of passes that read at all, and reply latency, per shard. */
+	std::ostringstream reads_name, dispatches_name, latency_name;
+	reads_name << "Provider" << shard_ << ".ReadsPerPass";
+	dispatches_name << "Provider" << shard_ << ".DispatchesPerPass";
+	latency_name << "Provider" << shard_ << ".ReplyLatencyMs";
+	reads_per_pass_ = chromium::Histogram::FactoryGet (reads_name.str(), 1, 10000, 50, chromium::Histogram::kNoFlags);
+	dispatches_per_pass_ = chromium::Histogram::FactoryGet (dispatches_name.str(), 1, 10000, 50, chromium::Histogram::kNoFlags);
+	reply_latency_ms_ = chromium::Histogram::FactoryGet (latency_name.str(), 1, 60000, 50, chromium::Histogram::kNoFlags);
+	std::ostringstream prefix;
+	prefix << "Provider" << shard_;
+	latency_.Initialize (prefix.str());
+	adopted_.reserve (config_.session_capacity);
+	adopting_.reserve (config_.session_capacity);
+/* Session slots, lowest index first. */
+	slots_.resize (config_.session_capacity);
+	free_slots_.reserve (config_.session_capacity);
+	for (size_t i = config_.session_capacity; i > 0; --i)
+		free_slots_.push_back (static_cast<uint32_t> (i - 1));
+	packed_sessions_.reserve (config_.session_capacity);
+	if (!client_t::ParseSlowConsumerPolicy (config_.slow_consumer_policy, &slow_consumer_policy_)) {
+		LOG(WARNING) << "Unknown slow consumer policy \"" << config_.slow_consumer_policy << "\", buffering replies.";
+		slow_consumer_policy_ = client_t::kBuffer;
+	}
+/* Ping and pong timer per client */
+	expired_timers_.reserve (2 * config_.session_capacity);
+	now_ = monotonic_milliseconds();
+	timers_.Initialize (now_);
+	next_latency_time_ = now_ + config_.latency_interval_ms;
 
 /* Pre-allocate memory buffer for payload iterator */
 	CHECK (config_.maximum_data_size > 0);
@@ -130,63 +217,51 @@ hitsuji::provider_t::Close()
 /* clients: five pass strategy */
 /* 1) Disable new requests via source directory update */
 	is_accepting_requests_ = false;
-	VLOG_IF(3, clients_.size() > 0) << "Updating source directory image, provider is not accepting new requests.";
-	for (auto it = clients_.begin(); it != clients_.end(); ++it) {
-		auto client = it->second;
-		client->OnSourceDirectoryUpdate();
-	}
+	VLOG_IF(3, client_count_ > 0) << "Updating source directory image, provider is not accepting new requests.";
+	SendDirectoryUpdates();
 
 /* 2) IFF tokens, pump messages until empty. */
-	if (nullptr != rssl_sock_ && !clients_.empty())
+	if (client_count_ > 0)
 	{
-		FD_ZERO (&in_rfds_); FD_SET (rssl_sock_->socketId, &in_rfds_);
-		FD_ZERO (&in_wfds_);
-		FD_ZERO (&in_efds_);
-		in_nfds_ = out_nfds_ = 0;
-		in_tv_.tv_sec = 0;
-		in_tv_.tv_usec = 1000 * 100;
 		if (INVALID_SOCKET != reply_sock_) {
-			FD_SET (reply_sock_, &in_rfds_);
+			poller_.Add (reply_sock_, poller_t::kRead, nullptr);
 		}
+		ready_count_ = 0;
 
 		for (;;) {
 			bool did_work = DoWork();
 
 			size_t active_tokens = 0;
-			for (auto it = clients_.begin(); it != clients_.end(); ++it) {
-				auto client = it->second;
-				active_tokens += client->tokens().size();
+			for (auto it = slots_.begin(); it != slots_.end(); ++it) {
+				if ((bool)it->client)
+					active_tokens += it->client->tokens().size();
 			}
 			if (0 == active_tokens) {
 				break;
 			} else {
-				VLOG(3) << "Waiting on " << active_tokens << " active tokens in " << clients_.size() << " active clients.";
+				VLOG(3) << "Waiting on " << active_tokens << " active tokens in " << client_count_ << " active clients.";
 			}
 
 			if (did_work)
 				continue;
 
-			out_rfds_ = in_rfds_;
-			out_wfds_ = in_wfds_;
-			out_efds_ = in_efds_;
-			out_tv_.tv_sec = in_tv_.tv_sec;
-			out_tv_.tv_usec = in_tv_.tv_usec;
-
-			out_nfds_ = select (in_nfds_ + 1, &out_rfds_, &out_wfds_, &out_efds_, &out_tv_);
+			ready_count_ = poller_.Wait (PollTimeout());
 		}
 	}
 
 /* 3) Send session close notification */
-	VLOG_IF(3, clients_.size() > 0) << "Closing " << clients_.size() << " client sessions.";
-	for (auto it = clients_.begin(); it != clients_.end(); ++it) {
-		auto client = it->second;
+	VLOG_IF(3, client_count_ > 0) << "Closing " << client_count_ << " client sessions.";
+	for (auto it = slots_.begin(); it != slots_.end(); ++it) {
+		auto client = it->client;
+		if (!(bool)client)
+			continue;
 		client->Close();
 /* 4) Flush message stream */
 		RsslChannel* c = client->handle();
 /* channel still open */
 		if ((RSSL_CH_STATE_ACTIVE == c->state) &&
 /* data pending */
-			FD_ISSET (c->socketId, &in_wfds_))
+			(poller_.interest (c->socketId) & poller_t::kWrite))
 		{
 			do {
 				DVLOG(1) << "rsslFlush";
@@ -196,7 +271,7 @@ hitsuji::provider_t::Close()
 					cumulative_stats_[PROVIDER_PC_RSSL_MSGS_SENT] += client->GetPendingCount();
 					client->ClearPendingCount();
 					cumulative_stats_[PROVIDER_PC_RSSL_FLUSH]++;
-					FD_CLR (c->socketId, &in_wfds_);
+					poller_.Modify (c->socketId, poller_t::kRead);
 					break;
 				}
 			} while (rc > 0);
@@ -211,26 +286,21 @@ hitsuji::provider_t::Close()
 		}
 	}
 /* 5) Cleanup */
-	clients_.clear();
-
-/* Closing listening socket. */
-	if (nullptr != rssl_sock_) {
-		RsslServerInfo server_info;
-		RsslError rssl_err;
-		VLOG(3) << "Closing RSSL server socket.";
-		VLOG_IF(3, RSSL_RET_SUCCESS == rsslGetServerInfo (rssl_sock_, &server_info, &rssl_err))
-			<< "RSSL server summary: {"
-			 " \"currentBufferUsage\": " << server_info.currentBufferUsage << ""
-			", \"peakBufferUsage\": " << server_info.peakBufferUsage << ""
-			" }";
-		if (RSSL_RET_SUCCESS != rsslCloseServer (rssl_sock_, &rssl_err)) {
-			LOG(ERROR) << "rsslCloseServer: { "
-				  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
-				", \"sysError\": " << rssl_err.sysError << ""
-				", \"text\": \"" << rssl_err.text << "\""
-				" }";
-		}
-		rssl_sock_ = nullptr;
+	for (auto it = slots_.begin(); it != slots_.end(); ++it) {
+		if ((bool)it->client)
+			ReleaseSlot (it->client->session_handle());
+	}
+	pending_reads_.clear();
+	packed_sessions_.clear();
+	aborted_.clear();
+	is_reply_pending_ = false;
+
+/* Connections handed over after the event loop stopped. */
+	{
+		boost::lock_guard<boost::mutex> lock (adopt_lock_);
+		connections_.insert (connections_.end(), adopted_.begin(), adopted_.end());
+		adopted_.clear();
+		is_adopt_pending_ = false;
 	}
 
 /* Close all RSSL client connections. */
@@ -238,7 +308,8 @@ hitsuji::provider_t::Close()
 	for (auto it = connections_.begin(); it != connections_.end(); ++it) {
 		Close (*it);
 	}
-	connections_.clear();
+	connections_.clear();
+	connection_count_ = 0;
 	VLOG(3) << "Provider closed.";
 }
 
@@ -354,20 +425,27 @@ hitsuji::provider_t::WriteRawClose (
 
 bool
 hitsuji::provider_t::SendReply (
-	RsslChannel*const handle,
+	uint64_t handle,
 	int32_t token,
 	const void* data,
-	size_t length
+	size_t length,
+	latency_stamps_t* latency
 	)
 {
-	boost::shared_lock<boost::shared_mutex> lock (clients_lock_);
-	auto client = clients_.find (handle);
-	lock.unlock();
+	OnReplyReceived (handle, token);
+	auto client = FindClient (handle);
 /* client may have disconnected before reply is available. */
-	if (clients_.end() != client)
-		return client->second->SendReply (token, data, length);
-	else
-		return false;
+	if (nullptr == client) {
+		cumulative_stats_[PROVIDER_PC_STALE_REPLY_DISCARDED]++;
+		return false;
+	}
+	const bool is_sent = client->SendReply (token, data, length);
+	latency->stamps[kWriteStamp] = monotonic_nanoseconds();
+	if (nullptr != trace_)
+		trace_->Complete (kTraceWrite, handle, token, latency->stamps[kReceiveStamp], latency->stamps[kWriteStamp], static_cast<uint32_t> (length));
+	if (is_sent)
+		latency_.Add (*latency);
+	return is_sent;
 }
 
 void
@@ -375,15 +453,20 @@ hitsuji::provider_t::Run()
 {
 	DCHECK(keep_running_) << "Quit must have been called outside of Run!";
 
-	FD_ZERO (&in_rfds_); FD_SET (rssl_sock_->socketId, &in_rfds_);
-	FD_ZERO (&in_wfds_);
-	FD_ZERO (&in_efds_);
-	in_nfds_ = out_nfds_ = 0;
-	in_tv_.tv_sec = 0;
-	in_tv_.tv_usec = 1000 * 100;
 /* Add external reply socket */
 	if (INVALID_SOCKET != reply_sock_) {
-		FD_SET (reply_sock_, &in_rfds_);
+		poller_.Add (reply_sock_, poller_t::kRead, nullptr);
+	}
+	ready_count_ = 0;
+
+/* Stats table column and trace ring for this event loop thread. */
+	if (0 == stats_slot_ && nullptr == trace_) {
+		std::ostringstream ss;
+		ss << "Provider" << shard_;
+		stats_slot_ = RegisterStatsThread (ss.str());
+		provider_rows_.Bind (stats_slot_, kProviderStatsNames);
+		client_rows_.Bind (stats_slot_, kClientStatsNames);
+		trace_ = RegisterTraceRing (ss.str(), config_.trace_ring_size);
 	}
 
 	for (;;) {
@@ -395,14 +478,7 @@ hitsuji::provider_t::Run()
 		if (did_work)
 			continue;
 
-/* Reset fd state */
-		out_rfds_ = in_rfds_;
-		out_wfds_ = in_wfds_;
-		out_efds_ = in_efds_;
-		out_tv_.tv_sec = in_tv_.tv_sec;
-		out_tv_.tv_usec = in_tv_.tv_usec;
-
-		out_nfds_ = select (in_nfds_ + 1, &out_rfds_, &out_wfds_, &out_efds_, &out_tv_);
+		ready_count_ = poller_.Wait (PollTimeout());
 	}
 
 	keep_running_ = true;
@@ -414,229 +490,291 @@ hitsuji::provider_t::DoWork()
 	bool did_work = false;
 
 	last_activity_ = boost::posix_time::second_clock::universal_time();
+	now_ = monotonic_milliseconds();
+	pass_reads_ = pass_dispatches_ = 0;
+
+/* Expired timers only, no scan of idle connections */
+	timers_.Advance (now_, &expired_timers_);
+	if (!expired_timers_.empty()) {
+		for (auto it = expired_timers_.begin(); it != expired_timers_.end(); ++it)
+			OnTimer (*it);
+		expired_timers_.clear();
+		did_work = true;
+	}
 
-/* Only check keepalives on timeout */
-	if (out_nfds_ <= 0)
-	{
-		for (auto it = connections_.begin(); it != connections_.end();) {
-			RsslChannel* c = *it;
-			if (nullptr != c->userSpecPtr && RSSL_CH_STATE_ACTIVE == c->state) {
-				auto client = reinterpret_cast<client_t*> (c->userSpecPtr);
-				if (last_activity_ >= client->NextPing()) {
-					Ping (c);
-				}
-				if (last_activity_ >= client->NextPong()) {
-					cumulative_stats_[PROVIDER_PC_RSSL_PONG_TIMEOUT]++;
-					LOG(ERROR) << "Pong timeout from peer, aborting connection.";
-					Abort (c);
-				}
-			}
-			if (FD_ISSET (c->socketId, &out_efds_)) {
-				cumulative_stats_[PROVIDER_PC_CONNECTION_EXCEPTION]++;
-				DVLOG(3) << "Socket exception.";
-/* Remove connection from list */
-				auto jt = it++;
-				connections_.erase (jt);
-/* Remove client from map */
-				{
-					boost::lock_guard<boost::shared_mutex> lock (clients_lock_);
-					auto kt = clients_.find (c);
-					if (clients_.end() != kt)
-						clients_.erase (kt);
-				}
-/* Remove RSSL socket from further event notification */
-				FD_CLR (c->socketId, &in_rfds_);
-				FD_CLR (c->socketId, &in_wfds_);
-				FD_CLR (c->socketId, &in_efds_);
-/* Ensure RSSL has closed out */
-				if (RSSL_CH_STATE_CLOSED != c->state)
-					Close (c);
-			} else {
-				++it;
-			}
-		}
-		return false;
+/* Connections handed over by the acceptor */
+	if (is_adopt_pending_) {
+		AdoptConnections();
+		did_work = true;
 	}
 
-/* External socket event */
-	if (INVALID_SOCKET != reply_sock_ &&
-	    FD_ISSET (reply_sock_, &out_rfds_))
-	{
-		if (!reply_delegate_->OnRead())
-			FD_CLR (reply_sock_, &out_rfds_);
+/* Input remaining from the previous pass */
+	if (!pending_reads_.empty()) {
+		reads_.swap (pending_reads_);
+		for (auto it = reads_.begin(); it != reads_.end(); ++it) {
+			RsslChannel* c = *it;
+			if (0 != poller_.interest (c->socketId))
+				OnCanReadWithoutBlocking (c);
+		}
+		reads_.clear();
 		did_work = true;
 	}
 
-/* New client connection */
-	if (FD_ISSET (rssl_sock_->socketId, &out_rfds_)) {
-		FD_CLR (rssl_sock_->socketId, &out_rfds_);
-		OnConnection (rssl_sock_);
+/* Worker replies remaining from the previous pass */
+	if (is_reply_pending_) {
+		is_reply_pending_ = reply_delegate_->OnRead();
+/* One write per client for the drained batch */
+		SubmitPacks();
 		did_work = true;
 	}
 
-/* Iterate over client set */
-	for (auto it = connections_.begin(); it != connections_.end();) {
-		RsslChannel* c = *it;
-/* incoming */
-		if (FD_ISSET (c->socketId, &out_rfds_)) {
-			FD_CLR (c->socketId, &out_rfds_);
-			OnCanReadWithoutBlocking (c);
-			did_work = true;
-		}
-/* outgoing */
-		if (FD_ISSET (c->socketId, &out_wfds_)) {
-			FD_CLR (c->socketId, &out_wfds_);
-			OnCanWriteWithoutBlocking (c);
-			did_work = true;
-		}
-/* Keepalive timeout on active session above connection */
-		if (nullptr != c->userSpecPtr && RSSL_CH_STATE_ACTIVE == c->state) {
-			auto client = reinterpret_cast<client_t*> (c->userSpecPtr);
-			if (last_activity_ >= client->NextPing()) {
-				Ping (c);
+/* Ready sockets only, no scan of idle connections */
+	if (ready_count_ > 0) {
+		const auto& events = poller_.events();
+		for (size_t i = 0; i < events.size(); ++i) {
+			const poller_t::event_t event = events[i];
+/* removed during this pass */
+			if (0 == event.events)
+				continue;
+/* External socket event */
+			if (INVALID_SOCKET != reply_sock_ && reply_sock_ == event.fd) {
+				is_reply_pending_ = reply_delegate_->OnRead();
+				SubmitPacks();
+				did_work = true;
+				continue;
 			}
-			if (last_activity_ >= client->NextPong()) {
-				cumulative_stats_[PROVIDER_PC_RSSL_PONG_TIMEOUT]++;
-				LOG(ERROR) << "Pong timeout from peer, aborting connection.";
+			RsslChannel* c = static_cast<RsslChannel*> (event.context);
+			DCHECK (nullptr != c);
+/* disconnects */
+			if (event.events & poller_t::kError) {
 				Abort (c);
+				continue;
 			}
-		}
-/* disconnects */
-		if (FD_ISSET (c->socketId, &out_efds_)) {
-			cumulative_stats_[PROVIDER_PC_CONNECTION_EXCEPTION]++;
-			DVLOG(3) << "Socket exception.";
-/* Remove connection from list */
-			auto jt = it++;
-			connections_.erase (jt);
-/* Remove client from map */
+/* incoming */
+			if (event.events & poller_t::kRead) {
+				OnCanReadWithoutBlocking (c);
+				did_work = true;
+			}
+/* outgoing */
+			if ((event.events & poller_t::kWrite) &&
+			    (poller_.interest (c->socketId) & poller_t::kWrite))
 			{
-				boost::lock_guard<boost::shared_mutex> lock (clients_lock_);
-				auto kt = clients_.find (c);
-				if (clients_.end() != kt)
-					clients_.erase (kt);
+				OnCanWriteWithoutBlocking (c);
+				did_work = true;
 			}
-/* Remove RSSL socket from further event notification */
-			FD_CLR (c->socketId, &in_rfds_);
-			FD_CLR (c->socketId, &in_wfds_);
-			FD_CLR (c->socketId, &in_efds_);
-/* Ensure RSSL has closed out */
-			if (RSSL_CH_STATE_CLOSED != c->state)
-				Close (c);
-		} else {
-			++it;
 		}
+		ready_count_ = 0;
+	}
+
+/* Advertised load, published when LoadFactor crosses a band */
+	if (now_ >= next_load_time_) {
+		UpdateServiceLoad();
+		UpdateServiceState();
+		next_load_time_ = now_ + config_.load_interval_ms;
+	}
+
+/* Per stage latency percentiles, logged and published for SNMP */
+	if (config_.latency_interval_ms > 0 && now_ >= next_latency_time_) {
+		latency_.Snapshot (shard_);
+		next_latency_time_ = now_ + config_.latency_interval_ms;
 	}
+
+/* Counters copied to the shared-memory stats table */
+	if (0 != stats_slot_ && now_ >= next_stats_time_) {
+		PublishStats();
+		next_stats_time_ = now_ + config_.stats_interval_ms;
+	}
+
+	if (pass_reads_ > 0) {
+		reads_per_pass_->Add (static_cast<int> (pass_reads_));
+		dispatches_per_pass_->Add (static_cast<int> (pass_dispatches_));
+	}
+/* Replies resumed by flushes and write retries */
+	if (!packed_sessions_.empty())
+		SubmitPacks();
+	RemoveAbortedConnections();
 	return did_work;
 }
 
+/* Exact wait until the next timer, bounded. */
+int
+hitsuji::provider_t::PollTimeout() const
+{
+	const int timeout = timers_.NextTimeout();
+	return (timeout < 0 || timeout > kMaxPollTimeoutMs) ? kMaxPollTimeoutMs : timeout;
+}
+
 void
-hitsuji::provider_t::Quit()
+hitsuji::provider_t::ScheduleKeepalives (
+	client_t* client
+	)
 {
-	keep_running_ = false;
+	client->ping_timer_.type = kPingTimer;
+	client->ping_timer_.context = client;
+	timers_.Schedule (&client->ping_timer_, client->NextPing());
+	client->pong_timer_.type = kPongTimer;
+	client->pong_timer_.context = client;
+	timers_.Schedule (&client->pong_timer_, client->NextPong());
 }
 
-/* 7.2. Establish Network Communication.
- * When an OMM consumer application attempts to connection begin the initialization process.
+/* Deadlines are pushed back by traffic without touching the wheel, an expired timer re-arms
+ * to the current deadline or acts on it.
  */
 void
-hitsuji::provider_t::OnConnection (
-	RsslServer* rssl_sock
+hitsuji::provider_t::OnTimer (
+	timer_wheel_t::entry_t* timer
 	)
 {
-	DCHECK (nullptr != rssl_sock);
-	cumulative_stats_[PROVIDER_PC_CONNECTION_RECEIVED]++;
-	if (!is_accepting_connections_ || connections_.size() == config_.session_capacity)
-		RejectConnection (rssl_sock);
-	else
-		AcceptConnection (rssl_sock);
+	auto client = static_cast<client_t*> (timer->context);
+	RsslChannel* c = client->handle();
+/* Closed channels are aborted on read. */
+	if (RSSL_CH_STATE_ACTIVE != c->state)
+		return;
+	switch (timer->type) {
+	case kPingTimer:
+		if (now_ >= client->NextPing())
+			Ping (c);
+/* Failed ping, retry after a full interval. */
+		if (now_ >= client->NextPing())
+			client->SetNextPing (now_ + 1000 * client->ping_interval_);
+		timers_.Schedule (timer, client->NextPing());
+		break;
+	case kPongTimer:
+		if (now_ >= client->NextPong()) {
+			cumulative_stats_[PROVIDER_PC_RSSL_PONG_TIMEOUT]++;
+			LOG(ERROR) << "Pong timeout from peer, aborting connection.";
+			Abort (c);
+		} else {
+			timers_.Schedule (timer, client->NextPong());
+		}
+		break;
+	case kWriteTimer:
+		if (client->is_write_blocked_ && !(poller_.interest (c->socketId) & poller_t::kWrite))
+			client->OnWritable();
+		break;
+	default:
+		NOTREACHED();
+		break;
+	}
 }
 
 void
-hitsuji::provider_t::RejectConnection (
-	RsslServer* rssl_sock
-	)
+hitsuji::provider_t::RemoveAbortedConnections()
 {
-#ifndef NDEBUG
-	RsslAcceptOptions addr = RSSL_INIT_ACCEPT_OPTS;
-#else
-	RsslAcceptOptions addr;
-	rsslClearAcceptOpts (&addr);
-#endif
-	RsslError rssl_err;
+	for (auto it = aborted_.begin(); it != aborted_.end(); ++it) {
+		RsslChannel* c = *it;
+		auto jt = std::find (connections_.begin(), connections_.end(), c);
+		if (connections_.end() == jt)
+			continue;
+		cumulative_stats_[PROVIDER_PC_CONNECTION_EXCEPTION]++;
+		DVLOG(3) << "Socket exception.";
+/* Remove connection from list */
+		connections_.erase (jt);
+		connection_count_.fetch_sub (1, boost::memory_order_relaxed);
+/* Release client slot, pending packs and worker replies then fail the generation check. */
+		if (nullptr != c->userSpecPtr) {
+			ReleaseSlot (reinterpret_cast<client_t*> (c->userSpecPtr)->session_handle());
+			c->userSpecPtr = nullptr;
+		}
+/* Remove RSSL socket from further event notification */
+		poller_.Remove (c->socketId);
+		pending_reads_.erase (std::remove (pending_reads_.begin(), pending_reads_.end(), c), pending_reads_.end());
+/* Ensure RSSL has closed out */
+		if (RSSL_CH_STATE_CLOSED != c->state)
+			Close (c);
+	}
+	aborted_.clear();
+}
 
-	DCHECK (nullptr != rssl_sock);
-	VLOG(2) << "Rejecting new connection request.";
+/* Plain stores into this thread's column, clients are summed with released sessions. */
+void
+hitsuji::provider_t::PublishStats()
+{
+	provider_rows_.Publish (cumulative_stats_);
+	uint64_t client_stats[CLIENT_PC_MAX];
+	CopyMemory (client_stats, released_client_stats_, sizeof (client_stats));
+	for (auto it = slots_.begin(); it != slots_.end(); ++it) {
+		if ((bool)it->client)
+			it->client->cumulative_stats().AddTo (client_stats);
+	}
+	client_rows_.Publish (client_stats);
+}
 
-	addr.nakMount = RSSL_TRUE;
-	RsslChannel* c = rsslAccept (rssl_sock, &addr, &rssl_err);
-	if (nullptr == c) {
-		LOG(ERROR) << "rsslAccept: { "
-			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
-			", \"sysError\": " << rssl_err.sysError << ""
-			", \"text\": \"" << rssl_err.text << "\""
-			", \"nakMount\": " << (addr.nakMount ? "true" : "false") << ""
-			" }";
+void
+hitsuji::provider_t::SubmitPacks()
+{
+	for (auto it = packed_sessions_.begin(); it != packed_sessions_.end(); ++it) {
+		auto client = FindClient (*it);
+/* client may have disconnected after the reply was packed. */
+		if (nullptr != client)
+			client->SubmitPack();
 	}
-	cumulative_stats_[PROVIDER_PC_CONNECTION_REJECTED]++;
+	packed_sessions_.clear();
 }
 
 void
-hitsuji::provider_t::AcceptConnection (
-	RsslServer* rssl_sock
+hitsuji::provider_t::ReleaseSlot (
+	uint64_t handle
 	)
 {
-#ifndef NDEBUG
-	RsslAcceptOptions addr = RSSL_INIT_ACCEPT_OPTS;
-#else
-	RsslAcceptOptions addr;
-	rsslClearAcceptOpts (&addr);
-#endif
-	RsslError rssl_err;
-
-	DCHECK (nullptr != rssl_sock);
-	VLOG(2) << "Accepting new connection request.";
+	const uint32_t index = static_cast<uint32_t> (handle);
+	DCHECK_LT (index, slots_.size());
+	slot_t& slot = slots_[index];
+	if (!(bool)slot.client || slot.generation != static_cast<uint32_t> (handle >> 32))
+		return;
+	++slot.generation;
+	slot.client->cumulative_stats().AddTo (released_client_stats_);
+	slot.client.reset();
+	free_slots_.push_back (index);
+	--client_count_;
+}
 
-	addr.nakMount = RSSL_FALSE;
-	RsslChannel* c = rsslAccept (rssl_sock, &addr, &rssl_err);
-	if (nullptr == c) {
-		LOG(ERROR) << "rsslAccept: { "
-			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
-			", \"sysError\": " << rssl_err.sysError << ""
-			", \"text\": \"" << rssl_err.text << "\""
-			", \"nakMount\": " << (addr.nakMount ? "true" : "false") << ""
-			" }";
-	} else {
-/* Add to directory of all client connections */
-		connections_.emplace_back (c);
-
-/* Wait for client session */
-		FD_SET (c->socketId, &in_rfds_);
-		FD_SET (c->socketId, &in_efds_);
-
-		cumulative_stats_[PROVIDER_PC_CONNECTION_ACCEPTED]++;
-
-		std::stringstream client_hostname, client_ip;
-		if (nullptr == c->clientHostname) 
-			client_hostname << "null";
-		else	
-			client_hostname << '"' << c->clientHostname << '"';
-		if (nullptr == c->clientIP)	
-			client_ip << "null";
-		else	
-			client_ip << '"' << c->clientIP << '"';
-
-		LOG(INFO) << "RSSL client socket created: { "
-			  "\"clientHostname\": " << client_hostname.str() << ""
-			", \"clientIP\": " << client_ip.str() << ""
-			", \"connectionType\": \"" << internal::connection_type_string (c->connectionType) << "\""
-			", \"majorVersion\": " << static_cast<unsigned> (c->majorVersion) << ""
-			", \"minorVersion\": " << static_cast<unsigned> (c->minorVersion) << ""
-			", \"pingTimeout\": " << c->pingTimeout << ""
-			", \"protocolType\": \"" << internal::protocol_type_string (c->protocolType) << "\""
-			", \"socketId\": " << c->socketId << ""
-			", \"state\": \"" << internal::channel_state_string (c->state) << "\""
-			" }";
-	}
+void
+hitsuji::provider_t::Quit()
+{
+	keep_running_ = false;
+	poller_.Wake();
+}
+
+/* Called on the acceptor thread, the connection is registered on the next pass of
+ * this event loop.
+ */
+void
+hitsuji::provider_t::Adopt (
+	RsslChannel* c
+	)
+{
+	DCHECK (nullptr != c);
+	connection_count_.fetch_add (1, boost::memory_order_relaxed);
+	{
+		boost::lock_guard<boost::mutex> lock (adopt_lock_);
+		adopted_.push_back (c);
+		is_adopt_pending_ = true;
+	}
+	poller_.Wake();
+}
+
+void
+hitsuji::provider_t::AdoptConnections()
+{
+	{
+		boost::lock_guard<boost::mutex> lock (adopt_lock_);
+		adopting_.swap (adopted_);
+		is_adopt_pending_ = false;
+	}
+	for (auto it = adopting_.begin(); it != adopting_.end(); ++it) {
+		RsslChannel* c = *it;
+/* Add to directory of all client connections */
+		connections_.emplace_back (c);
+		cumulative_stats_[PROVIDER_PC_CONNECTION_ADOPTED]++;
+/* Handshake completed on the acceptor thread. */
+		OnActiveClientSession (c);
+		poller_.Add (c->socketId, poller_t::kRead, c);
+/* Input may already be buffered by RSSL, e.g. the login request. */
+		pending_reads_.push_back (c);
+	}
+	VLOG(2) << "Adopted " << adopting_.size() << " connection(s) on shard " << shard_ << ".";
+	adopting_.clear();
 }
 
 void
@@ -655,8 +793,9 @@ hitsuji::provider_t::OnCanReadWithoutBlocking (
 		LOG(INFO) << "socket state is inactive.";
 		break;
 	case RSSL_CH_STATE_INITIALIZING:
-		LOG(INFO) << "socket state is initializing.";
-		OnInitializingState (c);
+/* Handshakes complete on the acceptor thread before hand over. */
+		LOG(ERROR) << "socket state is initializing.";
+		Abort (c);
 		break;
 	case RSSL_CH_STATE_ACTIVE:
 		OnActiveState (c);
@@ -669,11 +808,10 @@ hitsuji::provider_t::OnCanReadWithoutBlocking (
 }
 
 void
-hitsuji::provider_t::OnInitializingState (
+hitsuji::provider_t::OnCanWriteWithoutBlocking (
 	RsslChannel* c
 	)
 {
-	RsslInProgInfo state;
 	RsslError rssl_err;
 	RsslRet rc;
 
@@ -684,34 +822,41 @@ hitsuji::provider_t::OnInitializingState (
 	rssl_err.sysError = 0;
 	rssl_err.text[0] = '\0';
 
-	rc = rsslInitChannel (c, &state, &rssl_err);
-	switch (rc) {
-	case RSSL_RET_CHAN_INIT_IN_PROGRESS:
-		if ((state.flags & RSSL_IP_FD_CHANGE) == RSSL_IP_FD_CHANGE) {
-			cumulative_stats_[PROVIDER_PC_RSSL_PROTOCOL_DOWNGRADE]++;
-			LOG(INFO) << "RSSL protocol downgrade, reconnected.";
-			FD_CLR (state.oldSocket, &in_rfds_); FD_CLR (state.oldSocket, &in_efds_);
-			FD_SET (c->socketId, &in_rfds_); FD_SET (c->socketId, &in_efds_);
-		} else {
-			LOG(INFO) << "RSSL connection in progress.";
+	DVLOG(1) << "rsslFlush";
+	const uint64_t flush_time = (nullptr != trace_) ? monotonic_nanoseconds() : 0;
+	rc = rsslFlush (c, &rssl_err);
+	if (nullptr != trace_) {
+		const uint64_t handle = (nullptr != c->userSpecPtr) ? reinterpret_cast<client_t*> (c->userSpecPtr)->session_handle() : 0;
+		trace_->Complete (kTraceFlush, handle, 0, flush_time, monotonic_nanoseconds(), (rc > 0) ? static_cast<uint32_t> (rc) : 0);
+	}
+	if (RSSL_RET_SUCCESS == rc) {
+		cumulative_stats_[PROVIDER_PC_RSSL_FLUSH]++;
+		poller_.Modify (c->socketId, poller_t::kRead);
+/* Sent data equivalent to a ping. */
+		if (nullptr != c->userSpecPtr) {
+			auto client = reinterpret_cast<client_t*> (c->userSpecPtr);
+			cumulative_stats_[PROVIDER_PC_RSSL_MSGS_SENT] += client->GetPendingCount();
+			client->ClearPendingCount();
+			client->SetNextPing (now_ + 1000 * client->ping_interval_);
+/* Resume queued replies. */
+			client->OnWritable();
 		}
-		break;
-	case RSSL_RET_SUCCESS:
-		OnActiveClientSession (c);
-		FD_SET (c->socketId, &in_rfds_); FD_SET (c->socketId, &in_efds_);
-		break;
-	default:
-		LOG(ERROR) << "rsslInitChannel: { "
+	} else if (rc > 0) {
+		DVLOG(1) << static_cast<signed> (rc) << " bytes pending.";
+	} else {
+		LOG(ERROR) << "rsslFlush: { "
 			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
 			", \"sysError\": " << rssl_err.sysError << ""
 			", \"text\": \"" << rssl_err.text << "\""
 			" }";
-		break;
 	}
 }
 
+/* Exhausted buffer pool: wait on the socket only when output is pending to drain, otherwise
+ * kWrite would signal immediately on an idle socket, retry from the timer wheel instead.
+ */
 void
-hitsuji::provider_t::OnCanWriteWithoutBlocking (
+hitsuji::provider_t::WaitWritable (
 	RsslChannel* c
 	)
 {
@@ -725,27 +870,25 @@ hitsuji::provider_t::OnCanWriteWithoutBlocking (
 	rssl_err.sysError = 0;
 	rssl_err.text[0] = '\0';
 
-	DVLOG(1) << "rsslFlush";
 	rc = rsslFlush (c, &rssl_err);
-	if (RSSL_RET_SUCCESS == rc) {
-		cumulative_stats_[PROVIDER_PC_RSSL_FLUSH]++;
-		FD_CLR (c->socketId, &in_wfds_);
-/* Sent data equivalent to a ping. */
-		if (nullptr != c->userSpecPtr) {
-			auto client = reinterpret_cast<client_t*> (c->userSpecPtr);
-			cumulative_stats_[PROVIDER_PC_RSSL_MSGS_SENT] += client->GetPendingCount();
-			client->ClearPendingCount();
-			client->SetNextPing (last_activity_ + boost::posix_time::seconds (client->ping_interval_));
-		}
-	} else if (rc > 0) {
-		DVLOG(1) << static_cast<signed> (rc) << " bytes pending.";
-	} else {
+	if (rc > 0) {
+		poller_.Modify (c->socketId, poller_t::kRead | poller_t::kWrite);	/* pending output */
+		return;
+	}
+	if (rc < 0) {
 		LOG(ERROR) << "rsslFlush: { "
 			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
 			", \"sysError\": " << rssl_err.sysError << ""
 			", \"text\": \"" << rssl_err.text << "\""
 			" }";
 	}
+	poller_.Modify (c->socketId, poller_t::kRead);
+	if (nullptr != c->userSpecPtr) {
+		auto client = reinterpret_cast<client_t*> (c->userSpecPtr);
+		client->write_timer_.type = kWriteTimer;
+		client->write_timer_.context = client;
+		timers_.Schedule (&client->write_timer_, now_ + kWriteRetryMs);
+	}
 }
 
 void
@@ -754,9 +897,9 @@ hitsuji::provider_t::Abort (
 	)
 {
 	DCHECK (nullptr != c);
-	FD_CLR (c->socketId, &out_rfds_);
-	FD_CLR (c->socketId, &out_wfds_);
-	FD_SET (c->socketId, &out_efds_);
+/* Removed at the end of the current pass. */
+	if (aborted_.end() == std::find (aborted_.begin(), aborted_.end(), c))
+		aborted_.push_back (c);
 }
 
 void
@@ -768,6 +911,7 @@ hitsuji::provider_t::Close (
 
 	DCHECK (nullptr != c);
 
+	poller_.Remove (c->socketId);
 	LOG(INFO) << "Closing RSSL connection.";
 	if (RSSL_RET_SUCCESS != rsslCloseChannel (c, &rssl_err)) {
 		LOG(WARNING) << "rsslCloseChannel: { "
@@ -793,10 +937,7 @@ hitsuji::provider_t::OnActiveClientSession (
 	try {
 		auto handle = c;
 		const auto address = c->clientIP;
-		boost::shared_lock<boost::shared_mutex> lock (clients_lock_);
-		const auto connection_count = clients_.size();
-		lock.unlock();
-		if (!is_accepting_connections_ || connection_count == config_.session_capacity)
+		if (!is_accepting_connections_ || free_slots_.empty())
 			RejectClientSession (handle, address);
 		else if (!AcceptClientSession (handle, address))
 			RejectClientSession (handle, address);
@@ -824,100 +965,114 @@ hitsuji::provider_t::OnActiveState (
 
 	rsslClearReadInArgs (&in_args);
 
-	if (logging::DEBUG_MODE) {
-		rsslClearReadOutArgs (&out_args);
+/* Drain up to the read budget, remaining input waits behind other ready connections. */
+	unsigned msgs_read = 0;
+	size_t bytes_read = 0;
+	bool is_pending;
+	do {
+		if (logging::DEBUG_MODE) {
+			rsslClearReadOutArgs (&out_args);
 /* In place of absent API: rsslClearError (&rssl_err); */
-		rssl_err.rsslErrorId = 0;
-		rssl_err.sysError = 0;
-		rssl_err.text[0] = '\0';
-	}
-	buf = rsslReadEx (c, &in_args, &out_args, &rc, &rssl_err);
-	if (logging::DEBUG_MODE) {
-		std::stringstream return_code;
-		if (rc > 0) {
-			return_code << "\"pendingBytes\": " << static_cast<signed> (rc);
-		} else {
-			return_code << "\"returnCode\": \"" << static_cast<signed> (rc) << ""
-				     ", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\"";
+			rssl_err.rsslErrorId = 0;
+			rssl_err.sysError = 0;
+			rssl_err.text[0] = '\0';
+		}
+		buf = rsslReadEx (c, &in_args, &out_args, &rc, &rssl_err);
+		if (logging::DEBUG_MODE) {
+			std::stringstream return_code;
+			if (rc > 0) {
+				return_code << "\"pendingBytes\": " << static_cast<signed> (rc);
+			} else {
+				return_code << "\"returnCode\": \"" << static_cast<signed> (rc) << ""
+					     ", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\"";
+			}
+			VLOG(1) << "rsslReadEx: { "
+				  << return_code.str() << ""
+				", \"bytesRead\": " << out_args.bytesRead << ""
+				", \"uncompressedBytesRead\": " << out_args.uncompressedBytesRead << ""
+				", \"rsslErrorId\": " << rssl_err.rsslErrorId << ""
+				", \"sysError\": " << rssl_err.sysError << ""
+				", \"text\": \"" << rssl_err.text << "\""
+				" }";
 		}
-		VLOG(1) << "rsslReadEx: { "
-			  << return_code.str() << ""
-			", \"bytesRead\": " << out_args.bytesRead << ""
-			", \"uncompressedBytesRead\": " << out_args.uncompressedBytesRead << ""
-			", \"rsslErrorId\": " << rssl_err.rsslErrorId << ""
-			", \"sysError\": " << rssl_err.sysError << ""
-			", \"text\": \"" << rssl_err.text << "\""
-			" }";
-	}
 
-	cumulative_stats_[PROVIDER_PC_BYTES_RECEIVED] += out_args.bytesRead;
-	cumulative_stats_[PROVIDER_PC_UNCOMPRESSED_BYTES_RECEIVED] += out_args.uncompressedBytesRead;
+		cumulative_stats_[PROVIDER_PC_BYTES_RECEIVED] += out_args.bytesRead;
+		cumulative_stats_[PROVIDER_PC_UNCOMPRESSED_BYTES_RECEIVED] += out_args.uncompressedBytesRead;
+		bytes_read += out_args.bytesRead;
+		++pass_reads_;
+		is_pending = false;
 
-	switch (rc) {
+		switch (rc) {
 /* Reliable multicast events with hard-fail override. */
-	case RSSL_RET_CONGESTION_DETECTED:
-		cumulative_stats_[PROVIDER_PC_RSSL_CONGESTION_DETECTED]++;
-		goto check_closed_state;
-	case RSSL_RET_SLOW_READER:
-		cumulative_stats_[PROVIDER_PC_RSSL_SLOW_READER]++;
-		goto check_closed_state;
-	case RSSL_RET_PACKET_GAP_DETECTED:
-		cumulative_stats_[PROVIDER_PC_RSSL_PACKET_GAP_DETECTED]++;
-		goto check_closed_state;
+		case RSSL_RET_CONGESTION_DETECTED:
+			cumulative_stats_[PROVIDER_PC_RSSL_CONGESTION_DETECTED]++;
+			goto check_closed_state;
+		case RSSL_RET_SLOW_READER:
+			cumulative_stats_[PROVIDER_PC_RSSL_SLOW_READER]++;
+			goto check_closed_state;
+		case RSSL_RET_PACKET_GAP_DETECTED:
+			cumulative_stats_[PROVIDER_PC_RSSL_PACKET_GAP_DETECTED]++;
+			goto check_closed_state;
 check_closed_state:
-		if (RSSL_CH_STATE_CLOSED != c->state) {
-			LOG(WARNING) << "rsslReadEx: { "
+			if (RSSL_CH_STATE_CLOSED != c->state) {
+				LOG(WARNING) << "rsslReadEx: { "
+					  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
+					", \"sysError\": " << rssl_err.sysError << ""
+					", \"text\": \"" << rssl_err.text << "\""
+					" }";
+				break;
+			}
+		case RSSL_RET_READ_FD_CHANGE:
+			cumulative_stats_[PROVIDER_PC_RSSL_RECONNECT]++;
+			LOG(INFO) << "RSSL reconnected.";
+			poller_.Replace (c->oldSocketId, c->socketId);
+			break;
+		case RSSL_RET_READ_PING:
+			cumulative_stats_[PROVIDER_PC_RSSL_PONG_RECEIVED]++;
+			if (nullptr != c->userSpecPtr) {
+				auto client = reinterpret_cast<client_t*> (c->userSpecPtr);
+				client->SetNextPong (now_ + 1000 * c->pingTimeout);
+			}
+			DVLOG(1) << "RSSL pong.";
+			break;
+		case RSSL_RET_FAILURE:
+			cumulative_stats_[PROVIDER_PC_RSSL_READ_FAILURE]++;
+			LOG(ERROR) << "rsslReadEx: { "
 				  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
 				", \"sysError\": " << rssl_err.sysError << ""
 				", \"text\": \"" << rssl_err.text << "\""
 				" }";
 			break;
-		}
-	case RSSL_RET_READ_FD_CHANGE:
-		cumulative_stats_[PROVIDER_PC_RSSL_RECONNECT]++;
-		LOG(INFO) << "RSSL reconnected.";
-		FD_CLR (c->oldSocketId, &in_rfds_); FD_CLR (c->oldSocketId, &in_efds_);
-		FD_SET (c->socketId, &in_rfds_); FD_SET (c->socketId, &in_efds_);
-		break;
-	case RSSL_RET_READ_PING:
-		cumulative_stats_[PROVIDER_PC_RSSL_PONG_RECEIVED]++;
-		if (nullptr != c->userSpecPtr) {
-			auto client = reinterpret_cast<client_t*> (c->userSpecPtr);
-			client->SetNextPong (last_activity_ + boost::posix_time::seconds (c->pingTimeout));
-		}
-		DVLOG(1) << "RSSL pong.";
-		break;
-	case RSSL_RET_FAILURE:
-		cumulative_stats_[PROVIDER_PC_RSSL_READ_FAILURE]++;
-		LOG(ERROR) << "rsslReadEx: { "
-			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
-			", \"sysError\": " << rssl_err.sysError << ""
-			", \"text\": \"" << rssl_err.text << "\""
-			" }";
-		break;
 /* It is possible for rsslRead to succeed and return a NULL buffer. When this
  * occurs, it indicates that a portion of a fragmented buffer has been
  * received. The RSSL Reliable Transport is internally reassembling all parts
  * of the fragmented buffer and the entire buffer will be returned to the user
  * through rsslRead upon the arrival of the last fragment.
  */
-	case RSSL_RET_SUCCESS:
-	default: 
-		if (nullptr != buf) {
-			cumulative_stats_[PROVIDER_PC_RSSL_MSGS_RECEIVED]++;
-			OnMsg (c, buf);
+		case RSSL_RET_SUCCESS:
+		default: 
+			if (nullptr != buf) {
+				cumulative_stats_[PROVIDER_PC_RSSL_MSGS_RECEIVED]++;
+				++msgs_read;
+				++pass_dispatches_;
+				read_time_ = monotonic_nanoseconds();
+				OnMsg (c, buf);
 /* Received data equivalent to a heartbeat pong. */
-			if (nullptr != c->userSpecPtr) {
-				auto client = reinterpret_cast<client_t*> (c->userSpecPtr);
-				client->SetNextPong (last_activity_ + boost::posix_time::seconds (c->pingTimeout));
+				if (nullptr != c->userSpecPtr) {
+					auto client = reinterpret_cast<client_t*> (c->userSpecPtr);
+					client->SetNextPong (now_ + 1000 * c->pingTimeout);
+				}
 			}
-		}
-		if (rc > 0) {
 /* pending buffer needs flushing out before IO notification can resume */
-			FD_SET (c->socketId, &out_rfds_);
+			is_pending = (rc > 0);
+			break;
 		}
-		break;
-	}
+	} while (is_pending &&
+		 RSSL_CH_STATE_ACTIVE == c->state &&
+		 msgs_read < config_.read_budget_msgs &&
+		 bytes_read < config_.read_budget_bytes);
+	if (is_pending)
+		pending_reads_.push_back (c);
 }
 
 void
@@ -1022,7 +1177,10 @@ hitsuji::provider_t::AcceptClientSession (
 {
 	VLOG(2) << "Accepting new client session request: { \"Address\": \"" << address << "\" }";
 
-	auto client = std::make_shared<client_t> (shared_from_this(), request_delegate_, handle, address);
+	DCHECK (!free_slots_.empty());
+	const uint32_t index = free_slots_.back();
+	slot_t& slot = slots_[index];
+	auto client = std::make_shared<client_t> (shared_from_this(), request_delegate_, handle, session_handle (index, slot.generation), address);
 	if (!(bool)client || !client->Initialize()) {
 		cumulative_stats_[PROVIDER_PC_CLIENT_INIT_EXCEPTION]++;
 		LOG(ERROR) << "Client session initialisation failed, aborting connection.";
@@ -1051,12 +1209,195 @@ hitsuji::provider_t::AcceptClientSession (
 		min_rwf_version_.store (client_rwf_version);
 	}
 
-	boost::lock_guard<boost::shared_mutex> lock (clients_lock_);
-	clients_.emplace (std::make_pair (handle, client));
+	free_slots_.pop_back();
+	slot.client = client;
+	++client_count_;
+	ScheduleKeepalives (client.get());
 	cumulative_stats_[PROVIDER_PC_CLIENT_SESSION_ACCEPTED]++;
 	return true;
 }
 
+/* Slot index and token, the full session handle including slot generation is kept in the
+ * entry so that a reply for a released session cannot complete a request of its successor.
+ */
+static inline
+uint64_t
+in_flight_key (uint64_t handle, int32_t token)
+{
+	return (static_cast<uint64_t> (static_cast<uint32_t> (handle)) << 32) | static_cast<uint32_t> (token);
+}
+
+/* A successor session reusing the slot and token replaces a request whose reply never arrived. */
+void
+hitsuji::provider_t::OnRequestDispatched (
+	uint64_t handle,
+	int32_t token
+	)
+{
+	in_flight_t& entry = in_flight_[in_flight_key (handle, token)];
+	if (0 != entry.dispatched && entry.handle != handle)
+		cumulative_stats_[PROVIDER_PC_REQUEST_EXPIRED]++;
+	entry.handle = handle;
+	entry.dispatched = now_;
+}
+
+void
+hitsuji::provider_t::OnReplyReceived (
+	uint64_t handle,
+	int32_t token
+	)
+{
+	const uint64_t key = in_flight_key (handle, token);
+	const in_flight_t* entry = in_flight_.find (key);
+	if (nullptr == entry || entry->handle != handle)
+		return;
+	const uint32_t service_time = static_cast<uint32_t> (now_ - entry->dispatched);
+	service_times_[service_time_count_++ % service_times_.size()] = service_time;
+	reply_latency_ms_->Add (static_cast<int> (service_time));
+	in_flight_.erase (key);
+}
+
+/* LoadFactor is the greater of outstanding requests against open_limit and the 95th
+ * percentile service time against load_target_ms, scaled to 0-65535.  OpenLimit and
+ * OpenWindow advertise the remaining headroom.  Values are re-published when the LoadFactor
+ * band, OpenLimit or OpenWindow changes, at most once per load_interval_ms, so that small
+ * swings of LoadFactor within a band do not generate directory update traffic to ADS.
+ */
+void
+hitsuji::provider_t::UpdateServiceLoad()
+{
+/* Requests lost with a worker or a released session no longer count as outstanding. */
+	const uint64_t now = now_;
+	const size_t expired = in_flight_.erase_if ([now](uint64_t, const in_flight_t& entry) {
+		return now - entry.dispatched > kInFlightExpiryMs;
+	});
+	if (expired > 0) {
+		cumulative_stats_[PROVIDER_PC_REQUEST_EXPIRED] += static_cast<uint32_t> (expired);
+		LOG(WARNING) << "Expired " << expired << " requests without a worker reply.";
+	}
+	const uint64_t in_flight = in_flight_.size();
+/* Workers are shared by every shard, each shard is credited an even share of the pool.
+ * Requests beyond one per credited worker are waiting in the worker queue.
+ */
+	const size_t shard_count = (config_.shard_count > 0) ? config_.shard_count : 1;
+	const uint64_t workers = (config_.worker_count + shard_count - 1) / shard_count;
+	const uint64_t queue_depth = (in_flight > workers) ? in_flight - workers : 0;
+/* Without completions keep the last percentile whilst requests remain outstanding. */
+	const size_t samples = (service_time_count_ < service_times_.size()) ? service_time_count_ : service_times_.size();
+	if (samples > 0) {
+		sorted_service_times_.assign (service_times_.begin(), service_times_.begin() + samples);
+		auto nth = sorted_service_times_.begin() + (samples * 95) / 100;
+		std::nth_element (sorted_service_times_.begin(), nth, sorted_service_times_.end());
+		service_time_p95_ = *nth;
+		service_time_count_ = 0;
+	} else if (0 == in_flight) {
+		service_time_p95_ = 0;
+	}
+
+	uint64_t load_factor = (config_.open_limit > 0) ? (in_flight * kMaxLoadFactor) / config_.open_limit : 0;
+	if (config_.load_target_ms > 0) {
+		const uint64_t latency_factor = (static_cast<uint64_t> (service_time_p95_) * kMaxLoadFactor) / config_.load_target_ms;
+		if (latency_factor > load_factor)
+			load_factor = latency_factor;
+	}
+	if (load_factor > kMaxLoadFactor)
+		load_factor = kMaxLoadFactor;
+	const unsigned band = static_cast<unsigned> ((load_factor * config_.load_bands) / (kMaxLoadFactor + 1));
+	const uint64_t open_limit = (config_.open_limit > in_flight) ? config_.open_limit - in_flight : 0;
+	const uint64_t open_window = (config_.open_window > queue_depth) ? config_.open_window - queue_depth : 0;
+	if (band == load_.band && open_limit == load_.open_limit && open_window == load_.open_window)
+		return;
+
+	load_.open_limit = open_limit;
+	load_.open_window = open_window;
+	load_.load_factor = load_factor;
+	load_.band = band;
+	cumulative_stats_[PROVIDER_PC_SERVICE_LOAD_UPDATED]++;
+	VLOG(2) << "Service load: { "
+		  "\"shard\": " << shard_ << ""
+		", \"inFlight\": " << in_flight << ""
+		", \"queueDepth\": " << queue_depth << ""
+		", \"serviceTimeP95\": " << service_time_p95_ << ""
+		", \"openLimit\": " << load_.open_limit << ""
+		", \"openWindow\": " << load_.open_window << ""
+		", \"loadFactor\": " << load_.load_factor << ""
+		", \"band\": " << load_.band << ""
+		" }";
+
+	SendDirectoryUpdates();
+}
+
+/* Overloaded when either the 95th percentile service time or process private bytes
+ * reaches its limit for overload_sustain_ms, recovered when both are under
+ * overload_recovery_pct of their limits for the same period.  ADS then routes new
+ * requests to other instances whilst open streams are maintained.
+ */
+void
+hitsuji::provider_t::UpdateServiceState()
+{
+/* Withdrawn by Close. */
+	if (!is_accepting_connections_)
+		return;
+
+	const uint64_t wait_ms = service_time_p95_;
+	const uint64_t memory_mb = (config_.overload_memory_mb > 0) ? process_private_bytes() / (1024 * 1024) : 0;
+	const bool is_wait_over = config_.overload_wait_ms > 0 && wait_ms >= config_.overload_wait_ms;
+	const bool is_memory_over = config_.overload_memory_mb > 0 && memory_mb >= config_.overload_memory_mb;
+	const bool is_wait_under = 0 == config_.overload_wait_ms || (wait_ms * 100) < (static_cast<uint64_t> (config_.overload_wait_ms) * config_.overload_recovery_pct);
+	const bool is_memory_under = 0 == config_.overload_memory_mb || (memory_mb * 100) < (static_cast<uint64_t> (config_.overload_memory_mb) * config_.overload_recovery_pct);
+
+	if (is_accepting_requests_) {
+		if (!is_wait_over && !is_memory_over) {
+			overload_since_ = 0;
+			return;
+		}
+		if (0 == overload_since_)
+			overload_since_ = now_;
+		if (now_ - overload_since_ < config_.overload_sustain_ms)
+			return;
+		overload_since_ = 0;
+		is_accepting_requests_ = false;
+		cumulative_stats_[PROVIDER_PC_SERVICE_OVERLOADED]++;
+		LOG(WARNING) << "Service overloaded, not accepting new requests: { "
+			  "\"shard\": " << shard_ << ""
+			", \"serviceTimeP95\": " << wait_ms << ""
+			", \"overloadWaitMs\": " << config_.overload_wait_ms << ""
+			", \"privateMiB\": " << memory_mb << ""
+			", \"overloadMemoryMiB\": " << config_.overload_memory_mb << ""
+			", \"inFlight\": " << in_flight_.size() << ""
+			" }";
+	} else {
+		if (!is_wait_under || !is_memory_under) {
+			recovery_since_ = 0;
+			return;
+		}
+		if (0 == recovery_since_)
+			recovery_since_ = now_;
+		if (now_ - recovery_since_ < config_.overload_sustain_ms)
+			return;
+		recovery_since_ = 0;
+		is_accepting_requests_ = true;
+		cumulative_stats_[PROVIDER_PC_SERVICE_RECOVERED]++;
+		LOG(INFO) << "Service recovered, accepting new requests: { "
+			  "\"shard\": " << shard_ << ""
+			", \"serviceTimeP95\": " << wait_ms << ""
+			", \"privateMiB\": " << memory_mb << ""
+			", \"inFlight\": " << in_flight_.size() << ""
+			" }";
+	}
+	SendDirectoryUpdates();
+}
+
+void
+hitsuji::provider_t::SendDirectoryUpdates()
+{
+	encoded_cache_.Invalidate();
+	for (auto it = slots_.begin(); it != slots_.end(); ++it) {
+		if ((bool)it->client)
+			it->client->OnSourceDirectoryUpdate();
+	}
+}
+
 /* 7.3.5.5 Making Request for Service Directory
  * By default, information about all available services is returned. If an
  * application wishes to make a request for information pertaining to a 
@@ -1865,14 +2206,32 @@ hitsuji::provider_t::GetServiceLoad (
 		return false;
 	}
 
+/* OpenLimit<UInt>
+ * Maximum number of items the service will allow to be open, the remaining headroom
+ * of outstanding requests.
+ */
+	element.name       = RSSL_ENAME_OPEN_LIMIT;
+	element.dataType   = RSSL_DT_UINT;
+	rc = rsslEncodeElementEntry (it, &element, &load_.open_limit);
+	if (RSSL_RET_SUCCESS != rc) {
+		LOG(ERROR) << "rsslEncodeElementEntry failed: { "
+			  "\"returnCode\": " << static_cast<signed> (rc) << ""
+			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
+			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
+			", \"name\": \"RSSL_ENAME_OPEN_LIMIT\""
+			", \"dataType\": \"" << rsslDataTypeToString (element.dataType) << "\""
+			", \"openLimit\": " << load_.open_limit << ""
+			" }";
+		return false;
+	}
+
 /* OpenWindow<UInt>
  * Maximum number of outstanding requests (i.e. requests for items not yet open) that 
- * the service will allow at any given time.
+ * the service will allow at any given time, the remaining headroom of the worker queue.
  */
 	element.name       = RSSL_ENAME_OPEN_WINDOW;
 	element.dataType   = RSSL_DT_UINT;
-	static const uint64_t open_window = 1000;   /* ZMQ_SNDHWM */
-	rc = rsslEncodeElementEntry (it, &element, &open_window);
+	rc = rsslEncodeElementEntry (it, &element, &load_.open_window);
 	if (RSSL_RET_SUCCESS != rc) {
 		LOG(ERROR) << "rsslEncodeElementEntry failed: { "
 			  "\"returnCode\": " << static_cast<signed> (rc) << ""
@@ -1880,7 +2239,25 @@ hitsuji::provider_t::GetServiceLoad (
 			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
 			", \"name\": \"RSSL_ENAME_OPEN_WINDOW\""
 			", \"dataType\": \"" << rsslDataTypeToString (element.dataType) << "\""
-			", \"openWindow\": " << open_window << ""
+			", \"openWindow\": " << load_.open_window << ""
+			" }";
+		return false;
+	}
+
+/* LoadFactor<UInt>
+ * Number indicating the load on the service, lower numbers are less loaded.
+ */
+	element.name       = RSSL_ENAME_LOAD_FACT;
+	element.dataType   = RSSL_DT_UINT;
+	rc = rsslEncodeElementEntry (it, &element, &load_.load_factor);
+	if (RSSL_RET_SUCCESS != rc) {
+		LOG(ERROR) << "rsslEncodeElementEntry failed: { "
+			  "\"returnCode\": " << static_cast<signed> (rc) << ""
+			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
+			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
+			", \"name\": \"RSSL_ENAME_LOAD_FACT\""
+			", \"dataType\": \"" << rsslDataTypeToString (element.dataType) << "\""
+			", \"loadFactor\": " << load_.load_factor << ""
 			" }";
 		return false;
 	}
@@ -1914,7 +2291,7 @@ hitsuji::provider_t::Submit (
 	rsslClearWriteInArgs (&in_args);
 	in_args.rsslPriority = RSSL_LOW_PRIORITY;	/* flushing priority */
 /* direct write on clear socket, enqueue when writes are pending */
-	const bool should_write_direct = !FD_ISSET (c->socketId, &in_wfds_);
+	const bool should_write_direct = !(poller_.interest (c->socketId) & poller_t::kWrite);
 	in_args.writeInFlags = should_write_direct ? RSSL_WRITE_DIRECT_SOCKET_WRITE : 0;
 
 try_again:
@@ -1926,6 +2303,9 @@ try_again:
 		rssl_err.text[0] = '\0';
 	}
 	rc = rsslWriteEx (c, buf, &in_args, &out_args, &rssl_err);
+	cumulative_stats_[PROVIDER_PC_RSSL_WRITE_CALLS]++;
+	cumulative_stats_[PROVIDER_PC_BYTES_SENT] += out_args.bytesWritten;
+	cumulative_stats_[PROVIDER_PC_UNCOMPRESSED_BYTES_SENT] += out_args.uncompressedBytesWritten;
 	if (logging::DEBUG_MODE) {
 		std::stringstream return_code;
 		if (rc > 0) {
@@ -1954,20 +2334,30 @@ try_again:
 	switch (rc) {
 	case RSSL_RET_WRITE_CALL_AGAIN:			/* fragmenting the buffer and needs to be called again with the same buffer. */
 		goto try_again;
+	case RSSL_RET_BUFFER_NO_BUFFERS:		/* empty buffer pool: wait for output to drain or retry. */
+		cumulative_stats_[PROVIDER_PC_RSSL_WRITE_NO_BUFFERS]++;
+		if (nullptr != c->userSpecPtr) {
+			auto client = reinterpret_cast<client_t*> (c->userSpecPtr);
+			client->is_write_blocked_ = true;
+		}
+		WaitWritable (c);
+		return -1;
 	case RSSL_RET_WRITE_FLUSH_FAILED:		/* attempted to flush data to the connection but was blocked. */
 		cumulative_stats_[PROVIDER_PC_RSSL_WRITE_FLUSH_FAILED]++;
-		goto pending;
-	case RSSL_RET_BUFFER_NO_BUFFERS:		/* empty buffer pool: spin wait until buffer is available. */
-		cumulative_stats_[PROVIDER_PC_RSSL_WRITE_NO_BUFFERS]++;
+/* Consumer is behind, hold further replies in its outbound queue. */
+		if (nullptr != c->userSpecPtr) {
+			auto client = reinterpret_cast<client_t*> (c->userSpecPtr);
+			client->is_write_blocked_ = true;
+		}
 pending:
-		FD_SET (c->socketId, &in_wfds_);	/* pending output */
+		poller_.Modify (c->socketId, poller_t::kRead | poller_t::kWrite);	/* pending output */
 		return -1;
 	case RSSL_RET_SUCCESS:				/* sent, no flush required. */
 		cumulative_stats_[PROVIDER_PC_RSSL_MSGS_SENT]++;
 /* Sent data equivalent to a ping. */
 		if (nullptr != c->userSpecPtr) {
 			auto client = reinterpret_cast<client_t*> (c->userSpecPtr);
-			client->SetNextPing (last_activity_ + boost::posix_time::seconds (client->ping_interval_));
+			client->SetNextPing (now_ + 1000 * client->ping_interval_);
 		}
 		return 1;
 	default:
@@ -2025,7 +2415,7 @@ pending:
  * automatically.  If this fails then either the client has stalled or the systems is out of 
  * resources.  Suitable consequence is to force a disconnect.
  */
-		FD_SET (c->socketId, &out_efds_);
+		Abort (c);
 		LOG(INFO) << "rsslPing: { "
 			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
 			", \"sysError\": " << rssl_err.sysError << ""
@@ -2037,7 +2427,7 @@ pending:
 /* Advance ping expiration only on success. */
 		if (nullptr != c->userSpecPtr) {
 			auto client = reinterpret_cast<client_t*> (c->userSpecPtr);
-			client->SetNextPing (last_activity_ + boost::posix_time::seconds (client->ping_interval_));
+			client->SetNextPing (now_ + 1000 * client->ping_interval_);
 		}
 		return 1;
 	default:
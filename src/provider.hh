@@ -9,8 +9,8 @@
 #include <cstdint>
 #include <memory>
 #include <unordered_map>
-#include <unordered_set>
 #include <utility>
+#include <vector>
 
 /* Boost Atomics */
 #include <boost/atomic.hpp>
@@ -29,7 +29,20 @@
 #include "upa.hh"
 #include "client.hh"
 #include "config.hh"
+#include "counters.hh"
 #include "deleter.hh"
+#include "encoded_cache.hh"
+#include "flat_hash.hh"
+#include "latency.hh"
+#include "poller.hh"
+#include "stats.hh"
+#include "timer_wheel.hh"
+#include "trace.hh"
+
+namespace chromium
+{
+	class Histogram;
+}
 
 namespace hitsuji
 {
@@ -37,6 +50,8 @@ namespace hitsuji
 	enum {
 		PROVIDER_PC_BYTES_RECEIVED,
 		PROVIDER_PC_UNCOMPRESSED_BYTES_RECEIVED,
+		PROVIDER_PC_BYTES_SENT,
+		PROVIDER_PC_UNCOMPRESSED_BYTES_SENT,
 		PROVIDER_PC_MSGS_SENT,
 		PROVIDER_PC_RSSL_MSGS_ENQUEUED,
 		PROVIDER_PC_RSSL_MSGS_SENT,
@@ -44,16 +59,20 @@ namespace hitsuji
 		PROVIDER_PC_RSSL_MSGS_DECODED,
 		PROVIDER_PC_RSSL_MSGS_MALFORMED,
 		PROVIDER_PC_RSSL_MSGS_VALIDATED,
-		PROVIDER_PC_CONNECTION_RECEIVED,
-		PROVIDER_PC_CONNECTION_REJECTED,
-		PROVIDER_PC_CONNECTION_ACCEPTED,
+		PROVIDER_PC_CONNECTION_ADOPTED,
 		PROVIDER_PC_CONNECTION_EXCEPTION,
 		PROVIDER_PC_RWF_VERSION_UNSUPPORTED,
 		PROVIDER_PC_RSSL_PING_SENT,
 		PROVIDER_PC_RSSL_PONG_RECEIVED,
 		PROVIDER_PC_RSSL_PONG_TIMEOUT,
-		PROVIDER_PC_RSSL_PROTOCOL_DOWNGRADE,
 		PROVIDER_PC_RSSL_FLUSH,
+		PROVIDER_PC_RSSL_WRITE_CALLS,
+		PROVIDER_PC_RSSL_PACKED_MSGS,
+		PROVIDER_PC_STALE_REPLY_DISCARDED,
+		PROVIDER_PC_REQUEST_EXPIRED,
+		PROVIDER_PC_SERVICE_LOAD_UPDATED,
+		PROVIDER_PC_SERVICE_OVERLOADED,
+		PROVIDER_PC_SERVICE_RECOVERED,
 		PROVIDER_PC_OMM_ACTIVE_CLIENT_SESSION_RECEIVED,
 		PROVIDER_PC_OMM_ACTIVE_CLIENT_SESSION_EXCEPTION,
 		PROVIDER_PC_CLIENT_SESSION_REJECTED,
@@ -86,25 +105,51 @@ namespace hitsuji
 		public:
 		    Delegate() {}
 
-/* Return false on EAGAIN */
+/* Drain a bounded batch, return false on EAGAIN */
 		    virtual bool OnRead() = 0;
 
 		protected:
 		    virtual ~Delegate() {}
 		};
 
-		explicit provider_t (const config_t& config, std::shared_ptr<upa_t> upa, Delegate* reply_delegate, SOCKET reply_sock, client_t::Delegate* request_delegate);
+		explicit provider_t (const config_t& config, std::shared_ptr<upa_t> upa, unsigned shard, Delegate* reply_delegate, SOCKET reply_sock, client_t::Delegate* request_delegate);
 		~provider_t();
 
 		bool Initialize();
 /* Run the current MessageLoop. This blocks until Quit is called. */
 		void Run();
-/* Quit an earlier call to Run(). */
+/* Quit an earlier call to Run(), callable from any thread. */
 		void Quit();
 		void Close();
 
+/* Hand over an active connection from the acceptor thread. */
+		void Adopt (RsslChannel* c);
+		unsigned shard() const {
+			return shard_;
+		}
+/* Connections owned or being handed over, the load balancing metric. */
+		unsigned connection_count() const {
+			return connection_count_.load (boost::memory_order_relaxed);
+		}
+/* Monotonic milliseconds at the start of the current event loop pass. */
+		uint64_t now() const {
+			return now_;
+		}
+/* Monotonic nanoseconds when the message being dispatched was read. */
+		uint64_t read_time() const {
+			return read_time_;
+		}
+/* Per stage percentiles of the last latency interval, for SNMP. */
+		const latency_t& latency() const {
+			return latency_;
+		}
+/* Trace ring of this event loop thread, nullptr when tracing is disabled. */
+		trace_ring_t* trace() const {
+			return trace_;
+		}
+
 		static bool WriteRawClose (uint16_t rwf_version, int32_t token, uint16_t service_id, uint8_t model_type, const chromium::StringPiece& item_name, bool use_attribinfo_in_updates, uint8_t stream_state, uint8_t status_code, const chromium::StringPiece& status_text, void* data, size_t* length);
-		bool SendReply (RsslChannel*const handle, int32_t token, const void* buf, size_t length);
+		bool SendReply (uint64_t handle, int32_t token, const void* buf, size_t length, latency_stamps_t* latency);
 
 		uint16_t rwf_version() const {
 			return min_rwf_version_.load();
@@ -115,20 +160,24 @@ namespace hitsuji
 		uint16_t service_id() const {
 			return service_id_;
 		}
+		client_t::SlowConsumerPolicy slow_consumer_policy() const {
+			return slow_consumer_policy_;
+		}
 
 	private:
 		bool DoWork();
-
-		void OnConnection (RsslServer* rssl_sock);
-		void RejectConnection (RsslServer* rssl_sock);
-		void AcceptConnection (RsslServer* rssl_sock);
+		int PollTimeout() const;
+		void AdoptConnections();
+		void ScheduleKeepalives (client_t* client);
+		void OnTimer (timer_wheel_t::entry_t* timer);
+		void RemoveAbortedConnections();
+		void PublishStats();
 
 		void OnCanReadWithoutBlocking (RsslChannel* handle);
 		void OnCanWriteWithoutBlocking (RsslChannel* handle);
 		void Abort (RsslChannel* handle);
 		void Close (RsslChannel* handle);
 
-		void OnInitializingState (RsslChannel* handle);
 		void OnActiveClientSession (RsslChannel* handle);
 		void RejectClientSession (RsslChannel* handle, const char* address);
 		bool AcceptClientSession (RsslChannel* handle, const char* address);
@@ -147,37 +196,107 @@ namespace hitsuji
 		bool GetServiceLoad (RsslEncodeIterator*const it);
 
 		int Submit (RsslChannel* c, RsslBuffer* buf);
+		void WaitWritable (RsslChannel* c);
 		int Ping (RsslChannel* c);
+/* Packed replies are written once per pass. */
+		void OnPackPending (uint64_t handle) {
+			packed_sessions_.push_back (handle);
+		}
+		void SubmitPacks();
+
+/* Session handle: generation in the upper 32 bits, slot index in the lower. */
+		static uint64_t session_handle (uint32_t index, uint32_t generation) {
+			return (static_cast<uint64_t> (generation) << 32) | index;
+		}
+/* O(1), nullptr when the session has closed, including if the slot was reused. */
+		client_t* FindClient (uint64_t handle) const {
+			const uint32_t index = static_cast<uint32_t> (handle);
+			if (index >= slots_.size())
+				return nullptr;
+			const slot_t& slot = slots_[index];
+			return (slot.generation == static_cast<uint32_t> (handle >> 32)) ? slot.client.get() : nullptr;
+		}
+		void ReleaseSlot (uint64_t handle);
 
 		void SetServiceId (uint16_t service_id) {
 			service_id_.store (service_id);
+			encoded_cache_.Invalidate();
 		}
 
+/* Pre-encoded directory and login responses, the stream ID is patched per client. */
+		encoded_cache_t& encoded_cache() { return encoded_cache_; }
+
+/* Live service load from outstanding requests and worker service times. */
+		void OnRequestDispatched (uint64_t handle, int32_t token);
+		void OnReplyReceived (uint64_t handle, int32_t token);
+		void UpdateServiceLoad();
+/* Clears AcceptingRequests under sustained overload, restores with hysteresis. */
+		void UpdateServiceState();
+/* Invalidate encoded directories and update every open directory stream. */
+		void SendDirectoryUpdates();
+
 		static uint8_t rwf_major_version (uint16_t rwf_version) { return rwf_version / 256; }
 		static uint8_t rwf_minor_version (uint16_t rwf_version) { return rwf_version % 256; }
 
 		const config_t& config_;
+		const unsigned shard_;
 
 /* Reply socket to propagate events */
 		SOCKET reply_sock_;
 		Delegate* reply_delegate_;
 /* UPA context. */
 		std::shared_ptr<upa_t> upa_;
-/* Server socket for new connections */
-		RsslServer* rssl_sock_;
 /* This flag is set to false when Run should return. */
 		boost::atomic_bool keep_running_;
 
-		int in_nfds_, out_nfds_;
-		fd_set in_rfds_, in_wfds_, in_efds_;
-		fd_set out_rfds_, out_wfds_, out_efds_;
-		struct timeval in_tv_, out_tv_;
+/* Readiness of server, reply and connection sockets, context is the RsslChannel. */
+		poller_t poller_;
+		int ready_count_;
+/* Connections with input remaining in RSSL buffers, read again next pass. */
+		std::vector<RsslChannel*> pending_reads_, reads_;
+/* rsslReadEx calls and messages dispatched this pass. */
+		unsigned pass_reads_, pass_dispatches_;
+		chromium::Histogram* reads_per_pass_;
+		chromium::Histogram* dispatches_per_pass_;
+/* Worker replies remaining after a bounded drain. */
+		bool is_reply_pending_;
+/* Connections to remove at the end of the pass. */
+		std::vector<RsslChannel*> aborted_;
+/* Ping, pong and future per stream deadlines, only expired entries are visited. */
+		enum {
+			kPingTimer,
+			kPongTimer,
+			kWriteTimer
+		};
+		timer_wheel_t timers_;
+		std::vector<timer_wheel_t::entry_t*> expired_timers_;
+		uint64_t now_;
+		uint64_t read_time_;
+
+/* Connections handed over by the acceptor, the only state shared between event loops. */
+		std::vector<RsslChannel*> adopted_, adopting_;
+		boost::mutex adopt_lock_;
+		boost::atomic_bool is_adopt_pending_;
+		boost::atomic_uint connection_count_;
 
 /* RSSL connection directory */
 		std::list<RsslChannel*const> connections_;
-/* RSSL Client Session directory */
-		std::unordered_map<RsslChannel*const, std::shared_ptr<client_t>> clients_;
-		boost::shared_mutex clients_lock_;
+/* RSSL Client Session directory, fixed capacity of session_capacity slots, only accessed
+ * by this event loop thread.  Generation advances when a slot is released so handles held
+ * by workers for a closed session never match a new occupant.
+ */
+		struct slot_t {
+			slot_t() : generation (1) {}
+			uint32_t generation;
+			std::shared_ptr<client_t> client;
+		};
+		std::vector<slot_t> slots_;
+		std::vector<uint32_t> free_slots_;
+		size_t client_count_;
+/* Clients with a pending packed buffer this pass. */
+		std::vector<uint64_t> packed_sessions_;
+/* Parsed from config_.slow_consumer_policy. */
+		client_t::SlowConsumerPolicy slow_consumer_policy_;
 
 		client_t::Delegate* request_delegate_;
 		friend client_t;
@@ -190,11 +309,53 @@ namespace hitsuji
 /* TREP-RT can reject new client requests whilst maintaining current connected sessions. */
 		bool is_accepting_connections_;
 		bool is_accepting_requests_;
+/* Start of the current overload or recovery period, 0 when none. */
+		uint64_t overload_since_, recovery_since_;
+/* Invalidated on any service state change. */
+		encoded_cache_t encoded_cache_;
+
+/* Requests awaiting a worker reply, keyed by slot index and token. */
+		struct in_flight_t {
+			in_flight_t() : handle (0), dispatched (0) {}
+			uint64_t handle;
+			uint64_t dispatched;
+		};
+		internal::flat_map_t<uint64_t, in_flight_t> in_flight_;
+/* View of the request being decoded, shared by every client of this event loop. */
+		std::vector<int_fast16_t> view_by_fid_;
+/* Service times in milliseconds since the last load calculation, a ring of fixed size. */
+		std::vector<uint32_t> service_times_, sorted_service_times_;
+/* Dispatch to worker reply, milliseconds. */
+		chromium::Histogram* reply_latency_ms_;
+		size_t service_time_count_;
+		uint32_t service_time_p95_;
+		uint64_t next_load_time_;
+/* Read to write per analytic and stage, reduced every latency_interval_ms. */
+		latency_t latency_;
+		uint64_t next_latency_time_;
+/* Advertised load, only changed when LoadFactor crosses a band or the headroom changes,
+ * encoded directories remain valid in between.
+ */
+		struct service_load_t {
+			uint64_t open_limit;
+			uint64_t open_window;
+			uint64_t load_factor;
+			unsigned band;
+		} load_;
 
 /** Performance Counters **/
 		boost::posix_time::ptime creation_time_, last_activity_;
-		uint32_t cumulative_stats_[PROVIDER_PC_MAX];
+		counters_t<PROVIDER_PC_MAX> cumulative_stats_;
 		uint32_t snap_stats_[PROVIDER_PC_MAX];
+/* Sessions already released, so exported client totals never fall. */
+		uint64_t released_client_stats_[CLIENT_PC_MAX];
+/* Column of the shared-memory stats table, bound on the event loop thread. */
+		int stats_slot_;
+		stats_rows_t<PROVIDER_PC_MAX> provider_rows_;
+		stats_rows_t<CLIENT_PC_MAX> client_rows_;
+		uint64_t next_stats_time_;
+/* Binary trace of the request path, registered on the event loop thread. */
+		trace_ring_t* trace_;
 
 		chromium::debug::LeakTracker<provider_t> leak_tracker_;
 	};
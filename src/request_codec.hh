@@ -0,0 +1,148 @@
+/* SBE request message from an event loop shard to the worker pool.
+ *
+ * Encoded by shard_t::OnRequest into a pooled slab and decoded by worker_t::OnTask.  Free of
+ * the RSSL and ZeroMQ headers so that the request path can be tested alone.
+ */
+
+#ifndef REQUEST_CODEC_HH_
+#define REQUEST_CODEC_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* Outstanding defects:
+ * warning C4244: '=' : conversion from 'const sbe_uint64_t' to 'int', possible loss of data
+ * warning C4244: 'return' : conversion from 'sbe_uint64_t' to 'int', possible loss of data
+ * warning C4146: unary minus operator applied to unsigned type, result still unsigned
+ * warning C4244: 'initializing' : conversion from 'sbe_int64_t' to 'int', possible loss of data
+ */
+#pragma warning(push)
+#pragma warning(disable: 4244 146)
+#include "hitsuji/MessageHeader.hpp"
+#include "hitsuji/Request.hpp"
+#pragma warning(pop)
+
+#include "chromium/string_piece.hh"
+
+namespace hitsuji
+{
+/* Fixed block of one request. */
+	struct request_fields_t
+	{
+		uint64_t handle;
+		uint16_t rwf_version;
+		int32_t token;
+		uint16_t service_id;
+		uint8_t shard;
+		bool abort;
+		bool use_attribinfo_in_updates;
+		uint64_t read_time;
+		uint64_t queue_time;
+	};
+
+/* Encoded size of a request with view_count field identifiers. */
+	static inline
+	size_t
+	request_length (
+		int view_count,
+		size_t item_name_length
+		)
+	{
+		return MessageHeader::size() + Request::sbeBlockLength()
+			+ Request::View::sbeHeaderSize() + (view_count * Request::View::sbeBlockLength())
+			+ Request::itemNameHeaderSize() + item_name_length;
+	}
+
+/* Encode a request with the first view_count field identifiers of view_by_fid, the SBE
+ * group dimension is 8-bit.
+ *
+ * Returns the encoded length, 0 when the request exceeds capacity.
+ */
+	template <typename View>
+	static inline
+	size_t
+	encode_request (
+		MessageHeader* hdr,
+		Request* request,
+		char* buffer,
+		size_t capacity,
+		const request_fields_t& fields,
+		const View& view_by_fid,
+		int view_count,
+		const chromium::StringPiece& item_name
+		)
+	{
+		static const int version = 0;
+		const size_t length = request_length (view_count, item_name.size());
+		if (length > capacity)
+			return 0;
+		hdr->wrap (buffer, 0, version, static_cast<int> (length))
+			.blockLength (Request::sbeBlockLength())
+			.templateId (Request::sbeTemplateId())
+			.schemaId (Request::sbeSchemaId())
+			.version (Request::sbeSchemaVersion());
+		request->wrapForEncode (buffer, hdr->size(), static_cast<int> (length))
+			.handle (fields.handle)
+			.rwfVersion (fields.rwf_version)
+			.token (fields.token)
+			.serviceId (fields.service_id)
+			.shard (fields.shard)
+			.readTime (fields.read_time)
+			.queueTime (fields.queue_time);
+		request->flags().clear()
+			.abort (fields.abort)
+			.useAttribInfoInUpdates (fields.use_attribinfo_in_updates);
+		Request::View &view = request->viewCount (view_count);
+		for (int i = 0; i < view_count; ++i) {
+			view.next().fid (static_cast<sbe_int16_t> (view_by_fid[i]));
+		}
+		request->putItemName (item_name.data(), static_cast<int> (item_name.size()));
+		return length;
+	}
+
+/* Decode a request, view and item name are copied out so that the buffer may be released.
+ * An abort request carries only the fixed block, view and item name are left untouched.
+ */
+	template <typename View>
+	static inline
+	void
+	decode_request (
+		MessageHeader* hdr,
+		Request* request,
+		const void* buffer,
+		size_t length,
+		request_fields_t* fields,
+		View* view_by_fid,
+		std::string* item_name
+		)
+	{
+		static const int version = 0;
+		char* data = reinterpret_cast<char*> (const_cast<void*> (buffer));
+		hdr->wrap (data, 0, version, static_cast<int> (length));
+		request->wrapForDecode (data, hdr->size(), hdr->blockLength(), hdr->version(), static_cast<int> (length));
+		fields->abort = request->flags().abort();
+		if (fields->abort)
+			return;
+		fields->handle = request->handle();
+		fields->rwf_version = request->rwfVersion();
+		fields->token = request->token();
+		fields->service_id = request->serviceId();
+		fields->shard = request->shard();
+		fields->use_attribinfo_in_updates = request->flags().useAttribInfoInUpdates();
+		fields->read_time = request->readTime();
+		fields->queue_time = request->queueTime();
+/* View group precedes variable length data in the SBE wire format. */
+		view_by_fid->clear();
+		Request::View& view = request->view();
+		while (view.hasNext()) {
+			view_by_fid->push_back (static_cast<typename View::value_type> (view.next().fid()));
+		}
+		item_name->assign (request->itemName(), request->itemNameLength());
+	}
+
+} /* namespace hitsuji */
+
+#endif /* REQUEST_CODEC_HH_ */
+
+/* eof */
@@ -0,0 +1,371 @@
+/* RSSL event loop shard.
+ */
+
+#include "shard.hh"
+
+#define __STDC_FORMAT_MACROS
+#include <cstdint>
+#include <inttypes.h>
+#include <sstream>
+
+#include "chromium/logging.hh"
+#include "upa.hh"
+
+/* Outstanding defects:
+ * warning C4244: '=' : conversion from 'const sbe_uint64_t' to 'int', possible loss of data
+ * warning C4244: 'return' : conversion from 'sbe_uint64_t' to 'int', possible loss of data
+ * warning C4146: unary minus operator applied to unsigned type, result still unsigned
+ * warning C4244: 'initializing' : conversion from 'sbe_int64_t' to 'int', possible loss of data
+ */
+#pragma warning(push)
+#pragma warning(disable: 4244 146)
+#include "hitsuji/MessageHeader.hpp"
+#include "hitsuji/Request.hpp"
+#include "hitsuji/Reply.hpp"
+#pragma warning(pop)
+
+#include "request_codec.hh"
+
+/* Maximum worker replies drained per event loop pass, replies to one client are packed. */
+static const unsigned kMaxRepliesPerPass = 64;
+
+hitsuji::shard_t::shard_t (
+	unsigned id,
+	const hitsuji::config_t& config,
+	std::shared_ptr<hitsuji::upa_t> upa,
+	std::shared_ptr<void> zmq_context,
+	std::shared_ptr<hitsuji::slab_pool_t> request_pool
+	)
+	: id_ (id)
+	, config_ (config)
+	, upa_ (upa)
+	, zmq_context_ (zmq_context)
+	, request_pool_ (request_pool)
+	, sbe_hdr_ (new hitsuji::MessageHeader())
+	, sbe_request_ (new hitsuji::Request())
+	, sbe_reply_ (new hitsuji::Reply())
+{
+}
+
+hitsuji::shard_t::~shard_t()
+{
+	DLOG(INFO) << "~shard_t";
+}
+
+std::string
+hitsuji::shard_t::request_endpoint (
+	unsigned id
+	)
+{
+	std::ostringstream ss;
+	ss << "inproc://worker/request/" << id;
+	return ss.str();
+}
+
+std::string
+hitsuji::shard_t::reply_endpoint (
+	unsigned id
+	)
+{
+	std::ostringstream ss;
+	ss << "inproc://worker/reply/" << id;
+	return ss.str();
+}
+
+bool
+hitsuji::shard_t::Initialize()
+{
+	SOCKET reply_sock = INVALID_SOCKET;
+
+	try {
+		static const std::function<int(void*)> zmq_close_deleter = zmq_close;
+		int rc;
+/* PUSH to distribute tasks */
+		request_sock_.reset (zmq_socket (zmq_context_.get(), ZMQ_PUSH), zmq_close_deleter);
+		if (!(bool)request_sock_)
+			return false;
+		rc = zmq_bind (request_sock_.get(), request_endpoint (id_).c_str());
+		if (-1 == rc)
+			return false;
+/* PULL for worker reply messages */
+		reply_sock_.reset (zmq_socket (zmq_context_.get(), ZMQ_PULL), zmq_close_deleter);
+		if (!(bool)reply_sock_)
+			return false;
+		rc = zmq_bind (reply_sock_.get(), reply_endpoint (id_).c_str());
+		if (-1 == rc)
+			return false;
+/* Extract notification socket to pass to provider message pump */
+		size_t sock_len = sizeof (reply_sock);
+		rc = zmq_getsockopt (reply_sock_.get(), ZMQ_FD, &reply_sock, &sock_len);
+		if (-1 == rc)
+			return false;
+	} catch (const std::exception& e) {
+		LOG(ERROR) << "ZMQ::Exception: { "
+			"\"What\": \"" << e.what() << "\""
+			", \"shard\": " << id_ << ""
+			" }";
+		return false;
+	}
+/* UPA provider, the event loop of this shard. */
+	provider_.reset (new provider_t (config_, upa_, id_, static_cast<provider_t::Delegate*> (this), reply_sock, static_cast<client_t::Delegate*> (this)));
+	if (!(bool)provider_ || !provider_->Initialize())
+		return false;
+	return true;
+}
+
+void
+hitsuji::shard_t::Reset()
+{
+/* Release ZMQ sockets before context */
+	CHECK (request_sock_.use_count() <= 1);
+	request_sock_.reset();
+	CHECK (reply_sock_.use_count() <= 1);
+	reply_sock_.reset();
+	zmq_context_.reset();
+	request_pool_.reset();
+}
+
+void
+hitsuji::shard_t::Close()
+{
+/* Close client sockets with reference counts on provider. */
+	if ((bool)provider_)
+		provider_->Close();
+/* Release everything with an UPA dependency. */
+	CHECK_LE (provider_.use_count(), 1);
+	provider_.reset();
+	upa_.reset();
+}
+
+bool
+hitsuji::shard_t::OnRequest (
+	uint64_t handle,
+	uint16_t rwf_version, 
+	int32_t token,
+	uint16_t service_id,
+	const chromium::StringPiece& item_name,
+	bool use_attribinfo_in_updates
+	)
+{
+/* Full image is an empty view group. */
+	static const std::vector<int_fast16_t> no_view;
+	return OnRequest (handle, rwf_version, token, service_id, item_name, use_attribinfo_in_updates, no_view);
+}
+
+bool
+hitsuji::shard_t::OnRequest (
+	uint64_t handle,
+	uint16_t rwf_version, 
+	int32_t token,
+	uint16_t service_id,
+	const chromium::StringPiece& item_name,
+	bool use_attribinfo_in_updates,
+	const std::vector<int_fast16_t>& view_by_fid
+	)
+{
+	if (DCHECK_IS_ON() && VLOG_IS_ON(3)) {
+		std::ostringstream fids;
+		for (auto it = view_by_fid.begin(); it != view_by_fid.end(); ++it) {
+			if (it != view_by_fid.begin()) fids << ", ";
+			fids << *it;
+		}
+		DVLOG(3) << "Request: { "
+			  "\"handle\": " << handle << ""
+			", \"rwf_version\": " << rwf_version << ""
+			", \"token\": " << token << ""
+			", \"service_id\": " << service_id << ""
+			", \"item_name\": \"" << item_name << "\""
+			", \"use_attribinfo_in_updates\": " << (use_attribinfo_in_updates ? "true" : "false") << ""
+			", \"view_by_fid\": [" << fids.str() << "]"
+			" }";
+	}
+/* SBE group dimension is 8-bit, wider views are served the full image. */
+	int view_count = static_cast<int> (view_by_fid.size());
+	if (view_count > UINT8_MAX) {
+		LOG(WARNING) << "View exceeds SBE group capacity, sending full image: { "
+			  "\"item_name\": \"" << item_name << "\""
+			", \"fids\": " << view_count << ""
+			" }";
+		view_count = 0;
+	}
+/* distribute to worker */
+	request_fields_t fields;
+	fields.handle = handle;
+	fields.rwf_version = rwf_version;
+	fields.token = token;
+	fields.service_id = service_id;
+	fields.shard = static_cast<uint8_t> (id_);
+	fields.abort = false;
+	fields.use_attribinfo_in_updates = use_attribinfo_in_updates;
+	fields.read_time = provider_->read_time();
+	fields.queue_time = monotonic_nanoseconds();
+	slab_pool_t::slab_t* slab = request_pool_->Acquire();
+	const size_t length = encode_request (sbe_hdr_.get(), sbe_request_.get(), slab->data(), slab->capacity(), fields, view_by_fid, view_count, item_name);
+	if (0 == length) {
+		LOG(ERROR) << "Request exceeds encode buffer: { "
+			  "\"item_name\": \"" << item_name << "\""
+			", \"length\": " << request_length (view_count, item_name.size()) << ""
+			", \"capacity\": " << slab->capacity() << ""
+			" }";
+		request_pool_->Release (slab);
+		return false;
+	}
+	VLOG(2) << "Distributing task \"" << item_name << "\" from shard " << id_ << " to worker pool.";
+/* The slab belongs to the worker once sent. */
+	const bool is_sent = SendRequest (slab);
+	if (nullptr != provider_->trace())
+		provider_->trace()->Complete (kTraceDispatch, handle, token, provider_->read_time(), monotonic_nanoseconds(), static_cast<uint32_t> (length));
+	return is_sent;
+}
+
+/* Only the slab address is queued, a message of that size is held inline by ZeroMQ without
+ * allocation.  The worker returns the slab to the pool after decoding.
+ *
+ * Returns false on error, true on success.
+ */
+bool
+hitsuji::shard_t::SendRequest (
+	slab_pool_t::slab_t* slab
+	)
+{
+	int rc = zmq_msg_init_size (&zmq_msg_, sizeof (slab));
+	if (-1 == rc) {
+		LOG(ERROR) << "zmq_msg_init_size failed: " << zmq_strerror (zmq_errno());
+		request_pool_->Release (slab);
+		return false;
+	}
+	CopyMemory (zmq_msg_data (&zmq_msg_), &slab, sizeof (slab));
+	rc = zmq_msg_send (&zmq_msg_, request_sock_.get(), 0);
+	if (-1 == rc) {
+		LOG(ERROR) << "zmq_send failed: " << zmq_strerror (zmq_errno());
+		rc = zmq_msg_close (&zmq_msg_);
+		LOG_IF(ERROR, rc) << "zmq_msg_close failed: " << zmq_strerror (zmq_errno());
+		request_pool_->Release (slab);
+		return false;
+	}
+	return true;
+}
+
+bool
+hitsuji::shard_t::OnReply (
+	const void* buffer,
+	size_t length,
+	const void* payload,
+	size_t payload_length
+	)
+{
+	static const int version = 0;
+	sbe_hdr_->wrap (reinterpret_cast<char*> (const_cast<void*> (buffer)), 0, version, static_cast<int> (length));
+	sbe_reply_->wrapForDecode (reinterpret_cast<char*> (const_cast<void*> (buffer)), sbe_hdr_->size(), sbe_hdr_->blockLength(), sbe_hdr_->version(), static_cast<int> (length));
+	const uint64_t handle = sbe_reply_->handle();
+	const int32_t token = sbe_reply_->token();
+	DVLOG(3) << "Reply: { "
+		  "\"handle\": " << handle << ""
+		", \"token\": " << token << ""
+		", \"shard\": " << static_cast<unsigned> (sbe_reply_->shard()) << ""
+		", \"length\": " << payload_length << ""
+		" }";
+	DCHECK_EQ (static_cast<unsigned> (sbe_reply_->shard()), id_);
+/* Worker timestamps follow the encoded response. */
+	if (payload_length < kReplyTrailerSize) {
+		LOG(ERROR) << "Reply payload shorter than timestamp trailer: { "
+			  "\"handle\": " << handle << ""
+			", \"token\": " << token << ""
+			", \"length\": " << payload_length << ""
+			" }";
+		return false;
+	}
+	const size_t rssl_length = payload_length - kReplyTrailerSize;
+	latency_stamps_t latency;
+	latency.analytic = sbe_reply_->analytic();
+	CopyMemory (latency.stamps, static_cast<const char*> (payload) + rssl_length, kReplyTrailerSize);
+	latency.stamps[kReceiveStamp] = monotonic_nanoseconds();
+	return provider_->SendReply (handle, token, payload, rssl_length, &latency);
+}
+
+bool
+hitsuji::shard_t::OnRead()
+{
+	int rc, zmq_events = 0;
+	size_t zmq_events_len = sizeof (zmq_events);
+	rc = zmq_getsockopt (reply_sock_.get(), ZMQ_EVENTS, &zmq_events, &zmq_events_len);
+	if (-1 == rc) {
+		LOG(ERROR) << "zmq_getsockopt (ZMQ_EVENTS) failed: " << zmq_strerror (zmq_errno());
+		return false;
+	}
+	for (unsigned i = 0; (zmq_events & ZMQ_POLLIN) && i < kMaxRepliesPerPass; ++i) {
+		rc = zmq_msg_init (&zmq_msg_);
+		if (-1 == rc) {
+			LOG(ERROR) << "zmq_msg_init failed: " << zmq_strerror (zmq_errno());
+			return false;
+		}
+		rc = zmq_msg_recv (&zmq_msg_, reply_sock_.get(), 0);
+		if (-1 == rc) {
+			LOG(ERROR) << "zmq_recv failed: " << zmq_strerror (zmq_errno());
+			zmq_msg_close (&zmq_msg_);
+			return false;
+		}
+/* multi-part messages are delivered atomically, the payload is already queued. */
+		if (!zmq_msg_more (&zmq_msg_)) {
+			LOG(ERROR) << "Reply without payload frame.";
+			zmq_msg_close (&zmq_msg_);
+			return false;
+		}
+		rc = zmq_msg_init (&zmq_payload_);
+		if (-1 == rc) {
+			LOG(ERROR) << "zmq_msg_init failed: " << zmq_strerror (zmq_errno());
+			zmq_msg_close (&zmq_msg_);
+			return false;
+		}
+		rc = zmq_msg_recv (&zmq_payload_, reply_sock_.get(), 0);
+		if (-1 == rc) {
+			LOG(ERROR) << "zmq_recv failed: " << zmq_strerror (zmq_errno());
+			zmq_msg_close (&zmq_payload_);
+			zmq_msg_close (&zmq_msg_);
+			return false;
+		}
+/* reply is dropped, e.g. client disconnected, continue draining */
+		if (!OnReply (zmq_msg_data (&zmq_msg_), zmq_msg_size (&zmq_msg_), zmq_msg_data (&zmq_payload_), zmq_msg_size (&zmq_payload_))) {
+			DVLOG(3) << "Reply dropped.";
+		}
+/* Written or copied by the provider, the slab returns to the pool. */
+		rc = zmq_msg_close (&zmq_payload_);
+		if (-1 == rc) {
+			LOG(ERROR) << "zmq_msg_close failed: " << zmq_strerror (zmq_errno());
+			zmq_msg_close (&zmq_msg_);
+			return false;
+		}
+		rc = zmq_msg_close (&zmq_msg_);
+		if (-1 == rc) {
+			LOG(ERROR) << "zmq_msg_close failed: " << zmq_strerror (zmq_errno());
+			return false;
+		}
+/* re-read events due to edge triggering */
+		rc = zmq_getsockopt (reply_sock_.get(), ZMQ_EVENTS, &zmq_events, &zmq_events_len);
+		if (-1 == rc) {
+			LOG(ERROR) << "zmq_getsockopt (ZMQ_EVENTS) failed: " << zmq_strerror (zmq_errno());
+			return false;
+		}
+	}
+/* more pending: remain readable for the next pass */
+	return !!(zmq_events & ZMQ_POLLIN);
+}
+
+bool
+hitsuji::shard_t::AbortOneWorker()
+{
+	static const int version = 0;
+	const size_t length = MessageHeader::size() + Request::sbeBlockLength();
+	slab_pool_t::slab_t* slab = request_pool_->Acquire();
+	sbe_hdr_->wrap (slab->data(), 0, version, static_cast<int> (length))
+		.blockLength (Request::sbeBlockLength())
+		.templateId (Request::sbeTemplateId())
+		.schemaId (Request::sbeSchemaId())
+		.version (Request::sbeSchemaVersion());
+	sbe_request_->wrapForEncode (slab->data(), sbe_hdr_->size(), static_cast<int> (length));
+	sbe_request_->flags().clear()
+		.abort (true);
+	return SendRequest (slab);
+}
+
+/* eof */
\ No newline at end of file
@@ -0,0 +1,94 @@
+/* RSSL event loop shard: one provider event loop thread with its own worker request and
+ * reply queues.  Connections are owned by exactly one shard for their lifetime.
+ */
+
+#ifndef SHARD_HH_
+#define SHARD_HH_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* ZeroMQ messaging middleware. */
+#include <zmq.h>
+
+#include "chromium/debug/leak_tracker.hh"
+#include "client.hh"
+#include "provider.hh"
+#include "config.hh"
+#include "slab_pool.hh"
+
+namespace hitsuji
+{
+	class upa_t;
+	class MessageHeader;
+	class Request;
+	class Reply;
+
+	class shard_t
+		: public client_t::Delegate	/* Rssl requests */
+		, public provider_t::Delegate	/* Worker replies */
+	{
+	public:
+		explicit shard_t (unsigned id, const config_t& config, std::shared_ptr<upa_t> upa, std::shared_ptr<void> zmq_context, std::shared_ptr<slab_pool_t> request_pool);
+		virtual ~shard_t();
+
+		bool Initialize();
+/* Release ZMQ sockets ahead of the context. */
+		void Reset();
+/* Close client sessions and the provider, after Reset. */
+		void Close();
+
+		virtual bool OnRequest (uint64_t handle, uint16_t rwf_version, int32_t token, uint16_t service_id, const chromium::StringPiece& item_name, bool use_attribinfo_in_updates) override;
+		virtual bool OnRequest (uint64_t handle, uint16_t rwf_version, int32_t token, uint16_t service_id, const chromium::StringPiece& item_name, bool use_attribinfo_in_updates, const std::vector<int_fast16_t>& view_by_fid) override;
+		virtual bool OnRead() override;
+
+/* Queue an abort to one worker through this shard's request queue. */
+		bool AbortOneWorker();
+
+		unsigned id() const {
+			return id_;
+		}
+		std::shared_ptr<provider_t> provider() const {
+			return provider_;
+		}
+
+/* Per shard ZMQ endpoints, workers connect to every shard. */
+		static std::string request_endpoint (unsigned id);
+		static std::string reply_endpoint (unsigned id);
+/* Maximum encoded request: 8-bit view group and RSSL item names of at most 255 bytes. */
+		static const size_t kMaxRequestSize = 1024;
+
+	private:
+		bool OnReply (const void* buffer, size_t length, const void* payload, size_t payload_length);
+		bool SendRequest (slab_pool_t::slab_t* slab);
+
+		const unsigned id_;
+		const config_t& config_;
+/* UPA context. */
+		std::shared_ptr<upa_t> upa_;
+/* UPA provider */
+		std::shared_ptr<provider_t> provider_;
+/* ZMQ context. */
+		std::shared_ptr<void> zmq_context_;
+/* Request encode buffers, shared with workers. */
+		std::shared_ptr<slab_pool_t> request_pool_;
+		std::shared_ptr<void> request_sock_;
+		std::shared_ptr<void> reply_sock_;
+/* ZMQ message, replies carry the encoded response in a second frame. */
+		zmq_msg_t zmq_msg_;
+		zmq_msg_t zmq_payload_;
+/* Sbe message buffer */
+		std::shared_ptr<MessageHeader> sbe_hdr_;
+		std::shared_ptr<Request> sbe_request_;
+		std::shared_ptr<Reply> sbe_reply_;
+
+		chromium::debug::LeakTracker<shard_t> leak_tracker_;
+	};
+
+} /* namespace hitsuji */
+
+#endif /* SHARD_HH_ */
+
+/* eof */
\ No newline at end of file
@@ -0,0 +1,88 @@
+/* Pool of fixed size encode buffers.
+ */
+
+#include "slab_pool.hh"
+
+#include <new>
+
+#include "chromium/logging.hh"
+
+hitsuji::slab_pool_t::slab_pool_t (
+	size_t slab_size,
+	size_t count
+	)
+	: slab_size_ (slab_size)
+	, free_list_ (nullptr)
+	, allocated_ (0)
+	, available_ (0)
+{
+	for (size_t i = 0; i < count; ++i)
+		Release (Allocate());
+}
+
+hitsuji::slab_pool_t::~slab_pool_t()
+{
+	LOG_IF(WARNING, available_ != allocated_) << (allocated_ - available_) << " slab(s) outstanding.";
+	while (nullptr != free_list_) {
+		slab_t* slab = free_list_;
+		free_list_ = slab->next_;
+		::operator delete (slab);
+	}
+	VLOG(3) << "Slab pool summary: { "
+		  "\"slabSize\": " << slab_size_ << ""
+		", \"allocated\": " << allocated_ << ""
+		" }";
+}
+
+hitsuji::slab_pool_t::slab_t*
+hitsuji::slab_pool_t::Allocate()
+{
+	slab_t* slab = static_cast<slab_t*> (::operator new (sizeof (slab_t) + slab_size_));
+	slab->pool_ = this;
+	slab->next_ = nullptr;
+	boost::lock_guard<boost::mutex> lock (lock_);
+	++allocated_;
+	return slab;
+}
+
+hitsuji::slab_pool_t::slab_t*
+hitsuji::slab_pool_t::Acquire()
+{
+	{
+		boost::lock_guard<boost::mutex> lock (lock_);
+		slab_t* slab = free_list_;
+		if (nullptr != slab) {
+			free_list_ = slab->next_;
+			--available_;
+			return slab;
+		}
+	}
+/* Exhausted, e.g. a slow consumer holding replies in flight. */
+	return Allocate();
+}
+
+void
+hitsuji::slab_pool_t::Release (
+	slab_t* slab
+	)
+{
+	DCHECK (nullptr != slab);
+	DCHECK_EQ (this, slab->pool_);
+	boost::lock_guard<boost::mutex> lock (lock_);
+	slab->next_ = free_list_;
+	free_list_ = slab;
+	++available_;
+}
+
+void
+hitsuji::slab_pool_t::OnFree (
+	void* data,
+	void* hint
+	)
+{
+	slab_t* slab = static_cast<slab_t*> (hint);
+	DCHECK_EQ (slab->data(), data);
+	slab->pool_->Release (slab);
+}
+
+/* eof */
\ No newline at end of file
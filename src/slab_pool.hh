@@ -0,0 +1,79 @@
+/* Pool of fixed size encode buffers shared by workers and event loops.
+ *
+ * A worker encodes a reply directly into a slab and hands it to ZeroMQ by reference with
+ * zmq_msg_init_data, inproc transport passes the reference counted message content between
+ * threads without copying.  The slab returns to the pool when the receiving event loop
+ * closes the message, after the reply has been written to the client.
+ *
+ * Requests travel the other way as the bare slab address, released by the worker once the
+ * request is decoded.
+ */
+
+#ifndef SLAB_POOL_HH_
+#define SLAB_POOL_HH_
+
+#include <cstddef>
+#include <cstdint>
+
+/* Boost threading. */
+#include <boost/thread.hpp>
+
+#include "chromium/debug/leak_tracker.hh"
+
+namespace hitsuji
+{
+	class slab_pool_t
+	{
+	public:
+/* Header preceding the payload of each slab. */
+		class slab_t
+		{
+		public:
+			char* data() {
+				return reinterpret_cast<char*> (this + 1);
+			}
+			size_t capacity() const {
+				return pool_->slab_size();
+			}
+
+		private:
+			friend slab_pool_t;
+			slab_pool_t* pool_;
+			slab_t* next_;
+		};
+
+/* Pre-allocates count slabs, the pool grows on demand and never shrinks. */
+		explicit slab_pool_t (size_t slab_size, size_t count);
+		~slab_pool_t();
+
+		slab_t* Acquire();
+		void Release (slab_t* slab);
+/* zmq_free_fn, hint is the slab. */
+		static void OnFree (void* data, void* hint);
+
+		size_t slab_size() const {
+			return slab_size_;
+		}
+		size_t allocated() const {
+			return allocated_;
+		}
+		size_t available() const {
+			return available_;
+		}
+
+	private:
+		slab_t* Allocate();
+
+		const size_t slab_size_;
+		boost::mutex lock_;
+		slab_t* free_list_;
+		size_t allocated_, available_;
+
+		chromium::debug::LeakTracker<slab_pool_t> leak_tracker_;
+	};
+
+} /* namespace hitsuji */
+
+#endif /* SLAB_POOL_HH_ */
+
+/* eof */
\ No newline at end of file
@@ -0,0 +1,206 @@
+/* Performance counters exported to a named shared-memory StatsTable.
+ */
+
+#include "stats.hh"
+
+/* Boost threading */
+#include <boost/thread.hpp>
+
+#include "chromium/logging.hh"
+#include "acceptor.hh"
+#include "client.hh"
+#include "provider.hh"
+#include "worker.hh"
+
+/* Row names, at most StatsTable::kMaxCounterNameLength - 1 characters. */
+const char* const hitsuji::kProviderStatsNames[] = {
+	"Provider.BytesReceived",
+	"Provider.UncompressedBytesReceived",
+	"Provider.BytesSent",
+	"Provider.UncompressedBytesSent",
+	"Provider.MsgsSent",
+	"Provider.RsslMsgsEnqueued",
+	"Provider.RsslMsgsSent",
+	"Provider.RsslMsgsReceived",
+	"Provider.RsslMsgsDecoded",
+	"Provider.RsslMsgsMalformed",
+	"Provider.RsslMsgsValidated",
+	"Provider.ConnectionAdopted",
+	"Provider.ConnectionException",
+	"Provider.RwfVersionUnsupported",
+	"Provider.RsslPingSent",
+	"Provider.RsslPongReceived",
+	"Provider.RsslPongTimeout",
+	"Provider.RsslFlush",
+	"Provider.RsslWriteCalls",
+	"Provider.RsslPackedMsgs",
+	"Provider.StaleReplyDiscarded",
+	"Provider.RequestExpired",
+	"Provider.ServiceLoadUpdated",
+	"Provider.ServiceOverloaded",
+	"Provider.ServiceRecovered",
+	"Provider.OmmActiveClientSessionReceived",
+	"Provider.OmmActiveClientSessionException",
+	"Provider.ClientSessionRejected",
+	"Provider.ClientSessionAccepted",
+	"Provider.RsslReconnect",
+	"Provider.RsslCongestionDetected",
+	"Provider.RsslSlowReader",
+	"Provider.RsslPacketGapDetected",
+	"Provider.RsslReadFailure",
+	"Provider.ClientInitException",
+	"Provider.DirectoryMapException",
+	"Provider.RsslPingException",
+	"Provider.RsslPingFlushFailed",
+	"Provider.RsslPingNoBuffers",
+	"Provider.RsslWriteException",
+	"Provider.RsslWriteFlushFailed",
+	"Provider.RsslWriteNoBuffers",
+};
+
+const char* const hitsuji::kClientStatsNames[] = {
+	"Client.RsslMsgsSent",
+	"Client.RsslPackedMsgs",
+	"Client.RsslMsgsReceived",
+	"Client.RsslMsgsRejected",
+	"Client.RequestMsgsReceived",
+	"Client.RequestMsgsRejected",
+	"Client.CloseMsgsReceived",
+	"Client.CloseMsgsDiscarded",
+	"Client.MmtLoginReceived",
+	"Client.MmtLoginMalformed",
+	"Client.MmtLoginRejected",
+	"Client.MmtLoginAccepted",
+	"Client.MmtLoginResponseValidated",
+	"Client.MmtLoginResponseMalformed",
+	"Client.MmtLoginException",
+	"Client.MmtLoginCloseReceived",
+	"Client.MmtDirectoryRequestReceived",
+	"Client.MmtDirectoryValidated",
+	"Client.MmtDirectoryMalformed",
+	"Client.MmtDirectorySent",
+	"Client.MmtDirectoryException",
+	"Client.MmtDirectoryCloseReceived",
+	"Client.MmtDictionaryRequestReceived",
+	"Client.MmtDictionaryCloseReceived",
+	"Client.ItemRequestReceived",
+	"Client.ItemRequestMalformed",
+	"Client.ItemRequestBeforeLogin",
+	"Client.ItemStreamingRequestReceived",
+	"Client.ItemReissueRequestReceived",
+	"Client.ItemSnapshotRequestReceived",
+	"Client.ItemViewRequestReceived",
+	"Client.ItemRequestRejected",
+	"Client.ItemValidated",
+	"Client.ItemMalformed",
+	"Client.ItemNotFound",
+	"Client.ItemSent",
+	"Client.ItemClosed",
+	"Client.ItemException",
+	"Client.ItemCloseReceived",
+	"Client.ItemCloseMalformed",
+	"Client.ItemCloseValidated",
+	"Client.OmmInactiveClientSessionReceived",
+	"Client.OmmInactiveClientSessionException",
+	"Client.ReplyQueued",
+	"Client.ReplyConflated",
+	"Client.ReplyDiscarded",
+	"Client.QueueOverflow",
+	"Client.QueueStreamClosed",
+	"Client.QueueTimeMs",
+};
+
+const char* const hitsuji::kAcceptorStatsNames[] = {
+	"Acceptor.ConnectionReceived",
+	"Acceptor.ConnectionRejected",
+	"Acceptor.ConnectionAccepted",
+	"Acceptor.ConnectionHandedOver",
+	"Acceptor.RsslProtocolDowngrade",
+	"Acceptor.HandshakeException",
+	"Acceptor.HandshakeTimeout",
+};
+
+const char* const hitsuji::kWorkerStatsNames[] = {
+	"Worker.TaskReceived",
+	"Worker.TaskMalformed",
+	"Worker.TaskNotFound",
+	"Worker.TaskNotEntitled",
+	"Worker.TaskFailed",
+	"Worker.BatchCalculated",
+	"Worker.ReplySent",
+	"Worker.BarRequest",
+	"Worker.RollupBarRequest",
+	"Worker.CloseRequest",
+	"Worker.TestRequest",
+	"Worker.BusyTimeUs",
+	"Worker.QueueWaitUs",
+};
+
+const char* const hitsuji::kCacheStatsNames[] = {
+	"Cache.PermDataHits",
+	"Cache.PermDataMisses",
+	"Cache.PermDataSavedMs",
+	"Cache.SymbolHits",
+	"Cache.SymbolNegativeHits",
+	"Cache.SymbolEngineLookups",
+};
+
+static_assert (hitsuji::PROVIDER_PC_MAX == sizeof (hitsuji::kProviderStatsNames) / sizeof (hitsuji::kProviderStatsNames[0]), "provider row names");
+static_assert (hitsuji::CLIENT_PC_MAX == sizeof (hitsuji::kClientStatsNames) / sizeof (hitsuji::kClientStatsNames[0]), "client row names");
+static_assert (hitsuji::ACCEPTOR_PC_MAX == sizeof (hitsuji::kAcceptorStatsNames) / sizeof (hitsuji::kAcceptorStatsNames[0]), "acceptor row names");
+static_assert (hitsuji::WORKER_PC_MAX == sizeof (hitsuji::kWorkerStatsNames) / sizeof (hitsuji::kWorkerStatsNames[0]), "worker row names");
+static_assert (hitsuji::CACHE_PC_MAX == sizeof (hitsuji::kCacheStatsNames) / sizeof (hitsuji::kCacheStatsNames[0]), "cache row names");
+static_assert (hitsuji::PROVIDER_PC_MAX + hitsuji::CLIENT_PC_MAX + hitsuji::ACCEPTOR_PC_MAX + hitsuji::WORKER_PC_MAX + hitsuji::CACHE_PC_MAX <= hitsuji::kStatsMaxCounters, "stats table rows");
+
+namespace {
+
+/* Table shared by every instance, only locked to open and share it. */
+boost::mutex g_stats_table_lock;
+std::weak_ptr<chromium::StatsTable> g_stats_table;
+std::string g_stats_table_name;
+
+} /* anonymous namespace */
+
+std::shared_ptr<chromium::StatsTable>
+hitsuji::AcquireStatsTable (
+	const std::string& name
+	)
+{
+	boost::lock_guard<boost::mutex> lock (g_stats_table_lock);
+	std::shared_ptr<chromium::StatsTable> table (g_stats_table.lock());
+	if ((bool)table) {
+		LOG_IF(WARNING, !name.empty() && name != g_stats_table_name) << "StatsTable \"" << name << "\" ignored, sharing \"" << g_stats_table_name << "\".";
+		return table;
+	}
+	if (name.empty())
+		return table;
+/* The destructor clears the current table only if it is still this one. */
+	table.reset (new chromium::StatsTable (name, kStatsMaxThreads, kStatsMaxCounters));
+	chromium::StatsTable::set_current (table.get());
+	g_stats_table = table;
+	g_stats_table_name = name;
+	LOG(INFO) << "StatsTable: { "
+		  "\"name\": \"" << name << "\""
+		", \"maxThreads\": " << table->GetMaxThreads() <<
+		", \"maxCounters\": " << table->GetMaxCounters() <<
+		" }";
+	return table;
+}
+
+int
+hitsuji::RegisterStatsThread (
+	const std::string& name
+	)
+{
+	chromium::StatsTable* table = chromium::StatsTable::current();
+	if (nullptr == table)
+		return 0;
+	int slot = table->GetSlot();
+	if (0 == slot) {
+		slot = table->RegisterThread (name);
+		LOG_IF(WARNING, 0 == slot) << "StatsTable full, \"" << name << "\" is not exported.";
+	}
+	return slot;
+}
+
+/* eof */
\ No newline at end of file
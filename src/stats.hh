@@ -0,0 +1,103 @@
+/* Performance counters exported to a named shared-memory StatsTable.
+ *
+ * Each event loop, worker and the acceptor claims its own column of the table and copies
+ * its counters in with plain stores, so external monitoring needs no lock and no round
+ * trip into the serving process.  A reader, such as HitsujiStats, sums each row over the
+ * columns.  Table cells are 32-bit, the low half of each counter is stored and readers
+ * take rates from the difference modulo 2^32.
+ */
+
+#ifndef STATS_HH_
+#define STATS_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "chromium/metrics/stats_table.hh"
+#include "counters.hh"
+
+namespace hitsuji
+{
+/* Table dimensions, a reader must open the table with the same values. */
+	enum {
+		kStatsMaxThreads = 64,
+		kStatsMaxCounters = 256
+	};
+
+/* Performance Counters: caches shared by all workers. */
+	enum {
+		CACHE_PC_PERMDATA_HITS,
+		CACHE_PC_PERMDATA_MISSES,
+		CACHE_PC_PERMDATA_SAVED_MS,
+		CACHE_PC_SYMBOL_HITS,
+		CACHE_PC_SYMBOL_NEGATIVE_HITS,
+		CACHE_PC_SYMBOL_ENGINE_LOOKUPS,
+/* marker */
+		CACHE_PC_MAX
+	};
+
+/* Row names indexed by each counter enumeration, e.g. "Provider.RsslMsgsReceived". */
+	extern const char* const kProviderStatsNames[];
+	extern const char* const kClientStatsNames[];
+	extern const char* const kAcceptorStatsNames[];
+	extern const char* const kWorkerStatsNames[];
+	extern const char* const kCacheStatsNames[];
+
+/* Open the process-wide table and make it current, or share the table already open.  Every
+ * instance holds a reference while its threads may export, the table is unmapped and
+ * cleared as current with the last one.  An empty name only shares an open table, a
+ * differing name is ignored.
+ */
+	std::shared_ptr<chromium::StatsTable> AcquireStatsTable (const std::string& name);
+
+/* Claim a column of the current table for the calling thread.  Returns the slot, or 0
+ * when export is disabled or the table is full.
+ */
+	int RegisterStatsThread (const std::string& name);
+
+/* One counter set within the column of its owning thread. */
+	template <size_t N>
+	class stats_rows_t
+	{
+	public:
+		stats_rows_t() {
+			for (size_t i = 0; i < N; ++i)
+				locations_[i] = nullptr;
+		}
+
+/* Find or add each row, on the owning thread after RegisterStatsThread. */
+		void Bind (int slot, const char* const* names) {
+			chromium::StatsTable* table = chromium::StatsTable::current();
+			if (nullptr == table || 0 == slot)
+				return;
+			for (size_t i = 0; i < N; ++i) {
+				const int counter_id = table->FindCounter (names[i]);
+				locations_[i] = (0 == counter_id) ? nullptr : table->GetLocation (counter_id, slot);
+			}
+		}
+
+		void Publish (const counters_t<N>& counters) {
+			for (size_t i = 0; i < N; ++i)
+				Set (i, counters[i]);
+		}
+		void Publish (const uint64_t (&values)[N]) {
+			for (size_t i = 0; i < N; ++i)
+				Set (i, values[i]);
+		}
+
+	private:
+		void Set (size_t i, uint64_t value) {
+			if (nullptr != locations_[i])
+				*locations_[i] = static_cast<int> (static_cast<uint32_t> (value));
+		}
+
+		int* locations_[N];
+	};
+
+} /* namespace hitsuji */
+
+#endif /* STATS_HH_ */
+
+/* eof */
\ No newline at end of file
@@ -0,0 +1,72 @@
+/* Live view of a Hitsuji shared-memory stats table.
+ *
+ *	HitsujiStats [table name] [interval in milliseconds]
+ *
+ * Prints every non-zero row with its total over all exporting threads and its rate per
+ * second over the last interval.  Reads take no lock in the serving process.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+/* Boost threading */
+#include <boost/thread.hpp>
+
+#include "chromium/metrics/stats_table.hh"
+#include "stats.hh"
+
+int
+main (
+	int		argc,
+	const char*	argv[]
+	)
+{
+	const std::string name ((argc > 1) ? argv[1] : "Hitsuji");
+	const unsigned interval_ms = (argc > 2) ? static_cast<unsigned> (atoi (argv[2])) : 1000;
+	if (0 == interval_ms) {
+		fprintf (stderr, "usage: %s [table name] [interval in milliseconds]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+/* Same dimensions as the serving process, otherwise the mapping is misread. */
+	chromium::StatsTable table (name, hitsuji::kStatsMaxThreads, hitsuji::kStatsMaxCounters);
+	if (0 == table.GetMaxCounters()) {
+		fprintf (stderr, "Cannot open stats table \"%s\".\n", name.c_str());
+		return EXIT_FAILURE;
+	}
+/* First rates are over the first interval, not since the server started. */
+	std::vector<uint32_t> last (table.GetMaxCounters() + 1, 0);
+	for (int index = 1; index <= table.GetMaxCounters(); ++index)
+		last[index] = static_cast<uint32_t> (table.GetRowValue (index));
+	auto last_time = boost::chrono::steady_clock::now();
+	for (;;) {
+		boost::this_thread::sleep_for (boost::chrono::milliseconds (interval_ms));
+		const auto now = boost::chrono::steady_clock::now();
+		const double seconds = boost::chrono::duration<double> (now - last_time).count();
+		last_time = now;
+		printf ("%s: %d threads\n", name.c_str(), table.CountThreadsRegistered());
+/* Rows are numbered from 1, an empty name is an unused row. */
+		for (int index = 1; index <= table.GetMaxCounters(); ++index) {
+			const char* row_name = table.GetRowName (index);
+			if (nullptr == row_name || '\0' == *row_name)
+				continue;
+/* Cells hold the low 32 bits, unsigned difference is correct across wrap. */
+			const uint32_t value = static_cast<uint32_t> (table.GetRowValue (index));
+			const uint32_t delta = value - last[index];
+			last[index] = value;
+			if (0 == value)
+				continue;
+			printf ("  %-48s %12u %12.1f/s\n", row_name, value, delta / seconds);
+		}
+		printf ("\n");
+		fflush (stdout);
+	}
+	return EXIT_SUCCESS;
+}
+
+/* eof */
\ No newline at end of file
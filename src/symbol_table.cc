@@ -0,0 +1,316 @@
+/* Symbol name to SearchEngine handle table with negative caching of unknown names.
+ */
+
+#include "symbol_table.hh"
+
+#include <fstream>
+#include <unordered_set>
+
+#include "chromium/logging.hh"
+
+/* Names beyond this length cannot be SearchEngine symbols. */
+static const size_t kMaxSymbolLength		= 256;
+/* Bound on symbols learnt between refreshes. */
+static const size_t kMaxPendingSymbols		= 4096;
+
+/* FNV-1a, 64-bit. */
+static
+uint64_t
+HashSymbol (
+	const chromium::StringPiece& symbol_name
+	)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < symbol_name.size(); ++i) {
+		hash ^= static_cast<uint8_t> (symbol_name[i]);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+namespace vhayu
+{
+/* Open addressing table with names packed into one buffer, lookups do not allocate. */
+	class flat_symbol_map_t
+	{
+	public:
+		explicit flat_symbol_map_t (const std::vector<std::pair<std::string, TBSymbolHandle>>& symbols)
+			: size_ (0)
+		{
+			size_t capacity = 16;
+			while (capacity < symbols.size() * 2)
+				capacity <<= 1;
+			slots_.resize (capacity);
+			mask_ = capacity - 1;
+			for (auto it = symbols.begin(); it != symbols.end(); ++it) {
+				if (it->first.empty())
+					continue;
+				const uint64_t hash = HashSymbol (it->first);
+				size_t i = static_cast<size_t> (hash) & mask_;
+				while (0 != slots_[i].length) {
+					if (hash == slots_[i].hash && Name (slots_[i]) == it->first)
+						break;
+					i = (i + 1) & mask_;
+				}
+				if (0 != slots_[i].length)
+					continue;
+				slots_[i].hash = hash;
+				slots_[i].offset = static_cast<uint32_t> (names_.size());
+				slots_[i].length = static_cast<uint32_t> (it->first.size());
+				slots_[i].handle = it->second;
+				names_.append (it->first);
+				++size_;
+			}
+		}
+
+		bool Find (const chromium::StringPiece& symbol_name, uint64_t hash, TBSymbolHandle* handle) const {
+			size_t i = static_cast<size_t> (hash) & mask_;
+			while (0 != slots_[i].length) {
+				if (hash == slots_[i].hash && Name (slots_[i]) == symbol_name) {
+					*handle = slots_[i].handle;
+					return true;
+				}
+				i = (i + 1) & mask_;
+			}
+			return false;
+		}
+
+		size_t size() const { return size_; }
+
+/* Append all entries, for comparison with a replacement table. */
+		void Export (std::vector<std::pair<std::string, TBSymbolHandle>>* symbols) const {
+			for (auto it = slots_.begin(); it != slots_.end(); ++it) {
+				if (0 != it->length)
+					symbols->push_back (std::make_pair (Name (*it).as_string(), it->handle));
+			}
+		}
+
+	private:
+		struct slot_t
+		{
+			slot_t() : hash (0), offset (0), length (0) {}
+			uint64_t hash;
+			uint32_t offset;
+			uint32_t length;
+			TBSymbolHandle handle;
+		};
+
+		chromium::StringPiece Name (const slot_t& slot) const {
+			return chromium::StringPiece (names_.data() + slot.offset, slot.length);
+		}
+
+		std::string names_;
+		std::vector<slot_t> slots_;
+		size_t mask_;
+		size_t size_;
+	};
+
+} /* namespace vhayu */
+
+vhayu::symbol_table_t::symbol_table_t (
+	const std::string& symbol_map,
+	const boost::chrono::seconds& refresh_interval,
+	size_t negative_cache_size,
+	const std::function<void (const TBSymbolHandle&)>& on_evict
+	)
+	: symbol_map_ (symbol_map)
+	, refresh_interval_ (refresh_interval)
+	, on_evict_ (on_evict)
+	, negative_cache_ (negative_cache_size)
+	, refresh_shutdown_ (false)
+	, hits_ (0)
+	, negative_hits_ (0)
+	, engine_lookups_ (0)
+{
+}
+
+vhayu::symbol_table_t::~symbol_table_t()
+{
+	Reset();
+}
+
+bool
+vhayu::symbol_table_t::Initialize()
+{
+	if (!Refresh())
+		return false;
+	if (refresh_interval_.count() > 0) {
+		refresh_thread_.reset (new boost::thread ([this]() {
+			RefreshLoop();
+		}));
+	}
+	return true;
+}
+
+void
+vhayu::symbol_table_t::Reset()
+{
+	if ((bool)refresh_thread_) {
+		{
+			boost::lock_guard<boost::mutex> lock (refresh_lock_);
+			refresh_shutdown_ = true;
+			refresh_cond_.notify_one();
+		}
+		refresh_thread_->join();
+		refresh_thread_.reset();
+	}
+}
+
+void
+vhayu::symbol_table_t::RefreshLoop()
+{
+	boost::unique_lock<boost::mutex> lock (refresh_lock_);
+	while (!refresh_shutdown_) {
+		refresh_cond_.wait_for (lock, refresh_interval_);
+		if (refresh_shutdown_)
+			break;
+		lock.unlock();
+		Refresh();
+		lock.lock();
+	}
+}
+
+/* Rebuild the table from the symbol map file and symbols learnt on demand, each checked
+ * against the SearchEngine inventory so that delisted symbols are evicted.  Engine calls are
+ * made here, off the request path.  Symbols learnt since the last refresh are drained only
+ * once the replacement table is built, a failed refresh keeps them for the next.
+ *
+ * Returns false on error, true on success.
+ */
+bool
+vhayu::symbol_table_t::Refresh()
+{
+	std::vector<std::pair<std::string, TBSymbolHandle>> symbols;
+	if (!symbol_map_.empty()) {
+		std::ifstream file (symbol_map_);
+		if (!file) {
+			LOG(ERROR) << "Cannot open symbol map \"" << symbol_map_ << "\".";
+			return false;
+		}
+		std::string line;
+		while (std::getline (file, line)) {
+			const size_t begin = line.find_first_not_of (" \t\r");
+			if (std::string::npos == begin || '#' == line[begin])
+				continue;
+			const size_t end = line.find_last_not_of (" \t\r");
+			const std::string symbol_name (line, begin, end - begin + 1);
+#ifndef CONFIG_AS_APPLICATION
+			if (0 == TBPrimitives::IsSymbolExists (symbol_name.c_str())) {
+				LOG(WARNING) << "Symbol map entry \"" << symbol_name << "\" not found in SearchEngine.";
+				continue;
+			}
+#endif
+			symbols.push_back (std::make_pair (symbol_name, TBPrimitives::GetSymbolHandle (symbol_name.c_str(), 0)));
+		}
+	}
+/* Learnt symbols: those kept by the previous refresh, then those found since. */
+	std::vector<std::pair<std::string, TBSymbolHandle>> candidates (learnt_);
+	size_t pending_count;
+	{
+		boost::lock_guard<boost::mutex> lock (pending_lock_);
+		candidates.insert (candidates.end(), pending_.begin(), pending_.end());
+		pending_count = pending_.size();
+	}
+	std::unordered_set<std::string> names;
+	for (auto it = symbols.begin(); it != symbols.end(); ++it)
+		names.insert (it->first);
+	std::vector<std::pair<std::string, TBSymbolHandle>> learnt;
+	for (auto it = candidates.begin(); it != candidates.end(); ++it) {
+		if (!names.insert (it->first).second)
+			continue;
+#ifndef CONFIG_AS_APPLICATION
+		if (0 == TBPrimitives::IsSymbolExists (it->first.c_str()))
+			continue;
+#endif
+		learnt.push_back (std::make_pair (it->first, TBPrimitives::GetSymbolHandle (it->first.c_str(), 0)));
+	}
+	symbols.insert (symbols.end(), learnt.begin(), learnt.end());
+	auto table = std::make_shared<const flat_symbol_map_t> (symbols);
+	std::shared_ptr<const flat_symbol_map_t> previous (table);
+	{
+		boost::unique_lock<boost::shared_mutex> lock (table_lock_);
+		table_.swap (previous);
+	}
+	learnt_.swap (learnt);
+	{
+		boost::lock_guard<boost::mutex> lock (pending_lock_);
+		pending_.erase (pending_.begin(), pending_.begin() + pending_count);
+	}
+/* Handles of symbols no longer listed. */
+	size_t evicted = 0;
+	if ((bool)previous) {
+		std::vector<std::pair<std::string, TBSymbolHandle>> dropped;
+		previous->Export (&dropped);
+		for (auto it = dropped.begin(); it != dropped.end(); ++it) {
+			TBSymbolHandle handle;
+			if (table->Find (it->first, HashSymbol (it->first), &handle))
+				continue;
+			++evicted;
+			if ((bool)on_evict_)
+				on_evict_ (it->second);
+		}
+	}
+/* Listings may have appeared since names were rejected. */
+	{
+		boost::lock_guard<boost::mutex> lock (negative_cache_lock_);
+		negative_cache_.Clear();
+	}
+	LOG(INFO) << "SymbolTable: { "
+		  "\"size\": " << table->size() << ""
+		", \"learnt\": " << learnt_.size() << ""
+		", \"evicted\": " << evicted << ""
+		", \"hits\": " << hits() << ""
+		", \"negativeHits\": " << negative_hits() << ""
+		", \"engineLookups\": " << engine_lookups() << ""
+		" }";
+	return true;
+}
+
+bool
+vhayu::symbol_table_t::Lookup (
+	const chromium::StringPiece& symbol_name,
+	TBSymbolHandle* handle
+	)
+{
+	if (symbol_name.empty() || symbol_name.size() >= kMaxSymbolLength)
+		return false;
+	const uint64_t hash = HashSymbol (symbol_name);
+/* Known symbols */
+	{
+		boost::shared_lock<boost::shared_mutex> lock (table_lock_);
+		if (table_->Find (symbol_name, hash, handle)) {
+			hits_++;
+			return true;
+		}
+	}
+/* Recently rejected symbols */
+	{
+		boost::lock_guard<boost::mutex> lock (negative_cache_lock_);
+		auto it = negative_cache_.Get (hash);
+		if (negative_cache_.end() != it && symbol_name == it->second) {
+			negative_hits_++;
+			return false;
+		}
+	}
+/* Fallback to engine with a NULL terminated copy */
+	char c_str[kMaxSymbolLength];
+	symbol_name.copy (c_str, symbol_name.size());
+	c_str[symbol_name.size()] = '\0';
+	engine_lookups_++;
+#ifndef CONFIG_AS_APPLICATION
+	if (0 == TBPrimitives::IsSymbolExists (c_str)) {
+		boost::lock_guard<boost::mutex> lock (negative_cache_lock_);
+		negative_cache_.Put (hash, symbol_name.as_string());
+		return false;
+	}
+#endif
+	*handle = TBPrimitives::GetSymbolHandle (c_str, 0);
+	{
+		boost::lock_guard<boost::mutex> lock (pending_lock_);
+		if (pending_.size() < kMaxPendingSymbols)
+			pending_.push_back (std::make_pair (symbol_name.as_string(), *handle));
+	}
+	return true;
+}
+
+/* eof */
@@ -0,0 +1,91 @@
+/* Symbol name to SearchEngine handle table with negative caching of unknown names.
+ */
+
+#ifndef SYMBOL_TABLE_HH_
+#define SYMBOL_TABLE_HH_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* Boost Atomics */
+#include <boost/atomic.hpp>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+/* Boost threading. */
+#include <boost/thread.hpp>
+
+/* Velocity Analytics Plugin Framework */
+#include <vpf/vpf.h>
+#include <TBPrimitives.h>
+
+#include "chromium/memory/mru_cache.hh"
+#include "chromium/string_piece.hh"
+
+namespace vhayu
+{
+	class flat_symbol_map_t;
+
+	class symbol_table_t
+	{
+	public:
+/* symbol_map names a file of one symbol per line, empty to learn symbols on demand.  Learnt
+ * symbols are folded into the table every refresh_interval, on_evict is called with the
+ * handle of each symbol a refresh drops.
+ */
+		symbol_table_t (const std::string& symbol_map, const boost::chrono::seconds& refresh_interval, size_t negative_cache_size, const std::function<void (const TBSymbolHandle&)>& on_evict);
+		~symbol_table_t();
+
+		bool Initialize();
+		void Reset();
+
+/* Returns true and sets handle for a known symbol.  Unknown symbols are remembered and
+ * subsequently rejected without calling the engine until the next refresh.
+ */
+		bool Lookup (const chromium::StringPiece& symbol_name, TBSymbolHandle* handle);
+
+/* Statistics. */
+		uint64_t hits() const { return hits_.load(); }
+		uint64_t negative_hits() const { return negative_hits_.load(); }
+		uint64_t engine_lookups() const { return engine_lookups_.load(); }
+
+	private:
+		bool Refresh();
+		void RefreshLoop();
+
+		const std::string symbol_map_;
+		const boost::chrono::seconds refresh_interval_;
+		const std::function<void (const TBSymbolHandle&)> on_evict_;
+
+/* Immutable table, replaced wholesale on refresh. */
+		std::shared_ptr<const flat_symbol_map_t> table_;
+		boost::shared_mutex table_lock_;
+/* Bounded set of unknown names keyed by hash, payload name to reject collisions. */
+		chromium::HashingMRUCache<uint64_t, std::string> negative_cache_;
+		boost::mutex negative_cache_lock_;
+/* Symbols found via the engine since the last refresh. */
+		std::vector<std::pair<std::string, TBSymbolHandle>> pending_;
+		boost::mutex pending_lock_;
+/* Learnt symbols still listed at the last refresh, owned by the refreshing thread. */
+		std::vector<std::pair<std::string, TBSymbolHandle>> learnt_;
+
+/* Background refresh thread. */
+		std::unique_ptr<boost::thread> refresh_thread_;
+		boost::condition_variable refresh_cond_;
+		boost::mutex refresh_lock_;
+		bool refresh_shutdown_;
+
+		boost::atomic<uint64_t> hits_;
+		boost::atomic<uint64_t> negative_hits_;
+		boost::atomic<uint64_t> engine_lookups_;
+	};
+
+} /* namespace vhayu */
+
+#endif /* SYMBOL_TABLE_HH_ */
+
+/* eof */
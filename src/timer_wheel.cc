@@ -0,0 +1,211 @@
+/* Hierarchical timer wheel.
+ */
+
+#include "timer_wheel.hh"
+
+#include <climits>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#	include <intrin.h>
+#endif
+
+#include "chromium/logging.hh"
+
+/* Index of lowest set bit, value must be non-zero. */
+static inline
+unsigned
+lowest_bit (
+	uint64_t value
+	)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64 (&index, value);
+	return static_cast<unsigned> (index);
+#else
+	return static_cast<unsigned> (__builtin_ctzll (value));
+#endif
+}
+
+/* Rotate right so bit n becomes bit zero. */
+static inline
+uint64_t
+rotate_right (
+	uint64_t value,
+	unsigned n
+	)
+{
+	n &= 63;
+	return (0 == n) ? value : ((value >> n) | (value << (64 - n)));
+}
+
+hitsuji::timer_wheel_t::timer_wheel_t()
+	: now_ (0)
+	, size_ (0)
+{
+	memset (slots_, 0, sizeof (slots_));
+	memset (occupied_, 0, sizeof (occupied_));
+}
+
+void
+hitsuji::timer_wheel_t::Initialize (
+	uint64_t now
+	)
+{
+	DCHECK_EQ (0U, size_);
+	now_ = now;
+}
+
+void
+hitsuji::timer_wheel_t::Schedule (
+	entry_t* entry,
+	uint64_t expiry
+	)
+{
+	DCHECK (nullptr != entry);
+	if (entry->is_scheduled)
+		Unlink (entry);
+/* Current level zero slot has already fired this tick. */
+	entry->expiry = (expiry > now_) ? expiry : now_ + 1;
+	Insert (entry);
+}
+
+void
+hitsuji::timer_wheel_t::Cancel (
+	entry_t* entry
+	)
+{
+	DCHECK (nullptr != entry);
+	if (entry->is_scheduled)
+		Unlink (entry);
+}
+
+/* File by distance to expiry: level n holds deltas below 64^(n+1), slot indexed by the
+ * expiry bits of that level so a slot cascades exactly when its range begins.
+ */
+void
+hitsuji::timer_wheel_t::Insert (
+	entry_t* entry
+	)
+{
+	static const uint64_t kMaxDelta = (UINT64_C(1) << (kLevelBits * kLevels)) - 1;
+	const uint64_t delta = (entry->expiry > now_) ? (entry->expiry - now_) : 0;
+/* Beyond range: park at the furthest slot, re-filed on cascade. */
+	const uint64_t expiry = (delta > kMaxDelta) ? (now_ + kMaxDelta) : entry->expiry;
+	const uint64_t clamped = (delta > kMaxDelta) ? kMaxDelta : delta;
+	unsigned level = 0;
+	while (level < kLevels - 1 && clamped >= (UINT64_C(1) << (kLevelBits * (level + 1))))
+		++level;
+	const unsigned slot = static_cast<unsigned> ((expiry >> (kLevelBits * level)) & (kSlots - 1));
+	entry->level = level;
+	entry->slot = slot;
+	entry->prev = nullptr;
+	entry->next = slots_[level][slot];
+	if (nullptr != entry->next)
+		entry->next->prev = entry;
+	slots_[level][slot] = entry;
+	occupied_[level] |= UINT64_C(1) << slot;
+	entry->is_scheduled = true;
+	++size_;
+}
+
+void
+hitsuji::timer_wheel_t::Unlink (
+	entry_t* entry
+	)
+{
+	if (nullptr != entry->prev)
+		entry->prev->next = entry->next;
+	else
+		slots_[entry->level][entry->slot] = entry->next;
+	if (nullptr != entry->next)
+		entry->next->prev = entry->prev;
+	if (nullptr == slots_[entry->level][entry->slot])
+		occupied_[entry->level] &= ~(UINT64_C(1) << entry->slot);
+	entry->prev = entry->next = nullptr;
+	entry->is_scheduled = false;
+	--size_;
+}
+
+/* Re-file the slot of this level whose range starts now. */
+void
+hitsuji::timer_wheel_t::Cascade (
+	unsigned level
+	)
+{
+	const unsigned slot = static_cast<unsigned> ((now_ >> (kLevelBits * level)) & (kSlots - 1));
+	entry_t* entry = slots_[level][slot];
+	slots_[level][slot] = nullptr;
+	occupied_[level] &= ~(UINT64_C(1) << slot);
+	while (nullptr != entry) {
+		entry_t* next = entry->next;
+		--size_;
+		Insert (entry);
+		entry = next;
+	}
+}
+
+void
+hitsuji::timer_wheel_t::Advance (
+	uint64_t now,
+	std::vector<entry_t*>* expired
+	)
+{
+	while (now_ < now) {
+/* Skip to the next boundary of the lowest occupied level. */
+		unsigned empty_levels = 0;
+		while (empty_levels < kLevels && 0 == occupied_[empty_levels])
+			++empty_levels;
+		if (kLevels == empty_levels) {
+			now_ = now;
+			break;
+		}
+		const uint64_t step = UINT64_C(1) << (kLevelBits * empty_levels);
+		const uint64_t next = (0 == empty_levels) ? (now_ + 1) : ((now_ | (step - 1)) + 1);
+		if (next > now) {
+			now_ = now;
+			break;
+		}
+		now_ = next;
+		for (unsigned level = 1; level < kLevels; ++level) {
+			if (0 != (now_ & ((UINT64_C(1) << (kLevelBits * level)) - 1)))
+				break;
+			Cascade (level);
+		}
+/* Level zero slot holds a single expiry. */
+		const unsigned slot = static_cast<unsigned> (now_ & (kSlots - 1));
+		while (nullptr != slots_[0][slot]) {
+			entry_t* entry = slots_[0][slot];
+			Unlink (entry);
+			if (entry->expiry > now_)
+				Insert (entry);
+			else
+				expired->push_back (entry);
+		}
+	}
+}
+
+int
+hitsuji::timer_wheel_t::NextTimeout() const
+{
+	if (0 == size_)
+		return -1;
+	uint64_t next = UINT64_MAX;
+	for (unsigned level = 0; level < kLevels; ++level) {
+		if (0 == occupied_[level])
+			continue;
+		const unsigned shift = kLevelBits * level;
+		const uint64_t current = now_ >> shift;
+/* Slots after the current one, wrapping round to it last. */
+		const unsigned distance = lowest_bit (rotate_right (occupied_[level], static_cast<unsigned> (current + 1))) + 1;
+		const uint64_t start = (current + distance) << shift;
+		if (start < next)
+			next = start;
+	}
+	DCHECK_GT (next, now_);
+	const uint64_t timeout = next - now_;
+	return (timeout > INT_MAX) ? INT_MAX : static_cast<int> (timeout);
+}
+
+/* eof */
\ No newline at end of file
@@ -0,0 +1,86 @@
+/* Hierarchical timer wheel.
+ *
+ * Four levels of 64 slots over millisecond ticks, a range of 2^24 ms (4.6 hours), longer
+ * deadlines are parked in the top level and re-filed as they approach.  Schedule and Cancel
+ * are O(1) on intrusive entries, Advance is O(expired) plus one cascade per level boundary
+ * crossed, and empty stretches are skipped using per level occupancy bitmaps.
+ *
+ * Not thread-safe, owned by one event loop.
+ */
+
+#ifndef TIMER_WHEEL_HH_
+#define TIMER_WHEEL_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hitsuji
+{
+	class timer_wheel_t
+	{
+	public:
+/* Intrusive timer, embedded in its owner and cancelled before the owner is destroyed. */
+		struct entry_t {
+			entry_t() : prev (nullptr), next (nullptr), expiry (0), level (0), slot (0), is_scheduled (false), type (0), context (nullptr) {}
+
+			entry_t* prev;
+			entry_t* next;
+			uint64_t expiry;
+			unsigned level;
+			unsigned slot;
+			bool is_scheduled;
+/* Caller defined dispatch. */
+			unsigned type;
+			void* context;
+		};
+
+		timer_wheel_t();
+
+/* Start ticking from now, in milliseconds of a monotonic clock. */
+		void Initialize (uint64_t now);
+
+/* (Re-)schedule entry to expire at the given tick, past deadlines expire on the next tick. */
+		void Schedule (entry_t* entry, uint64_t expiry);
+		void Cancel (entry_t* entry);
+
+/* Move time forward, appending entries that expired.  Expired entries are unscheduled and may
+ * be scheduled again by the caller.
+ */
+		void Advance (uint64_t now, std::vector<entry_t*>* expired);
+
+/* Milliseconds until the next expiry or cascade, -1 when empty.  An earlier wake for a
+ * cascade re-files entries so the following timeout is exact.
+ */
+		int NextTimeout() const;
+
+		uint64_t now() const {
+			return now_;
+		}
+		size_t size() const {
+			return size_;
+		}
+
+	private:
+		enum {
+			kLevelBits	= 6,
+			kSlots		= 1 << kLevelBits,
+			kLevels		= 4
+		};
+
+		void Insert (entry_t* entry);
+		void Unlink (entry_t* entry);
+		void Cascade (unsigned level);
+
+		entry_t* slots_[kLevels][kSlots];
+/* Non-empty slots per level. */
+		uint64_t occupied_[kLevels];
+		uint64_t now_;
+		size_t size_;
+	};
+
+} /* namespace hitsuji */
+
+#endif /* TIMER_WHEEL_HH_ */
+
+/* eof */
\ No newline at end of file
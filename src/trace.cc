@@ -0,0 +1,219 @@
+/* Binary trace events in per-thread rings.
+ */
+
+#include "trace.hh"
+
+#if defined(_WIN32)
+#	include <windows.h>
+#else
+#	include <sys/syscall.h>
+#	include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+/* Boost threading */
+#include <boost/thread.hpp>
+
+#include "chromium/logging.hh"
+
+namespace {
+
+/* Rings of every tracing thread, only locked to register, dump and reset. */
+boost::mutex g_rings_lock;
+std::vector<std::shared_ptr<hitsuji::trace_ring_t>> g_rings;
+
+/* Destination of a dump on fault, and installs not yet uninstalled. */
+std::string g_fault_path;
+unsigned g_fault_installs = 0;
+#if defined(_WIN32)
+LPTOP_LEVEL_EXCEPTION_FILTER g_previous_filter = nullptr;
+#endif
+
+uint32_t
+current_thread_id()
+{
+#if defined(_WIN32)
+	return static_cast<uint32_t> (GetCurrentThreadId());
+#else
+	return static_cast<uint32_t> (syscall (SYS_gettid));
+#endif
+}
+
+uint32_t
+current_process_id()
+{
+#if defined(_WIN32)
+	return static_cast<uint32_t> (GetCurrentProcessId());
+#else
+	return static_cast<uint32_t> (getpid());
+#endif
+}
+
+uint64_t
+round_up_power_of_two (
+	uint64_t value
+	)
+{
+	uint64_t result = 1;
+	while (result < value)
+		result <<= 1;
+	return result;
+}
+
+/* Caller holds g_rings_lock. */
+bool
+dump_locked (
+	const std::string& path
+	)
+{
+	FILE* fp = fopen (path.c_str(), "wb");
+	if (nullptr == fp)
+		return false;
+	hitsuji::trace_file_header_t header;
+	memset (&header, 0, sizeof (header));
+	memcpy (header.magic, "HITSUJI", sizeof ("HITSUJI"));
+	header.version = hitsuji::kTraceVersion;
+	header.record_size = sizeof (hitsuji::trace_record_t);
+	header.ring_count = static_cast<uint32_t> (g_rings.size());
+	header.process_id = current_process_id();
+	bool is_written = (1 == fwrite (&header, sizeof (header), 1, fp));
+	std::vector<hitsuji::trace_record_t> records;
+	for (auto it = g_rings.begin(); is_written && it != g_rings.end(); ++it) {
+		(*it)->Snapshot (&records);
+		hitsuji::trace_ring_header_t ring_header;
+		memset (&ring_header, 0, sizeof (ring_header));
+		strncpy (ring_header.name, (*it)->name().c_str(), sizeof (ring_header.name) - 1);
+		ring_header.thread_id = (*it)->thread_id();
+		ring_header.record_count = static_cast<uint32_t> (records.size());
+		is_written = (1 == fwrite (&ring_header, sizeof (ring_header), 1, fp));
+		if (is_written && !records.empty())
+			is_written = (records.size() == fwrite (&records[0], sizeof (records[0]), records.size(), fp));
+	}
+	return (0 == fclose (fp)) && is_written;
+}
+
+#if defined(_WIN32)
+/* Best effort, skipped if the fault interrupted a dump in progress. */
+LONG WINAPI
+fault_filter (
+	EXCEPTION_POINTERS* exception_info
+	)
+{
+	LPTOP_LEVEL_EXCEPTION_FILTER previous_filter = nullptr;
+	if (g_rings_lock.try_lock()) {
+		dump_locked (g_fault_path);
+		previous_filter = g_previous_filter;
+		g_rings_lock.unlock();
+	}
+	return (nullptr != previous_filter) ? previous_filter (exception_info) : EXCEPTION_CONTINUE_SEARCH;
+}
+#endif
+
+} /* anonymous namespace */
+
+hitsuji::trace_ring_t::trace_ring_t (
+	const std::string& name,
+	size_t capacity
+	)
+	: name_ (name)
+	, thread_id_ (current_thread_id())
+	, mask_ (round_up_power_of_two (capacity) - 1)
+	, records_ (new trace_record_t[mask_ + 1])
+	, head_ (0)
+{
+/* Touch every page now rather than on the request path. */
+	memset (records_.get(), 0, (mask_ + 1) * sizeof (trace_record_t));
+}
+
+void
+hitsuji::trace_ring_t::Snapshot (
+	std::vector<trace_record_t>* records
+	) const
+{
+	const uint64_t capacity = mask_ + 1;
+	const uint64_t first_head = head_.load (boost::memory_order_acquire);
+	const uint64_t first = (first_head > capacity) ? first_head - capacity : 0;
+	records->resize (static_cast<size_t> (first_head - first));
+	for (uint64_t sequence = first; sequence < first_head; ++sequence)
+		(*records)[static_cast<size_t> (sequence - first)] = records_[sequence & mask_];
+/* Records written meanwhile, including one in progress, have overwritten the oldest. */
+	const uint64_t last_head = head_.load (boost::memory_order_acquire);
+	const uint64_t overwritten = (last_head + 1 > first + capacity) ? (last_head + 1) - (first + capacity) : 0;
+	if (overwritten >= records->size()) {
+		records->clear();
+	} else if (overwritten > 0) {
+		records->erase (records->begin(), records->begin() + static_cast<size_t> (overwritten));
+	}
+}
+
+hitsuji::trace_ring_t*
+hitsuji::RegisterTraceRing (
+	const std::string& name,
+	size_t capacity
+	)
+{
+	if (0 == capacity)
+		return nullptr;
+	auto ring = std::make_shared<trace_ring_t> (name, capacity);
+	boost::lock_guard<boost::mutex> lock (g_rings_lock);
+	g_rings.push_back (ring);
+	return ring.get();
+}
+
+void
+hitsuji::UnregisterTraceRing (
+	trace_ring_t* ring
+	)
+{
+	if (nullptr == ring)
+		return;
+	boost::lock_guard<boost::mutex> lock (g_rings_lock);
+	g_rings.erase (std::remove_if (g_rings.begin(), g_rings.end(),
+		[ring](const std::shared_ptr<trace_ring_t>& it) { return it.get() == ring; }), g_rings.end());
+}
+
+bool
+hitsuji::DumpTraceRings (
+	const std::string& path
+	)
+{
+	boost::lock_guard<boost::mutex> lock (g_rings_lock);
+	const bool is_dumped = dump_locked (path);
+	LOG_IF(ERROR, !is_dumped) << "Failed to write trace dump \"" << path << "\".";
+	LOG_IF(INFO, is_dumped) << "TraceDump: { "
+		  "\"path\": \"" << path << "\""
+		", \"rings\": " << g_rings.size() <<
+		" }";
+	return is_dumped;
+}
+
+void
+hitsuji::InstallTraceFaultHandler (
+	const std::string& path
+	)
+{
+	boost::lock_guard<boost::mutex> lock (g_rings_lock);
+	g_fault_path = path;
+#if defined(_WIN32)
+	if (0 == g_fault_installs)
+		g_previous_filter = SetUnhandledExceptionFilter (fault_filter);
+#endif
+	++g_fault_installs;
+}
+
+void
+hitsuji::UninstallTraceFaultHandler()
+{
+	boost::lock_guard<boost::mutex> lock (g_rings_lock);
+	if (0 == g_fault_installs || 0 != --g_fault_installs)
+		return;
+#if defined(_WIN32)
+	SetUnhandledExceptionFilter (g_previous_filter);
+	g_previous_filter = nullptr;
+#endif
+}
+
+/* eof */
\ No newline at end of file
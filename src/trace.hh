@@ -0,0 +1,170 @@
+/* Binary trace events in per-thread rings.
+ *
+ * Each event loop and worker owns a fixed ring of 32-byte records and overwrites the
+ * oldest record without locking, so tracing can stay enabled in production.  Rings are
+ * dumped to one file on demand or on fault, and HitsujiTrace converts a dump to Chrome
+ * trace JSON for chrome://tracing.
+ *
+ * The file and record layouts are shared with the decoder, change kTraceVersion with them.
+ */
+
+#ifndef TRACE_HH_
+#define TRACE_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* Boost Atomics */
+#include <boost/atomic.hpp>
+
+namespace hitsuji
+{
+	enum {
+		kTraceVersion = 1,
+		kTraceMaxNameLength = 32
+	};
+
+	enum trace_event_e {
+		kTraceNone,
+		kTraceDispatch,		/* event loop: request read, encoded and queued */
+		kTraceParse,		/* worker: item name parsed */
+		kTraceLookup,		/* worker: symbol handle and PermData DACS lock */
+		kTraceFlexRecord,	/* worker: analytic calculation, one per batch */
+		kTraceEncode,		/* worker: response encoded */
+		kTraceSend,		/* worker: reply handed to the event loop */
+		kTraceWrite,		/* event loop: reply written or queued to the client */
+		kTraceFlush,		/* event loop: rsslFlush of a congested channel */
+		kTraceEventCount
+	};
+
+/* As Chrome trace phases. */
+	enum trace_phase_e {
+		kTraceBegin = 'B',
+		kTraceEnd = 'E',
+		kTraceInstant = 'i',
+		kTraceComplete = 'X'
+	};
+
+#pragma pack(push, 1)
+	struct trace_record_t
+	{
+		uint64_t timestamp;	/* monotonic nanoseconds, start of a complete event */
+		uint64_t handle;	/* client session, 0 if none */
+		uint32_t duration;	/* nanoseconds of a complete event, saturated */
+		int32_t token;		/* request stream, 0 if none */
+		uint16_t event;
+		uint8_t phase;
+		uint8_t reserved;
+		uint32_t value;		/* event argument, e.g. bytes or batch size */
+	};
+
+/* Dump file: header, then per ring a ring header followed by its records oldest first. */
+	struct trace_file_header_t
+	{
+		char magic[8];		/* "HITSUJI\0" */
+		uint32_t version;
+		uint32_t record_size;
+		uint32_t ring_count;
+		uint32_t process_id;
+	};
+
+	struct trace_ring_header_t
+	{
+		char name[kTraceMaxNameLength];
+		uint32_t thread_id;
+		uint32_t record_count;
+	};
+#pragma pack(pop)
+
+	static_assert (32 == sizeof (trace_record_t), "trace record size");
+
+	static inline
+	const char*
+	trace_event_name (unsigned event)
+	{
+		static const char* names[kTraceEventCount] = {
+			"None",
+			"Dispatch",
+			"Parse",
+			"Lookup",
+			"FlexRecord",
+			"Encode",
+			"Send",
+			"Write",
+			"Flush"
+		};
+		return (event < kTraceEventCount) ? names[event] : "Unknown";
+	}
+
+/* Single writer ring, readable by a dumping thread at any time. */
+	class trace_ring_t
+	{
+	public:
+/* Capacity in records is rounded up to a power of two. */
+		trace_ring_t (const std::string& name, size_t capacity);
+
+		void Add (trace_event_e event, trace_phase_e phase, uint64_t handle, int32_t token, uint64_t timestamp, uint64_t duration, uint32_t value) {
+			const uint64_t head = head_.load (boost::memory_order_relaxed);
+			trace_record_t& record = records_[head & mask_];
+			record.timestamp = timestamp;
+			record.handle = handle;
+			record.duration = (duration > UINT32_MAX) ? UINT32_MAX : static_cast<uint32_t> (duration);
+			record.token = token;
+			record.event = static_cast<uint16_t> (event);
+			record.phase = static_cast<uint8_t> (phase);
+			record.reserved = 0;
+			record.value = value;
+			head_.store (head + 1, boost::memory_order_release);
+		}
+/* Span from start to end, both monotonic nanoseconds. */
+		void Complete (trace_event_e event, uint64_t handle, int32_t token, uint64_t start, uint64_t end, uint32_t value = 0) {
+			Add (event, kTraceComplete, handle, token, start, (end > start) ? end - start : 0, value);
+		}
+		void Begin (trace_event_e event, uint64_t timestamp, uint32_t value = 0) {
+			Add (event, kTraceBegin, 0, 0, timestamp, 0, value);
+		}
+		void End (trace_event_e event, uint64_t timestamp, uint32_t value = 0) {
+			Add (event, kTraceEnd, 0, 0, timestamp, 0, value);
+		}
+
+/* Copy out the records not overwritten during the copy, oldest first. */
+		void Snapshot (std::vector<trace_record_t>* records) const;
+
+		const std::string& name() const {
+			return name_;
+		}
+		uint32_t thread_id() const {
+			return thread_id_;
+		}
+
+	private:
+		const std::string name_;
+		const uint32_t thread_id_;
+		const uint64_t mask_;
+		std::unique_ptr<trace_record_t[]> records_;
+/* Records ever written, the next slot is head & mask. */
+		boost::atomic<uint64_t> head_;
+	};
+
+/* Create a ring for the calling thread, kept until its owner unregisters it so that a dump
+ * after the thread has exited still includes it.  Returns nullptr when capacity is 0.
+ */
+	trace_ring_t* RegisterTraceRing (const std::string& name, size_t capacity);
+/* Release one ring, by its owner once the tracing thread has been joined. */
+	void UnregisterTraceRing (trace_ring_t* ring);
+/* Write every ring to path, callable from any thread. */
+	bool DumpTraceRings (const std::string& path);
+/* Also dump to path on an unhandled exception, Windows only.  The previous filter is chained
+ * and restored when every install has been matched by an uninstall.
+ */
+	void InstallTraceFaultHandler (const std::string& path);
+	void UninstallTraceFaultHandler();
+
+} /* namespace hitsuji */
+
+#endif /* TRACE_HH_ */
+
+/* eof */
\ No newline at end of file
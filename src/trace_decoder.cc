@@ -0,0 +1,49 @@
+/* Convert a Hitsuji trace dump to Chrome trace JSON.
+ *
+ *	HitsujiTrace <dump file> [json file]
+ *
+ * Load the output in chrome://tracing or Perfetto.  Timestamps are microseconds from the
+ * earliest record in the dump, one lane per event loop or worker thread.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "trace_reader.hh"
+
+int
+main (
+	int		argc,
+	const char*	argv[]
+	)
+{
+	if (argc < 2) {
+		fprintf (stderr, "usage: %s <dump file> [json file]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	FILE* in = fopen (argv[1], "rb");
+	if (nullptr == in) {
+		fprintf (stderr, "Cannot open \"%s\".\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+	hitsuji::trace_file_header_t header;
+	std::vector<hitsuji::trace_dump_ring_t> rings;
+	const bool is_read = hitsuji::ReadTraceDump (in, &header, &rings);
+	fclose (in);
+	if (!is_read) {
+		fprintf (stderr, "Truncated or invalid dump \"%s\".\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+	FILE* out = (argc > 2) ? fopen (argv[2], "w") : stdout;
+	if (nullptr == out) {
+		fprintf (stderr, "Cannot open \"%s\".\n", argv[2]);
+		return EXIT_FAILURE;
+	}
+	hitsuji::WriteTraceJson (out, header, rings);
+	if (out != stdout)
+		fclose (out);
+	return EXIT_SUCCESS;
+}
+
+/* eof */
\ No newline at end of file
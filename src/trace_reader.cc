@@ -0,0 +1,95 @@
+/* Read a trace dump and write it as Chrome trace JSON.
+ */
+
+#include "trace_reader.hh"
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstring>
+
+namespace { /* anonymous */
+
+/* Nanoseconds to fractional microseconds. */
+double
+to_us (
+	uint64_t ns
+	)
+{
+	return static_cast<double> (ns) / 1000.0;
+}
+
+} /* anonymous namespace */
+
+bool
+hitsuji::ReadTraceDump (
+	FILE* fp,
+	trace_file_header_t* header,
+	std::vector<trace_dump_ring_t>* rings
+	)
+{
+	if (1 != fread (header, sizeof (*header), 1, fp))
+		return false;
+	if (0 != memcmp (header->magic, "HITSUJI", sizeof ("HITSUJI"))) {
+		fprintf (stderr, "Not a Hitsuji trace dump.\n");
+		return false;
+	}
+	if (hitsuji::kTraceVersion != header->version || sizeof (hitsuji::trace_record_t) != header->record_size) {
+		fprintf (stderr, "Unsupported trace version %" PRIu32 ", record size %" PRIu32 ".\n", header->version, header->record_size);
+		return false;
+	}
+	rings->resize (header->ring_count);
+	for (auto it = rings->begin(); it != rings->end(); ++it) {
+		if (1 != fread (&it->header, sizeof (it->header), 1, fp))
+			return false;
+		it->header.name[sizeof (it->header.name) - 1] = '\0';
+		it->records.resize (it->header.record_count);
+		if (!it->records.empty() &&
+		    it->records.size() != fread (&it->records[0], sizeof (it->records[0]), it->records.size(), fp))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void
+hitsuji::WriteTraceJson (
+	FILE* fp,
+	const trace_file_header_t& header,
+	const std::vector<trace_dump_ring_t>& rings
+	)
+{
+	uint64_t origin = UINT64_MAX;
+	for (auto it = rings.begin(); it != rings.end(); ++it) {
+		for (auto jt = it->records.begin(); jt != it->records.end(); ++jt) {
+			if (jt->timestamp < origin)
+				origin = jt->timestamp;
+		}
+	}
+	const char* separator = "";
+	fprintf (fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	for (auto it = rings.begin(); it != rings.end(); ++it) {
+		fprintf (fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%" PRIu32 ",\"tid\":%" PRIu32 ",\"args\":{\"name\":\"%s\"}}",
+			separator, header.process_id, it->header.thread_id, it->header.name);
+		separator = ",";
+		for (auto jt = it->records.begin(); jt != it->records.end(); ++jt) {
+			fprintf (fp, ",\n{\"name\":\"%s\",\"cat\":\"hitsuji\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%" PRIu32 ",\"tid\":%" PRIu32,
+				hitsuji::trace_event_name (jt->event), jt->phase, to_us (jt->timestamp - origin), header.process_id, it->header.thread_id);
+			switch (jt->phase) {
+			case hitsuji::kTraceComplete:
+				fprintf (fp, ",\"dur\":%.3f", to_us (jt->duration));
+				break;
+			case hitsuji::kTraceInstant:
+				fprintf (fp, ",\"s\":\"t\"");
+				break;
+			default:
+				break;
+			}
+			fprintf (fp, ",\"args\":{\"handle\":%" PRIu64 ",\"token\":%" PRId32 ",\"value\":%" PRIu32 "}}",
+				jt->handle, jt->token, jt->value);
+		}
+	}
+	fprintf (fp, "\n]}\n");
+}
+
+/* eof */
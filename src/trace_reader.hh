@@ -0,0 +1,32 @@
+/* Read a trace dump and write it as Chrome trace JSON.
+ *
+ * Shared by HitsujiTrace and the trace tests, standalone of the plugin.
+ */
+
+#ifndef TRACE_READER_HH_
+#define TRACE_READER_HH_
+
+#include <cstdio>
+#include <vector>
+
+#include "trace.hh"
+
+namespace hitsuji
+{
+/* One ring of a dump, records oldest first. */
+	struct trace_dump_ring_t
+	{
+		trace_ring_header_t header;
+		std::vector<trace_record_t> records;
+	};
+
+/* Returns false on a truncated dump, or one of another format or version. */
+	bool ReadTraceDump (FILE* fp, trace_file_header_t* header, std::vector<trace_dump_ring_t>* rings);
+/* Timestamps are microseconds from the earliest record in the dump, one lane per ring. */
+	void WriteTraceJson (FILE* fp, const trace_file_header_t& header, const std::vector<trace_dump_ring_t>& rings);
+
+} /* namespace hitsuji */
+
+#endif /* TRACE_READER_HH_ */
+
+/* eof */
@@ -29,9 +29,13 @@ hitsuji::upa_t::Initialize()
 
 /* UPA library state.  As of rssl1.5 rsslInitialize implements reference
  * counting so each call should be matched with a call to rsslUninitialize.
+ *
+ * Each channel is only used by one thread at a time, the acceptor until active
+ * and then its owning event loop, so only the global pools require locking.
  */
+	const RsslLockingTypes locking = RSSL_LOCK_GLOBAL;
 	VLOG(2) << "Initializing UPA.";
-	if (RSSL_RET_SUCCESS != rsslInitialize (RSSL_LOCK_NONE, &rssl_err)) {
+	if (RSSL_RET_SUCCESS != rsslInitialize (locking, &rssl_err)) {
 		LOG(ERROR) << "rsslInitialize: { "
 			  "\"rsslErrorId\": " << rssl_err.rsslErrorId << ""
 			", \"sysError\": " << rssl_err.sysError << ""
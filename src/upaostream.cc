@@ -22,6 +22,20 @@ internal::channel_state_string (
 	return "";
 }
 
+const char*
+internal::compression_type_string (
+	const RsslCompTypes type_
+	)
+{
+	switch (type_) {
+	RETURN_STRING_LITERAL (RSSL_COMP_NONE);
+	RETURN_STRING_LITERAL (RSSL_COMP_ZLIB);
+	RETURN_STRING_LITERAL (RSSL_COMP_LZ4);
+	default: return "(Unknown)";
+	}
+	return "";
+}
+
 const char*
 internal::connection_type_string (
 	const RsslConnectionTypes type_
@@ -14,6 +14,7 @@ namespace internal {
 
 /* enumerated types */
 const char* channel_state_string (const RsslChannelState state_);
+const char* compression_type_string (const RsslCompTypes type_);
 const char* connection_type_string (const RsslConnectionTypes type_);
 const char* container_type_string (const RsslContainerType type_);
 const char* data_type_string (const RsslDataTypes type_);
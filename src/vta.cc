@@ -0,0 +1,238 @@
+/* Intraday analytic interface for Vhayu Trade Analytics.
+ */
+
+#include "vta.hh"
+
+#include <cstring>
+
+#include "chromium/logging.hh"
+
+vta::intraday_t::intraday_t (
+	const chromium::StringPiece& worker_name
+	)
+{
+/* Set logger ID */
+	std::ostringstream ss;
+	ss << worker_name << ':';
+	prefix_.assign (ss.str());
+
+/* 7.4.8.1 Create a response message (4.2.2) */
+	rsslClearRefreshMsg (&refresh_template_);
+/* 7.4.8.3 Set the message model type of the response. */
+	refresh_template_.msgBase.domainType = RSSL_DMT_MARKET_PRICE;
+/* 7.4.8.4 Set response type, response type number, and indication mask. */
+	refresh_template_.msgBase.msgClass = RSSL_MC_REFRESH;
+/* for snapshot images do not cache */
+	refresh_template_.flags = RSSL_RFMF_SOLICITED        |
+				  RSSL_RFMF_REFRESH_COMPLETE |
+				  RSSL_RFMF_DO_NOT_CACHE     |
+				  RSSL_RFMF_HAS_MSG_KEY;
+/* RDM field list. */
+	refresh_template_.msgBase.containerType = RSSL_DT_FIELD_LIST;
+/* 7.4.8.2 Create or re-use a request attribute object (4.2.4) */
+	refresh_template_.msgBase.msgKey.nameType = RDM_INSTRUMENT_NAME_TYPE_RIC;
+	refresh_template_.msgBase.msgKey.flags = RSSL_MKF_HAS_SERVICE_ID | RSSL_MKF_HAS_NAME_TYPE | RSSL_MKF_HAS_NAME;
+/** Optional: but require to replace stale values in cache when stale values are supported. **/
+/* Item interaction state: Open, Closed, ClosedRecover, Redirected, NonStreaming, or Unspecified. */
+	refresh_template_.state.streamState = RSSL_STREAM_NON_STREAMING;
+/* Data quality state: Ok, Suspect, or Unspecified. */
+	refresh_template_.state.dataState = RSSL_DATA_OK;
+/* Error code, e.g. NotFound, InvalidArgument, ... */
+	refresh_template_.state.code = RSSL_SC_NONE;
+}
+
+vta::intraday_t::~intraday_t()
+{
+}
+
+/* Single pass encode: only the stream, key name, service and permission data vary per
+ * response, the payload is already serialised.
+ *
+ * Returns false on error, true on success.
+ */
+bool
+vta::intraday_t::WriteRefresh (
+	uint16_t rwf_version,
+	int32_t token,
+	uint16_t service_id,
+	const chromium::StringPiece& item_name,
+	const chromium::StringPiece& dacs_lock,
+	const RsslBuffer& payload,
+	void* data,
+	size_t* length
+	)
+{
+#ifndef NDEBUG
+	RsslEncodeIterator it = RSSL_INIT_ENCODE_ITERATOR;
+#else
+	RsslEncodeIterator it;
+	rsslClearEncodeIterator (&it);
+#endif
+	RsslBuffer buf = { static_cast<uint32_t> (*length), static_cast<char*> (data) };
+	RsslRet rc;
+
+	DCHECK(!item_name.empty());
+
+	RsslRefreshMsg response = refresh_template_;
+/* Set the request token. */
+	response.msgBase.streamId = token;
+	response.msgBase.msgKey.serviceId   = service_id;
+	response.msgBase.msgKey.name.data   = const_cast<char*> (item_name.data());
+	response.msgBase.msgKey.name.length = static_cast<uint32_t> (item_name.size());
+/* DACS permission data, if provided */
+	if (!dacs_lock.empty()) {
+		response.permData.data = const_cast<char*> (dacs_lock.data());
+		response.permData.length = static_cast<uint32_t> (dacs_lock.size());
+		response.flags |= RSSL_RFMF_HAS_PERM_DATA;
+	}
+/* 4.3.1 RespMsg.Payload */
+	response.msgBase.encDataBody = payload;
+
+	rc = rsslSetEncodeIteratorBuffer (&it, &buf);
+	if (RSSL_RET_SUCCESS != rc) {
+		LOG(ERROR) << prefix_ << "rsslSetEncodeIteratorBuffer: { "
+			  "\"returnCode\": " << static_cast<signed> (rc) << ""
+			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
+			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
+			" }";
+		return false;
+	}
+	rc = rsslSetEncodeIteratorRWFVersion (&it, rwf_major_version (rwf_version), rwf_minor_version (rwf_version));
+	if (RSSL_RET_SUCCESS != rc) {
+		LOG(ERROR) << prefix_ << "rsslSetEncodeIteratorRWFVersion: { "
+			  "\"returnCode\": " << static_cast<signed> (rc) << ""
+			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
+			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
+			", \"majorVersion\": " << static_cast<unsigned> (rwf_major_version (rwf_version)) << ""
+			", \"minorVersion\": " << static_cast<unsigned> (rwf_minor_version (rwf_version)) << ""
+			" }";
+		return false;
+	}
+	rc = rsslEncodeMsg (&it, reinterpret_cast<RsslMsg*> (&response));
+	if (RSSL_RET_SUCCESS != rc) {
+		LOG(ERROR) << prefix_ << "rsslEncodeMsg: { "
+			  "\"returnCode\": " << static_cast<signed> (rc) << ""
+			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
+			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
+			" }";
+		return false;
+	}
+	buf.length = rsslGetEncodedBufferLength (&it);
+	LOG_IF(WARNING, 0 == buf.length) << prefix_ << "rsslGetEncodedBufferLength returned 0.";
+
+	if (DCHECK_IS_ON()) {
+/* Message validation: must use ASSERT libraries for error description :/ */
+		if (!rsslValidateMsg (reinterpret_cast<RsslMsg*> (&response))) {
+			LOG(ERROR) << prefix_ << "rsslValidateMsg failed.";
+			return false;
+		} else {
+			LOG(INFO) << prefix_ << "rsslValidateMsg succeeded.";
+		}
+/* Payload must be byte identical to the iterator encoder */
+		if (!VerifyFieldList (rwf_version, payload))
+			return false;
+	}
+	*length = static_cast<size_t> (buf.length);
+	return true;
+}
+
+/* Decode each real of the serialised field list and re-encode with the RSSL iterator API.
+ *
+ * Returns false on mismatch, true on identical output.
+ */
+bool
+vta::intraday_t::VerifyFieldList (
+	uint16_t rwf_version,
+	const RsslBuffer& payload
+	)
+{
+	RsslDecodeIterator dit = RSSL_INIT_DECODE_ITERATOR;
+	RsslEncodeIterator eit = RSSL_INIT_ENCODE_ITERATOR;
+	RsslFieldList field_list = RSSL_INIT_FIELD_LIST;
+	RsslFieldEntry field = RSSL_INIT_FIELD_ENTRY;
+	RsslReal rssl_real;
+	char reference[sizeof (payload_)];
+	RsslBuffer in = payload;
+	RsslBuffer out = { sizeof (reference), reference };
+	RsslRet rc;
+
+	if (RSSL_RET_SUCCESS != rsslSetDecodeIteratorBuffer (&dit, &in) ||
+	    RSSL_RET_SUCCESS != rsslSetDecodeIteratorRWFVersion (&dit, rwf_major_version (rwf_version), rwf_minor_version (rwf_version)) ||
+	    RSSL_RET_SUCCESS != rsslSetEncodeIteratorBuffer (&eit, &out) ||
+	    RSSL_RET_SUCCESS != rsslSetEncodeIteratorRWFVersion (&eit, rwf_major_version (rwf_version), rwf_minor_version (rwf_version)))
+	{
+		LOG(ERROR) << prefix_ << "Field list verification iterators failed.";
+		return false;
+	}
+	rc = rsslDecodeFieldList (&dit, &field_list, nullptr /* local set definitions */);
+	if (RSSL_RET_SUCCESS != rc) {
+		LOG(ERROR) << prefix_ << "rsslDecodeFieldList: { "
+			  "\"returnCode\": " << static_cast<signed> (rc) << ""
+			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
+			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
+			" }";
+		return false;
+	}
+	rc = rsslEncodeFieldListInit (&eit, &field_list, 0 /* summary data */, 0 /* payload */);
+	if (RSSL_RET_SUCCESS != rc) {
+		LOG(ERROR) << prefix_ << "rsslEncodeFieldListInit: { "
+			  "\"returnCode\": " << static_cast<signed> (rc) << ""
+			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
+			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
+			" }";
+		return false;
+	}
+	while (RSSL_RET_END_OF_CONTAINER != (rc = rsslDecodeFieldEntry (&dit, &field))) {
+		if (RSSL_RET_SUCCESS != rc) {
+			LOG(ERROR) << prefix_ << "rsslDecodeFieldEntry: { "
+				  "\"returnCode\": " << static_cast<signed> (rc) << ""
+				", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
+				", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
+				" }";
+			return false;
+		}
+		rc = rsslDecodeReal (&dit, &rssl_real);
+		if (RSSL_RET_BLANK_DATA == rc) {
+			rsslBlankReal (&rssl_real);
+		} else if (RSSL_RET_SUCCESS != rc) {
+			LOG(ERROR) << prefix_ << "rsslDecodeReal: { "
+				  "\"returnCode\": " << static_cast<signed> (rc) << ""
+				", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
+				", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
+				", \"fieldId\": " << field.fieldId << ""
+				" }";
+			return false;
+		}
+		field.dataType = RSSL_DT_REAL;
+		rc = rsslEncodeFieldEntry (&eit, &field, &rssl_real);
+		if (RSSL_RET_SUCCESS != rc) {
+			LOG(ERROR) << prefix_ << "rsslEncodeFieldEntry: { "
+				  "\"returnCode\": " << static_cast<signed> (rc) << ""
+				", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
+				", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
+				", \"fieldId\": " << field.fieldId << ""
+				" }";
+			return false;
+		}
+	}
+	rc = rsslEncodeFieldListComplete (&eit, RSSL_TRUE /* commit */);
+	if (RSSL_RET_SUCCESS != rc) {
+		LOG(ERROR) << prefix_ << "rsslEncodeFieldListComplete: { "
+			  "\"returnCode\": " << static_cast<signed> (rc) << ""
+			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
+			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
+			" }";
+		return false;
+	}
+	out.length = rsslGetEncodedBufferLength (&eit);
+	if (out.length != payload.length || 0 != std::memcmp (out.data, payload.data, out.length)) {
+		LOG(ERROR) << prefix_ << "Field list mismatch: { "
+			  "\"length\": " << payload.length << ""
+			", \"referenceLength\": " << out.length << ""
+			" }";
+		return false;
+	}
+	return true;
+}
+
+/* eof */
\ No newline at end of file
@@ -4,45 +4,84 @@
 #ifndef VTA_HH_
 #define VTA_HH_
 
+#include <algorithm>
 #include <cstdint>
 #include <sstream>
 #include <string>
+#include <vector>
 
 /* Velocity Analytics Plugin Framework */
 #include <vpf/vpf.h>
 #include <TBPrimitives.h>
 
+/* UPA 7.4 headers */
+#include <upa/upa.h>
+
 #include "chromium/string_piece.hh"
-#include "googleurl/url_parse.h"
+#include "rounding.hh"
+#include "vta_batch.hh"
 
 namespace vta
 {
+/* Sorted field identifiers requested by a view, empty for the full image. */
+	typedef std::vector<RsslFieldId> view_t;
+
 	class intraday_t
 	{
 	public:
-		intraday_t (const chromium::StringPiece& worker_name)
-		{
-/* Set logger ID */
-			std::ostringstream ss;
-			ss << worker_name << ':';
-			prefix_.assign (ss.str());
-		}
-		virtual ~intraday_t()
-		{
-		}
+		intraday_t (const chromium::StringPiece& worker_name);
+		virtual ~intraday_t();
 
-		virtual bool ParseRequest (const chromium::StringPiece& url, const url_parse::Component& parsed_query) = 0;
+		virtual bool ParseRequest (const chromium::StringPiece& query) = 0;
 		virtual bool Calculate (const chromium::StringPiece& symbol_name) = 0;
 		virtual bool Calculate (const TBSymbolHandle& handle, FlexRecWorkAreaElement* work_area, FlexRecViewElement* view_element) = 0;
-		virtual bool WriteRaw (uint16_t rwf_version, int32_t token, uint16_t service_id, const chromium::StringPiece& item_name, const chromium::StringPiece& dacs_lock, void* data, size_t* length) = 0;
+		virtual bool WriteRaw (uint16_t rwf_version, int32_t token, uint16_t service_id, const chromium::StringPiece& item_name, const chromium::StringPiece& dacs_lock, const view_t& view, void* data, size_t* length) = 0;
 		virtual void Reset() = 0;
 
+/* Returns true if other is the same analytic over the same time window and hence may
+ * share one FlexRecord cursor.
+ */
+		virtual bool IsSameWindow (const intraday_t& other) const { return false; }
+/* Calculate every analytic in the batch, default implementation opens one cursor per item. */
+		virtual bool Calculate (const batch_t& batch) {
+			for (auto it = batch.begin(); it != batch.end(); ++it) {
+				if (!it->analytic->Calculate (it->symbol_name))
+					return false;
+			}
+			return true;
+		}
+
 	protected:
+/* Returns true if the field identifier is within the view. */
+		static bool IsInView (const view_t& view, RsslFieldId fid) {
+			return view.empty() || std::binary_search (view.begin(), view.end(), fid);
+		}
+/* Encode a field entry only when within the view. */
+		static RsslRet EncodeFieldEntry (const view_t& view, RsslEncodeIterator* it, RsslFieldEntry* field, const void* data) {
+			return IsInView (view, field->fieldId) ? rsslEncodeFieldEntry (it, field, data) : RSSL_RET_SUCCESS;
+		}
+
 		uint8_t rwf_major_version (uint16_t rwf_version) const { return rwf_version / 256; }
 		uint8_t rwf_minor_version (uint16_t rwf_version) const { return rwf_version % 256; }
 
+/* Price as a real of 4 decimal places. */
+		static void PriceToReal (double price, RsslReal* real) {
+			rsslClearReal (real);
+			real->value = rounding::mantissa (price);
+			real->hint  = rounding::hint();
+		}
+
+/* Encode a non-streaming refresh from the template around a pre-encoded field list. */
+		bool WriteRefresh (uint16_t rwf_version, int32_t token, uint16_t service_id, const chromium::StringPiece& item_name, const chromium::StringPiece& dacs_lock, const RsslBuffer& payload, void* data, size_t* length);
+/* Compare a field list with the output of the RSSL encoder. */
+		bool VerifyFieldList (uint16_t rwf_version, const RsslBuffer& payload);
+
 /* logging unique identifier prefix */
 		std::string prefix_;
+/* Refresh message with all constant members set, patched per response. */
+		RsslRefreshMsg refresh_template_;
+/* Field list payload buffer */
+		char payload_[256];
 	};
 
 } /* namespace vta */
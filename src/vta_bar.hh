@@ -33,10 +33,12 @@ namespace vta
 		bar_t (const chromium::StringPiece& worker_name);
 		~bar_t();
 
-		virtual bool ParseRequest (const chromium::StringPiece& url, const url_parse::Component& parsed_query) override;
+		virtual bool ParseRequest (const chromium::StringPiece& query) override;
 		virtual bool Calculate (const chromium::StringPiece& symbol_name) override;
 		virtual bool Calculate (const TBSymbolHandle& handle, FlexRecWorkAreaElement* work_area, FlexRecViewElement* view_element) override;
-		virtual bool WriteRaw (uint16_t rwf_version, int32_t token, uint16_t service_id, const chromium::StringPiece& item_name, const chromium::StringPiece& dacs_lock, void* data, size_t* length);
+		virtual bool Calculate (const batch_t& batch) override;
+		virtual bool IsSameWindow (const intraday_t& other) const override;
+		virtual bool WriteRaw (uint16_t rwf_version, int32_t token, uint16_t service_id, const chromium::StringPiece& item_name, const chromium::StringPiece& dacs_lock, const view_t& view, void* data, size_t* length);
 		virtual void Reset() override;
 
 /* FlexRecPrimitives callback */
@@ -52,10 +54,6 @@ namespace vta
 		const boost::posix_time::ptime& open_time() const { return open_time_; }
 		const boost::posix_time::ptime& close_time() const { return close_time_; }
 
-/* Pre-allocated parsing state for requested items. */
-		std::string value_;
-		std::istringstream iss_;
-
 /* Request parameters */
 		boost::posix_time::ptime open_time_, close_time_;
 /* Analytic state */
@@ -0,0 +1,87 @@
+/* Batch of intraday analytics sharing one time window.
+ *
+ * Held in a fixed array of one worker batch so that grouping requests does not allocate,
+ * free of the Velocity Analytics and RSSL headers so that it can be tested alone.
+ */
+
+#ifndef VTA_BATCH_HH_
+#define VTA_BATCH_HH_
+
+#include <cstddef>
+#include <utility>
+
+#include "chromium/logging.hh"
+#include "chromium/string_piece.hh"
+
+namespace vta
+{
+	class intraday_t;
+
+/* Analytics of one type sharing one time window, members of one underlying symbol are kept
+ * adjacent so that each symbol is one contiguous range.
+ */
+	class batch_t
+	{
+	public:
+/* Maximum number of queued requests drained into one worker batch. */
+		enum { kMaxSize = 16 };
+
+		struct member_t {
+/* References the request, valid for the life time of the batch. */
+			chromium::StringPiece symbol_name;
+			intraday_t* analytic;
+		};
+		typedef const member_t* const_iterator;
+
+		batch_t() : size_ (0), symbol_count_ (0) {}
+
+		void clear() {
+			size_ = symbol_count_ = 0;
+		}
+
+/* Add an analytic after any other of the same symbol. */
+		void insert (const chromium::StringPiece& symbol_name, intraday_t* analytic) {
+			CHECK_LT (size_, static_cast<size_t> (kMaxSize));
+			size_t i = size_;
+			while (i > 0 && members_[i - 1].symbol_name != symbol_name)
+				--i;
+			if (0 == i) {
+				i = size_;
+				++symbol_count_;
+			} else {
+				for (size_t j = size_; j > i; --j)
+					members_[j] = members_[j - 1];
+			}
+			members_[i].symbol_name = symbol_name;
+			members_[i].analytic = analytic;
+			++size_;
+		}
+
+/* Range of members for one symbol, empty when absent. */
+		std::pair<const_iterator, const_iterator> equal_range (const chromium::StringPiece& symbol_name) const {
+			const_iterator first = begin();
+			while (first != end() && first->symbol_name != symbol_name)
+				++first;
+			const_iterator last = first;
+			while (last != end() && last->symbol_name == symbol_name)
+				++last;
+			return std::make_pair (first, last);
+		}
+
+		const_iterator begin() const { return members_; }
+		const_iterator end() const { return members_ + size_; }
+		size_t size() const { return size_; }
+		bool empty() const { return 0 == size_; }
+		size_t symbol_count() const { return symbol_count_; }
+
+	private:
+		member_t members_[kMaxSize];
+		size_t size_;
+		size_t symbol_count_;
+	};
+
+} /* namespace vta */
+
+#endif /* VTA_BATCH_HH_ */
+
+/* eof */
@@ -7,6 +7,9 @@
 #include <FlexRecReader.h>
 
 #include "chromium/logging.hh"
+#include "chromium/string_number_conversions.hh"
+#include "field_list.hh"
+#include "item_name.hh"
 #include "upaostream.hh"
 #include "unix_epoch.hh"
 #include "rounding.hh"
@@ -47,25 +50,22 @@ vta::close_t::~close_t()
 
 bool
 vta::close_t::ParseRequest (
-	const chromium::StringPiece& url,
-	const url_parse::Component& parsed_query
+	const chromium::StringPiece& query
 	)
 {
-	using namespace boost::gregorian;
-    	using namespace boost::posix_time;
-	url_parse::Component query = parsed_query;
-	url_parse::Component key_range, value_range;
+	using namespace boost::posix_time;
+	chromium::StringPiece remaining (query), key, value;
+	int64_t seconds;
 /* For each key-value pair, i.e. ?a=x&b=y&c=z -> (a,x) (b,y) (c,z) */
-	while (url_parse::ExtractQueryKeyValue (url.data(), &query, &key_range, &value_range))
+	while (internal::extract_query_key_value (&remaining, &key, &value))
 	{
-/* Lazy std::string conversion for key. */
-		const chromium::StringPiece key (url.data() + key_range.begin, key_range.len);
-/* Value must convert to add NULL terminator for conversion APIs. */
-		value_.assign (url.data() + value_range.begin, value_range.len);
+/* Best effort conversion in place, as std::atol: invalid input yields leading digits or zero. */
 		if (key == kOpenParameter) {
-			open_time_ = from_time_t (std::atol (value_.c_str()));
+			chromium::StringToInt64 (value, &seconds);
+			open_time_ = from_time_t (static_cast<std::time_t> (seconds));
 		} else if (key == kCloseParameter) {
-			close_time_ = from_time_t (std::atol (value_.c_str()));
+			chromium::StringToInt64 (value, &seconds);
+			close_time_ = from_time_t (static_cast<std::time_t> (seconds));
 		}
 	}
 /* Validation success. */
@@ -188,175 +188,31 @@ vta::close_t::WriteRaw (
 	uint16_t service_id,
 	const chromium::StringPiece& item_name,
 	const chromium::StringPiece& dacs_lock,
+	const view_t& view,
 	void* data,
 	size_t* length
 	)
 {
-/* 7.4.8.1 Create a response message (4.2.2) */
-	RsslRefreshMsg response = RSSL_INIT_REFRESH_MSG;
-#ifndef NDEBUG
-	RsslEncodeIterator it = RSSL_INIT_ENCODE_ITERATOR;
-#else
-	RsslEncodeIterator it;
-	rsslClearEncodeIterator (&it);
-#endif
-	RsslBuffer buf = { static_cast<uint32_t> (*length), static_cast<char*> (data) };
-	RsslRet rc;
-
-	DCHECK(!item_name.empty());
-
-/* 7.4.8.3 Set the message model type of the response. */
-	response.msgBase.domainType = RSSL_DMT_MARKET_PRICE;
-/* 7.4.8.4 Set response type, response type number, and indication mask. */
-	response.msgBase.msgClass = RSSL_MC_REFRESH;
-/* for snapshot images do not cache */
-	response.flags = RSSL_RFMF_SOLICITED        |
-			 RSSL_RFMF_REFRESH_COMPLETE |
-			 RSSL_RFMF_DO_NOT_CACHE;
-/* RDM field list. */
-	response.msgBase.containerType = RSSL_DT_FIELD_LIST;
-
-/* 7.4.8.2 Create or re-use a request attribute object (4.2.4) */
-	response.msgBase.msgKey.serviceId   = service_id;
-	response.msgBase.msgKey.nameType    = RDM_INSTRUMENT_NAME_TYPE_RIC;
-	response.msgBase.msgKey.name.data   = const_cast<char*> (item_name.data());
-	response.msgBase.msgKey.name.length = static_cast<uint32_t> (item_name.size());
-	response.msgBase.msgKey.flags = RSSL_MKF_HAS_SERVICE_ID | RSSL_MKF_HAS_NAME_TYPE | RSSL_MKF_HAS_NAME;
-	response.flags |= RSSL_RFMF_HAS_MSG_KEY;
-/* Set the request token. */
-	response.msgBase.streamId = token;
-
-/* DACS permission data, if provided */
-	if (!dacs_lock.empty()) {
-		response.permData.data = const_cast<char*> (dacs_lock.data());
-		response.permData.length = static_cast<uint32_t> (dacs_lock.size());
-		response.flags |= RSSL_RFMF_HAS_PERM_DATA;
-	}
-
-/** Optional: but require to replace stale values in cache when stale values are supported. **/
-/* Item interaction state: Open, Closed, ClosedRecover, Redirected, NonStreaming, or Unspecified. */
-	response.state.streamState = RSSL_STREAM_NON_STREAMING;
-/* Data quality state: Ok, Suspect, or Unspecified. */
-	response.state.dataState = RSSL_DATA_OK;
-/* Error code, e.g. NotFound, InvalidArgument, ... */
-	response.state.code = RSSL_SC_NONE;
-
-	rc = rsslSetEncodeIteratorBuffer (&it, &buf);
-	if (RSSL_RET_SUCCESS != rc) {
-		LOG(ERROR) << prefix_ << "rsslSetEncodeIteratorBuffer: { "
-			  "\"returnCode\": " << static_cast<signed> (rc) << ""
-			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
-			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
-			" }";
-		return false;
-	}
-	rc = rsslSetEncodeIteratorRWFVersion (&it, rwf_major_version (rwf_version), rwf_major_version (rwf_version));
-	if (RSSL_RET_SUCCESS != rc) {
-		LOG(ERROR) << prefix_ << "rsslSetEncodeIteratorRWFVersion: { "
-			  "\"returnCode\": " << static_cast<signed> (rc) << ""
-			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
-			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
-			", \"majorVersion\": " << static_cast<unsigned> (rwf_major_version (rwf_version)) << ""
-			", \"minorVersion\": " << static_cast<unsigned> (rwf_minor_version (rwf_version)) << ""
-			" }";
-		return false;
-	}
-	rc = rsslEncodeMsgInit (&it, reinterpret_cast<RsslMsg*> (&response), /* maximum size */ 0);
-	if (RSSL_RET_ENCODE_CONTAINER != rc) {
-		LOG(ERROR) << prefix_ << "rsslEncodeMsgInit: { "
-			  "\"returnCode\": " << static_cast<signed> (rc) << ""
-			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
-			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
-			" }";
-		return false;
-	}
-	{
 /* 4.3.1 RespMsg.Payload */
-/* Clear required for SingleWriteIterator state machine. */
-		RsslFieldList field_list;
-		RsslFieldEntry field;
-		RsslReal rssl_real;
+	internal::real_field_list_t field_list (payload_, sizeof (payload_), &view);
+	RsslBuffer payload;
+	RsslReal rssl_real;
 
-		rsslClearFieldList (&field_list);
-		rsslClearFieldEntry (&field);		
-
-		field_list.flags = RSSL_FLF_HAS_STANDARD_DATA;
-		rc = rsslEncodeFieldListInit (&it, &field_list, 0 /* summary data */, 0 /* payload */);
-		if (RSSL_RET_SUCCESS != rc) {
-			LOG(ERROR) << prefix_ << "rsslEncodeFieldListInit: { "
-				  "\"returnCode\": " << static_cast<signed> (rc) << ""
-				", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
-				", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
-				", \"flags\": \"RSSL_FLF_HAS_STANDARD_DATA\""
-				" }";
-			return false;
-		}
-
-/* For each field set the Id via a FieldEntry bound to the iterator followed by setting the data.
- * The iterator API provides setters for common types excluding 32-bit floats, with fallback to 
- * a generic DataBuffer API for other types or support of pre-calculated values.
- */
 /* HST_CLOSE */
-		field.fieldId  = kRdmHistoricCloseId;
-		field.dataType = RSSL_DT_REAL;
-		if (0 == number_trades()) {
-			rsslBlankReal (&rssl_real);
-		} else {
-			const double close_price = this->close_price();
-			rsslClearReal (&rssl_real);
-			rssl_real.value = rounding::mantissa (close_price);
-			rssl_real.hint  = rounding::hint();
-		}
-		rc = rsslEncodeFieldEntry (&it, &field, &rssl_real);
-		if (RSSL_RET_SUCCESS != rc) {
-			LOG(ERROR) << prefix_ << "rsslEncodeFieldEntry: { "
-				  "\"returnCode\": " << static_cast<signed> (rc) << ""
-				", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
-				", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
-				", \"fieldId\": " << field.fieldId << ""
-				", \"dataType\": \"" << rsslDataTypeToString (field.dataType) << "\""
-				", \"HST_CLOSE\": { "
-					  "\"isBlank\": " << (rssl_real.isBlank ? "true" : "false") << ""
-					", \"value\": " << rssl_real.value << ""
-					", \"hint\": \"" << internal::real_hint_string (static_cast<RsslRealHints> (rssl_real.hint)) << "\""
-				" }"
-				" }";
-			return false;
-		}
-		rc = rsslEncodeFieldListComplete (&it, RSSL_TRUE /* commit */);
-		if (RSSL_RET_SUCCESS != rc) {
-			LOG(ERROR) << prefix_ << "rsslEncodeFieldListComplete: { "
-				  "\"returnCode\": " << static_cast<signed> (rc) << ""
-				", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
-				", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
-				" }";
-			return false;
-		}
+	if (0 == number_trades()) {
+		rsslBlankReal (&rssl_real);
+	} else {
+		PriceToReal (close_price(), &rssl_real);
 	}
-/* finalize multi-step encoder */
-	rc = rsslEncodeMsgComplete (&it, RSSL_TRUE /* commit */);
-	if (RSSL_RET_SUCCESS != rc) {
-		LOG(ERROR) << prefix_ << "rsslEncodeMsgComplete: { "
-			  "\"returnCode\": " << static_cast<signed> (rc) << ""
-			", \"enumeration\": \"" << rsslRetCodeToString (rc) << "\""
-			", \"text\": \"" << rsslRetCodeInfo (rc) << "\""
+	field_list.Append (kRdmHistoricCloseId, rssl_real);
+
+	if (!field_list.Complete (&payload)) {
+		LOG(ERROR) << prefix_ << "Field list exceeds payload buffer: { "
+			  "\"size\": " << sizeof (payload_) << ""
 			" }";
 		return false;
 	}
-	buf.length = rsslGetEncodedBufferLength (&it);
-	LOG_IF(WARNING, 0 == buf.length) << prefix_ << "rsslGetEncodedBufferLength returned 0.";
-
-	if (DCHECK_IS_ON()) {
-/* Message validation: must use ASSERT libraries for error description :/ */
-		if (!rsslValidateMsg (reinterpret_cast<RsslMsg*> (&response))) {
-			LOG(ERROR) << prefix_ << "rsslValidateMsg failed.";
-			return false;
-		} else {
-			LOG(INFO) << prefix_ << "rsslValidateMsg succeeded.";
-		}
-	}
-	*length = static_cast<size_t> (buf.length);
-	return true;
+	return WriteRefresh (rwf_version, token, service_id, item_name, dacs_lock, payload, data, length);
 }
 
 void
@@ -36,8 +36,7 @@ vta::test_t::~test_t()
 
 bool
 vta::test_t::ParseRequest (
-	const chromium::StringPiece& url,
-	const url_parse::Component& parsed_query
+	const chromium::StringPiece& query
 	)
 {
 	return true;
@@ -82,6 +81,7 @@ vta::test_t::WriteRaw (
 	uint16_t service_id,
 	const chromium::StringPiece& item_name,
 	const chromium::StringPiece& dacs_lock,	    /* ignore DACS lock */
+	const view_t& view,
 	void* data,
 	size_t* length
 	)
@@ -189,7 +189,7 @@ vta::test_t::WriteRaw (
 		field.fieldId  = kRdmProductPermissionId;
 		field.dataType = RSSL_DT_UINT;
 		const uint64_t prod_perm = 213;		/* for JPY= */
-		rc = rsslEncodeFieldEntry (&it, &field, &prod_perm);
+		rc = EncodeFieldEntry (view, &it, &field, &prod_perm);
 		if (RSSL_RET_SUCCESS != rc) {
 			LOG(ERROR) << prefix_ << "rsslEncodeFieldEntry: { "
 				  "\"returnCode\": " << static_cast<signed> (rc) << ""
@@ -206,7 +206,7 @@ vta::test_t::WriteRaw (
 		field.fieldId  = kRdmPreferredDisplayTemplateId;
 		field.dataType = RSSL_DT_UINT;
 		const uint64_t pref_disp = 6205;	/* for JPY= */
-		rc = rsslEncodeFieldEntry (&it, &field, &pref_disp);
+		rc = EncodeFieldEntry (view, &it, &field, &pref_disp);
 		if (RSSL_RET_SUCCESS != rc) {
 			LOG(ERROR) << prefix_ << "rsslEncodeFieldEntry: { "
 				  "\"returnCode\": " << static_cast<signed> (rc) << ""
@@ -225,7 +225,7 @@ vta::test_t::WriteRaw (
 		const std::string bkgd_ref ("Japanese Yen");
 		data_buffer.data   = const_cast<char*> (bkgd_ref.c_str());
 		data_buffer.length = static_cast<uint32_t> (bkgd_ref.size());
-		rc = rsslEncodeFieldEntry (&it, &field, &data_buffer);
+		rc = EncodeFieldEntry (view, &it, &field, &data_buffer);
 		if (RSSL_RET_SUCCESS != rc) {
 			LOG(ERROR) << prefix_ << "rsslEncodeFieldEntry: { "
 				  "\"returnCode\": " << static_cast<signed> (rc) << ""
@@ -244,7 +244,7 @@ vta::test_t::WriteRaw (
 		const std::string gv1_text ("SPOT");
 		data_buffer.data   = const_cast<char*> (gv1_text.c_str());
 		data_buffer.length = static_cast<uint32_t> (gv1_text.size());
-		rc = rsslEncodeFieldEntry (&it, &field, &data_buffer);
+		rc = EncodeFieldEntry (view, &it, &field, &data_buffer);
 		if (RSSL_RET_SUCCESS != rc) {
 			LOG(ERROR) << prefix_ << "rsslEncodeFieldEntry: { "
 				  "\"returnCode\": " << static_cast<signed> (rc) << ""
@@ -263,7 +263,7 @@ vta::test_t::WriteRaw (
 		const std::string gv2_text ("USDJPY");
 		data_buffer.data   = const_cast<char*> (gv2_text.c_str());
 		data_buffer.length = static_cast<uint32_t> (gv2_text.size());
-		rc = rsslEncodeFieldEntry (&it, &field, &data_buffer);
+		rc = EncodeFieldEntry (view, &it, &field, &data_buffer);
 		if (RSSL_RET_SUCCESS != rc) {
 			LOG(ERROR) << prefix_ << "rsslEncodeFieldEntry: { "
 				  "\"returnCode\": " << static_cast<signed> (rc) << ""
@@ -282,7 +282,7 @@ vta::test_t::WriteRaw (
 		const double bid = 82.20;
 		rssl_real.value = rounding::mantissa (bid);
 		rssl_real.hint  = rounding::hint();
-		rc = rsslEncodeFieldEntry (&it, &field, &rssl_real);
+		rc = EncodeFieldEntry (view, &it, &field, &rssl_real);
 		if (RSSL_RET_SUCCESS != rc) {
 			LOG(ERROR) << prefix_ << "rsslEncodeFieldEntry: { "
 				  "\"returnCode\": " << static_cast<signed> (rc) << ""
@@ -305,7 +305,7 @@ vta::test_t::WriteRaw (
 		const double ask = 82.22;
 		rssl_real.value = rounding::mantissa (ask);
 		rssl_real.hint  = rounding::hint();
-		rc = rsslEncodeFieldEntry (&it, &field, &rssl_real);
+		rc = EncodeFieldEntry (view, &it, &field, &rssl_real);
 		if (RSSL_RET_SUCCESS != rc) {
 			LOG(ERROR) << prefix_ << "rsslEncodeFieldEntry: { "
 				  "\"returnCode\": " << static_cast<signed> (rc) << ""
@@ -328,7 +328,7 @@ vta::test_t::WriteRaw (
 		const std::string ctbtr_1 ("RBS");
 		data_buffer.data   = const_cast<char*> (ctbtr_1.c_str());
 		data_buffer.length = static_cast<uint32_t> (ctbtr_1.size());
-		rc = rsslEncodeFieldEntry (&it, &field, &data_buffer);
+		rc = EncodeFieldEntry (view, &it, &field, &data_buffer);
 		if (RSSL_RET_SUCCESS != rc) {
 			LOG(ERROR) << prefix_ << "rsslEncodeFieldEntry: { "
 				  "\"returnCode\": " << static_cast<signed> (rc) << ""
@@ -347,7 +347,7 @@ vta::test_t::WriteRaw (
 		const std::string ctb_loc1 ("XST");
 		data_buffer.data   = const_cast<char*> (ctb_loc1.c_str());
 		data_buffer.length = static_cast<uint32_t> (ctb_loc1.size());
-		rc = rsslEncodeFieldEntry (&it, &field, &data_buffer);
+		rc = EncodeFieldEntry (view, &it, &field, &data_buffer);
 		if (RSSL_RET_SUCCESS != rc) {
 			LOG(ERROR) << prefix_ << "rsslEncodeFieldEntry: { "
 				  "\"returnCode\": " << static_cast<signed> (rc) << ""
@@ -366,7 +366,7 @@ vta::test_t::WriteRaw (
 		const std::string ctb_page1 ("1RBS");
 		data_buffer.data   = const_cast<char*> (ctb_page1.c_str()); 
 		data_buffer.length = static_cast<uint32_t> (ctb_page1.size());
-		rc = rsslEncodeFieldEntry (&it, &field, &data_buffer);
+		rc = EncodeFieldEntry (view, &it, &field, &data_buffer);
 		if (RSSL_RET_SUCCESS != rc) {
 			LOG(ERROR) << prefix_ << "rsslEncodeFieldEntry: { "
 				  "\"returnCode\": " << static_cast<signed> (rc) << ""
@@ -385,7 +385,7 @@ vta::test_t::WriteRaw (
 		const std::string dlg_code1 ("RBSN");
 		data_buffer.data   = const_cast<char*> (dlg_code1.c_str());
 		data_buffer.length = static_cast<uint32_t> (dlg_code1.size());
-		rc = rsslEncodeFieldEntry (&it, &field, &data_buffer);
+		rc = EncodeFieldEntry (view, &it, &field, &data_buffer);
 		if (RSSL_RET_SUCCESS != rc) {
 			LOG(ERROR) << prefix_ << "rsslEncodeFieldEntry: { "
 				  "\"returnCode\": " << static_cast<signed> (rc) << ""
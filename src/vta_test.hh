@@ -15,10 +15,10 @@ namespace vta
 		test_t (const chromium::StringPiece& worker_name);
 		~test_t();
 
-		virtual bool ParseRequest (const chromium::StringPiece& url, const url_parse::Component& parsed_query) override;
+		virtual bool ParseRequest (const chromium::StringPiece& query) override;
 		virtual bool Calculate (const chromium::StringPiece& symbol_name) override;
 		virtual bool Calculate (const TBSymbolHandle& handle, FlexRecWorkAreaElement* work_area, FlexRecViewElement* view_element) override;
-		virtual bool WriteRaw (uint16_t rwf_version, int32_t token, uint16_t service_id, const chromium::StringPiece& item_name, const chromium::StringPiece& dacs_lock, void* data, size_t* length);
+		virtual bool WriteRaw (uint16_t rwf_version, int32_t token, uint16_t service_id, const chromium::StringPiece& item_name, const chromium::StringPiece& dacs_lock, const view_t& view, void* data, size_t* length);
 		virtual void Reset() override;
 	};
 
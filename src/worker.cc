@@ -9,6 +9,7 @@
 
 #include "chromium/logging.hh"
 #include "provider.hh"
+#include "shard.hh"
 
 /* Outstanding defects:
  * warning C4244: '=' : conversion from 'const sbe_uint64_t' to 'int', possible loss of data
@@ -23,7 +24,10 @@
 #include "hitsuji/Reply.hpp"
 #pragma warning(pop)
 
+#include "item_name.hh"
 #include "permdata.hh"
+#include "request_codec.hh"
+#include "symbol_table.hh"
 #include "vta_bar.hh"
 #include "vta_close.hh"
 #include "vta_rollup_bar.hh"
@@ -34,22 +38,64 @@ static const std::string kErrorNotFound = "Not found in SearchEngine.";
 static const std::string kErrorPermData = "Unable to retrieve permission data for item.";
 static const std::string kErrorInternal = "Internal error.";
 
+/* Maximum number of queued requests drained into one batch. */
+static const size_t kMaxBatchSize = vta::batch_t::kMaxSize;
+/* Reserved string capacities: RSSL names are limited to 255 bytes. */
+static const size_t kMaxItemNameLength = 256;
+static const size_t kMaxDacsLockLength = 64;
+/* SBE view group dimension is 8-bit */
+static const size_t kMaxViewLength = 255;
+
+/* Trace event ending at each stage, calculation is traced per batch instead. */
+static const hitsuji::trace_event_e kStageTraceEvents[hitsuji::kLatencyStampCount] = {
+	hitsuji::kTraceNone,		/* read */
+	hitsuji::kTraceNone,		/* queue */
+	hitsuji::kTraceNone,		/* dequeue */
+	hitsuji::kTraceParse,
+	hitsuji::kTraceLookup,
+	hitsuji::kTraceNone,		/* calculate */
+	hitsuji::kTraceEncode,
+	hitsuji::kTraceNone,		/* receive */
+	hitsuji::kTraceNone		/* write */
+};
+
 hitsuji::worker_t::worker_t (
-	std::shared_ptr<void>& zmq_context
+	std::shared_ptr<void>& zmq_context,
+	std::shared_ptr<vhayu::permdata_t>& permdata,
+	std::shared_ptr<vhayu::symbol_table_t>& symbol_table,
+	std::shared_ptr<hitsuji::slab_pool_t>& slab_pool,
+	std::shared_ptr<hitsuji::slab_pool_t>& request_pool,
+	size_t shard_count,
+	size_t trace_ring_size
 	)
-	: zmq_context_ (zmq_context)
-	, permdata_ (std::make_shared<vhayu::permdata_t> ())
+	: id_ (0)
+	, zmq_context_ (zmq_context)
+	, shard_count_ (shard_count)
+	, trace_ring_size_ (trace_ring_size)
+	, task_count_ (0)
+	, permdata_ (permdata)
+	, symbol_table_ (symbol_table)
+	, slab_pool_ (slab_pool)
+	, request_pool_ (request_pool)
 	, manager_ (nullptr)
+	, stats_slot_ (0)
+	, trace_ (nullptr)
 {
 }
 
 hitsuji::worker_t::~worker_t()
 {
+	UnregisterTraceRing (trace_);
+	for (auto it = tasks_.begin(); it != tasks_.end(); ++it) {
+		if (nullptr != (*it)->slab)
+			slab_pool_->Release ((*it)->slab);
+	}
 }
 
 bool
 hitsuji::worker_t::Initialize (size_t id)
 {
+	id_ = id;
 /* Set thread affinity to this thread */
 	DWORD_PTR default_mask;
 	DWORD_PTR system_mask;
@@ -104,15 +150,18 @@ hitsuji::worker_t::Initialize (size_t id)
 		request_sock_.reset (zmq_socket (zmq_context_.get(), ZMQ_PULL), zmq_close_deleter);
 		if (!(bool)request_sock_)
 			goto cleanup;
-		int rc = zmq_connect (request_sock_.get(), "inproc://worker/request");
-		if (-1 == rc)
-			goto cleanup;
-		reply_sock_.reset (zmq_socket (zmq_context_.get(), ZMQ_PUSH), zmq_close_deleter);
-		if (!(bool)reply_sock_)
-			goto cleanup;
-		rc = zmq_connect (reply_sock_.get(), "inproc://worker/reply");
-		if (-1 == rc)
-			goto cleanup;
+		for (size_t i = 0; i < shard_count_; ++i) {
+			int rc = zmq_connect (request_sock_.get(), shard_t::request_endpoint (static_cast<unsigned> (i)).c_str());
+			if (-1 == rc)
+				goto cleanup;
+			std::shared_ptr<void> reply_sock (zmq_socket (zmq_context_.get(), ZMQ_PUSH), zmq_close_deleter);
+			if (!(bool)reply_sock)
+				goto cleanup;
+			rc = zmq_connect (reply_sock.get(), shard_t::reply_endpoint (static_cast<unsigned> (i)).c_str());
+			if (-1 == rc)
+				goto cleanup;
+			reply_socks_.push_back (reply_sock);
+		}
 	} catch (const std::exception& e) {
 		LOG(ERROR) << prefix_ << "ZeroMQ::Exception: { "
 			"\"What\": \"" << e.what() << "\""
@@ -132,26 +181,52 @@ hitsuji::worker_t::Initialize (size_t id)
 		sbe_hdr_.reset (new hitsuji::MessageHeader());
 		sbe_request_.reset (new hitsuji::Request());
 		sbe_reply_.reset (new hitsuji::Reply());
-		vta_bar_.reset (new vta::bar_t (prefix_));
-		vta_rollup_bar_.reset (new vta::rollup_bar_t (prefix_));
-		vta_close_.reset (new vta::close_t (prefix_));
-		vta_test_.reset (new vta::test_t (prefix_));
 		if (!(bool)sbe_hdr_ ||
 		    !(bool)sbe_request_ ||
-		    !(bool)sbe_reply_ ||
-		    !(bool)vta_bar_ ||
-		    !(bool)vta_rollup_bar_ ||
-		    !(bool)vta_close_ ||
-		    !(bool)vta_test_)
+		    !(bool)sbe_reply_)
 		{
 			goto cleanup;
 		}
+		tasks_.reserve (kMaxBatchSize);
+		for (size_t i = 0; i < kMaxBatchSize; ++i) {
+			auto task = std::make_shared<task_t> ();
+			task->slab = nullptr;
+			task->analytic_type = Analytic::none;
+			task->last_stamp = kReadStamp;
+			task->vta_bar.reset (new vta::bar_t (prefix_));
+			task->vta_rollup_bar.reset (new vta::rollup_bar_t (prefix_));
+			task->vta_close.reset (new vta::close_t (prefix_));
+			task->vta_test.reset (new vta::test_t (prefix_));
+/* Pre-size request strings so steady state assignment does not allocate */
+			task->item_name.reserve (kMaxItemNameLength);
+			task->underlying_symbol.reserve (kMaxItemNameLength);
+			task->dacs_lock.reserve (kMaxDacsLockLength);
+			task->view.reserve (kMaxViewLength);
+			if (!(bool)task->vta_bar ||
+			    !(bool)task->vta_rollup_bar ||
+			    !(bool)task->vta_close ||
+			    !(bool)task->vta_test)
+			{
+				goto cleanup;
+			}
+			tasks_.push_back (task);
+		}
 	} catch (const std::exception& e) {
 		LOG(ERROR) << prefix_ << "SBE::Initialisation exception: { "
 			"\"What\": \"" << e.what() << "\""
 			" }";
 		goto cleanup;
 	}
+/* Stats table column and trace ring for this worker thread. */
+	{
+		std::ostringstream name;
+		name << "Worker" << id_;
+		stats_slot_ = RegisterStatsThread (name.str());
+		trace_ = RegisterTraceRing (name.str(), trace_ring_size_);
+		worker_rows_.Bind (stats_slot_, kWorkerStatsNames);
+		if (0 == id_)
+			cache_rows_.Bind (stats_slot_, kCacheStatsNames);
+	}
 	LOG(INFO) << prefix_ << "Initialisation complete.";
 	return true;
 cleanup:
@@ -174,218 +249,295 @@ hitsuji::worker_t::AcquireFlexRecordCursor()
 	return true;
 }
 
+/* Decode one queued request into a batch slot, validating the item and fetching permission
+ * data.  Invalid requests have a close response written immediately and are excluded from
+ * calculation.
+ *
+ * Returns false on abort or unrecoverable error, true otherwise.
+ */
 bool
 hitsuji::worker_t::OnTask (
 	const void* buffer,
-	size_t length
+	size_t length,
+	task_t* task
 	)
 {
-	static const int version = 0;
-	sbe_hdr_->wrap (reinterpret_cast<char*> (const_cast<void*> (buffer)), 0, version, static_cast<int> (length));
-	sbe_request_->wrapForDecode (reinterpret_cast<char*> (const_cast<void*> (buffer)), sbe_hdr_->size(), sbe_hdr_->blockLength(), sbe_hdr_->version(), static_cast<int> (length));
+	const uint64_t dequeue_time = monotonic_nanoseconds();
+/* copy out as the request slab is released before the batch is calculated. */
+	request_fields_t fields;
+	decode_request (sbe_hdr_.get(), sbe_request_.get(), buffer, length, &fields, &task->view, &task->item_name);
 
 /* abort flag */
-	if (sbe_request_->flags().abort()) {
+	if (fields.abort) {
 		LOG(INFO) << prefix_ << "Abort flag received.";
 		return false;
 	}
 
-	const uintptr_t handle = sbe_request_->handle();
-	const uint16_t rwf_version = sbe_request_->rwfVersion();
-	const int32_t token = sbe_request_->token();
-	const uint16_t service_id = sbe_request_->serviceId();
-	const bool use_attribinfo_in_updates = sbe_request_->flags().useAttribInfoInUpdates();
-	const chromium::StringPiece item_name (sbe_request_->itemName(), sbe_request_->itemNameLength());
-
-	using namespace boost::chrono;
-	auto t0 = high_resolution_clock::now();
+	task->handle = fields.handle;
+	task->shard = fields.shard;
+	task->rwf_version = fields.rwf_version;
+	task->token = fields.token;
+	task->service_id = fields.service_id;
+	task->use_attribinfo_in_updates = fields.use_attribinfo_in_updates;
+	task->stamps[kReadStamp] = fields.read_time;
+	task->stamps[kQueueStamp] = fields.queue_time;
+	task->stamps[kDequeueStamp] = dequeue_time;
+	task->last_stamp = kDequeueStamp;
+	task->analytic_type = Analytic::none;
+	cumulative_stats_[WORKER_PC_TASK_RECEIVED]++;
+	if (dequeue_time > task->stamps[kQueueStamp])
+		cumulative_stats_[WORKER_PC_QUEUE_WAIT_US] += (dequeue_time - task->stamps[kQueueStamp]) / 1000;
+	task->analytic = nullptr;
 
 /* Reset message buffer */
-	rssl_length_ = sizeof (rssl_buf_);
-/* decompose request */
-	url_parse::Parsed parsed;
-	url_parse::Component file_name;
-	url_.assign ("null://localhost/");
-	url_.append (item_name.as_string());
-	url_parse::ParseStandardURL (url_.c_str(), static_cast<int>(url_.size()), &parsed);
-	if (parsed.path.is_valid())
-		url_parse::ExtractFileName (url_.c_str(), parsed.path, &file_name);
-	if (!file_name.is_valid()) {
-//		cumulative_stats_[CLIENT_PC_ITEM_REQUEST_REJECTED]++;
-//		cumulative_stats_[CLIENT_PC_ITEM_REQUEST_MALFORMED]++;
-		LOG(INFO) << prefix_ << "Closing invalid request for \"" << item_name << "\"";
-		if (!provider_t::WriteRawClose (
-				rwf_version,
-				token,
-				service_id,
-				RSSL_DMT_MARKET_PRICE,
-				item_name,
-				use_attribinfo_in_updates,
-				RSSL_STREAM_CLOSED, RSSL_SC_NOT_FOUND, kErrorMalformedRequest,
-				rssl_buf_,
-				&rssl_length_
-				))
-		{
-			return false;
+	ResetBuffer (task);
+/* decompose request */
+	internal::parsed_item_name_t parsed;
+	if (!internal::parse_item_name (task->item_name, &parsed)) {
+		cumulative_stats_[WORKER_PC_TASK_MALFORMED]++;
+		LOG(INFO) << prefix_ << "Closing invalid request for \"" << task->item_name << "\"";
+		return WriteClose (task, RSSL_STREAM_CLOSED, RSSL_SC_NOT_FOUND, kErrorMalformedRequest);
+	}
+	Stamp (task, kParseStamp);
+	task->underlying_symbol.assign (parsed.symbol.data(), parsed.symbol.size());
+/* select implementation, fragment length discriminates before one comparison */
+	vta::intraday_t* analytic = task->vta_bar.get();
+	unsigned analytic_type = Analytic::bar;
+	switch (parsed.fragment.size()) {
+	case 4:
+		if (parsed.fragment == "test") {
+			analytic = task->vta_test.get();
+			analytic_type = Analytic::test;
+		}
+		break;
+	case 5:
+		if (parsed.fragment == "close") {
+			analytic = task->vta_close.get();
+			analytic_type = Analytic::close;
 		}
-		goto send_reply;
+		break;
+	case 6:
+		if (parsed.fragment == "rollup") {
+			analytic = task->vta_rollup_bar.get();
+			analytic_type = Analytic::rollupBar;
+		}
+		break;
+	default:
+		break;
 	}
-	else
-	{
-/* require a NULL terminated string */
-		underlying_symbol_.assign (url_.c_str() + file_name.begin, file_name.len);
-/* select implementation */
-		auto analytic = static_pointer_cast<vta::intraday_t> (vta_bar_);
-		if (parsed.ref.is_valid())  {
-			chromium::StringPiece ref (url_.c_str() + parsed.ref.begin, parsed.ref.len);
-			if (0 == ref.compare ("test")) {
-				analytic = static_pointer_cast<vta::intraday_t> (vta_test_);
-			} else if (0 == ref.compare ("rollup")) {
-				analytic = static_pointer_cast<vta::intraday_t> (vta_rollup_bar_);
-			} else if (0 == ref.compare ("close")) {
-				analytic = static_pointer_cast<vta::intraday_t> (vta_close_);
-			}
-		}
 /* clear analytic state */
-		analytic->Reset();
-#ifndef CONFIG_AS_APPLICATION
-/* Check SearchEngine.exe inventory */
-		if (0 == TBPrimitives::IsSymbolExists (underlying_symbol_.c_str())) 
-		{
-//			cumulative_stats_[CLIENT_PC_ITEM_NOT_FOUND]++;
-//			cumulative_stats_[CLIENT_PC_ITEM_REQUEST_REJECTED]++;
-			LOG(INFO) << prefix_ << "Closing request for unknown item \"" << underlying_symbol_ << "\".";
-			if (!provider_t::WriteRawClose (
-					rwf_version,
-					token,
-					service_id,
-					RSSL_DMT_MARKET_PRICE,
-					item_name,
-					use_attribinfo_in_updates,
-					RSSL_STREAM_CLOSED, RSSL_SC_NOT_FOUND, kErrorNotFound,
-					rssl_buf_,
-					&rssl_length_
-					))
-			{
-				return false;
-			}
-			goto send_reply;
-		}
-#endif
+	analytic->Reset();
+/* Check SearchEngine.exe inventory via symbol table */
+	TBSymbolHandle symbol_handle;
+	if (!symbol_table_->Lookup (parsed.symbol, &symbol_handle))
+	{
+		cumulative_stats_[WORKER_PC_TASK_NOT_FOUND]++;
+		LOG(INFO) << prefix_ << "Closing request for unknown item \"" << task->underlying_symbol << "\".";
+		return WriteClose (task, RSSL_STREAM_CLOSED, RSSL_SC_NOT_FOUND, kErrorNotFound);
+	}
 /* Validate request, e.g. be satisifed with this SearchEngine instance */
-		if (parsed.query.is_valid() && !analytic->ParseRequest (url_, parsed.query)) {
-			if (!provider_t::WriteRawClose (
-					rwf_version,
-					token,
-					service_id,
-					RSSL_DMT_MARKET_PRICE,
-					item_name,
-					use_attribinfo_in_updates,
-					RSSL_STREAM_CLOSED, RSSL_SC_NOT_FOUND, kErrorMalformedRequest,
-					rssl_buf_,
-					&rssl_length_
-					))
-			{
-				return false;
-			}
-			goto send_reply;
-		}
-		auto symbol_handle = TBPrimitives::GetSymbolHandle (underlying_symbol_.c_str(), 0);
-/* Fetch DACS lock from PermData FlexRecord history: string is cleared. */
-//		if (!permdata_->GetDacsLock (underlying_symbol_, &dacs_lock_)) {
-		if (!permdata_->GetDacsLock (symbol_handle, work_area_.get(), view_element_.get(), &dacs_lock_)) {
-			if (!provider_t::WriteRawClose (
-					rwf_version,
-					token,
-					service_id,
-					RSSL_DMT_MARKET_PRICE,
-					item_name,
-					use_attribinfo_in_updates,
-					RSSL_STREAM_CLOSED, RSSL_SC_NOT_ENTITLED, kErrorPermData,
-					rssl_buf_,
-					&rssl_length_
-					))
-			{
-				return false;
-			}
-			goto send_reply;
-		}
-/* Execute analytic */
-		if (!analytic->Calculate (underlying_symbol_)) {
-//		if (!analytic->Calculate (symbol_handle, work_area_.get(), view_element_.get())) {
-			if (!provider_t::WriteRawClose (
-					rwf_version,
-					token,
-					service_id,
-					RSSL_DMT_MARKET_PRICE,
-					item_name,
-					use_attribinfo_in_updates,
-					RSSL_STREAM_CLOSED_RECOVER, RSSL_SC_ERROR, kErrorInternal,
-					rssl_buf_,
-					&rssl_length_
-					))
-			{
-				return false;
-			}
-			goto send_reply;
+	if (!analytic->ParseRequest (parsed.query)) {
+		cumulative_stats_[WORKER_PC_TASK_MALFORMED]++;
+		return WriteClose (task, RSSL_STREAM_CLOSED, RSSL_SC_NOT_FOUND, kErrorMalformedRequest);
+	}
+/* Fetch DACS lock from PermData FlexRecord history: string is cleared. */
+//	if (!permdata_->GetDacsLock (task->underlying_symbol, &task->dacs_lock)) {
+	if (!permdata_->GetDacsLock (symbol_handle, work_area_.get(), view_element_.get(), &task->dacs_lock)) {
+		cumulative_stats_[WORKER_PC_TASK_NOT_ENTITLED]++;
+		return WriteClose (task, RSSL_STREAM_CLOSED, RSSL_SC_NOT_ENTITLED, kErrorPermData);
+	}
+	Stamp (task, kLookupStamp);
+/* Pending calculation */
+	task->analytic = analytic;
+	task->analytic_type = analytic_type;
+	cumulative_stats_[WORKER_PC_BAR_REQUEST + (analytic_type - Analytic::bar)]++;
+	return true;
+}
+
+/* Calculate all pending requests of the batch, grouping requests for the same analytic and
+ * time window onto one FlexRecord cursor, then send every response.
+ *
+ * Returns false on unrecoverable error, true otherwise.
+ */
+bool
+hitsuji::worker_t::OnBatch()
+{
+	vta::batch_t batch;
+	size_t members[kMaxBatchSize];
+	for (size_t i = 0; i < task_count_; ++i) {
+		auto leader = tasks_[i]->analytic;
+		if (nullptr == leader)
+			continue;
+/* Collect all pending requests sharing the leader's window, including the leader. */
+		batch.clear();
+		size_t member_count = 0;
+		for (size_t j = i; j < task_count_; ++j) {
+			auto& task = *tasks_[j];
+			if (nullptr == task.analytic || (j != i && !leader->IsSameWindow (*task.analytic)))
+				continue;
+			batch.insert (task.underlying_symbol, task.analytic);
+			members[member_count++] = j;
 		}
-/* Response message with analytic payload */
-		if (!analytic->WriteRaw (rwf_version, token, service_id, item_name, dacs_lock_, rssl_buf_, &rssl_length_)) {
+		DVLOG(4) << prefix_ << "Calculating batch of " << member_count << " item(s) over " << batch.symbol_count() << " symbol(s).";
+/* Execute analytic */
+		if (nullptr != trace_)
+			trace_->Begin (kTraceFlexRecord, monotonic_nanoseconds(), static_cast<uint32_t> (member_count));
+		const bool is_calculated = (1 == member_count) ? leader->Calculate (tasks_[i]->underlying_symbol)
+							       : leader->Calculate (batch);
+		if (nullptr != trace_)
+			trace_->End (kTraceFlexRecord, monotonic_nanoseconds(), static_cast<uint32_t> (member_count));
+		cumulative_stats_[WORKER_PC_BATCH_CALCULATED]++;
+		for (size_t k = 0; k < member_count; ++k) {
+			auto& task = *tasks_[members[k]];
+			Stamp (&task, kCalculateStamp);
+			if (!is_calculated) {
+				cumulative_stats_[WORKER_PC_TASK_FAILED]++;
+				if (!WriteClose (&task, RSSL_STREAM_CLOSED_RECOVER, RSSL_SC_ERROR, kErrorInternal))
+					return false;
+				continue;
+			}
+/* Response message with analytic payload */
+			if (!task.analytic->WriteRaw (task.rwf_version, task.token, task.service_id, task.item_name, task.dacs_lock, task.view, task.slab->data(), &task.rssl_length)) {
 /* Extremely unlikely situation that writing the response fails but writing a close will not */
-			if (!provider_t::WriteRawClose (
-					rwf_version,
-					token,
-					service_id,
-					RSSL_DMT_MARKET_PRICE,
-					item_name,
-					use_attribinfo_in_updates,
-					RSSL_STREAM_CLOSED_RECOVER, RSSL_SC_ERROR, kErrorInternal,
-					rssl_buf_,
-					&rssl_length_
-					))
-			{
-				return false;
+				cumulative_stats_[WORKER_PC_TASK_FAILED]++;
+				if (!WriteClose (&task, RSSL_STREAM_CLOSED_RECOVER, RSSL_SC_ERROR, kErrorInternal))
+					return false;
+				continue;
 			}
-			goto send_reply;
+			Stamp (&task, kEncodeStamp);
+			task.analytic = nullptr;
 		}
 	}
 
-send_reply:
-	auto t1 = high_resolution_clock::now();
-	VLOG(3) << prefix_ << boost::chrono::duration_cast<boost::chrono::milliseconds> (t1 - t0).count() << "ms @ " << item_name;
-	return SendReply (handle, token);
+	for (size_t i = 0; i < task_count_; ++i) {
+		VLOG(3) << prefix_ << (tasks_[i]->stamps[kEncodeStamp] - tasks_[i]->stamps[kDequeueStamp]) << "ns @ " << tasks_[i]->item_name;
+		if (!SendReply (tasks_[i].get()))
+			return false;
+	}
+	return true;
 }
 
+/* Responses are encoded directly into a pooled slab, a slab is kept across requests until
+ * it is handed over with a reply.  The tail of the slab is reserved for the timestamps.
+ */
+void
+hitsuji::worker_t::ResetBuffer (
+	task_t* task
+	)
+{
+	if (nullptr == task->slab)
+		task->slab = slab_pool_->Acquire();
+	task->rssl_length = task->slab->capacity() - kReplyTrailerSize;
+}
+
+/* Write a close response for the request in place of an analytic payload.
+ */
+bool
+hitsuji::worker_t::WriteClose (
+	task_t* task,
+	uint8_t stream_state,
+	uint8_t status_code,
+	const std::string& status_text
+	)
+{
+	task->analytic = nullptr;
+	task->analytic_type = Analytic::none;
+	ResetBuffer (task);
+	const bool is_written = provider_t::WriteRawClose (
+			task->rwf_version,
+			task->token,
+			task->service_id,
+			RSSL_DMT_MARKET_PRICE,
+			task->item_name,
+			task->use_attribinfo_in_updates,
+			stream_state, status_code, status_text,
+			task->slab->data(),
+			&task->rssl_length
+			);
+	Stamp (task, kEncodeStamp);
+	return is_written;
+}
+
+/* Reply header frame followed by the encoded response and timestamps as a second frame
+ * referencing the slab, ownership of the slab passes to ZeroMQ.  The header frame is held
+ * inline by ZeroMQ without allocation.
+ */
 bool
 hitsuji::worker_t::SendReply(
-	uintptr_t handle,
-	int32_t token
+	task_t* task
 	)
 {
 	static const int version = 0;
+	const uint64_t send_time = (nullptr != trace_) ? monotonic_nanoseconds() : 0;
 	int rc;
-	rc = zmq_msg_init_size (&zmq_msg_, MessageHeader::size() + Reply::sbeBlockLength() + Reply::rsslBufferHeaderSize() + rssl_length_);
+	if (task->shard >= reply_socks_.size()) {
+		LOG(ERROR) << prefix_ << "Reply dropped for unknown shard " << static_cast<unsigned> (task->shard) << ".";
+		return true;
+	}
+	rc = zmq_msg_init_size (&zmq_msg_, MessageHeader::size() + Reply::sbeBlockLength());
 	if (-1 == rc) {
 		LOG(ERROR) << prefix_ << "zmq_msg_init_size failed: " << zmq_strerror (zmq_errno());
-		return false;		}
+		return false;
+	}
 	sbe_hdr_->wrap (reinterpret_cast<char*> (zmq_msg_data (&zmq_msg_)), 0, version, static_cast<int> (zmq_msg_size (&zmq_msg_)))
 		.blockLength (Reply::sbeBlockLength())
 		.templateId (Reply::sbeTemplateId())
 		.schemaId (Reply::sbeSchemaId())
 		.version (Reply::sbeSchemaVersion());
 	sbe_reply_->wrapForEncode (reinterpret_cast<char*> (zmq_msg_data (&zmq_msg_)), sbe_hdr_->size(), static_cast<int> (zmq_msg_size (&zmq_msg_)))
-		.handle (handle)
-		.token (token);
-	sbe_reply_->putRsslBuffer (rssl_buf_, static_cast<int> (rssl_length_));
-	rc = zmq_msg_send (&zmq_msg_, reply_sock_.get(), 0);
+		.handle (task->handle)
+		.token (task->token)
+		.shard (task->shard)
+		.analytic (static_cast<Analytic::Value> (task->analytic_type));
+	CopyMemory (task->slab->data() + task->rssl_length, task->stamps, kReplyTrailerSize);
+	rc = zmq_msg_init_data (&zmq_payload_, task->slab->data(), task->rssl_length + kReplyTrailerSize, &slab_pool_t::OnFree, task->slab);
+	if (-1 == rc) {
+		LOG(ERROR) << prefix_ << "zmq_msg_init_data failed: " << zmq_strerror (zmq_errno());
+		rc = zmq_msg_close (&zmq_msg_);
+		LOG_IF(ERROR, -1 == rc) << prefix_ << "zmq_msg_close failed: " << zmq_strerror (zmq_errno());
+		return false;
+	}
+/* released by ZeroMQ after the event loop closes the payload. */
+	task->slab = nullptr;
+	void* reply_sock = reply_socks_[task->shard].get();
+	rc = zmq_msg_send (&zmq_msg_, reply_sock, ZMQ_SNDMORE);
 	if (-1 == rc) {
 		LOG(ERROR) << prefix_ << "zmq_send failed: " << zmq_strerror (zmq_errno());
 		rc = zmq_msg_close (&zmq_msg_);
 		LOG_IF(ERROR, -1 == rc) << prefix_ << "zmq_msg_close failed: " << zmq_strerror (zmq_errno());
+		rc = zmq_msg_close (&zmq_payload_);
+		LOG_IF(ERROR, -1 == rc) << prefix_ << "zmq_msg_close failed: " << zmq_strerror (zmq_errno());
 		return false;
-	} else {
-		return true;
 	}
+	rc = zmq_msg_send (&zmq_payload_, reply_sock, 0);
+	if (-1 == rc) {
+		LOG(ERROR) << prefix_ << "zmq_send failed: " << zmq_strerror (zmq_errno());
+		rc = zmq_msg_close (&zmq_payload_);
+		LOG_IF(ERROR, -1 == rc) << prefix_ << "zmq_msg_close failed: " << zmq_strerror (zmq_errno());
+		return false;
+	}
+	cumulative_stats_[WORKER_PC_REPLY_SENT]++;
+	if (nullptr != trace_)
+		trace_->Complete (kTraceSend, task->handle, task->token, send_time, monotonic_nanoseconds(), static_cast<uint32_t> (task->rssl_length));
+	return true;
+}
+
+/* Timestamp a stage, stages skipped by an early close repeat the preceding timestamp.  The
+ * stage is traced from the preceding timestamp, so parts of a refresh encode in sequence.
+ */
+void
+hitsuji::worker_t::Stamp (
+	task_t* task,
+	unsigned stage
+	)
+{
+	const uint64_t now = monotonic_nanoseconds();
+	if (nullptr != trace_ && kTraceNone != kStageTraceEvents[stage])
+		trace_->Complete (kStageTraceEvents[stage], task->handle, task->token, task->stamps[task->last_stamp], now);
+	for (unsigned i = task->last_stamp + 1; i < stage; ++i)
+		task->stamps[i] = task->stamps[i - 1];
+	task->stamps[stage] = now;
+	task->last_stamp = stage;
 }
 
 void
@@ -397,29 +549,97 @@ void
 hitsuji::worker_t::MainLoop()
 {
 	int rc;
+	bool is_muted = false;
 	LOG(INFO) << prefix_ << "Accepting requests.";
-	while (true) {
-		rc = zmq_msg_init (&zmq_msg_);
-		if (-1 == rc) {
-			LOG(ERROR) << "zmq_msg_init failed: " << zmq_strerror (zmq_errno());
-			break;
-		}
-		rc = zmq_msg_recv (&zmq_msg_, request_sock_.get(), 0);
-		if (-1 == rc) {
-			LOG(ERROR) << "zmq_recv failed: " << zmq_strerror (zmq_errno());
-			zmq_msg_close (&zmq_msg_);
-			break;
-		}
-		if (!OnTask (zmq_msg_data (&zmq_msg_), zmq_msg_size (&zmq_msg_))) {
-			break;
+	while (!is_muted) {
+/* Block for the first request then drain whatever else is already queued into the batch. */
+		task_count_ = 0;
+		while (task_count_ < kMaxBatchSize) {
+			rc = zmq_msg_init (&zmq_msg_);
+			if (-1 == rc) {
+				LOG(ERROR) << "zmq_msg_init failed: " << zmq_strerror (zmq_errno());
+				is_muted = true;
+				break;
+			}
+			rc = zmq_msg_recv (&zmq_msg_, request_sock_.get(), (0 == task_count_) ? 0 : ZMQ_DONTWAIT);
+			if (-1 == rc) {
+				const int errnum = zmq_errno();
+				zmq_msg_close (&zmq_msg_);
+				if (EAGAIN == errnum)
+					break;
+				LOG(ERROR) << "zmq_recv failed: " << zmq_strerror (errnum);
+				is_muted = true;
+				break;
+			}
+/* Message is the address of the request slab. */
+			if (sizeof (slab_pool_t::slab_t*) != zmq_msg_size (&zmq_msg_)) {
+				LOG(ERROR) << prefix_ << "Discarding request of unexpected size " << zmq_msg_size (&zmq_msg_) << ".";
+				zmq_msg_close (&zmq_msg_);
+				continue;
+			}
+			slab_pool_t::slab_t* slab;
+			CopyMemory (&slab, zmq_msg_data (&zmq_msg_), sizeof (slab));
+			rc = zmq_msg_close (&zmq_msg_);
+			if (-1 == rc) {
+				LOG(ERROR) << "zmq_msg_close failed: " << zmq_strerror (zmq_errno());
+				request_pool_->Release (slab);
+				is_muted = true;
+				break;
+			}
+/* Task state is copied out of the slab, return it before calculation. */
+			const bool is_accepted = OnTask (slab->data(), slab->capacity(), tasks_[task_count_].get());
+			request_pool_->Release (slab);
+			if (!is_accepted) {
+				is_muted = true;
+				break;
+			}
+			++task_count_;
 		}
-		rc = zmq_msg_close (&zmq_msg_);
-		if (-1 == rc) {
-			LOG(ERROR) << "zmq_msg_close failed: " << zmq_strerror (zmq_errno());
-			break;
+/* Complete requests already taken from the queue before muting. */
+		if (task_count_ > 0) {
+			const bool is_sent = OnBatch();
+/* Busy from taking the first request of the batch. */
+			cumulative_stats_[WORKER_PC_BUSY_TIME_US] += (monotonic_nanoseconds() - tasks_[0]->stamps[kDequeueStamp]) / 1000;
+/* Idle workers block on the queue, their counters cannot change meanwhile. */
+			if (0 != stats_slot_)
+				PublishStats();
+			if (!is_sent)
+				break;
 		}
 	}
 	LOG(INFO) << prefix_ << "Muted.";
+	if (0 != stats_slot_)
+		PublishStats();
+/* Summary output */
+	VLOG(3) << prefix_ << "Worker summary: {"
+		 " \"Id\": " << id_ <<
+		", \"TasksReceived\": " << cumulative_stats_[WORKER_PC_TASK_RECEIVED] <<
+		", \"TasksMalformed\": " << cumulative_stats_[WORKER_PC_TASK_MALFORMED] <<
+		", \"TasksNotFound\": " << cumulative_stats_[WORKER_PC_TASK_NOT_FOUND] <<
+		", \"TasksNotEntitled\": " << cumulative_stats_[WORKER_PC_TASK_NOT_ENTITLED] <<
+		", \"TasksFailed\": " << cumulative_stats_[WORKER_PC_TASK_FAILED] <<
+		", \"Batches\": " << cumulative_stats_[WORKER_PC_BATCH_CALCULATED] <<
+		", \"RepliesSent\": " << cumulative_stats_[WORKER_PC_REPLY_SENT] <<
+		", \"BusyTimeUs\": " << cumulative_stats_[WORKER_PC_BUSY_TIME_US] <<
+		", \"QueueWaitUs\": " << cumulative_stats_[WORKER_PC_QUEUE_WAIT_US] <<
+		" }";
+}
+
+/* Plain stores into this thread's column, one batch behind at most. */
+void
+hitsuji::worker_t::PublishStats()
+{
+	worker_rows_.Publish (cumulative_stats_);
+	if (0 == id_) {
+		uint64_t cache_stats[CACHE_PC_MAX];
+		cache_stats[CACHE_PC_PERMDATA_HITS] = permdata_->hits();
+		cache_stats[CACHE_PC_PERMDATA_MISSES] = permdata_->misses();
+		cache_stats[CACHE_PC_PERMDATA_SAVED_MS] = boost::chrono::duration_cast<boost::chrono::milliseconds> (permdata_->saved_latency()).count();
+		cache_stats[CACHE_PC_SYMBOL_HITS] = symbol_table_->hits();
+		cache_stats[CACHE_PC_SYMBOL_NEGATIVE_HITS] = symbol_table_->negative_hits();
+		cache_stats[CACHE_PC_SYMBOL_ENGINE_LOOKUPS] = symbol_table_->engine_lookups();
+		cache_rows_.Publish (cache_stats);
+	}
 }
 
 /* eof */
\ No newline at end of file
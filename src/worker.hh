@@ -6,6 +6,8 @@
 
 #include <cstdint>
 #include <memory>
+#include <string>
+#include <vector>
 
 /* Boost threading */
 #include <boost/thread.hpp>
@@ -17,11 +19,13 @@
 #include <vpf/vpf.h>
 
 #include "chromium/debug/leak_tracker.hh"
-#include "googleurl/url_parse.h"
 #include "chromium/string_piece.hh"
-
-/* Maximum encoded size of an RSSL provider to client message. */
-#define MAX_MSG_SIZE 4096
+#include "counters.hh"
+#include "latency.hh"
+#include "slab_pool.hh"
+#include "stats.hh"
+#include "trace.hh"
+#include "vta.hh"
 
 namespace vta
 {
@@ -34,10 +38,33 @@ namespace vta
 namespace vhayu
 {
 	class permdata_t;
+	class symbol_table_t;
 }
 
 namespace hitsuji
 {
+/* Performance Counters */
+	enum {
+		WORKER_PC_TASK_RECEIVED,
+		WORKER_PC_TASK_MALFORMED,
+		WORKER_PC_TASK_NOT_FOUND,
+		WORKER_PC_TASK_NOT_ENTITLED,
+		WORKER_PC_TASK_FAILED,
+		WORKER_PC_BATCH_CALCULATED,
+		WORKER_PC_REPLY_SENT,
+/* Calculated requests per analytic, in SBE Analytic order. */
+		WORKER_PC_BAR_REQUEST,
+		WORKER_PC_ROLLUP_BAR_REQUEST,
+		WORKER_PC_CLOSE_REQUEST,
+		WORKER_PC_TEST_REQUEST,
+/* Microseconds from the first request of a batch until every reply is sent. */
+		WORKER_PC_BUSY_TIME_US,
+/* Microseconds requests waited in the queue for any worker. */
+		WORKER_PC_QUEUE_WAIT_US,
+/* marker */
+		WORKER_PC_MAX
+	};
+
 	class provider_t;
 	class MessageHeader;
 	class Request;
@@ -46,7 +73,7 @@ namespace hitsuji
 	class worker_t
 	{
 	public:
-		explicit worker_t (std::shared_ptr<void>& zmq_context);
+		worker_t (std::shared_ptr<void>& zmq_context, std::shared_ptr<vhayu::permdata_t>& permdata, std::shared_ptr<vhayu::symbol_table_t>& symbol_table, std::shared_ptr<slab_pool_t>& slab_pool, std::shared_ptr<slab_pool_t>& request_pool, size_t shard_count, size_t trace_ring_size);
 		virtual ~worker_t();
 
 		bool Initialize (size_t id);
@@ -55,48 +82,109 @@ namespace hitsuji
 /* Run core event loop. */
 		void MainLoop();
 
-		bool OnTask (const void* buffer, size_t length);
+		size_t id() const {
+			return id_;
+		}
+/* Owned by the worker thread, readable from any thread. */
+		const counters_t<WORKER_PC_MAX>& cumulative_stats() const {
+			return cumulative_stats_;
+		}
 
 	private:
+/* Per request state, one per batch slot. */
+		struct task_t
+		{
+			uint64_t handle;
+/* Event loop owning the client connection. */
+			uint8_t shard;
+			uint16_t rwf_version;
+			int32_t token;
+			uint16_t service_id;
+			bool use_attribinfo_in_updates;
+			std::string item_name;
+/* Parsing state for requested items. */
+			std::string underlying_symbol;
+/* Permission data */
+			std::string dacs_lock;
+/* Sorted field identifiers of a view request, empty for all fields. */
+			vta::view_t view;
+/* Selected analytic, nullptr when a close response has been written instead. */
+			vta::intraday_t* analytic;
+/* Analytics */
+			std::shared_ptr<vta::bar_t> vta_bar;
+			std::shared_ptr<vta::rollup_bar_t> vta_rollup_bar;
+			std::shared_ptr<vta::close_t> vta_close;
+			std::shared_ptr<vta::test_t> vta_test;
+/* Rssl message buffer, owned until handed to ZeroMQ with the reply. */
+			slab_pool_t::slab_t* slab;
+			size_t rssl_length;
+/* SBE Analytic of the reply and per stage timestamps up to encoding. */
+			unsigned analytic_type;
+			uint64_t stamps[kLatencyStampCount];
+			unsigned last_stamp;
+		};
+
 /* Per thread workspace. */
 		bool AcquireFlexRecordCursor();
 
-		bool SendReply (uintptr_t handle, int32_t token);
+		bool OnTask (const void* buffer, size_t length, task_t* task);
+		bool OnBatch();
+		void ResetBuffer (task_t* task);
+		bool WriteClose (task_t* task, uint8_t stream_state, uint8_t status_code, const std::string& status_text);
+		bool SendReply (task_t* task);
+		void Stamp (task_t* task, unsigned stage);
+		void PublishStats();
 
 /* unique id per worker for trace. */
+		size_t id_;
 		std::string prefix_;
 
 /* ZMQ context. */
 		std::shared_ptr<void> zmq_context_;
+/* Fair-queued from every shard. */
 		std::shared_ptr<void> request_sock_;
-		std::shared_ptr<void> reply_sock_;
+/* One per shard, replies return to the shard of the request. */
+		std::vector<std::shared_ptr<void>> reply_socks_;
+		const size_t shard_count_;
+/* Records per trace ring, config_t::trace_ring_size. */
+		const size_t trace_ring_size_;
 /* As worker state: */
-/* Parsing state for requested items. */
-		std::string url_;
-		std::string underlying_symbol_;
-/* Permission data */
+/* Requests drained from the queue to share FlexRecord cursors. */
+		std::vector<std::shared_ptr<task_t>> tasks_;
+		size_t task_count_;
+/* Permission data, shared by all workers */
 		std::shared_ptr<vhayu::permdata_t> permdata_;
-		std::string dacs_lock_;
+/* Symbol handles, shared by all workers */
+		std::shared_ptr<vhayu::symbol_table_t> symbol_table_;
+/* Reply encode buffers, shared by all workers and event loops */
+		std::shared_ptr<slab_pool_t> slab_pool_;
+/* Request buffers, released once decoded */
+		std::shared_ptr<slab_pool_t> request_pool_;
 /* FlexRecord cursor */
 		FlexRecDefinitionManager* manager_;
 		std::shared_ptr<FlexRecWorkAreaElement> work_area_;
 		std::shared_ptr<FlexRecViewElement> view_element_;
 /* ZMQ message */
 		zmq_msg_t zmq_msg_;
+		zmq_msg_t zmq_payload_;
 /* Sbe message buffer */
 		std::shared_ptr<MessageHeader> sbe_hdr_;
 		std::shared_ptr<Request> sbe_request_;
 		std::shared_ptr<Reply> sbe_reply_;
-		char sbe_buf_[MAX_MSG_SIZE];
-		size_t sbe_length_;
-/* Rssl message buffer */
-		char rssl_buf_[MAX_MSG_SIZE];
-		size_t rssl_length_;
-/* Analytics */
-		std::shared_ptr<vta::bar_t> vta_bar_;
-		std::shared_ptr<vta::rollup_bar_t> vta_rollup_bar_;
-		std::shared_ptr<vta::close_t> vta_close_;
-		std::shared_ptr<vta::test_t> vta_test_;
+
+/** Performance Counters **/
+		counters_t<WORKER_PC_MAX> cumulative_stats_;
+/* Column of the shared-memory stats table, the first worker also exports the caches. */
+		int stats_slot_;
+		stats_rows_t<WORKER_PC_MAX> worker_rows_;
+		stats_rows_t<CACHE_PC_MAX> cache_rows_;
+/* Binary trace of tasks and FlexRecord calls, registered on the worker thread. */
+		trace_ring_t* trace_;
+
+#ifdef HITSUJIMIB_H
+		friend Netsnmp_Next_Data_Point hitsujiWorkerTable_get_next_data_point;
+		friend Netsnmp_Node_Handler hitsujiWorkerTable_handler;
+#endif /* HITSUJIMIB_H */
 
 		chromium::debug::LeakTracker<worker_t> leak_tracker_;
 	};
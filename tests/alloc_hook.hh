@@ -0,0 +1,66 @@
+/* Global allocation counter for unit tests and benchmarks.
+ *
+ * Replaces the global operator new and delete of the including executable, include from one
+ * translation unit only.  Not thread-safe, tests allocate from a single thread.
+ */
+
+#ifndef ALLOC_HOOK_HH_
+#define ALLOC_HOOK_HH_
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace testing
+{
+	static size_t g_allocation_count = 0;
+
+/* Allocations since process start, compare before and after the code under test. */
+	static inline
+	size_t
+	allocation_count()
+	{
+		return g_allocation_count;
+	}
+
+} /* namespace testing */
+
+void*
+operator new (
+	size_t size
+	)
+{
+	++testing::g_allocation_count;
+	void* p = malloc (0 == size ? 1 : size);
+	if (nullptr == p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void*
+operator new[] (
+	size_t size
+	)
+{
+	return operator new (size);
+}
+
+void
+operator delete (
+	void* p
+	) throw()
+{
+	free (p);
+}
+
+void
+operator delete[] (
+	void* p
+	) throw()
+{
+	free (p);
+}
+
+#endif /* ALLOC_HOOK_HH_ */
+
+/* eof */
@@ -0,0 +1,170 @@
+/* Encoded response cache tests.
+ *
+ * Directory images must be distinct per RWF version, message class and filter mask and go
+ * stale on every invalidation, login images must be distinct per login name, name type and
+ * RWF version and survive invalidation within the login capacity.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "encoded_cache.hh"
+
+using namespace hitsuji;
+
+static int g_failures = 0;
+
+#define EXPECT(condition) \
+	do { \
+		if (!(condition)) { \
+			fprintf (stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+			++g_failures; \
+		} \
+	} while (0)
+
+/* Returns true if the cached image holds exactly the given text. */
+static
+bool
+IsImage (
+	const std::vector<char>* encoded,
+	const std::string& image
+	)
+{
+	return nullptr != encoded && std::string (encoded->begin(), encoded->end()) == image;
+}
+
+/* Every combination of the key fields, including the extremes of each, maps to its own key. */
+static
+void
+TestDirectoryKeys()
+{
+	static const uint16_t kRwfVersions[] = { 0, 1, 255, 256, (14 * 256) + 1, UINT16_MAX };
+	static const uint8_t kMsgClasses[] = { 0, 1, 2, 0x7f, UINT8_MAX };
+	static const uint32_t kFilterMasks[] = { 0, 1, 2, 3, 0x3f, 0x80000000, UINT32_MAX };
+	std::set<uint64_t> keys;
+	size_t count = 0;
+	for (size_t i = 0; i < sizeof (kRwfVersions) / sizeof (kRwfVersions[0]); ++i)
+		for (size_t j = 0; j < sizeof (kMsgClasses) / sizeof (kMsgClasses[0]); ++j)
+			for (size_t k = 0; k < sizeof (kFilterMasks) / sizeof (kFilterMasks[0]); ++k) {
+				keys.insert (encoded_cache_t::directory_key (kRwfVersions[i], kMsgClasses[j], kFilterMasks[k]));
+				++count;
+			}
+	EXPECT(count == keys.size());
+}
+
+/* Names may hold any byte, a name must never run into the fields that follow it. */
+static
+void
+TestLoginKeys()
+{
+	static const char kNames[][4] = { "", "a", "ab", "b" };
+	static const uint8_t kNameTypes[] = { 0, 1, 2, UINT8_MAX };
+	static const uint16_t kRwfVersions[] = { 0, 1, 256, (14 * 256) + 1, UINT16_MAX };
+	std::vector<std::string> names;
+	for (size_t i = 0; i < sizeof (kNames) / sizeof (kNames[0]); ++i)
+		names.push_back (kNames[i]);
+/* Prefixes of a key built from a shorter name. */
+	names.push_back (std::string ("a\0", 2));
+	names.push_back (std::string ("a\0\x01", 3));
+	names.push_back (std::string ("a\0\x01\x0e", 4));
+	names.push_back (std::string ("a\0\x01\x0e\x01", 5));
+	std::set<std::string> keys;
+	size_t count = 0;
+	std::string key;
+	for (size_t i = 0; i < names.size(); ++i)
+		for (size_t j = 0; j < sizeof (kNameTypes) / sizeof (kNameTypes[0]); ++j)
+			for (size_t k = 0; k < sizeof (kRwfVersions) / sizeof (kRwfVersions[0]); ++k) {
+				encoded_cache_t::login_key (names[i], kNameTypes[j], kRwfVersions[k], &key);
+				keys.insert (key);
+				++count;
+			}
+	EXPECT(count == keys.size());
+}
+
+/* Images are served until invalidated, refresh and update images are independent. */
+static
+void
+TestDirectoryInvalidation()
+{
+	encoded_cache_t cache (2);
+	const uint64_t refresh_v14 = encoded_cache_t::directory_key ((14 * 256) + 1, 2, 0x3f);
+	const uint64_t refresh_v13 = encoded_cache_t::directory_key ((13 * 256) + 1, 2, 0x3f);
+	const uint64_t update_v14 = encoded_cache_t::directory_key ((14 * 256) + 1, 3, 0x3f);
+	EXPECT(nullptr == cache.GetDirectory (refresh_v14));
+	const std::vector<char>& stored = cache.SetDirectory (refresh_v14, "refresh-14", 10);
+	EXPECT(IsImage (&stored, "refresh-14"));
+	EXPECT(IsImage (cache.GetDirectory (refresh_v14), "refresh-14"));
+	EXPECT(nullptr == cache.GetDirectory (refresh_v13));
+	EXPECT(nullptr == cache.GetDirectory (update_v14));
+	cache.SetDirectory (update_v14, "update-14", 9);
+	EXPECT(IsImage (cache.GetDirectory (refresh_v14), "refresh-14"));
+	EXPECT(IsImage (cache.GetDirectory (update_v14), "update-14"));
+/* State change: every image is stale, including ones not yet requested again. */
+	cache.Invalidate();
+	EXPECT(nullptr == cache.GetDirectory (refresh_v14));
+	EXPECT(nullptr == cache.GetDirectory (update_v14));
+/* Re-encoded image is fresh, the other remains stale until re-encoded. */
+	cache.SetDirectory (refresh_v14, "refresh-14b", 11);
+	EXPECT(IsImage (cache.GetDirectory (refresh_v14), "refresh-14b"));
+	EXPECT(nullptr == cache.GetDirectory (update_v14));
+/* Repeated changes, an image stored between two is stale after the second. */
+	cache.Invalidate();
+	cache.SetDirectory (update_v14, "update-14b", 10);
+	cache.Invalidate();
+	EXPECT(nullptr == cache.GetDirectory (update_v14));
+	EXPECT(nullptr == cache.GetDirectory (refresh_v14));
+	EXPECT(2 == cache.directory_count());
+/* Empty image is still an image. */
+	cache.SetDirectory (refresh_v13, "", 0);
+	EXPECT(IsImage (cache.GetDirectory (refresh_v13), ""));
+}
+
+/* Logins are independent of service state and bounded by capacity. */
+static
+void
+TestLogins()
+{
+	encoded_cache_t cache (2);
+	std::string ads, ads_v13, other, third;
+	encoded_cache_t::login_key ("ads", 1, (14 * 256) + 1, &ads);
+	encoded_cache_t::login_key ("ads", 1, (13 * 256) + 1, &ads_v13);
+	encoded_cache_t::login_key ("other", 1, (14 * 256) + 1, &other);
+	encoded_cache_t::login_key ("third", 1, (14 * 256) + 1, &third);
+	EXPECT(nullptr == cache.GetLogin (ads));
+	cache.SetLogin (ads, "login-ads", 9);
+	EXPECT(IsImage (cache.GetLogin (ads), "login-ads"));
+	EXPECT(nullptr == cache.GetLogin (ads_v13));
+	cache.Invalidate();
+	EXPECT(IsImage (cache.GetLogin (ads), "login-ads"));
+/* Replacing a key at capacity keeps the others. */
+	cache.SetLogin (other, "login-other", 11);
+	cache.SetLogin (ads, "login-ads2", 10);
+	EXPECT(2 == cache.login_count());
+	EXPECT(IsImage (cache.GetLogin (ads), "login-ads2"));
+	EXPECT(IsImage (cache.GetLogin (other), "login-other"));
+/* A new key at capacity starts over. */
+	cache.SetLogin (third, "login-third", 11);
+	EXPECT(1 == cache.login_count());
+	EXPECT(IsImage (cache.GetLogin (third), "login-third"));
+	EXPECT(nullptr == cache.GetLogin (ads));
+	EXPECT(nullptr == cache.GetLogin (other));
+}
+
+int
+main (
+	int	argc,
+	char*	argv[]
+	)
+{
+	TestDirectoryKeys();
+	TestLoginKeys();
+	TestDirectoryInvalidation();
+	TestLogins();
+	printf ("EncodedCache: { \"failures\": %d }\n", g_failures);
+	return 0 == g_failures ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */
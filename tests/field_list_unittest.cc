@@ -0,0 +1,317 @@
+/* Direct field list serialisation tests and benchmark.
+ *
+ * Output of internal::real_field_list_t must be byte identical to the RSSL iterator encoder,
+ * rsslEncodeFieldListInit, rsslEncodeFieldEntry and rsslEncodeFieldListComplete, for every
+ * real hint, blank reals, each mantissa width, and with field identifier views applied.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+/* UPA 7.4 headers */
+#include <upa/upa.h>
+
+#include "field_list.hh"
+#include "alloc_hook.hh"
+
+struct field_t
+{
+	RsslFieldId fid;
+	RsslReal real;
+};
+
+static const RsslRealHints kHints[] = {
+	RSSL_RH_EXPONENT_14, RSSL_RH_EXPONENT_13, RSSL_RH_EXPONENT_12, RSSL_RH_EXPONENT_11,
+	RSSL_RH_EXPONENT_10, RSSL_RH_EXPONENT_9, RSSL_RH_EXPONENT_8, RSSL_RH_EXPONENT_7,
+	RSSL_RH_EXPONENT_6, RSSL_RH_EXPONENT_5, RSSL_RH_EXPONENT_4, RSSL_RH_EXPONENT_3,
+	RSSL_RH_EXPONENT_2, RSSL_RH_EXPONENT_1, RSSL_RH_EXPONENT0, RSSL_RH_EXPONENT1,
+	RSSL_RH_EXPONENT2, RSSL_RH_EXPONENT3, RSSL_RH_EXPONENT4, RSSL_RH_EXPONENT5,
+	RSSL_RH_EXPONENT6, RSSL_RH_EXPONENT7,
+	RSSL_RH_FRACTION_1, RSSL_RH_FRACTION_2, RSSL_RH_FRACTION_4, RSSL_RH_FRACTION_8,
+	RSSL_RH_FRACTION_16, RSSL_RH_FRACTION_32, RSSL_RH_FRACTION_64, RSSL_RH_FRACTION_128,
+	RSSL_RH_FRACTION_256
+};
+
+/* Mantissas either side of each two's complement width boundary. */
+static const int64_t kValues[] = {
+	0, 1, -1, 127, 128, -128, -129,
+	INT64_C(32767), INT64_C(32768), INT64_C(-32768), INT64_C(-32769),
+	INT64_C(8388607), INT64_C(8388608), INT64_C(-8388608), INT64_C(-8388609),
+	INT64_C(2147483647), INT64_C(2147483648), INT64_C(-2147483648), INT64_C(-2147483649),
+	INT64_C(549755813887), INT64_C(549755813888), INT64_C(-549755813888), INT64_C(-549755813889),
+	INT64_C(140737488355327), INT64_C(140737488355328), INT64_C(-140737488355328), INT64_C(-140737488355329),
+	INT64_C(36028797018963967), INT64_C(36028797018963968), INT64_C(-36028797018963968), INT64_C(-36028797018963969),
+	INT64_MAX, INT64_MIN
+};
+
+/* Bar analytic field identifiers, plus the extremes of the signed range. */
+static const RsslFieldId kFieldIds[] = {
+	12 /* HIGH_1 */, 13 /* LOW_1 */, 19 /* OPEN_PRC */, 21 /* HST_CLOSE */, 32 /* ACVOL_1 */,
+	255, 256, 32767, -1, -32768
+};
+
+static const size_t kHintCount = sizeof (kHints) / sizeof (kHints[0]);
+static const size_t kValueCount = sizeof (kValues) / sizeof (kValues[0]);
+static const size_t kFieldIdCount = sizeof (kFieldIds) / sizeof (kFieldIds[0]);
+
+/* Reference encoding, fields outside a non-empty view are skipped as by the direct encoder.
+ *
+ * Returns false when the iterator reports an error, e.g. buffer too small.
+ */
+static
+bool
+EncodeReference (
+	const std::vector<field_t>& fields,
+	const std::vector<RsslFieldId>& view,
+	char* data,
+	size_t length,
+	RsslBuffer* encoded
+	)
+{
+	RsslEncodeIterator it = RSSL_INIT_ENCODE_ITERATOR;
+	RsslFieldList field_list = RSSL_INIT_FIELD_LIST;
+	RsslFieldEntry field = RSSL_INIT_FIELD_ENTRY;
+	RsslBuffer buf = { static_cast<uint32_t> (length), data };
+	if (RSSL_RET_SUCCESS != rsslSetEncodeIteratorBuffer (&it, &buf) ||
+	    RSSL_RET_SUCCESS != rsslSetEncodeIteratorRWFVersion (&it, RSSL_RWF_MAJOR_VERSION, RSSL_RWF_MINOR_VERSION))
+	{
+		return false;
+	}
+	field_list.flags = RSSL_FLF_HAS_STANDARD_DATA;
+	if (RSSL_RET_SUCCESS != rsslEncodeFieldListInit (&it, &field_list, 0 /* summary data */, 0 /* payload */))
+		return false;
+	for (auto jt = fields.begin(); jt != fields.end(); ++jt) {
+		if (!view.empty() && !std::binary_search (view.begin(), view.end(), jt->fid))
+			continue;
+		field.fieldId = jt->fid;
+		field.dataType = RSSL_DT_REAL;
+		if (RSSL_RET_SUCCESS != rsslEncodeFieldEntry (&it, &field, const_cast<RsslReal*> (&jt->real)))
+			return false;
+	}
+	if (RSSL_RET_SUCCESS != rsslEncodeFieldListComplete (&it, RSSL_TRUE /* commit */))
+		return false;
+	encoded->data = data;
+	encoded->length = rsslGetEncodedBufferLength (&it);
+	return true;
+}
+
+static
+bool
+EncodeDirect (
+	const std::vector<field_t>& fields,
+	const std::vector<RsslFieldId>& view,
+	char* data,
+	size_t length,
+	RsslBuffer* encoded
+	)
+{
+	internal::real_field_list_t field_list (data, length, &view);
+	for (auto jt = fields.begin(); jt != fields.end(); ++jt) {
+		if (!field_list.Append (jt->fid, jt->real))
+			break;
+	}
+	return field_list.Complete (encoded);
+}
+
+/* Returns false and reports the first differing byte on mismatch. */
+static
+bool
+Compare (
+	const char* name,
+	const std::vector<field_t>& fields,
+	const std::vector<RsslFieldId>& view
+	)
+{
+	char reference[4096], direct[4096];
+	RsslBuffer reference_buf, direct_buf;
+	if (!EncodeReference (fields, view, reference, sizeof (reference), &reference_buf)) {
+		fprintf (stderr, "FAIL %s: reference encoding failed.\n", name);
+		return false;
+	}
+	if (!EncodeDirect (fields, view, direct, sizeof (direct), &direct_buf)) {
+		fprintf (stderr, "FAIL %s: direct encoding failed.\n", name);
+		return false;
+	}
+	if (reference_buf.length != direct_buf.length) {
+		fprintf (stderr, "FAIL %s: length %u expected %u.\n", name, direct_buf.length, reference_buf.length);
+		return false;
+	}
+	for (uint32_t i = 0; i < reference_buf.length; ++i) {
+		if (reference_buf.data[i] != direct_buf.data[i]) {
+			fprintf (stderr, "FAIL %s: byte %u is 0x%02x expected 0x%02x.\n", name, i,
+				static_cast<uint8_t> (direct_buf.data[i]), static_cast<uint8_t> (reference_buf.data[i]));
+			return false;
+		}
+	}
+	return true;
+}
+
+static
+field_t
+MakeField (
+	RsslFieldId fid,
+	int64_t value,
+	RsslRealHints hint
+	)
+{
+	field_t field;
+	field.fid = fid;
+	rsslClearReal (&field.real);
+	field.real.value = value;
+	field.real.hint = hint;
+	return field;
+}
+
+static
+field_t
+MakeBlankField (
+	RsslFieldId fid
+	)
+{
+	field_t field;
+	field.fid = fid;
+	rsslBlankReal (&field.real);
+	return field;
+}
+
+int
+main (
+	int	argc,
+	char*	argv[]
+	)
+{
+	int failures = 0;
+	char name[128];
+	const std::vector<RsslFieldId> no_view;
+/* Every hint and mantissa as a single field. */
+	for (size_t h = 0; h < kHintCount; ++h) {
+		for (size_t v = 0; v < kValueCount; ++v) {
+			std::vector<field_t> fields (1, MakeField (kFieldIds[0], kValues[v], kHints[h]));
+			sprintf (name, "real(hint=%d,value=%lld)", static_cast<int> (kHints[h]), static_cast<long long> (kValues[v]));
+			if (!Compare (name, fields, no_view))
+				++failures;
+		}
+	}
+/* Every field identifier, blank and populated. */
+	for (size_t f = 0; f < kFieldIdCount; ++f) {
+		std::vector<field_t> fields;
+		fields.push_back (MakeBlankField (kFieldIds[f]));
+		fields.push_back (MakeField (kFieldIds[f], 12345, RSSL_RH_EXPONENT_2));
+		sprintf (name, "fid(%d)", static_cast<int> (kFieldIds[f]));
+		if (!Compare (name, fields, no_view))
+			++failures;
+	}
+/* Empty field list. */
+	if (!Compare ("empty", std::vector<field_t>(), no_view))
+		++failures;
+/* Bar image: HIGH_1, LOW_1, OPEN_PRC, HST_CLOSE, ACVOL_1, blank and populated. */
+	std::vector<field_t> image, blank_image;
+	image.push_back (MakeField (12, 4512, RSSL_RH_EXPONENT_2));
+	image.push_back (MakeField (13, 4498, RSSL_RH_EXPONENT_2));
+	image.push_back (MakeField (19, 4501, RSSL_RH_EXPONENT_2));
+	image.push_back (MakeField (21, 4507, RSSL_RH_EXPONENT_2));
+	image.push_back (MakeField (32, INT64_C(72057594037927935), RSSL_RH_EXPONENT0));
+	for (auto it = image.begin(); it != image.end(); ++it)
+		blank_image.push_back (MakeBlankField (it->fid));
+	if (!Compare ("image", image, no_view))
+		++failures;
+	if (!Compare ("blank image", blank_image, no_view))
+		++failures;
+/* Views: single field, subset, superset, disjoint, and negative identifiers, sorted as by
+ * client_t::ParseView.
+ */
+	static const RsslFieldId kHstClose[] = { 21 };
+	static const RsslFieldId kAcvol[] = { 32 };
+	static const RsslFieldId kSubset[] = { 13, 21 };
+	static const RsslFieldId kSuperset[] = { -1, 1, 12, 13, 19, 21, 22, 32, 1000 };
+	static const RsslFieldId kDisjoint[] = { 1, 2, 3 };
+	struct {
+		const char* name;
+		const RsslFieldId* fids;
+		size_t count;
+	} views[] = {
+		{ "view HST_CLOSE", kHstClose, 1 },
+		{ "view ACVOL_1", kAcvol, 1 },
+		{ "view subset", kSubset, 2 },
+		{ "view superset", kSuperset, sizeof (kSuperset) / sizeof (kSuperset[0]) },
+		{ "view disjoint", kDisjoint, sizeof (kDisjoint) / sizeof (kDisjoint[0]) }
+	};
+	for (size_t i = 0; i < sizeof (views) / sizeof (views[0]); ++i) {
+		const std::vector<RsslFieldId> view (views[i].fids, views[i].fids + views[i].count);
+		if (!Compare (views[i].name, image, view))
+			++failures;
+		sprintf (name, "blank %s", views[i].name);
+		if (!Compare (name, blank_image, view))
+			++failures;
+	}
+/* Short buffers: the direct encoder reserves the widest real per field so may fail before
+ * the iterator, it must never write past the buffer, and output must match when both succeed.
+ */
+	for (size_t length = 0; length < 64; ++length) {
+		static const char kGuard = '\x5a';
+		char reference[64], direct[64 + 16];
+		RsslBuffer reference_buf, direct_buf;
+		memset (direct, kGuard, sizeof (direct));
+		const bool is_reference = EncodeReference (image, no_view, reference, length, &reference_buf);
+		const bool is_direct = EncodeDirect (image, no_view, direct, length, &direct_buf);
+		for (size_t i = length; i < sizeof (direct); ++i) {
+			if (kGuard != direct[i]) {
+				fprintf (stderr, "FAIL overflow(%u): byte %u written past buffer.\n", static_cast<unsigned> (length), static_cast<unsigned> (i));
+				++failures;
+				break;
+			}
+		}
+		if (is_direct && !is_reference) {
+			fprintf (stderr, "FAIL overflow(%u): direct succeeded where the iterator failed.\n", static_cast<unsigned> (length));
+			++failures;
+		} else if (is_direct && (reference_buf.length != direct_buf.length || 0 != memcmp (reference_buf.data, direct_buf.data, direct_buf.length))) {
+			fprintf (stderr, "FAIL overflow(%u): output differs.\n", static_cast<unsigned> (length));
+			++failures;
+		}
+	}
+/* Benchmark: bar image refresh payload, direct and via the iterator. */
+	using namespace boost::chrono;
+	static const unsigned kIterations = 1000000;
+	char buffer[256];
+	RsslBuffer encoded;
+	size_t bytes = 0;
+	const size_t allocations = testing::allocation_count();
+	auto t0 = high_resolution_clock::now();
+	for (unsigned n = 0; n < kIterations; ++n) {
+		EncodeDirect (image, no_view, buffer, sizeof (buffer), &encoded);
+		bytes += encoded.length;
+	}
+	auto t1 = high_resolution_clock::now();
+	const size_t direct_allocations = testing::allocation_count() - allocations;
+	for (unsigned n = 0; n < kIterations; ++n) {
+		EncodeReference (image, no_view, buffer, sizeof (buffer), &encoded);
+		bytes += encoded.length;
+	}
+	auto t2 = high_resolution_clock::now();
+	printf ("FieldList: { "
+		"\"failures\": %d"
+		", \"iterations\": %u"
+		", \"directNs\": %.1f"
+		", \"directAllocations\": %u"
+		", \"iteratorNs\": %.1f"
+		", \"bytes\": %u"
+		" }\n",
+		failures,
+		kIterations,
+		static_cast<double> (duration_cast<nanoseconds> (t1 - t0).count()) / kIterations,
+		static_cast<unsigned> (direct_allocations),
+		static_cast<double> (duration_cast<nanoseconds> (t2 - t1).count()) / kIterations,
+		static_cast<unsigned> (bytes));
+	if (0 != direct_allocations) {
+		fprintf (stderr, "FAIL: %u allocations encoding field lists.\n", static_cast<unsigned> (direct_allocations));
+		++failures;
+	}
+	return 0 == failures ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */
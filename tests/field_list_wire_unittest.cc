@@ -0,0 +1,347 @@
+/* Direct field list serialisation against the RWF wire format.
+ *
+ * Unlike field_list_unittest this needs only the UPA type declarations, not the runtime, so
+ * it runs wherever the tree builds.  Output of internal::real_field_list_t is decoded by an
+ * independent reader of the standard field list layout, checked against hand-assembled
+ * bytes for the bar image, and guarded against writing past short buffers.
+ *
+ *	flags (1), field count (2, big-endian), then per field:
+ *	field identifier (2, big-endian), length (1), [hint (1), mantissa (length - 1)]
+ *
+ * A blank real is a zero length entry, a mantissa is the shortest two's complement form.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+/* UPA 7.4 headers */
+#include <upa/upa.h>
+
+#include "field_list.hh"
+#include "alloc_hook.hh"
+
+struct field_t
+{
+	RsslFieldId fid;
+	bool is_blank;
+	uint8_t hint;
+	int64_t value;
+};
+
+/* Every hint value, RSSL_RH_EXPONENT_14 through RSSL_RH_FRACTION_256. */
+static const uint8_t kHintCount = RSSL_RH_FRACTION_256 + 1;
+
+/* Mantissas either side of each two's complement width boundary. */
+static const int64_t kValues[] = {
+	0, 1, -1, 127, 128, -128, -129,
+	INT64_C(32767), INT64_C(32768), INT64_C(-32768), INT64_C(-32769),
+	INT64_C(8388607), INT64_C(8388608), INT64_C(-8388608), INT64_C(-8388609),
+	INT64_C(2147483647), INT64_C(2147483648), INT64_C(-2147483648), INT64_C(-2147483649),
+	INT64_C(549755813887), INT64_C(549755813888), INT64_C(-549755813888), INT64_C(-549755813889),
+	INT64_C(140737488355327), INT64_C(140737488355328), INT64_C(-140737488355328), INT64_C(-140737488355329),
+	INT64_C(36028797018963967), INT64_C(36028797018963968), INT64_C(-36028797018963968), INT64_C(-36028797018963969),
+	INT64_MAX, INT64_MIN
+};
+static const size_t kValueCount = sizeof (kValues) / sizeof (kValues[0]);
+
+/* Bar analytic field identifiers, plus the extremes of the signed range. */
+static const RsslFieldId kFieldIds[] = {
+	12 /* HIGH_1 */, 13 /* LOW_1 */, 19 /* OPEN_PRC */, 21 /* HST_CLOSE */, 32 /* ACVOL_1 */,
+	255, 256, 32767, -1, -32768
+};
+static const size_t kFieldIdCount = sizeof (kFieldIds) / sizeof (kFieldIds[0]);
+
+static
+field_t
+MakeField (
+	RsslFieldId fid,
+	int64_t value,
+	uint8_t hint
+	)
+{
+	field_t field;
+	field.fid = fid;
+	field.is_blank = false;
+	field.hint = hint;
+	field.value = value;
+	return field;
+}
+
+static
+field_t
+MakeBlankField (
+	RsslFieldId fid
+	)
+{
+	field_t field;
+	field.fid = fid;
+	field.is_blank = true;
+	field.hint = 0;
+	field.value = 0;
+	return field;
+}
+
+/* Smallest number of bytes holding value as two's complement. */
+static
+unsigned
+ExpectedWidth (
+	int64_t value
+	)
+{
+	for (unsigned width = 1; width < 8; ++width) {
+		const int64_t limit = INT64_C(1) << (width * 8 - 1);
+		if (value >= -limit && value < limit)
+			return width;
+	}
+	return 8;
+}
+
+static
+bool
+Encode (
+	const std::vector<field_t>& fields,
+	const std::vector<RsslFieldId>& view,
+	char* data,
+	size_t length,
+	RsslBuffer* encoded
+	)
+{
+	internal::real_field_list_t field_list (data, length, &view);
+	for (auto it = fields.begin(); it != fields.end(); ++it) {
+		RsslReal real;
+		memset (&real, 0, sizeof (real));
+		real.isBlank = it->is_blank ? RSSL_TRUE : 0;
+		real.hint = it->hint;
+		real.value = it->value;
+		if (!field_list.Append (it->fid, real))
+			break;
+	}
+	return field_list.Complete (encoded);
+}
+
+/* Decode the encoded container and require exactly the fields within the view, in order,
+ * each in its shortest form.
+ */
+static
+bool
+Verify (
+	const char* name,
+	const std::vector<field_t>& fields,
+	const std::vector<RsslFieldId>& view
+	)
+{
+	char data[4096];
+	RsslBuffer encoded;
+	if (!Encode (fields, view, data, sizeof (data), &encoded)) {
+		fprintf (stderr, "FAIL %s: encoding failed.\n", name);
+		return false;
+	}
+	std::vector<field_t> expected;
+	for (auto it = fields.begin(); it != fields.end(); ++it)
+		if (view.empty() || std::binary_search (view.begin(), view.end(), it->fid))
+			expected.push_back (*it);
+	const uint8_t* p = reinterpret_cast<const uint8_t*> (encoded.data);
+	const uint8_t* end = p + encoded.length;
+	if (encoded.length < 3 || RSSL_FLF_HAS_STANDARD_DATA != p[0]) {
+		fprintf (stderr, "FAIL %s: header.\n", name);
+		return false;
+	}
+	const unsigned count = (static_cast<unsigned> (p[1]) << 8) | p[2];
+	if (count != expected.size()) {
+		fprintf (stderr, "FAIL %s: count %u expected %u.\n", name, count, static_cast<unsigned> (expected.size()));
+		return false;
+	}
+	p += 3;
+	for (auto it = expected.begin(); it != expected.end(); ++it) {
+		if (end - p < 3) {
+			fprintf (stderr, "FAIL %s: truncated at field %d.\n", name, static_cast<int> (it->fid));
+			return false;
+		}
+		const RsslFieldId fid = static_cast<RsslFieldId> ((static_cast<unsigned> (p[0]) << 8) | p[1]);
+		const unsigned length = p[2];
+		p += 3;
+		if (fid != it->fid || end - p < static_cast<ptrdiff_t> (length)) {
+			fprintf (stderr, "FAIL %s: field %d expected %d.\n", name, static_cast<int> (fid), static_cast<int> (it->fid));
+			return false;
+		}
+		if (it->is_blank) {
+			if (0 != length) {
+				fprintf (stderr, "FAIL %s: blank field %d has length %u.\n", name, static_cast<int> (fid), length);
+				return false;
+			}
+			continue;
+		}
+		if (1 + ExpectedWidth (it->value) != length || it->hint != p[0]) {
+			fprintf (stderr, "FAIL %s: field %d length %u hint %u, expected %u and %u.\n", name, static_cast<int> (fid),
+				length, static_cast<unsigned> (p[0]), 1 + ExpectedWidth (it->value), static_cast<unsigned> (it->hint));
+			return false;
+		}
+/* Sign extend from the first mantissa byte. */
+		int64_t value = static_cast<int8_t> (p[1]);
+		for (unsigned i = 2; i < length; ++i)
+			value = static_cast<int64_t> ((static_cast<uint64_t> (value) << 8) | p[i]);
+		if (value != it->value) {
+			fprintf (stderr, "FAIL %s: field %d value %lld expected %lld.\n", name, static_cast<int> (fid),
+				static_cast<long long> (value), static_cast<long long> (it->value));
+			return false;
+		}
+		p += length;
+	}
+	if (p != end) {
+		fprintf (stderr, "FAIL %s: %u trailing bytes.\n", name, static_cast<unsigned> (end - p));
+		return false;
+	}
+	return true;
+}
+
+int
+main (
+	int	argc,
+	char*	argv[]
+	)
+{
+	int failures = 0;
+	char name[128];
+	const std::vector<RsslFieldId> no_view;
+/* Every hint and mantissa as a single field. */
+	for (uint8_t hint = 0; hint < kHintCount; ++hint) {
+		for (size_t v = 0; v < kValueCount; ++v) {
+			std::vector<field_t> fields (1, MakeField (kFieldIds[0], kValues[v], hint));
+			sprintf (name, "real(hint=%u,value=%lld)", static_cast<unsigned> (hint), static_cast<long long> (kValues[v]));
+			if (!Verify (name, fields, no_view))
+				++failures;
+		}
+	}
+/* Every field identifier, blank and populated. */
+	for (size_t f = 0; f < kFieldIdCount; ++f) {
+		std::vector<field_t> fields;
+		fields.push_back (MakeBlankField (kFieldIds[f]));
+		fields.push_back (MakeField (kFieldIds[f], 12345, RSSL_RH_EXPONENT_2));
+		sprintf (name, "fid(%d)", static_cast<int> (kFieldIds[f]));
+		if (!Verify (name, fields, no_view))
+			++failures;
+	}
+	if (!Verify ("empty", std::vector<field_t>(), no_view))
+		++failures;
+/* Bar image: HIGH_1, LOW_1, OPEN_PRC, HST_CLOSE, ACVOL_1, blank and populated. */
+	std::vector<field_t> image, blank_image;
+	image.push_back (MakeField (12, 4512, RSSL_RH_EXPONENT_2));
+	image.push_back (MakeField (13, 4498, RSSL_RH_EXPONENT_2));
+	image.push_back (MakeField (19, 4501, RSSL_RH_EXPONENT_2));
+	image.push_back (MakeField (21, 4507, RSSL_RH_EXPONENT_2));
+	image.push_back (MakeField (32, INT64_C(72057594037927935), RSSL_RH_EXPONENT0));
+	for (auto it = image.begin(); it != image.end(); ++it)
+		blank_image.push_back (MakeBlankField (it->fid));
+	if (!Verify ("image", image, no_view))
+		++failures;
+	if (!Verify ("blank image", blank_image, no_view))
+		++failures;
+/* Hand-assembled bar image bytes. */
+	{
+		static const uint8_t kImage[] = {
+			RSSL_FLF_HAS_STANDARD_DATA, 0x00, 0x05,
+			0x00, 0x0c, 0x03, RSSL_RH_EXPONENT_2, 0x11, 0xa0,	/* HIGH_1 45.12 */
+			0x00, 0x0d, 0x03, RSSL_RH_EXPONENT_2, 0x11, 0x92,	/* LOW_1 44.98 */
+			0x00, 0x13, 0x03, RSSL_RH_EXPONENT_2, 0x11, 0x95,	/* OPEN_PRC 45.01 */
+			0x00, 0x15, 0x03, RSSL_RH_EXPONENT_2, 0x11, 0x9b,	/* HST_CLOSE 45.07 */
+			0x00, 0x20, 0x09, RSSL_RH_EXPONENT0,			/* ACVOL_1 2^56 - 1 */
+				0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+		};
+		char data[256];
+		RsslBuffer encoded;
+		if (!Encode (image, no_view, data, sizeof (data), &encoded) ||
+		    sizeof (kImage) != encoded.length ||
+		    0 != memcmp (kImage, encoded.data, sizeof (kImage)))
+		{
+			fprintf (stderr, "FAIL image bytes.\n");
+			++failures;
+		}
+	}
+/* Views: single field, subset, superset, disjoint, and negative identifiers, sorted as by
+ * client_t::ParseView.
+ */
+	static const RsslFieldId kHstClose[] = { 21 };
+	static const RsslFieldId kSubset[] = { 13, 21 };
+	static const RsslFieldId kSuperset[] = { -1, 1, 12, 13, 19, 21, 22, 32, 1000 };
+	static const RsslFieldId kDisjoint[] = { 1, 2, 3 };
+	struct {
+		const char* name;
+		const RsslFieldId* fids;
+		size_t count;
+	} views[] = {
+		{ "view HST_CLOSE", kHstClose, 1 },
+		{ "view subset", kSubset, 2 },
+		{ "view superset", kSuperset, sizeof (kSuperset) / sizeof (kSuperset[0]) },
+		{ "view disjoint", kDisjoint, sizeof (kDisjoint) / sizeof (kDisjoint[0]) }
+	};
+	for (size_t i = 0; i < sizeof (views) / sizeof (views[0]); ++i) {
+		const std::vector<RsslFieldId> view (views[i].fids, views[i].fids + views[i].count);
+		if (!Verify (views[i].name, image, view))
+			++failures;
+		sprintf (name, "blank %s", views[i].name);
+		if (!Verify (name, blank_image, view))
+			++failures;
+	}
+/* Short buffers: never write past the end, and never succeed with a truncated container. */
+	{
+		char full[256];
+		RsslBuffer full_buf;
+		Encode (image, no_view, full, sizeof (full), &full_buf);
+		for (size_t length = 0; length < 64; ++length) {
+			static const char kGuard = '\x5a';
+			char data[64 + 16];
+			RsslBuffer encoded;
+			memset (data, kGuard, sizeof (data));
+			const bool is_encoded = Encode (image, no_view, data, length, &encoded);
+			for (size_t i = length; i < sizeof (data); ++i) {
+				if (kGuard != data[i]) {
+					fprintf (stderr, "FAIL overflow(%u): byte %u written past buffer.\n", static_cast<unsigned> (length), static_cast<unsigned> (i));
+					++failures;
+					break;
+				}
+			}
+			if (is_encoded && (full_buf.length != encoded.length || 0 != memcmp (full_buf.data, encoded.data, encoded.length))) {
+				fprintf (stderr, "FAIL overflow(%u): truncated container.\n", static_cast<unsigned> (length));
+				++failures;
+			}
+		}
+	}
+/* Benchmark: bar image refresh payload. */
+	using namespace boost::chrono;
+	static const unsigned kIterations = 1000000;
+	char buffer[256];
+	RsslBuffer encoded;
+	size_t bytes = 0;
+	const size_t allocations = testing::allocation_count();
+	auto t0 = high_resolution_clock::now();
+	for (unsigned n = 0; n < kIterations; ++n) {
+		Encode (image, no_view, buffer, sizeof (buffer), &encoded);
+		bytes += encoded.length;
+	}
+	auto t1 = high_resolution_clock::now();
+	const size_t direct_allocations = testing::allocation_count() - allocations;
+	printf ("FieldListWire: { "
+		"\"failures\": %d"
+		", \"iterations\": %u"
+		", \"directNs\": %.1f"
+		", \"directAllocations\": %u"
+		", \"bytes\": %u"
+		" }\n",
+		failures,
+		kIterations,
+		static_cast<double> (duration_cast<nanoseconds> (t1 - t0).count()) / kIterations,
+		static_cast<unsigned> (direct_allocations),
+		static_cast<unsigned> (bytes));
+	if (0 != direct_allocations) {
+		fprintf (stderr, "FAIL: %u allocations encoding field lists.\n", static_cast<unsigned> (direct_allocations));
+		++failures;
+	}
+	return 0 == failures ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */
@@ -0,0 +1,206 @@
+/* Item name parser tests and allocation benchmark.
+ *
+ * Every item name form is decomposed both in place and via the googleurl round trip the
+ * parser replaced, components and query pairs must match.  Steady state parsing must not
+ * allocate.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+#include "googleurl/url_parse.h"
+#include "item_name.hh"
+#include "alloc_hook.hh"
+
+/* Item names as requested by consumers, including malformed forms. */
+static const char* kItemNames[] = {
+	"MSFT.O",
+	"MSFT.O?",
+	"MSFT.O#",
+	"MSFT.O?#",
+	"MSFT.O#test",
+	"MSFT.O#close",
+	"MSFT.O#rollup",
+	"MSFT.O?interval=60",
+	"MSFT.O?interval=60&period=3600",
+	"MSFT.O?interval=60&period=3600#rollup",
+	"MSFT.O?open=1400000000&close=1400003600&days=5#close",
+	"MSFT.O?a&b=&=c&&",
+	"MSFT.O?a=1?b=2",
+	"MSFT.O?a=1#b?c=2",
+	"MSFT.O#a#b",
+	"MSFT.O;p=1?interval=60",
+	"/MSFT.O",
+	"a/b/MSFT.O?interval=60",
+	"a\\MSFT.O#test",
+	"a/",
+	"?interval=60",
+	"#test",
+	"",
+	"0#.DJI",
+	"EUR=?interval=300",
+	"VOD.L?interval=60&tz=Europe/London"
+};
+
+static const char kPrefix[] = "null://localhost/";
+
+/* Components by the googleurl round trip, invalid components are empty. */
+struct reference_t
+{
+	std::string url;
+	url_parse::Parsed parsed;
+	url_parse::Component file_name;
+
+	explicit reference_t (const char* item_name)
+		: url (kPrefix)
+	{
+		url.append (item_name);
+		url_parse::ParseStandardURL (url.c_str(), static_cast<int> (url.size()), &parsed);
+		if (parsed.path.is_valid())
+			url_parse::ExtractFileName (url.c_str(), parsed.path, &file_name);
+	}
+
+	chromium::StringPiece Piece (const url_parse::Component& component) const {
+		if (!component.is_valid())
+			return chromium::StringPiece();
+		return chromium::StringPiece (url.c_str() + component.begin, component.len);
+	}
+};
+
+static
+bool
+CompareQuery (
+	const reference_t& reference,
+	chromium::StringPiece query,
+	const char* item_name
+	)
+{
+	url_parse::Component reference_query (reference.parsed.query), key, value;
+	chromium::StringPiece k, v;
+	for (;;) {
+		const bool has_reference = reference_query.is_valid()
+			&& url_parse::ExtractQueryKeyValue (reference.url.c_str(), &reference_query, &key, &value);
+		const bool has_pair = internal::extract_query_key_value (&query, &k, &v);
+		if (has_reference != has_pair) {
+			fprintf (stderr, "FAIL \"%s\": query pair count differs.\n", item_name);
+			return false;
+		}
+		if (!has_pair)
+			return true;
+		if (reference.Piece (key) != k || reference.Piece (value) != v) {
+			fprintf (stderr, "FAIL \"%s\": query pair (%s,%s) expected (%s,%s).\n", item_name,
+				k.as_string().c_str(), v.as_string().c_str(),
+				reference.Piece (key).as_string().c_str(), reference.Piece (value).as_string().c_str());
+			return false;
+		}
+	}
+}
+
+static
+bool
+Compare (
+	const char* item_name
+	)
+{
+	const reference_t reference (item_name);
+	internal::parsed_item_name_t parsed;
+	const bool is_valid = internal::parse_item_name (item_name, &parsed);
+	const bool is_reference_valid = reference.file_name.is_valid() && reference.file_name.len > 0;
+	if (is_valid != is_reference_valid) {
+		fprintf (stderr, "FAIL \"%s\": valid %d expected %d.\n", item_name, is_valid, is_reference_valid);
+		return false;
+	}
+	if (!is_valid)
+		return true;
+	if (reference.Piece (reference.file_name) != parsed.symbol) {
+		fprintf (stderr, "FAIL \"%s\": symbol \"%s\" expected \"%s\".\n", item_name,
+			parsed.symbol.as_string().c_str(), reference.Piece (reference.file_name).as_string().c_str());
+		return false;
+	}
+	if (reference.Piece (reference.parsed.ref) != parsed.fragment) {
+		fprintf (stderr, "FAIL \"%s\": fragment \"%s\" expected \"%s\".\n", item_name,
+			parsed.fragment.as_string().c_str(), reference.Piece (reference.parsed.ref).as_string().c_str());
+		return false;
+	}
+	return CompareQuery (reference, parsed.query, item_name);
+}
+
+int
+main (
+	int	argc,
+	char*	argv[]
+	)
+{
+	static const size_t kItemNameCount = sizeof (kItemNames) / sizeof (kItemNames[0]);
+	static const unsigned kIterations = 100000;
+	int failures = 0;
+	for (size_t i = 0; i < kItemNameCount; ++i) {
+		if (!Compare (kItemNames[i]))
+			++failures;
+	}
+/* Benchmark: in place parse and query walk of every form. */
+	using namespace boost::chrono;
+	size_t pairs = 0;
+	const size_t allocations = testing::allocation_count();
+	auto t0 = high_resolution_clock::now();
+	for (unsigned n = 0; n < kIterations; ++n) {
+		for (size_t i = 0; i < kItemNameCount; ++i) {
+			internal::parsed_item_name_t parsed;
+			chromium::StringPiece key, value;
+			if (!internal::parse_item_name (kItemNames[i], &parsed))
+				continue;
+			while (internal::extract_query_key_value (&parsed.query, &key, &value))
+				++pairs;
+		}
+	}
+	auto t1 = high_resolution_clock::now();
+	const size_t parse_allocations = testing::allocation_count() - allocations;
+/* Baseline: googleurl round trip with the prefixed copy. */
+	std::string url;
+	url.reserve (1024);
+	const size_t url_allocations = testing::allocation_count();
+	for (unsigned n = 0; n < kIterations; ++n) {
+		for (size_t i = 0; i < kItemNameCount; ++i) {
+			url_parse::Parsed parsed;
+			url_parse::Component file_name, key, value;
+			url.assign (kPrefix);
+			url.append (kItemNames[i]);
+			url_parse::ParseStandardURL (url.c_str(), static_cast<int> (url.size()), &parsed);
+			if (parsed.path.is_valid())
+				url_parse::ExtractFileName (url.c_str(), parsed.path, &file_name);
+			while (parsed.query.is_valid() && url_parse::ExtractQueryKeyValue (url.c_str(), &parsed.query, &key, &value))
+				++pairs;
+		}
+	}
+	auto t2 = high_resolution_clock::now();
+	const size_t parses = kIterations * kItemNameCount;
+	printf ("ItemName: { "
+		"\"forms\": %u"
+		", \"failures\": %d"
+		", \"parses\": %u"
+		", \"parseNs\": %.1f"
+		", \"parseAllocations\": %u"
+		", \"googleurlNs\": %.1f"
+		", \"googleurlAllocations\": %u"
+		", \"pairs\": %u"
+		" }\n",
+		static_cast<unsigned> (kItemNameCount),
+		failures,
+		static_cast<unsigned> (parses),
+		static_cast<double> (duration_cast<nanoseconds> (t1 - t0).count()) / parses,
+		static_cast<unsigned> (parse_allocations),
+		static_cast<double> (duration_cast<nanoseconds> (t2 - t1).count()) / parses,
+		static_cast<unsigned> (testing::allocation_count() - url_allocations),
+		static_cast<unsigned> (pairs));
+	if (0 != parse_allocations) {
+		fprintf (stderr, "FAIL: %u allocations parsing item names.\n", static_cast<unsigned> (parse_allocations));
+		++failures;
+	}
+	return 0 == failures ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */
@@ -0,0 +1,217 @@
+/* Packed buffer arithmetic tests and write counts.
+ *
+ * A model of an RSSL packed buffer, where rsslPackBuffer charges the pending reply and its
+ * prefix against the space remaining, drives the same decisions as client_t::PackReply.
+ * Every written buffer must hold its replies and prefixes within capacity, and a reply is
+ * only moved to a new buffer when it cannot follow.  Writes per reply are then reported for
+ * bursts of analytic-sized replies against one write per reply before packing.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "packed_buffer.hh"
+
+/* Packed buffer requested per client, as client.cc. */
+static const size_t kPackCapacity = 4096;
+/* Worker replies drained per event loop pass, as hitsuji_t::OnRead. */
+static const size_t kDrainBudget = 64;
+
+/* One client channel: a pending packed buffer and counts of what was written. */
+class channel_t
+{
+public:
+	channel_t()
+		: is_pending_ (false)
+		, used_ (0)
+		, pending_length_ (0)
+		, available_ (0)
+		, count_ (0)
+		, writes_ (0)
+		, large_writes_ (0)
+		, replies_ (0)
+		, is_overrun_ (false)
+	{
+	}
+
+/* As client_t::PackReply. */
+	void Pack (size_t length) {
+		++replies_;
+		if (!hitsuji::fits_packed_buffer (length, kPackCapacity)) {
+			Submit();
+			++writes_;
+			++large_writes_;
+			return;
+		}
+		if (is_pending_) {
+			if (hitsuji::can_pack (pending_length_, length, available_)) {
+/* rsslPackBuffer: the pending reply and its prefix are committed. */
+				used_ += hitsuji::kPackedHeaderSize + pending_length_;
+				available_ -= hitsuji::kPackedHeaderSize + pending_length_;
+			} else {
+				Submit();
+			}
+		}
+		if (!is_pending_) {
+			is_pending_ = true;
+			used_ = 0;
+			available_ = kPackCapacity;
+			count_ = 0;
+		}
+		pending_length_ = length;
+		++count_;
+	}
+
+/* As client_t::SubmitPack, the last reply is prefixed as the buffer is written. */
+	void Submit() {
+		if (!is_pending_)
+			return;
+		const size_t written = used_ + hitsuji::kPackedHeaderSize + pending_length_;
+		if (written > kPackCapacity) {
+			fprintf (stderr, "FAIL: %u replies wrote %u bytes into a %u byte buffer.\n",
+				count_, static_cast<unsigned> (written), static_cast<unsigned> (kPackCapacity));
+			is_overrun_ = true;
+		}
+		is_pending_ = false;
+		++writes_;
+	}
+
+	size_t available() const {
+		return is_pending_ ? available_ : kPackCapacity;
+	}
+	size_t pending_length() const {
+		return is_pending_ ? pending_length_ : 0;
+	}
+	bool is_pending() const {
+		return is_pending_;
+	}
+	unsigned count() const {
+		return count_;
+	}
+	size_t writes() const {
+		return writes_;
+	}
+	size_t large_writes() const {
+		return large_writes_;
+	}
+	size_t replies() const {
+		return replies_;
+	}
+	bool is_overrun() const {
+		return is_overrun_;
+	}
+
+private:
+	bool is_pending_;
+	size_t used_;
+	size_t pending_length_;
+	size_t available_;
+	unsigned count_;
+	size_t writes_;
+	size_t large_writes_;
+	size_t replies_;
+	bool is_overrun_;
+};
+
+/* Exact boundaries of the condition. */
+static
+bool
+TestBoundaries()
+{
+	bool is_passed = true;
+	is_passed &= hitsuji::can_pack (100, 200, 100 + 200 + 2 * hitsuji::kPackedHeaderSize);
+	is_passed &= !hitsuji::can_pack (100, 201, 100 + 200 + 2 * hitsuji::kPackedHeaderSize);
+	is_passed &= hitsuji::can_pack (0, 0, 2 * hitsuji::kPackedHeaderSize);
+	is_passed &= !hitsuji::can_pack (0, 0, 2 * hitsuji::kPackedHeaderSize - 1);
+	is_passed &= hitsuji::fits_packed_buffer (kPackCapacity - 2 * hitsuji::kPackedHeaderSize, kPackCapacity);
+	is_passed &= !hitsuji::fits_packed_buffer (kPackCapacity - 2 * hitsuji::kPackedHeaderSize + 1, kPackCapacity);
+	if (!is_passed)
+		fprintf (stderr, "FAIL: packing boundaries.\n");
+	return is_passed;
+}
+
+/* Every sequence of sizes stays within capacity, and a new buffer is only started when the
+ * reply could not follow.
+ */
+static
+bool
+TestSequences()
+{
+	static const size_t kSizes[] = { 1, 2, 3, 62, 200, 256, 1000, 2046, 2047, 4091, 4092, 4093, 5000, 65536 };
+	static const size_t kSizeCount = sizeof (kSizes) / sizeof (kSizes[0]);
+	bool is_passed = true;
+/* Pairs and triples of every size, then a long pseudo-random run. */
+	for (size_t i = 0; i < kSizeCount; ++i) {
+		for (size_t j = 0; j < kSizeCount; ++j) {
+			for (size_t k = 0; k < kSizeCount; ++k) {
+				channel_t channel;
+				channel.Pack (kSizes[i]);
+				channel.Pack (kSizes[j]);
+				const size_t available = channel.available();
+				const size_t pending = channel.pending_length();
+				const bool was_pending = channel.is_pending();
+				const size_t writes = channel.writes();
+				channel.Pack (kSizes[k]);
+/* A reply that could follow must not start a new buffer. */
+				if (was_pending && hitsuji::can_pack (pending, kSizes[k], available) && writes != channel.writes()) {
+					fprintf (stderr, "FAIL: %u byte reply fits behind %u bytes in %u available but was not packed.\n",
+						static_cast<unsigned> (kSizes[k]), static_cast<unsigned> (pending), static_cast<unsigned> (available));
+					is_passed = false;
+				}
+				channel.Submit();
+				is_passed &= !channel.is_overrun();
+			}
+		}
+	}
+	channel_t channel;
+	uint32_t seed = 12345;
+	for (unsigned n = 0; n < 100000; ++n) {
+		seed = seed * 1103515245 + 12345;
+		channel.Pack ((seed >> 8) % 5000);
+		if (0 == n % kDrainBudget)
+			channel.Submit();
+	}
+	channel.Submit();
+	is_passed &= !channel.is_overrun();
+	return is_passed;
+}
+
+int
+main (
+	int	argc,
+	char*	argv[]
+	)
+{
+	int failures = 0;
+	if (!TestBoundaries()) ++failures;
+	if (!TestSequences()) ++failures;
+/* Writes per reply for full drains of one client, before packing every reply was written. */
+	static const size_t kReplySizes[] = { 64, 128, 200, 256, 1024, 8192 };
+	static const unsigned kPasses = 1000;
+	for (size_t i = 0; i < sizeof (kReplySizes) / sizeof (kReplySizes[0]); ++i) {
+		channel_t channel;
+		for (unsigned pass = 0; pass < kPasses; ++pass) {
+			for (size_t n = 0; n < kDrainBudget; ++n)
+				channel.Pack (kReplySizes[i]);
+			channel.Submit();
+		}
+		if (channel.is_overrun())
+			++failures;
+		printf ("PackedBuffer: { "
+			"\"replyBytes\": %u"
+			", \"repliesPerPass\": %u"
+			", \"writesPerReply\": %.3f"
+			", \"largeWrites\": %u"
+			", \"unpackedWritesPerReply\": 1.000"
+			" }\n",
+			static_cast<unsigned> (kReplySizes[i]),
+			static_cast<unsigned> (kDrainBudget),
+			static_cast<double> (channel.writes()) / channel.replies(),
+			static_cast<unsigned> (channel.large_writes()));
+	}
+	printf ("PackedBuffer: { \"failures\": %d }\n", failures);
+	return 0 == failures ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */
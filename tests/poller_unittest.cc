@@ -0,0 +1,331 @@
+/* Socket readiness tests and benchmark.
+ *
+ * Registrations are checked for context delivery, interest changes, socket replacement,
+ * removal and a cross-thread wake.  The benchmark holds hundreds of loopback sessions with a
+ * varying number kept readable and compares the cost of one wait with the select() loop it
+ * replaced, which rebuilt and scanned an fd_set of every session on each pass.
+ */
+
+#if defined(_WIN32)
+/* Room for every benchmark session in the select() baseline. */
+#	define FD_SETSIZE 1024
+#	include <winsock2.h>
+#	include <ws2tcpip.h>
+#else
+#	include <arpa/inet.h>
+#	include <netinet/in.h>
+#	include <netinet/tcp.h>
+#	include <sys/select.h>
+#	include <sys/socket.h>
+#	include <unistd.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+/* Boost threading */
+#include <boost/thread.hpp>
+
+#include "poller.hh"
+
+#if defined(_WIN32)
+#	define close_socket closesocket
+#else
+#	define close_socket close
+#endif
+
+/* Sessions held open by the benchmark, below FD_SETSIZE for the baseline. */
+static const size_t kSessions = 400;
+
+struct session_t
+{
+	SOCKET server;
+	SOCKET client;
+};
+
+/* Connected loopback TCP pair, WSAPoll does not accept socketpair() or pipes. */
+static
+bool
+CreateSession (
+	SOCKET listener,
+	const struct sockaddr_in& addr,
+	session_t* session
+	)
+{
+	session->client = socket (AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (INVALID_SOCKET == session->client)
+		return false;
+	if (0 != connect (session->client, reinterpret_cast<const struct sockaddr*> (&addr), sizeof (addr))) {
+		close_socket (session->client);
+		return false;
+	}
+	session->server = accept (listener, nullptr, nullptr);
+	if (INVALID_SOCKET == session->server) {
+		close_socket (session->client);
+		return false;
+	}
+	return true;
+}
+
+static
+bool
+CreateSessions (
+	size_t count,
+	std::vector<session_t>* sessions
+	)
+{
+	SOCKET listener = socket (AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (INVALID_SOCKET == listener)
+		return false;
+	struct sockaddr_in addr;
+	memset (&addr, 0, sizeof (addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	socklen_t addr_len = sizeof (addr);
+	if (0 != bind (listener, reinterpret_cast<struct sockaddr*> (&addr), sizeof (addr)) ||
+	    0 != getsockname (listener, reinterpret_cast<struct sockaddr*> (&addr), &addr_len) ||
+	    0 != listen (listener, SOMAXCONN))
+	{
+		close_socket (listener);
+		return false;
+	}
+	sessions->resize (count);
+	bool is_created = true;
+	for (size_t i = 0; is_created && i < count; ++i)
+		is_created = CreateSession (listener, addr, &(*sessions)[i]);
+	close_socket (listener);
+	return is_created;
+}
+
+static
+void
+DestroySessions (
+	std::vector<session_t>* sessions
+	)
+{
+	for (auto it = sessions->begin(); it != sessions->end(); ++it) {
+		close_socket (it->client);
+		close_socket (it->server);
+	}
+	sessions->clear();
+}
+
+/* One byte from the client side leaves the server side readable until drained. */
+static
+void
+MakeReadable (
+	const session_t& session
+	)
+{
+	static const char c = 0;
+	send (session.client, &c, sizeof (c), 0);
+}
+
+static
+void
+Drain (
+	const session_t& session
+	)
+{
+	char c;
+	recv (session.server, &c, sizeof (c), 0);
+}
+
+/* Returns count of events for fd with the given context and event bits. */
+static
+int
+CountEvents (
+	const hitsuji::poller_t& poller,
+	SOCKET fd,
+	void* context,
+	unsigned events
+	)
+{
+	int count = 0;
+	for (auto it = poller.events().begin(); it != poller.events().end(); ++it) {
+		if (it->fd == fd && it->context == context && (it->events & events) == events)
+			++count;
+	}
+	return count;
+}
+
+static
+bool
+TestRegistrations()
+{
+	std::vector<session_t> sessions;
+	if (!CreateSessions (3, &sessions)) {
+		fprintf (stderr, "FAIL: loopback sessions.\n");
+		return false;
+	}
+	hitsuji::poller_t poller;
+	bool is_passed = poller.Initialize();
+	void* contexts[] = { &sessions[0], &sessions[1], &sessions[2] };
+	for (size_t i = 0; i < sessions.size(); ++i)
+		is_passed &= poller.Add (sessions[i].server, hitsuji::poller_t::kRead, contexts[i]);
+/* Idle sessions are not reported. */
+	is_passed &= (0 == poller.Wait (0));
+/* Readable session maps to its own context. */
+	MakeReadable (sessions[1]);
+	is_passed &= (1 == poller.Wait (1000)) && (1 == CountEvents (poller, sessions[1].server, contexts[1], hitsuji::poller_t::kRead));
+	Drain (sessions[1]);
+	is_passed &= (0 == poller.Wait (0));
+/* Write interest on a clear socket is reported until removed again. */
+	is_passed &= poller.Modify (sessions[0].server, hitsuji::poller_t::kRead | hitsuji::poller_t::kWrite);
+	is_passed &= (hitsuji::poller_t::kRead | hitsuji::poller_t::kWrite) == poller.interest (sessions[0].server);
+	is_passed &= (1 == poller.Wait (0)) && (1 == CountEvents (poller, sessions[0].server, contexts[0], hitsuji::poller_t::kWrite));
+	is_passed &= poller.Modify (sessions[0].server, hitsuji::poller_t::kRead);
+	is_passed &= (0 == poller.Wait (0));
+/* Replacement keeps interest and context on the new socket. */
+	is_passed &= poller.Replace (sessions[2].server, sessions[2].client);
+	is_passed &= (0 == poller.interest (sessions[2].server)) && (hitsuji::poller_t::kRead == poller.interest (sessions[2].client));
+	static const char c = 0;
+	send (sessions[2].server, &c, sizeof (c), 0);
+	is_passed &= (1 == poller.Wait (1000)) && (1 == CountEvents (poller, sessions[2].client, contexts[2], hitsuji::poller_t::kRead));
+/* Removed sockets are silent. */
+	poller.Remove (sessions[2].client);
+	is_passed &= (0 == poller.Wait (0)) && (2 == poller.size() - 1);
+/* Wake from another thread ends a long wait without an event. */
+	boost::thread waker ([&poller]() {
+		boost::this_thread::sleep_for (boost::chrono::milliseconds (50));
+		poller.Wake();
+	});
+	auto t0 = boost::chrono::steady_clock::now();
+	is_passed &= (0 == poller.Wait (10000));
+	is_passed &= (boost::chrono::steady_clock::now() - t0) < boost::chrono::seconds (5);
+	waker.join();
+	poller.Close();
+	DestroySessions (&sessions);
+	if (!is_passed)
+		fprintf (stderr, "FAIL: registrations.\n");
+	return is_passed;
+}
+
+/* Average nanoseconds per pass of the poller with active sessions readable. */
+static
+double
+BenchmarkPoller (
+	const std::vector<session_t>& sessions,
+	size_t active,
+	unsigned iterations,
+	bool* is_passed
+	)
+{
+	hitsuji::poller_t poller;
+	poller.Initialize();
+	for (auto it = sessions.begin(); it != sessions.end(); ++it)
+		poller.Add (it->server, hitsuji::poller_t::kRead, const_cast<session_t*> (&*it));
+	using namespace boost::chrono;
+	size_t ready = 0;
+	auto t0 = high_resolution_clock::now();
+	for (unsigned n = 0; n < iterations; ++n) {
+		poller.Wait (0);
+		for (auto it = poller.events().begin(); it != poller.events().end(); ++it)
+			if (nullptr != it->context)
+				++ready;
+	}
+	auto t1 = high_resolution_clock::now();
+	if (ready != active * iterations) {
+		fprintf (stderr, "FAIL: poller reported %u ready, expected %u.\n", static_cast<unsigned> (ready), static_cast<unsigned> (active * iterations));
+		*is_passed = false;
+	}
+	return static_cast<double> (duration_cast<nanoseconds> (t1 - t0).count()) / iterations;
+}
+
+/* Baseline: rebuild the fd_set of every session, select, then scan every session. */
+static
+double
+BenchmarkSelect (
+	const std::vector<session_t>& sessions,
+	size_t active,
+	unsigned iterations,
+	bool* is_passed
+	)
+{
+	SOCKET max_fd = 0;
+	for (auto it = sessions.begin(); it != sessions.end(); ++it)
+		if (it->server > max_fd)
+			max_fd = it->server;
+	using namespace boost::chrono;
+	size_t ready = 0;
+	auto t0 = high_resolution_clock::now();
+	for (unsigned n = 0; n < iterations; ++n) {
+		fd_set readfds;
+		FD_ZERO (&readfds);
+		for (auto it = sessions.begin(); it != sessions.end(); ++it)
+			FD_SET (it->server, &readfds);
+		struct timeval tv = { 0, 0 };
+		select (static_cast<int> (max_fd + 1), &readfds, nullptr, nullptr, &tv);
+		for (auto it = sessions.begin(); it != sessions.end(); ++it)
+			if (FD_ISSET (it->server, &readfds))
+				++ready;
+	}
+	auto t1 = high_resolution_clock::now();
+	if (ready != active * iterations) {
+		fprintf (stderr, "FAIL: select reported %u ready, expected %u.\n", static_cast<unsigned> (ready), static_cast<unsigned> (active * iterations));
+		*is_passed = false;
+	}
+	return static_cast<double> (duration_cast<nanoseconds> (t1 - t0).count()) / iterations;
+}
+
+int
+main (
+	int	argc,
+	char*	argv[]
+	)
+{
+#if defined(_WIN32)
+	WSADATA wsa_data;
+	if (0 != WSAStartup (MAKEWORD (2, 2), &wsa_data))
+		return EXIT_FAILURE;
+#endif
+	int failures = 0;
+	if (!TestRegistrations())
+		++failures;
+/* Benchmark: all idle, a few active, a tenth active, half active.  Below the 256 events
+ * returned per wait so that every ready session is reported on each pass.
+ */
+	static const unsigned kIterations = 2000;
+	static const size_t kActive[] = { 0, 4, kSessions / 10, kSessions / 2 };
+	std::vector<session_t> sessions;
+	if (!CreateSessions (kSessions, &sessions)) {
+		fprintf (stderr, "FAIL: %u loopback sessions.\n", static_cast<unsigned> (kSessions));
+		return EXIT_FAILURE;
+	}
+	size_t readable = 0;
+	for (size_t i = 0; i < sizeof (kActive) / sizeof (kActive[0]); ++i) {
+		for (; readable < kActive[i]; ++readable)
+			MakeReadable (sessions[readable]);
+/* Let loopback delivery complete before timing. */
+		boost::this_thread::sleep_for (boost::chrono::milliseconds (50));
+		bool is_passed = true;
+		const double poller_ns = BenchmarkPoller (sessions, kActive[i], kIterations, &is_passed);
+		const double select_ns = BenchmarkSelect (sessions, kActive[i], kIterations, &is_passed);
+		if (!is_passed)
+			++failures;
+		printf ("Poller: { "
+			"\"sessions\": %u"
+			", \"active\": %u"
+			", \"waitNs\": %.0f"
+			", \"selectNs\": %.0f"
+			" }\n",
+			static_cast<unsigned> (kSessions),
+			static_cast<unsigned> (kActive[i]),
+			poller_ns,
+			select_ns);
+	}
+	DestroySessions (&sessions);
+	printf ("Poller: { \"failures\": %d }\n", failures);
+#if defined(_WIN32)
+	WSACleanup();
+#endif
+	return 0 == failures ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */
@@ -0,0 +1,429 @@
+/* Request path tests and allocation benchmark.
+ *
+ * Stream tokens and in-flight requests are held in internal::flat_map_t, checked against
+ * std::unordered_map under random insertion and erasure, and with clusters wrapping the end
+ * of the table to exercise backward shift deletion.  The steady state of one event loop and
+ * worker, tokens opened and closed within open_limit, the production SBE request codec into a
+ * pooled slab, item name decomposition and batch grouping, must not allocate.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+#include "chromium/string_piece.hh"
+#include "flat_hash.hh"
+#include "item_name.hh"
+#include "request_codec.hh"
+#include "slab_pool.hh"
+#include "vta_batch.hh"
+#include "alloc_hook.hh"
+
+using namespace hitsuji;
+
+/* Open requests per event loop, as config_t::open_limit. */
+static const size_t kOpenLimit = 1000;
+/* As shard_t::kMaxRequestSize. */
+static const size_t kMaxRequestSize = 1024;
+
+static int g_failures = 0;
+
+#define EXPECT(condition) \
+	do { \
+		if (!(condition)) { \
+			fprintf (stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+			++g_failures; \
+		} \
+	} while (0)
+
+/* Home bucket as flat_map_t::bucket for a table of 16 slots. */
+static
+size_t
+home_bucket (
+	uint64_t key
+	)
+{
+	return static_cast<size_t> ((key * UINT64_C(0x9E3779B97F4A7C15)) >> 60);
+}
+
+/* Returns the next key from start with the given home bucket of a 16 slot table. */
+static
+uint64_t
+key_for_bucket (
+	uint64_t start,
+	size_t bucket
+	)
+{
+	while (home_bucket (start) != bucket)
+		++start;
+	return start;
+}
+
+/* A cluster wrapping from the last slot to the first, erasing its head must shift every
+ * entry whose probe sequence passes through the hole, and only those.
+ */
+static
+void
+TestBackwardShift()
+{
+	internal::flat_map_t<uint64_t, uint64_t> map (4);
+	const uint64_t a = key_for_bucket (1, 15);
+	const uint64_t b = key_for_bucket (a + 1, 15);
+	const uint64_t c = key_for_bucket (b + 1, 15);
+	const uint64_t d = key_for_bucket (1, 0);
+	const uint64_t e = key_for_bucket (1, 3);
+/* a:15 b:0 c:1 d:2 e:3, e is home and must not move. */
+	EXPECT(map.insert (a, 1));
+	EXPECT(map.insert (b, 2));
+	EXPECT(map.insert (c, 3));
+	EXPECT(map.insert (d, 4));
+	EXPECT(map.insert (e, 5));
+	EXPECT(!map.insert (c, 0));
+	EXPECT(5 == map.size());
+	EXPECT(1 == map.erase (a));
+	EXPECT(0 == map.erase (a));
+	EXPECT(nullptr == map.find (a));
+	EXPECT(nullptr != map.find (b) && 2 == *map.find (b));
+	EXPECT(nullptr != map.find (c) && 3 == *map.find (c));
+	EXPECT(nullptr != map.find (d) && 4 == *map.find (d));
+	EXPECT(nullptr != map.find (e) && 5 == *map.find (e));
+/* Middle of the cluster. */
+	EXPECT(1 == map.erase (c));
+	EXPECT(nullptr != map.find (b) && 2 == *map.find (b));
+	EXPECT(nullptr != map.find (d) && 4 == *map.find (d));
+	EXPECT(nullptr != map.find (e) && 5 == *map.find (e));
+	EXPECT(1 == map.erase (b));
+	EXPECT(1 == map.erase (d));
+	EXPECT(nullptr != map.find (e) && 5 == *map.find (e));
+	EXPECT(1 == map.size());
+/* Predicate erase over a wrapped cluster. */
+	map.insert (a, 1);
+	map.insert (b, 2);
+	map.insert (c, 3);
+	map.insert (d, 4);
+	EXPECT(2 == map.erase_if ([](uint64_t, uint64_t value) { return 0 == value % 2; }));
+	EXPECT(nullptr != map.find (a) && nullptr != map.find (c) && nullptr != map.find (e));
+	EXPECT(nullptr == map.find (b) && nullptr == map.find (d));
+	EXPECT(3 == map.size());
+}
+
+/* Random operations over a small key range keep the table near its maximum load. */
+static
+void
+TestAgainstUnorderedMap()
+{
+	internal::flat_map_t<uint64_t, uint64_t> map;
+	internal::flat_set_t<int32_t> set;
+	std::unordered_map<uint64_t, uint64_t> reference;
+	uint64_t seed = 88172645463325252ULL;
+	for (unsigned n = 0; n < 200000; ++n) {
+/* xorshift64 */
+		seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+		const uint64_t key = seed % 512;
+		switch ((seed >> 32) % 4) {
+		case 0:
+		case 1: {
+			const bool is_new = reference.insert (std::make_pair (key, n)).second;
+			EXPECT(is_new == map.insert (key, n));
+			EXPECT(is_new == set.insert (static_cast<int32_t> (key)));
+			break;
+		}
+		case 2: {
+			const size_t erased = reference.erase (key);
+			EXPECT(erased == map.erase (key));
+			EXPECT(erased == set.erase (static_cast<int32_t> (key)));
+			break;
+		}
+		default: {
+			auto it = reference.find (key);
+			const uint64_t* value = map.find (key);
+			EXPECT((reference.end() == it) == (nullptr == value));
+			if (reference.end() != it && nullptr != value)
+				EXPECT(it->second == *value);
+			break;
+		}
+		}
+		if (0 != g_failures)
+			return;
+	}
+	EXPECT(reference.size() == map.size());
+	EXPECT(reference.size() == set.size());
+	for (auto it = reference.begin(); it != reference.end(); ++it)
+		EXPECT(1 == map.count (it->first));
+}
+
+/* Sequential stream tokens, each request closed kOpenLimit requests later. */
+template <typename Map>
+static
+void
+OpenCloseTokens (
+	Map* in_flight,
+	uint64_t slot,
+	int32_t first,
+	unsigned count
+	)
+{
+	for (unsigned n = 0; n < count; ++n) {
+		const int32_t token = first + static_cast<int32_t> (n);
+		(*in_flight)[(slot << 32) | static_cast<uint32_t> (token)] = n;
+		if (n >= kOpenLimit)
+			in_flight->erase ((slot << 32) | static_cast<uint32_t> (token - static_cast<int32_t> (kOpenLimit)));
+	}
+	for (unsigned n = (count > kOpenLimit) ? count - static_cast<unsigned> (kOpenLimit) : 0; n < count; ++n)
+		in_flight->erase ((slot << 32) | static_cast<uint32_t> (first + static_cast<int32_t> (n)));
+}
+
+/* One request through the production codec: encoded into a pooled slab as shard_t::OnRequest,
+ * decoded and the slab released as worker_t::OnTask, the item name decomposed, then grouped
+ * into a batch as worker_t::OnBatch.
+ *
+ * Returns false on error, true on success.
+ */
+static
+bool
+DispatchRequest (
+	slab_pool_t* pool,
+	MessageHeader* hdr,
+	Request* request,
+	const request_fields_t& fields,
+	const std::vector<int_fast16_t>& view_by_fid,
+	const chromium::StringPiece& item_name,
+	request_fields_t* decoded,
+	std::vector<int16_t>* view,
+	std::string* decoded_item_name,
+	vta::batch_t* batch
+	)
+{
+	slab_pool_t::slab_t* slab = pool->Acquire();
+	const size_t length = encode_request (hdr, request, slab->data(), slab->capacity(), fields, view_by_fid, static_cast<int> (view_by_fid.size()), item_name);
+	if (0 == length) {
+		pool->Release (slab);
+		return false;
+	}
+/* Worker side. */
+	decode_request (hdr, request, slab->data(), slab->capacity(), decoded, view, decoded_item_name);
+	pool->Release (slab);
+	internal::parsed_item_name_t parsed;
+	if (decoded->abort || !internal::parse_item_name (*decoded_item_name, &parsed))
+		return false;
+	batch->clear();
+	batch->insert (parsed.symbol, reinterpret_cast<vta::intraday_t*> (decoded));
+	return true;
+}
+
+/* Field by field round trip, the full image, the capacity check and an abort request. */
+static
+void
+TestRequestCodec()
+{
+	slab_pool_t pool (kMaxRequestSize, 1);
+	MessageHeader hdr;
+	Request request;
+	request_fields_t fields, decoded;
+	fields.handle = UINT64_C(0x100000002);
+	fields.rwf_version = 14;
+	fields.token = -7;
+	fields.service_id = 65535;
+	fields.shard = 3;
+	fields.abort = false;
+	fields.use_attribinfo_in_updates = true;
+	fields.read_time = UINT64_C(0x123456789abcdef0);
+	fields.queue_time = 2;
+	std::vector<int_fast16_t> view_by_fid;
+	view_by_fid.push_back (INT16_MIN);
+	view_by_fid.push_back (22);
+	view_by_fid.push_back (INT16_MAX);
+	std::vector<int16_t> view (1, 99);
+	std::string item_name;
+	const chromium::StringPiece kItemName ("MSFT.O?open=1400000000&close=1400003600#rollup");
+	slab_pool_t::slab_t* slab = pool.Acquire();
+	const size_t length = encode_request (&hdr, &request, slab->data(), slab->capacity(), fields, view_by_fid, 3, kItemName);
+	EXPECT(request_length (3, kItemName.size()) == length);
+	decode_request (&hdr, &request, slab->data(), length, &decoded, &view, &item_name);
+	EXPECT(!decoded.abort);
+	EXPECT(fields.handle == decoded.handle);
+	EXPECT(fields.rwf_version == decoded.rwf_version);
+	EXPECT(fields.token == decoded.token);
+	EXPECT(fields.service_id == decoded.service_id);
+	EXPECT(fields.shard == decoded.shard);
+	EXPECT(decoded.use_attribinfo_in_updates);
+	EXPECT(fields.read_time == decoded.read_time);
+	EXPECT(fields.queue_time == decoded.queue_time);
+	EXPECT(3 == view.size() && INT16_MIN == view[0] && 22 == view[1] && INT16_MAX == view[2]);
+	EXPECT(kItemName == chromium::StringPiece (item_name));
+/* Full image: no view, only the leading view_count fields are sent. */
+	fields.use_attribinfo_in_updates = false;
+	encode_request (&hdr, &request, slab->data(), slab->capacity(), fields, view_by_fid, 0, chromium::StringPiece ("A"));
+	decode_request (&hdr, &request, slab->data(), slab->capacity(), &decoded, &view, &item_name);
+	EXPECT(view.empty() && "A" == item_name && !decoded.use_attribinfo_in_updates);
+/* Names beyond the slab are refused. */
+	const std::string long_name (kMaxRequestSize, 'X');
+	EXPECT(0 == encode_request (&hdr, &request, slab->data(), slab->capacity(), fields, view_by_fid, 3, long_name));
+	EXPECT(0 != encode_request (&hdr, &request, slab->data(), slab->capacity(), fields, view_by_fid, 0,
+		chromium::StringPiece (long_name.data(), slab->capacity() - request_length (0, 0))));
+/* Abort leaves the view and name alone. */
+	fields.abort = true;
+	view.assign (1, 99);
+	item_name.assign ("unchanged");
+	encode_request (&hdr, &request, slab->data(), slab->capacity(), fields, view_by_fid, 0, chromium::StringPiece());
+	decode_request (&hdr, &request, slab->data(), slab->capacity(), &decoded, &view, &item_name);
+	EXPECT(decoded.abort && 1 == view.size() && "unchanged" == item_name);
+	pool.Release (slab);
+}
+
+/* Members of one symbol are adjacent in insertion order, each symbol one range. */
+static
+void
+TestBatch()
+{
+	int analytics[vta::batch_t::kMaxSize];
+	static const char* kSymbols[] = { "A", "B", "A", "C", "B", "A" };
+	vta::batch_t batch;
+	EXPECT(batch.empty());
+	for (size_t i = 0; i < sizeof (kSymbols) / sizeof (kSymbols[0]); ++i)
+		batch.insert (kSymbols[i], reinterpret_cast<vta::intraday_t*> (&analytics[i]));
+	EXPECT(6 == batch.size() && 3 == batch.symbol_count());
+	auto a = batch.equal_range ("A");
+	EXPECT(3 == a.second - a.first);
+	EXPECT(a.first != a.second && reinterpret_cast<vta::intraday_t*> (&analytics[0]) == a.first[0].analytic);
+	EXPECT(3 == a.second - a.first && reinterpret_cast<vta::intraday_t*> (&analytics[5]) == a.first[2].analytic);
+	auto b = batch.equal_range ("B");
+	EXPECT(2 == b.second - b.first && reinterpret_cast<vta::intraday_t*> (&analytics[4]) == b.first[1].analytic);
+	auto c = batch.equal_range ("C");
+	EXPECT(1 == c.second - c.first && reinterpret_cast<vta::intraday_t*> (&analytics[3]) == c.first[0].analytic);
+	auto d = batch.equal_range ("D");
+	EXPECT(d.first == d.second);
+	size_t runs = 0;
+	for (auto it = batch.begin(); it != batch.end(); ++it)
+		if (batch.begin() == it || it[-1].symbol_name != it->symbol_name)
+			++runs;
+	EXPECT(batch.symbol_count() == runs);
+/* Full batch of distinct symbols. */
+	batch.clear();
+	std::vector<std::string> names;
+	for (int i = 0; i < vta::batch_t::kMaxSize; ++i)
+		names.push_back (std::string (1, static_cast<char> ('a' + i)));
+	for (int i = 0; i < vta::batch_t::kMaxSize; ++i)
+		batch.insert (names[i], reinterpret_cast<vta::intraday_t*> (&analytics[i]));
+	EXPECT(vta::batch_t::kMaxSize == batch.size() && vta::batch_t::kMaxSize == batch.symbol_count());
+	EXPECT(reinterpret_cast<vta::intraday_t*> (&analytics[7]) == batch.equal_range (names[7]).first->analytic);
+}
+
+int
+main (
+	int	argc,
+	char*	argv[]
+	)
+{
+	static const unsigned kIterations = 1000000;
+	static const unsigned kRequests = 100000;
+	TestBackwardShift();
+	TestAgainstUnorderedMap();
+	TestRequestCodec();
+	TestBatch();
+
+	using namespace boost::chrono;
+/* Event loop scratch, sized once at start up. */
+	internal::flat_map_t<uint64_t, uint64_t> in_flight (kOpenLimit);
+	internal::flat_set_t<int32_t> tokens (kOpenLimit);
+	slab_pool_t pool (kMaxRequestSize, 4);
+	MessageHeader hdr;
+	Request request;
+	request_fields_t fields, decoded_fields;
+	fields.handle = UINT64_C(0x100000002);
+	fields.rwf_version = 14;
+	fields.token = 7;
+	fields.service_id = 1;
+	fields.shard = 0;
+	fields.abort = false;
+	fields.use_attribinfo_in_updates = true;
+	fields.read_time = 1;
+	fields.queue_time = 2;
+/* As provider_t::view_by_fid_ and the reserved strings of worker_t::task_t. */
+	std::vector<int_fast16_t> view_by_fid;
+	std::vector<int16_t> view;
+	std::string item_name;
+	vta::batch_t batch;
+	view_by_fid.push_back (22);
+	view_by_fid.push_back (25);
+	view_by_fid.push_back (32);
+	view.reserve (256);
+	item_name.reserve (256);
+	const chromium::StringPiece kItemName ("MSFT.O?open=1400000000&close=1400003600#rollup");
+
+/* Benchmark: stream tokens and in-flight requests opened and closed. */
+	const size_t allocations = testing::allocation_count();
+	auto t0 = high_resolution_clock::now();
+	for (unsigned n = 0; n < kIterations; ++n) {
+		const int32_t token = static_cast<int32_t> (n);
+		tokens.insert (token);
+		if (n >= kOpenLimit)
+			tokens.erase (token - static_cast<int32_t> (kOpenLimit));
+	}
+	OpenCloseTokens (&in_flight, 1, 0, kIterations);
+	auto t1 = high_resolution_clock::now();
+	const size_t token_allocations = testing::allocation_count() - allocations;
+	EXPECT(kOpenLimit == tokens.size());
+	EXPECT(in_flight.empty());
+
+/* Benchmark: request encode, decode and batching through the slab pool. */
+	const size_t request_allocations_start = testing::allocation_count();
+	unsigned decoded = 0;
+	for (unsigned n = 0; n < kRequests; ++n) {
+		fields.token = static_cast<int32_t> (n);
+		if (DispatchRequest (&pool, &hdr, &request, fields, view_by_fid, kItemName, &decoded_fields, &view, &item_name, &batch))
+			++decoded;
+	}
+	auto t2 = high_resolution_clock::now();
+	const size_t request_allocations = testing::allocation_count() - request_allocations_start;
+	EXPECT(kRequests == decoded);
+	EXPECT(kRequests - 1 == static_cast<unsigned> (decoded_fields.token));
+	EXPECT(3 == view.size() && 22 == view[0] && 25 == view[1] && 32 == view[2]);
+	EXPECT(kItemName == chromium::StringPiece (item_name));
+	EXPECT(1 == batch.size() && "MSFT.O" == batch.begin()->symbol_name);
+	EXPECT(pool.allocated() == pool.available());
+
+/* Baseline: node based map, as replaced. */
+	std::unordered_map<uint64_t, uint64_t> node_map;
+	const size_t node_allocations_start = testing::allocation_count();
+	OpenCloseTokens (&node_map, 1, 0, kIterations);
+	auto t3 = high_resolution_clock::now();
+	const size_t node_allocations = testing::allocation_count() - node_allocations_start;
+
+	printf ("RequestPath: { "
+		"\"failures\": %d"
+		", \"tokens\": %u"
+		", \"tokenNs\": %.1f"
+		", \"tokenAllocations\": %u"
+		", \"requests\": %u"
+		", \"requestNs\": %.1f"
+		", \"requestAllocations\": %u"
+		", \"unorderedMapNs\": %.1f"
+		", \"unorderedMapAllocations\": %u"
+		" }\n",
+		g_failures,
+		kIterations,
+		static_cast<double> (duration_cast<nanoseconds> (t1 - t0).count()) / kIterations,
+		static_cast<unsigned> (token_allocations),
+		kRequests,
+		static_cast<double> (duration_cast<nanoseconds> (t2 - t1).count()) / kRequests,
+		static_cast<unsigned> (request_allocations),
+		static_cast<double> (duration_cast<nanoseconds> (t3 - t2).count()) / kIterations,
+		static_cast<unsigned> (node_allocations));
+	if (0 != token_allocations) {
+		fprintf (stderr, "FAIL: %u allocations opening and closing tokens.\n", static_cast<unsigned> (token_allocations));
+		++g_failures;
+	}
+	if (0 != request_allocations) {
+		fprintf (stderr, "FAIL: %u allocations encoding and decoding requests.\n", static_cast<unsigned> (request_allocations));
+		++g_failures;
+	}
+	return 0 == g_failures ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */
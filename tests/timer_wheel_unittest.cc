@@ -0,0 +1,313 @@
+/* Timer wheel tests and benchmark.
+ *
+ * Every expiry reported by the wheel is checked against a brute-force model holding each
+ * scheduled deadline in a flat list: an Advance must return exactly the entries due by the
+ * new time.  Directed cases cover the level boundaries, the same-slot wrap a full turn
+ * ahead, deadlines clamped beyond the wheel range and skipping empty stretches.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/* Boost Chrono. */
+#include <boost/chrono.hpp>
+
+#include "timer_wheel.hh"
+#include "alloc_hook.hh"
+
+typedef hitsuji::timer_wheel_t timer_wheel_t;
+
+/* Largest delta filed without clamping, 2^24 - 1 ticks. */
+static const uint64_t kMaxDelta = (UINT64_C(1) << 24) - 1;
+
+/* Deadline per entry as the wheel should honour it, 0 when not scheduled. */
+class model_t
+{
+public:
+	explicit model_t (size_t capacity)
+		: entries_ (capacity)
+		, deadlines_ (capacity, 0)
+		, now_ (0)
+	{
+		for (size_t i = 0; i < capacity; ++i)
+			entries_[i].context = reinterpret_cast<void*> (i);
+	}
+
+	void Initialize (uint64_t now) {
+		now_ = now;
+		wheel_.Initialize (now);
+	}
+	void Schedule (size_t i, uint64_t expiry) {
+		deadlines_[i] = (expiry > now_) ? expiry : now_ + 1;
+		wheel_.Schedule (&entries_[i], expiry);
+	}
+	void Cancel (size_t i) {
+		deadlines_[i] = 0;
+		wheel_.Cancel (&entries_[i]);
+	}
+
+/* Returns false when the wheel disagrees with the model.  With is_exact every expired entry
+ * must fall due at exactly the new time, as when stepping by NextTimeout.
+ */
+	bool Advance (uint64_t now, bool is_exact, const char* label) {
+		expired_.clear();
+		wheel_.Advance (now, &expired_);
+		bool is_equal = true;
+		for (auto it = expired_.begin(); it != expired_.end(); ++it) {
+			const size_t i = reinterpret_cast<size_t> ((*it)->context);
+			if (0 == deadlines_[i] || deadlines_[i] > now || (is_exact && deadlines_[i] != now)) {
+				fprintf (stderr, "FAIL %s: entry %u due %llu expired at %llu.\n", label,
+					static_cast<unsigned> (i), static_cast<unsigned long long> (deadlines_[i]), static_cast<unsigned long long> (now));
+				is_equal = false;
+			}
+			deadlines_[i] = 0;
+		}
+		size_t scheduled = 0;
+		for (size_t i = 0; i < deadlines_.size(); ++i) {
+			if (0 == deadlines_[i])
+				continue;
+			++scheduled;
+			if (deadlines_[i] <= now) {
+				fprintf (stderr, "FAIL %s: entry %u due %llu not expired at %llu.\n", label,
+					static_cast<unsigned> (i), static_cast<unsigned long long> (deadlines_[i]), static_cast<unsigned long long> (now));
+				is_equal = false;
+			}
+		}
+		if (scheduled != wheel_.size()) {
+			fprintf (stderr, "FAIL %s: wheel holds %u entries, expected %u.\n", label,
+				static_cast<unsigned> (wheel_.size()), static_cast<unsigned> (scheduled));
+			is_equal = false;
+		}
+		now_ = now;
+		return is_equal;
+	}
+
+/* Step by NextTimeout until the last deadline, every wake must be no later than the earliest
+ * deadline.
+ */
+	bool Drain (const char* label) {
+		while (wheel_.size() > 0) {
+			const int timeout = wheel_.NextTimeout();
+			const uint64_t earliest = Earliest();
+			if (timeout <= 0 || now_ + timeout > earliest) {
+				fprintf (stderr, "FAIL %s: timeout %d at %llu, earliest deadline %llu.\n", label,
+					timeout, static_cast<unsigned long long> (now_), static_cast<unsigned long long> (earliest));
+				return false;
+			}
+			const uint64_t now = now_ + timeout;
+			if (!Advance (now, now == earliest, label))
+				return false;
+		}
+		if (-1 != wheel_.NextTimeout()) {
+			fprintf (stderr, "FAIL %s: empty wheel timeout %d.\n", label, wheel_.NextTimeout());
+			return false;
+		}
+		return true;
+	}
+
+	uint64_t Earliest() const {
+		uint64_t earliest = UINT64_MAX;
+		for (auto it = deadlines_.begin(); it != deadlines_.end(); ++it)
+			if (0 != *it && *it < earliest)
+				earliest = *it;
+		return earliest;
+	}
+	uint64_t now() const {
+		return now_;
+	}
+	size_t size() const {
+		return wheel_.size();
+	}
+
+private:
+	timer_wheel_t wheel_;
+	std::vector<timer_wheel_t::entry_t> entries_;
+	std::vector<uint64_t> deadlines_;
+	std::vector<timer_wheel_t::entry_t*> expired_;
+	uint64_t now_;
+};
+
+/* Deltas either side of each level boundary and of the clamp. */
+static
+bool
+TestBoundaries()
+{
+	static const uint64_t kDeltas[] = {
+		0, 1, 2, 62, 63, 64, 65, 127, 128,
+		4095, 4096, 4097, 262143, 262144, 262145,
+		kMaxDelta - 1, kMaxDelta, kMaxDelta + 1, kMaxDelta + 64,
+		UINT64_C(1) << 26, (UINT64_C(1) << 30) + 12345
+	};
+	static const size_t kDeltaCount = sizeof (kDeltas) / sizeof (kDeltas[0]);
+/* Start times on and just off every level boundary. */
+	static const uint64_t kStarts[] = {
+		0, 1, 63, 64, 4095, 4096, 262143, 262144, 1000003, kMaxDelta, kMaxDelta + 1
+	};
+	bool is_passed = true;
+	for (size_t s = 0; s < sizeof (kStarts) / sizeof (kStarts[0]); ++s) {
+		model_t model (kDeltaCount);
+		model.Initialize (kStarts[s]);
+		for (size_t i = 0; i < kDeltaCount; ++i)
+			model.Schedule (i, kStarts[s] + kDeltas[i]);
+		is_passed &= model.Drain ("boundaries");
+	}
+	return is_passed;
+}
+
+/* A deadline 64 ticks ahead lands in the slot that fires this tick, it must wait a turn. */
+static
+bool
+TestSameSlotWrap()
+{
+	bool is_passed = true;
+	for (uint64_t start = 0; start < 130; ++start) {
+		model_t model (2);
+		model.Initialize (start);
+		model.Schedule (0, start + 64);
+		model.Schedule (1, start + 4096);
+		for (uint64_t now = start + 1; now <= start + 4096 && is_passed; ++now)
+			is_passed &= model.Advance (now, false, "wrap");
+	}
+	return is_passed;
+}
+
+/* Past and present deadlines fire on the next tick, never the current one. */
+static
+bool
+TestPastDeadlines()
+{
+	model_t model (3);
+	model.Initialize (1000);
+	model.Schedule (0, 0);
+	model.Schedule (1, 999);
+	model.Schedule (2, 1000);
+	bool is_passed = model.Advance (1000, false, "past");
+	is_passed &= model.Advance (1001, true, "past");
+	return is_passed && 0 == model.size();
+}
+
+/* One large jump over many levels, then a jump into the middle of the parked range. */
+static
+bool
+TestSkip()
+{
+	model_t model (4);
+	model.Initialize (5);
+	model.Schedule (0, 5 + 100);
+	model.Schedule (1, 5 + 300000);
+	model.Schedule (2, 5 + kMaxDelta + 1000);
+	model.Schedule (3, 5 + (UINT64_C(1) << 28));
+	bool is_passed = model.Advance (5 + 200000, false, "skip");
+	is_passed &= model.Advance (5 + kMaxDelta + 999, false, "skip");
+	is_passed &= model.Advance (5 + kMaxDelta + 1000, false, "skip");
+	is_passed &= model.Drain ("skip");
+	return is_passed;
+}
+
+/* Deterministic random mix of schedules, reschedules, cancels and advances. */
+static
+bool
+TestRandom()
+{
+	static const size_t kEntries = 512;
+	static const unsigned kRounds = 20000;
+	model_t model (kEntries);
+	uint64_t seed = UINT64_C(0x9e3779b97f4a7c15);
+	auto next = [&seed]() -> uint64_t {
+		seed ^= seed << 13;
+		seed ^= seed >> 7;
+		seed ^= seed << 17;
+		return seed;
+	};
+	model.Initialize (next() & 0xffffff);
+	bool is_passed = true;
+	for (unsigned round = 0; round < kRounds && is_passed; ++round) {
+		const size_t i = static_cast<size_t> (next() % kEntries);
+		const uint64_t r = next();
+		switch (r % 8) {
+		case 0:
+			model.Cancel (i);
+			break;
+		case 1:
+		case 2:
+		case 3:
+		case 4: {
+/* Deltas spread over every level and beyond the clamp. */
+			const unsigned bits = static_cast<unsigned> ((r >> 8) % 30);
+			model.Schedule (i, model.now() + ((r >> 16) & ((UINT64_C(1) << bits) - 1)));
+			break;
+		}
+		case 5:
+		case 6:
+			is_passed &= model.Advance (model.now() + ((r >> 8) % 200), false, "random");
+			break;
+		default:
+			is_passed &= model.Advance (model.now() + ((r >> 8) & ((UINT64_C(1) << ((r >> 40) % 26)) - 1)), false, "random");
+			break;
+		}
+	}
+	return is_passed && model.Drain ("random");
+}
+
+int
+main (
+	int	argc,
+	char*	argv[]
+	)
+{
+	int failures = 0;
+	if (!TestBoundaries()) ++failures;
+	if (!TestSameSlotWrap()) ++failures;
+	if (!TestPastDeadlines()) ++failures;
+	if (!TestSkip()) ++failures;
+	if (!TestRandom()) ++failures;
+/* Benchmark: keepalive pattern, every session re-arms its ping as it fires. */
+	static const size_t kSessions = 10000;
+	static const uint64_t kPingMs = 30000;
+	static const unsigned kTicks = 10 * kPingMs;
+	std::vector<timer_wheel_t::entry_t> entries (kSessions);
+	std::vector<timer_wheel_t::entry_t*> expired;
+	expired.reserve (kSessions);
+	timer_wheel_t wheel;
+	wheel.Initialize (0);
+	for (size_t i = 0; i < kSessions; ++i)
+		wheel.Schedule (&entries[i], 1 + (i * kPingMs) / kSessions);
+	using namespace boost::chrono;
+	size_t fired = 0;
+	const size_t allocations = testing::allocation_count();
+	auto t0 = high_resolution_clock::now();
+	for (uint64_t now = 1; now <= kTicks; ++now) {
+		expired.clear();
+		wheel.Advance (now, &expired);
+		for (auto it = expired.begin(); it != expired.end(); ++it)
+			wheel.Schedule (*it, now + kPingMs);
+		fired += expired.size();
+	}
+	auto t1 = high_resolution_clock::now();
+	const size_t wheel_allocations = testing::allocation_count() - allocations;
+	printf ("TimerWheel: { "
+		"\"failures\": %d"
+		", \"sessions\": %u"
+		", \"ticks\": %u"
+		", \"fired\": %u"
+		", \"tickNs\": %.1f"
+		", \"firedNs\": %.1f"
+		", \"allocations\": %u"
+		" }\n",
+		failures,
+		static_cast<unsigned> (kSessions),
+		kTicks,
+		static_cast<unsigned> (fired),
+		static_cast<double> (duration_cast<nanoseconds> (t1 - t0).count()) / kTicks,
+		static_cast<double> (duration_cast<nanoseconds> (t1 - t0).count()) / (fired ? fired : 1),
+		static_cast<unsigned> (wheel_allocations));
+	if (0 != wheel_allocations) {
+		fprintf (stderr, "FAIL: %u allocations re-arming timers.\n", static_cast<unsigned> (wheel_allocations));
+		++failures;
+	}
+	return 0 == failures ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */
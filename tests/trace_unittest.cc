@@ -0,0 +1,240 @@
+/* Trace dump tests.
+ *
+ * Records written to the rings must read back unchanged from a dump, oldest first after the
+ * ring has wrapped, and convert to one Chrome trace event each.  Dumps of another format,
+ * version or truncated are rejected.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "trace.hh"
+#include "trace_reader.hh"
+
+using namespace hitsuji;
+
+static int g_failures = 0;
+
+#define EXPECT(condition) \
+	do { \
+		if (!(condition)) { \
+			fprintf (stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+			++g_failures; \
+		} \
+	} while (0)
+
+static const char kDumpPath[] = "trace_unittest.dump";
+static const char kJsonPath[] = "trace_unittest.json";
+
+/* Returns the whole file, empty when absent. */
+static
+std::string
+ReadFile (
+	const char* path
+	)
+{
+	std::string contents;
+	FILE* fp = fopen (path, "rb");
+	if (nullptr == fp)
+		return contents;
+	char buffer[4096];
+	size_t length;
+	while ((length = fread (buffer, 1, sizeof (buffer), fp)) > 0)
+		contents.append (buffer, length);
+	fclose (fp);
+	return contents;
+}
+
+static
+void
+WriteFile (
+	const char* path,
+	const std::string& contents
+	)
+{
+	FILE* fp = fopen (path, "wb");
+	if (nullptr == fp)
+		return;
+	fwrite (contents.data(), 1, contents.size(), fp);
+	fclose (fp);
+}
+
+static
+bool
+ReadDump (
+	const char* path,
+	trace_file_header_t* header,
+	std::vector<trace_dump_ring_t>* rings
+	)
+{
+	FILE* fp = fopen (path, "rb");
+	if (nullptr == fp)
+		return false;
+	const bool is_read = ReadTraceDump (fp, header, rings);
+	fclose (fp);
+	return is_read;
+}
+
+static
+size_t
+CountOf (
+	const std::string& haystack,
+	const std::string& needle
+	)
+{
+	size_t count = 0;
+	for (size_t pos = haystack.find (needle); std::string::npos != pos; pos = haystack.find (needle, pos + needle.size()))
+		++count;
+	return count;
+}
+
+/* Records of both rings round trip field by field, the wrapped ring keeps its newest. */
+static
+void
+TestRoundTrip()
+{
+	trace_ring_t* worker = RegisterTraceRing ("worker", 8);
+	trace_ring_t* loop = RegisterTraceRing ("event loop with a name well over the limit", 4);
+	EXPECT(nullptr != worker);
+	EXPECT(nullptr != loop);
+	EXPECT(nullptr == RegisterTraceRing ("disabled", 0));
+	if (nullptr == worker || nullptr == loop)
+		return;
+	for (uint32_t i = 0; i < 20; ++i)
+		worker->Complete (kTraceFlexRecord, 1000 + i, static_cast<int32_t> (i), 5000 + (i * 100), 5000 + (i * 100) + 50, i);
+	loop->Begin (kTraceFlush, 4000, 7);
+	loop->Complete (kTraceWrite, UINT64_MAX, -3, 4100, 4100 + 0x100000000ULL, UINT32_MAX);
+	loop->End (kTraceFlush, 4200);
+
+	EXPECT(DumpTraceRings (kDumpPath));
+	trace_file_header_t header;
+	std::vector<trace_dump_ring_t> rings;
+	EXPECT(ReadDump (kDumpPath, &header, &rings));
+	EXPECT(kTraceVersion == header.version);
+	EXPECT(sizeof (trace_record_t) == header.record_size);
+	EXPECT(2 == header.ring_count);
+	EXPECT(2 == rings.size());
+	if (2 != rings.size())
+		return;
+
+/* Wrapped: a dump while the writer may be mid-record drops the oldest slot as well. */
+	const trace_dump_ring_t& dumped_worker = rings[0];
+	EXPECT(0 == strcmp ("worker", dumped_worker.header.name));
+	EXPECT(worker->thread_id() == dumped_worker.header.thread_id);
+	EXPECT(7 == dumped_worker.header.record_count);
+	EXPECT(7 == dumped_worker.records.size());
+	for (size_t i = 0; i < dumped_worker.records.size(); ++i) {
+		const trace_record_t& record = dumped_worker.records[i];
+		const uint32_t sequence = static_cast<uint32_t> (13 + i);
+		EXPECT(5000 + (sequence * 100) == record.timestamp);
+		EXPECT(1000 + sequence == record.handle);
+		EXPECT(50 == record.duration);
+		EXPECT(static_cast<int32_t> (sequence) == record.token);
+		EXPECT(kTraceFlexRecord == record.event);
+		EXPECT(kTraceComplete == record.phase);
+		EXPECT(sequence == record.value);
+	}
+
+	const trace_dump_ring_t& dumped_loop = rings[1];
+	EXPECT(kTraceMaxNameLength - 1 == strlen (dumped_loop.header.name));
+	EXPECT(0 == strncmp ("event loop with a name well over the limit", dumped_loop.header.name, kTraceMaxNameLength - 1));
+	EXPECT(3 == dumped_loop.records.size());
+	if (3 == dumped_loop.records.size()) {
+		EXPECT(kTraceFlush == dumped_loop.records[0].event);
+		EXPECT(kTraceBegin == dumped_loop.records[0].phase);
+		EXPECT(4000 == dumped_loop.records[0].timestamp);
+		EXPECT(7 == dumped_loop.records[0].value);
+		EXPECT(kTraceWrite == dumped_loop.records[1].event);
+		EXPECT(UINT64_MAX == dumped_loop.records[1].handle);
+		EXPECT(-3 == dumped_loop.records[1].token);
+		EXPECT(UINT32_MAX == dumped_loop.records[1].duration);
+		EXPECT(UINT32_MAX == dumped_loop.records[1].value);
+		EXPECT(kTraceEnd == dumped_loop.records[2].phase);
+	}
+
+/* One thread name per ring and one event per record, relative to the earliest record. */
+	FILE* fp = fopen (kJsonPath, "wb");
+	EXPECT(nullptr != fp);
+	if (nullptr != fp) {
+		WriteTraceJson (fp, header, rings);
+		fclose (fp);
+	}
+	const std::string json = ReadFile (kJsonPath);
+	EXPECT(0 == json.find ("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+	EXPECT(2 == CountOf (json, "\"name\":\"thread_name\""));
+	EXPECT(std::string::npos != json.find ("\"args\":{\"name\":\"worker\"}"));
+	EXPECT(10 == CountOf (json, "\"cat\":\"hitsuji\""));
+	EXPECT(7 == CountOf (json, "\"name\":\"FlexRecord\""));
+	EXPECT(8 == CountOf (json, "\"ph\":\"X\""));
+	EXPECT(8 == CountOf (json, "\"dur\":"));
+	EXPECT(std::string::npos != json.find ("\"name\":\"Flush\",\"cat\":\"hitsuji\",\"ph\":\"B\",\"ts\":0.000,"));
+	EXPECT(std::string::npos != json.find ("\"dur\":4294967.295"));
+	EXPECT(std::string::npos != json.find ("\"token\":-3"));
+	EXPECT(json.size() >= 4 && 0 == json.compare (json.size() - 4, 4, "\n]}\n"));
+
+	UnregisterTraceRing (worker);
+	UnregisterTraceRing (loop);
+	EXPECT(DumpTraceRings (kDumpPath));
+	EXPECT(ReadDump (kDumpPath, &header, &rings));
+	EXPECT(0 == header.ring_count);
+	EXPECT(rings.empty());
+}
+
+/* Foreign, newer and cut short dumps are refused. */
+static
+void
+TestRejected()
+{
+	trace_ring_t* ring = RegisterTraceRing ("rejected", 4);
+	if (nullptr != ring)
+		ring->Complete (kTraceEncode, 1, 2, 100, 200, 3);
+	EXPECT(DumpTraceRings (kDumpPath));
+	UnregisterTraceRing (ring);
+	const std::string dump = ReadFile (kDumpPath);
+	EXPECT(sizeof (trace_file_header_t) + sizeof (trace_ring_header_t) + sizeof (trace_record_t) == dump.size());
+	trace_file_header_t header;
+	std::vector<trace_dump_ring_t> rings;
+	EXPECT(ReadDump (kDumpPath, &header, &rings));
+
+	std::string bad_magic (dump);
+	bad_magic[0] = 'X';
+	WriteFile (kDumpPath, bad_magic);
+	EXPECT(!ReadDump (kDumpPath, &header, &rings));
+
+	std::string bad_version (dump);
+	const uint32_t version = kTraceVersion + 1;
+	memcpy (&bad_version[offsetof (trace_file_header_t, version)], &version, sizeof (version));
+	WriteFile (kDumpPath, bad_version);
+	EXPECT(!ReadDump (kDumpPath, &header, &rings));
+
+	std::string bad_record_size (dump);
+	const uint32_t record_size = sizeof (trace_record_t) + 8;
+	memcpy (&bad_record_size[offsetof (trace_file_header_t, record_size)], &record_size, sizeof (record_size));
+	WriteFile (kDumpPath, bad_record_size);
+	EXPECT(!ReadDump (kDumpPath, &header, &rings));
+
+	for (size_t length = 0; length < dump.size(); ++length) {
+		WriteFile (kDumpPath, dump.substr (0, length));
+		EXPECT(!ReadDump (kDumpPath, &header, &rings));
+	}
+}
+
+int
+main (
+	int	argc,
+	char*	argv[]
+	)
+{
+	TestRoundTrip();
+	TestRejected();
+	remove (kDumpPath);
+	remove (kJsonPath);
+	printf ("Trace: { \"failures\": %d }\n", g_failures);
+	return 0 == g_failures ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */